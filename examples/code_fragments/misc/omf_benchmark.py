@@ -0,0 +1,43 @@
+# Times OMF encoding and decoding of a large structure. Run with
+#
+#   ost omf_benchmark.py [num_atoms] [num_runs]
+#
+# The atoms follow a random walk with 3.8 A steps, which gives delta
+# distributions similar to real protein chains.
+
+import random
+import sys
+import time
+
+from ost import geom, io, mol
+
+num_atoms = int(sys.argv[1]) if len(sys.argv) > 1 else 200000
+num_runs = int(sys.argv[2]) if len(sys.argv) > 2 else 20
+
+random.seed(42)
+ent = mol.CreateEntity()
+ed = ent.EditXCS(mol.BUFFERED_EDIT)
+ch = ed.InsertChain("A")
+pos = geom.Vec3()
+for i in range(num_atoms):
+  if i % 10 == 0:
+    res = ed.AppendResidue(ch, "GLY")
+  step = geom.Vec3(random.gauss(0, 1), random.gauss(0, 1), random.gauss(0, 1))
+  pos += 3.8 * geom.Normalize(step)
+  ed.InsertAtom(res, "X%d" % (i % 10), pos, "C", 1.0, random.uniform(5, 80))
+ed.UpdateICS()
+
+omf = io.OMF.FromEntity(ent)
+data = omf.ToBytes()
+
+def Time(func):
+  times = []
+  for i in range(num_runs):
+    start = time.perf_counter()
+    func()
+    times.append(time.perf_counter() - start)
+  return 1000 * sum(times) / len(times)
+
+print("%d atoms, %d bytes, mean of %d runs" % (num_atoms, len(data), num_runs))
+print("OMF.FromBytes %8.2f ms" % Time(lambda: io.OMF.FromBytes(data)))
+print("OMF.ToBytes   %8.2f ms" % Time(lambda: omf.ToBytes()))
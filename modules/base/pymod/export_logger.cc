@@ -31,6 +31,14 @@ using namespace boost::python;
 
 using namespace ost;
 
+class ScopedGILState {
+public:
+  ScopedGILState(): state_(PyGILState_Ensure()) { }
+  ~ScopedGILState() { PyGILState_Release(state_); }
+private:
+  PyGILState_STATE state_;
+};
+
 struct PyLogSink: public LogSink {
 
 };
@@ -40,6 +48,8 @@ struct WrappedLogSink : public PyLogSink, public wrapper<PyLogSink> {
   { }
   virtual void LogMessage(const String& message , int severity) 
   {
+    // messages may be logged from worker threads that don't hold the GIL
+    ScopedGILState gil;
     call_method<void>(self_, "LogMessage", message, severity);
   }
   
@@ -0,0 +1,132 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_PARALLEL_FOR_HH
+#define OST_PARALLEL_FOR_HH
+
+#include <algorithm>
+#include <exception>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <ost/message.hh>
+
+namespace ost {
+
+namespace detail {
+
+// hands out the chunks one at a time, so threads that happen to get cheap
+// chunks don't idle. No chunks are handed out after the first error.
+class ChunkQueue {
+public:
+  ChunkQueue(size_t num_items, size_t chunk_size):
+    num_items_(num_items), chunk_size_(chunk_size), next_(0)
+  { }
+
+  bool Next(size_t& begin, size_t& end)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (next_>=num_items_ || !error_.empty()) {
+      return false;
+    }
+    begin=next_;
+    end=std::min(num_items_, begin+chunk_size_);
+    next_=end;
+    return true;
+  }
+
+  void SetError(const String& error)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (error_.empty()) {
+      error_=error;
+    }
+  }
+
+  const String& GetError() const { return error_; }
+private:
+  size_t       num_items_;
+  size_t       chunk_size_;
+  size_t       next_;
+  String       error_;
+  boost::mutex mutex_;
+};
+
+template <typename F>
+class ChunkWorker {
+public:
+  ChunkWorker(ChunkQueue& queue, const F& work): queue_(queue), work_(work) { }
+
+  void operator()()
+  {
+    size_t begin=0, end=0;
+    while (queue_.Next(begin, end)) {
+      try {
+        work_(begin, end);
+      } catch (std::exception& e) {
+        queue_.SetError(e.what());
+        return;
+      }
+    }
+  }
+private:
+  ChunkQueue& queue_;
+  F           work_;
+};
+
+}
+
+/// \brief calls work(begin, end) for every chunk [begin, end) of chunk_size
+///        consecutive items in [0, num_items) on num_threads threads
+///
+/// If num_threads is 0, one thread per core is used. Every thread calls its
+/// own copy of work, which may therefore keep per-thread scratch space. Since
+/// chunks are processed concurrently, work must only write to per-item or
+/// per-chunk results. If work throws, no further chunks are started and the
+/// message of the first exception is rethrown as an Error once all threads
+/// are done. With a single thread, the chunks are processed in order on the
+/// calling thread and exceptions pass unchanged.
+template <typename F>
+void ParallelForChunks(size_t num_items, size_t chunk_size, int num_threads,
+                       F work)
+{
+  chunk_size=std::max(size_t(1), chunk_size);
+  size_t num_chunks=(num_items+chunk_size-1)/chunk_size;
+  if (num_threads<=0) {
+    num_threads=std::max(1u, boost::thread::hardware_concurrency());
+  }
+  num_threads=std::min(static_cast<size_t>(num_threads), num_chunks);
+  if (num_threads<=1) {
+    for (size_t begin=0; begin<num_items; begin+=chunk_size) {
+      work(begin, std::min(num_items, begin+chunk_size));
+    }
+    return;
+  }
+  detail::ChunkQueue queue(num_items, chunk_size);
+  boost::thread_group threads;
+  for (int i=0; i<num_threads; ++i) {
+    threads.create_thread(detail::ChunkWorker<F>(queue, work));
+  }
+  threads.join_all();
+  if (!queue.GetError().empty()) {
+    throw Error(queue.GetError());
+  }
+}
+
+}
+
+#endif
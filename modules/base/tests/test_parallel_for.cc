@@ -0,0 +1,85 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#include <vector>
+#include <ost/parallel_for.hh>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace ost;
+
+namespace {
+
+struct MarkChunks {
+  MarkChunks(std::vector<int>& visited, std::vector<size_t>& chunk_begin):
+    visited(visited), chunk_begin(chunk_begin)
+  { }
+
+  void operator()(size_t begin, size_t end)
+  {
+    for (size_t i=begin; i<end; ++i) {
+      visited[i]+=1;
+      chunk_begin[i]=begin;
+    }
+  }
+  std::vector<int>&    visited;
+  std::vector<size_t>& chunk_begin;
+};
+
+struct FailOnItem {
+  FailOnItem(size_t item): item(item) { }
+
+  void operator()(size_t begin, size_t end)
+  {
+    if (begin<=item && item<end) {
+      throw Error("failed");
+    }
+  }
+  size_t item;
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE(base);
+
+BOOST_AUTO_TEST_CASE(parallel_for_chunks)
+{
+  for (int num_threads=0; num_threads<=4; ++num_threads) {
+    std::vector<int> visited(103, 0);
+    std::vector<size_t> chunk_begin(103, 0);
+    ParallelForChunks(visited.size(), 10, num_threads,
+                      MarkChunks(visited, chunk_begin));
+    for (size_t i=0; i<visited.size(); ++i) {
+      BOOST_CHECK_EQUAL(visited[i], 1);
+      BOOST_CHECK_EQUAL(chunk_begin[i], (i/10)*10);
+    }
+  }
+  // nothing to do
+  std::vector<int> visited;
+  std::vector<size_t> chunk_begin;
+  ParallelForChunks(0, 10, 4, MarkChunks(visited, chunk_begin));
+}
+
+BOOST_AUTO_TEST_CASE(parallel_for_chunks_error)
+{
+  BOOST_CHECK_THROW(ParallelForChunks(100, 1, 1, FailOnItem(50)), Error);
+  BOOST_CHECK_THROW(ParallelForChunks(100, 1, 4, FailOnItem(50)), Error);
+  BOOST_CHECK_NO_THROW(ParallelForChunks(100, 1, 4, FailOnItem(100)));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
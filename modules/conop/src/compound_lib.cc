@@ -221,6 +221,7 @@ String CompoundLib::GetOSTVersionUsed() {
 
 void CompoundLib::AddCompound(const CompoundPtr& compound)
 {
+  boost::mutex::scoped_lock lock(mutex_);
   sqlite3_stmt* stmt=NULL;  
   int retval=sqlite3_prepare_v2(db_->ptr, INSERT_COMPOUND_STATEMENT, 
                                 strlen(INSERT_COMPOUND_STATEMENT), &stmt, NULL);
@@ -427,6 +428,7 @@ void CompoundLib::LoadAtomsFromDB(CompoundPtr comp, int pk) const {
 }
 void CompoundLib::ClearCache()
 {
+  boost::mutex::scoped_lock lock(mutex_);
   compound_cache_.clear();
 }
 
@@ -456,6 +458,7 @@ void CompoundLib::LoadBondsFromDB(CompoundPtr comp, int pk) const {
 
 CompoundPtr CompoundLib::FindCompound(const String& id, 
                                       Compound::Dialect dialect) const {
+  boost::mutex::scoped_lock lock(mutex_);
   CompoundMap::const_iterator i=compound_cache_.find(id);
   if (i!=compound_cache_.end()) {
     return i->second;
@@ -21,6 +21,7 @@
 
 #include <map>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "module_config.hh"
 #include "compound.hh"
@@ -55,6 +56,9 @@ private:
   struct Database;
   Database* db_;
   mutable CompoundMap       compound_cache_;
+  // guards the cache and the database connection, so processors running on
+  // several threads can share the library
+  mutable boost::mutex      mutex_;
   bool                      chem_type_available_; // wether pdbx_type is available in db
   bool                      name_available_; // wether name is available in db
   bool                      inchi_available_; //whether inchi is available in db
@@ -209,7 +209,7 @@ def SavePDB(models, filename, dialect=None,  pqr=False, profile='DEFAULT'):
   if isinstance(profile, str):
     profile=profiles[profile].Copy()
   elif isinstance(profile, IOProfile):
-    profile.Copy()
+    profile=profile.Copy()
   else:
     raise TypeError('profile must be of type string or IOProfile, '+\
                     'instead of %s'%type(profile))
@@ -221,6 +221,34 @@ def SavePDB(models, filename, dialect=None,  pqr=False, profile='DEFAULT'):
   for model in models:
     writer.Write(model)
 
+def SaveMMCIF(ent, filename, info=None, data_name=None):
+  """
+  Save entity to disk in mmCIF format. Files ending in .gz are compressed.
+
+  Chain names are written as label_asym_id, the pdb_auth_chain_name string
+  property of the chains (set by :func:`LoadMMCIF`) as auth_asym_id. Only the
+  current position of atoms with alternative locations is written. Residue
+  numbers are written as auth_seq_id, polymer residues get a label_seq_id
+  counting from 1 along the chain. :func:`LoadMMCIF` numbers polymer residues
+  by label_seq_id, so reading the file back renumbers them from 1.
+
+  :param ent: The entity (handle or view) to be saved
+  :param filename: The filename
+  :type  filename: string
+  :param info: Entity ids and biounits to write, e.g. as returned by
+               :func:`LoadMMCIF`. Chains without entity id get an entity of
+               their own.
+  :type  info: :class:`MMCifInfo`
+  :param data_name: Name of the data block, defaults to the entity name
+  :type  data_name: string
+  """
+  writer=MMCifWriter(filename)
+  if info:
+    writer.SetInfo(info)
+  if data_name:
+    writer.SetDataName(data_name)
+  writer.Write(ent)
+
 try:
   from ost import img
   LoadMap = LoadImage
@@ -251,8 +279,9 @@ def LoadCHARMMTraj(crd, dcd_file=None, profile='CHARMM',
   :param dcd_file: The filename of the DCD file. If not set, and crd is a 
       string, the filename is set to the <crd>.dcd
   :param layz_load: Whether the trajectory should be loaded on demand. Instead 
-      of loading the complete trajectory into memory, the trajectory frames are 
-      loaded from disk when requested.
+      of loading the complete trajectory into memory, the file is memory-mapped
+      and the trajectory frames are decoded when requested. The 16 most 
+      recently used frames are cached.
   :param stride: The spacing of the frames to load. When set to 2, for example, 
       every second frame is loaded from the trajectory. By default, every frame 
       is loaded.
@@ -275,7 +304,7 @@ def LoadCHARMMTraj(crd, dcd_file=None, profile='CHARMM',
       raise ValueError("No DCD filename given")
   return LoadCHARMMTraj_(crd, dcd_file, stride, lazy_load, detect_swap, swap_bytes)
 
-def LoadMMCIF(filename, fault_tolerant=None, calpha_only=None, profile='DEFAULT', remote=False, seqres=False, info=False):
+def LoadMMCIF(filename, fault_tolerant=None, calpha_only=None, profile='DEFAULT', remote=False, seqres=False, info=False, categories=None, atom_site_items=None, num_threads=1):
   """
   Load a mmCIF file and return one or more entities. Several options allow to
   customize the exact behaviour of the mmCIF import. For more information on
@@ -305,6 +334,28 @@ def LoadMMCIF(filename, fault_tolerant=None, calpha_only=None, profile='DEFAULT'
   :param info: Whether to return an info container with the other output.
                If True, a :class:`MMCifInfo` object is returned as last item.
 
+  :param categories: If given, only these mmCIF categories are read, all other
+                     loops are skipped without converting their values. The
+                     atom_site category is always read. Note that chain types
+                     need *entity*, SEQRES needs *entity* and *entity_poly*
+                     and secondary structure needs *struct_conf* and
+                     *struct_sheet_range*. The :class:`MMCifInfo` object only
+                     holds information from the read categories.
+  :type categories: :class:`list` of :class:`str`
+
+  :param atom_site_items: If given, only these of the optional atom_site items
+                          *occupancy*, *B_iso_or_equiv* and *group_PDB* are
+                          read. Atoms get an occupancy of 1, a B-factor of 0
+                          and are not flagged as HETATM otherwise. Items
+                          needed to build the entity are always read.
+  :type atom_site_items: :class:`list` of :class:`str`
+
+  :param num_threads: Number of threads used to split large loops, like
+                      atom_site of big structures, into values. 0 means one
+                      thread per core. Rows are still added to the entity one
+                      after the other.
+  :type num_threads: :class:`int`
+
   :raises: :exc:`~ost.io.IOException` if the import fails due to an erroneous
            or non-existent file.
   """
@@ -330,6 +381,11 @@ def LoadMMCIF(filename, fault_tolerant=None, calpha_only=None, profile='DEFAULT'
     ent = mol.CreateEntity()
     reader = MMCifReader(filename, ent, prof)
     reader.read_seqres = seqres
+    reader.num_threads = num_threads
+    if categories:
+      reader.categories = list(categories)
+    if atom_site_items:
+      reader.atom_site_items = list(atom_site_items)
     
     # NOTE: to speed up things, we could introduce a restrict_chains parameter
     #       similar to the one in LoadPDB. Here, it would have to be a list/set
@@ -352,6 +408,33 @@ def LoadMMCIF(filename, fault_tolerant=None, calpha_only=None, profile='DEFAULT'
   except:
     raise
 
+def LoadEntityBatch(filenames, profile='DEFAULT', num_threads=0,
+                    max_in_flight=0, ordered=True):
+  """
+  Load many structure files on several threads. This is a generator yielding
+  a tuple (filename, entity) per file. The entity is None if the file could
+  not be loaded, the reason is logged as an error. See :class:`BatchLoader`
+  for a description of the parameters.
+
+  .. code-block:: python
+
+    for filename, ent in io.LoadEntityBatch(glob.glob('models/*.cif.gz')):
+      if ent:
+        print(filename, ent.atom_count)
+  """
+  if isinstance(profile, str):
+    prof = profiles[profile].Copy()
+  else:
+    prof = profile.Copy()
+  loader = BatchLoader(list(filenames), prof, num_threads, max_in_flight,
+                       ordered)
+  while loader.HasNext():
+    result = loader.Next()
+    if result.ent.IsValid():
+      yield result.filename, result.ent
+    else:
+      yield result.filename, None
+
 # this function uses a dirty trick: should be a member of MMCifInfoBioUnit
 # which is totally C++, but we want the method in Python... so we define it
 # here (__init__) and add it as a member to the class. With this, the first
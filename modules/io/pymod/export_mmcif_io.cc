@@ -26,6 +26,7 @@ using namespace boost::python;
 #include <ost/io/mol/io_profile.hh>
 #include <ost/io/mol/mmcif_reader.hh>
 #include <ost/io/mol/mmcif_info.hh>
+#include <ost/io/mol/mmcif_writer.hh>
 using namespace ost;
 using namespace ost::io;
 using namespace ost::mol;
@@ -44,6 +45,36 @@ boost::python::list WrapGetNames(MMCifInfo *p){
   return VecToList<String>(names);
 }
 
+template<typename T>
+std::vector<T> ListToVec(const boost::python::list& l){
+  std::vector<T> vec;
+  for(int i=0;i<boost::python::len(l);++i){
+    vec.push_back(boost::python::extract<T>(l[i]));
+  }
+  return vec;
+}
+
+void (MMCifWriter::*mmcif_write_a)(const mol::EntityHandle&)=&MMCifWriter::Write;
+void (MMCifWriter::*mmcif_write_b)(const mol::EntityView&)=&MMCifWriter::Write;
+
+boost::python::list WrapGetCategories(MMCifReader *p){
+  std::vector<String> categories = p->GetCategories();
+  return VecToList<String>(categories);
+}
+
+void WrapSetCategories(MMCifReader *p, const boost::python::list& l){
+  p->SetCategories(ListToVec<String>(l));
+}
+
+boost::python::list WrapGetAtomSiteItems(MMCifReader *p){
+  std::vector<String> items = p->GetAtomSiteItems();
+  return VecToList<String>(items);
+}
+
+void WrapSetAtomSiteItems(MMCifReader *p, const boost::python::list& l){
+  p->SetAtomSiteItems(ListToVec<String>(l));
+}
+
 void export_mmcif_io()
 {
   class_<MMCifReader, boost::noncopyable>("MMCifReader", init<const String&, EntityHandle&, const IOProfile&>())
@@ -57,6 +88,17 @@ void export_mmcif_io()
                   make_function(&MMCifReader::GetRestrictChains,
                                 return_value_policy<copy_const_reference>()),
                   &MMCifReader::SetRestrictChains)
+    .def("SetCategories", &WrapSetCategories)
+    .def("GetCategories", &WrapGetCategories)
+    .def("SetAtomSiteItems", &WrapSetAtomSiteItems)
+    .def("GetAtomSiteItems", &WrapGetAtomSiteItems)
+    .add_property("categories", &WrapGetCategories, &WrapSetCategories)
+    .add_property("atom_site_items", &WrapGetAtomSiteItems,
+                  &WrapSetAtomSiteItems)
+    .def("SetNumThreads", &MMCifReader::SetNumThreads)
+    .def("GetNumThreads", &MMCifReader::GetNumThreads)
+    .add_property("num_threads", &MMCifReader::GetNumThreads,
+                  &MMCifReader::SetNumThreads)
     .add_property("seqres", &MMCifReader::GetSeqRes)
     .add_property("read_seqres", &MMCifReader::GetReadSeqRes, 
                   &MMCifReader::SetReadSeqRes)
@@ -64,6 +106,20 @@ void export_mmcif_io()
                                    return_value_policy<copy_const_reference>()))
     ;
 
+  class_<MMCifWriter, boost::noncopyable>("MMCifWriter", init<String>())
+    .def("Write", mmcif_write_a)
+    .def("Write", mmcif_write_b)
+    .def("SetDataName", &MMCifWriter::SetDataName)
+    .def("GetDataName", &MMCifWriter::GetDataName,
+         return_value_policy<copy_const_reference>())
+    .def("SetInfo", &MMCifWriter::SetInfo)
+    .def("GetInfo", &MMCifWriter::GetInfo,
+         return_value_policy<copy_const_reference>())
+    .add_property("data_name", make_function(&MMCifWriter::GetDataName,
+                                   return_value_policy<copy_const_reference>()),
+                  &MMCifWriter::SetDataName)
+  ;
+
   enum_<MMCifInfoCitation::MMCifInfoCType>("MMCifInfoCType")
     .value("Journal", MMCifInfoCitation::JOURNAL)
     .value("Book", MMCifInfoCitation::BOOK)
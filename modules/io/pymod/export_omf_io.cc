@@ -31,6 +31,29 @@ namespace{
     return PyBytes_FromStringAndSize(str.c_str(), str.size());
   }
   
+  PyObject* wrap_to_indexed_bytes(OMFPtr omf, bool compress) {
+    String str = omf->ToIndexedString(compress);
+    return PyBytes_FromStringAndSize(str.c_str(), str.size());
+  }
+
+  boost::python::list wrap_get_chain_names(OMFPtr omf) {
+    std::vector<String> names = omf->GetChainNames();
+    boost::python::list return_list;
+    for(auto it = names.begin(); it != names.end(); ++it) {
+      return_list.append(*it);
+    }
+    return return_list;
+  }
+
+  boost::python::list wrap_get_ids(OMFArchivePtr archive) {
+    const std::vector<String>& ids = archive->GetIds();
+    boost::python::list return_list;
+    for(auto it = ids.begin(); it != ids.end(); ++it) {
+      return_list.append(*it);
+    }
+    return return_list;
+  }
+
   OMFPtr wrap_from_bytes(boost::python::object obj) {
     String str(PyBytes_AsString(obj.ptr()), PyBytes_Size(obj.ptr()));
     return OMF::FromString(str);
@@ -46,8 +69,31 @@ void export_omf_io() {
     .def("FromBytes", &wrap_from_bytes).staticmethod("FromBytes")
     .def("ToFile", &OMF::ToFile)
     .def("ToBytes", &wrap_to_bytes)
+    .def("ToIndexedFile", &OMF::ToIndexedFile, (arg("filepath"),
+                                                arg("compress")=false))
+    .def("ToIndexedBytes", &wrap_to_indexed_bytes, (arg("compress")=false))
+    .def("GetChainNames", &wrap_get_chain_names)
     .def("GetAU", &OMF::GetAU)
     .def("GetAUChain", &OMF::GetAUChain)
     .def("GetBU", &OMF::GetBU)
   ;
+
+  class_<OMFArchiveWriter, boost::noncopyable>("OMFArchiveWriter",
+                                               init<const String&, bool>(
+                                               (arg("filepath"),
+                                                arg("compress")=false)))
+    .def("Add", &OMFArchiveWriter::Add, (arg("id"), arg("omf")))
+    .def("Close", &OMFArchiveWriter::Close)
+  ;
+
+  class_<OMFArchive, OMFArchivePtr>("OMFArchive", no_init)
+    .def("FromFile", &OMFArchive::FromFile).staticmethod("FromFile")
+    .def("GetSize", &OMFArchive::GetSize)
+    .def("__len__", &OMFArchive::GetSize)
+    .def("GetIds", &wrap_get_ids)
+    .def("HasEntry", &OMFArchive::HasEntry)
+    .def("__contains__", &OMFArchive::HasEntry)
+    .def("GetEntry", &OMFArchive::GetEntry)
+    .def("GetEntryByIndex", &OMFArchive::GetEntryByIndex)
+  ;
 }
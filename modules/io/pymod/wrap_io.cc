@@ -33,6 +33,8 @@ using namespace boost::python;
 #include <ost/io/mol/entity_io_sdf_handler.hh>
 #include <ost/io/mol/pdb_reader.hh>
 #include <ost/io/mol/dcd_io.hh>
+#include <ost/io/mol/compressed_traj_io.hh>
+#include <ost/io/mol/batch_loader.hh>
 #include <ost/io/stereochemical_params_reader.hh>
 using namespace ost;
 using namespace ost::io;
@@ -62,6 +64,48 @@ BOOST_PYTHON_FUNCTION_OVERLOADS(save_entity_handle_ov,
 BOOST_PYTHON_FUNCTION_OVERLOADS(save_entity_view_ov,
                                 save_ent_view, 2, 3)
 
+// the GIL is released while waiting for the workers of the BatchLoader, so
+// they can log to sinks implemented in Python
+class ScopedGILRelease {
+public:
+  ScopedGILRelease(): state_(PyEval_SaveThread()) { }
+  ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+private:
+  PyThreadState* state_;
+};
+
+void delete_batch_loader(BatchLoader* loader)
+{
+  ScopedGILRelease release;
+  delete loader;
+}
+
+typedef boost::shared_ptr<BatchLoader> BatchLoaderPtr;
+
+BatchLoaderPtr batch_loader_init(const list& filenames, const IOProfile& profile,
+                                 int num_threads, size_t max_in_flight,
+                                 bool ordered)
+{
+  std::vector<String> fn_vec;
+  for (int i=0; i<len(filenames); ++i) {
+    fn_vec.push_back(extract<String>(filenames[i]));
+  }
+  return BatchLoaderPtr(new BatchLoader(fn_vec, profile, num_threads,
+                                        max_in_flight, ordered),
+                        &delete_batch_loader);
+}
+
+BatchLoadResult batch_loader_next(BatchLoader& loader)
+{
+  ScopedGILRelease release;
+  return loader.Next();
+}
+
+mol::CoordGroupHandle mapped_dcd_to_coord_group(MappedDCDCoordSourcePtr source)
+{
+  return mol::CoordGroupHandle(source);
+}
+
 ost::mol::alg::StereoChemicalProps (*read_props_a)(String filename, bool check) = &ReadStereoChemicalPropsFile;
 ost::mol::alg::StereoChemicalProps (*read_props_b)(bool check) = &ReadStereoChemicalPropsFile;
 
@@ -122,6 +166,25 @@ BOOST_PYTHON_MODULE(_ost_io)
                                            arg("stride")=1, arg("lazy_load")=false,
                                            arg("detect_swap")=true,arg("swap_bytes")=false))
 ;
+  class_<MappedDCDCoordSource, MappedDCDCoordSourcePtr, 
+         boost::noncopyable>("MappedDCDCoordSource", no_init)
+    .def("GetFrameCount", &MappedDCDCoordSource::GetFrameCount)
+    .def("IsByteSwapped", &MappedDCDCoordSource::IsByteSwapped)
+    .def("GetCacheSize", &MappedDCDCoordSource::GetCacheSize)
+    .def("SetCacheSize", &MappedDCDCoordSource::SetCacheSize)
+    .def("GetPrefetch", &MappedDCDCoordSource::GetPrefetch)
+    .def("SetPrefetch", &MappedDCDCoordSource::SetPrefetch)
+    .def("CreateCoordGroup", &mapped_dcd_to_coord_group)
+    .add_property("frame_count", &MappedDCDCoordSource::GetFrameCount)
+    .add_property("cache_size", &MappedDCDCoordSource::GetCacheSize,
+                  &MappedDCDCoordSource::SetCacheSize)
+    .add_property("prefetch", &MappedDCDCoordSource::GetPrefetch,
+                  &MappedDCDCoordSource::SetPrefetch)
+  ;
+  def("MapCHARMMTraj", &MapCHARMMTraj, (arg("ent"), arg("trj_filename"), 
+                                        arg("stride")=1, arg("cache_size")=16,
+                                        arg("detect_swap")=true,
+                                        arg("swap_bytes")=false));
   def("LoadMAE", &LoadMAE);
   def("LoadPQR", &LoadPQR);
 
@@ -138,4 +201,28 @@ BOOST_PYTHON_MODULE(_ost_io)
   def("SaveCHARMMTraj", &SaveCHARMMTraj, 
       (arg("traj"), arg("pdb_filename"), arg("dcd_filename"), arg("stride")=1, 
        arg("profile")=IOProfile()));
+  def("LoadCompressedTraj", &LoadCompressedTraj,
+      (arg("ent"), arg("filename"), arg("stride")=1, arg("lazy_load")=false));
+  def("SaveCompressedTraj", &SaveCompressedTraj,
+      (arg("traj"), arg("filename"), arg("stride")=1, arg("precision")=100.0));
+
+  class_<BatchLoadResult>("BatchLoadResult", no_init)
+    .def_readonly("index", &BatchLoadResult::index)
+    .def_readonly("filename", &BatchLoadResult::filename)
+    .def_readonly("ent", &BatchLoadResult::ent)
+    .def_readonly("error", &BatchLoadResult::error)
+  ;
+
+  class_<BatchLoader, BatchLoaderPtr, boost::noncopyable>("BatchLoader", no_init)
+    .def("__init__", make_constructor(&batch_loader_init, default_call_policies(),
+                                      (arg("filenames"), arg("profile"),
+                                       arg("num_threads")=0,
+                                       arg("max_in_flight")=0,
+                                       arg("ordered")=true)))
+    .def("HasNext", &BatchLoader::HasNext)
+    .def("Next", &batch_loader_next)
+    .def("GetFileCount", &BatchLoader::GetFileCount)
+    .def("GetThreadCount", &BatchLoader::GetThreadCount)
+    .def("GetMaxInFlight", &BatchLoader::GetMaxInFlight)
+  ;
 }
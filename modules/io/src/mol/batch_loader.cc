@@ -0,0 +1,194 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#include <algorithm>
+
+#include <ost/log.hh>
+#include <ost/mol/xcs_editor.hh>
+#include <ost/io/io_exception.hh>
+#include <ost/io/io_manager.hh>
+#include "batch_loader.hh"
+#include "entity_io_handler.hh"
+#include "entity_io_mmcif_handler.hh"
+#include "entity_io_pdb_handler.hh"
+#include "mmcif_reader.hh"
+#include "pdb_reader.hh"
+
+namespace ost { namespace io {
+
+class BatchLoader::Worker {
+public:
+  Worker(BatchLoader& loader): loader_(loader) { }
+
+  void operator()() { loader_.Work(); }
+private:
+  BatchLoader& loader_;
+};
+
+
+BatchLoader::BatchLoader(const std::vector<String>& filenames,
+                         const IOProfile& profile, int num_threads,
+                         size_t max_in_flight, bool ordered):
+  filenames_(filenames), profile_(profile), num_threads_(num_threads),
+  max_in_flight_(max_in_flight), ordered_(ordered), next_(0), in_flight_(0),
+  returned_(0), stop_(false)
+{
+  if (num_threads_<=0) {
+    num_threads_=std::max(1u, boost::thread::hardware_concurrency());
+  }
+  num_threads_=std::max(1, std::min(num_threads_,
+                                    static_cast<int>(filenames_.size())));
+  if (max_in_flight_==0) {
+    max_in_flight_=2*num_threads_;
+  }
+  for (int i=0; i<num_threads_ && !filenames_.empty(); ++i) {
+    threads_.create_thread(Worker(*this));
+  }
+}
+
+
+BatchLoader::~BatchLoader()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_=true;
+  }
+  slot_free_.notify_all();
+  threads_.join_all();
+}
+
+
+bool BatchLoader::HasNext() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return returned_<filenames_.size();
+}
+
+
+BatchLoadResult BatchLoader::Next()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (returned_>=filenames_.size()) {
+    throw IOException("BatchLoader: all files have been returned");
+  }
+  std::map<size_t, BatchLoadResult>::iterator i;
+  if (ordered_) {
+    // files are started in order, so the next one is always being loaded or
+    // done and the wait can't block forever.
+    while ((i=done_.find(returned_))==done_.end()) {
+      result_ready_.wait(lock);
+    }
+  } else {
+    while (done_order_.empty()) {
+      result_ready_.wait(lock);
+    }
+    i=done_.find(done_order_.front());
+    done_order_.pop_front();
+  }
+  BatchLoadResult result=i->second;
+  done_.erase(i);
+  ++returned_;
+  --in_flight_;
+  slot_free_.notify_one();
+  return result;
+}
+
+
+void BatchLoader::Work()
+{
+  IOProfile profile;
+  {
+    // processors are copied per thread, only the compound library is shared
+    boost::mutex::scoped_lock lock(mutex_);
+    profile=profile_.Copy();
+  }
+  while (true) {
+    BatchLoadResult result;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while (!stop_ && next_<filenames_.size() && in_flight_>=max_in_flight_) {
+        slot_free_.wait(lock);
+      }
+      if (stop_ || next_>=filenames_.size()) {
+        return;
+      }
+      result.index=next_++;
+      ++in_flight_;
+    }
+    result.filename=filenames_[result.index];
+    try {
+      result.ent=Load(result.filename, profile);
+    } catch (std::exception& e) {
+      result.ent=mol::EntityHandle();
+      result.error=e.what();
+    } catch (...) {
+      result.ent=mol::EntityHandle();
+      result.error="unknown error";
+    }
+    if (!result.error.empty()) {
+      LOG_ERROR("BatchLoader: could not load " << result.filename << ": "
+                << result.error);
+    }
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      done_[result.index]=result;
+      done_order_.push_back(result.index);
+    }
+    result_ready_.notify_all();
+  }
+}
+
+
+mol::EntityHandle BatchLoader::Load(const String& filename, IOProfile& profile)
+{
+  boost::filesystem::path loc(filename);
+  mol::EntityHandle ent=mol::CreateEntity();
+  if (EntityIOMMCIFHandler::ProvidesImport(loc, "auto")) {
+    MMCifReader reader(filename, ent, profile);
+    reader.Parse();
+    if (profile.processor) {
+      profile.processor->Process(ent);
+      MMCifInfo info=reader.GetInfo();
+      info.ConnectBranchLinks();
+    }
+    return ent;
+  }
+  if (EntityIOPDBHandler::ProvidesImport(loc, "auto")) {
+    PDBReader reader(filename, profile);
+    if (!reader.HasNext()) {
+      throw IOException("file doesn't contain any entities");
+    }
+    reader.Import(ent);
+    if (profile.processor) {
+      profile.processor->Process(ent);
+    }
+    return ent;
+  }
+  EntityIOHandlerP handler=IOManager::Instance().FindEntityImportHandler(filename,
+                                                                        "auto");
+  {
+    mol::XCSEditor edi=ent.EditXCS(mol::BUFFERED_EDIT);
+    handler->Import(ent, filename);
+  }
+  if (handler->RequiresProcessor() && profile.processor) {
+    profile.processor->Process(ent);
+  }
+  return ent;
+}
+
+}}
@@ -0,0 +1,114 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_IO_BATCH_LOADER_HH
+#define OST_IO_BATCH_LOADER_HH
+
+#include <deque>
+#include <map>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <ost/io/module_config.hh>
+#include <ost/io/mol/io_profile.hh>
+#include <ost/mol/entity_handle.hh>
+
+namespace ost { namespace io {
+
+/// \brief entity loaded by the BatchLoader
+struct DLLEXPORT_OST_IO BatchLoadResult {
+  BatchLoadResult(): index(0) { }
+
+  /// \brief position of the file in the list passed to the BatchLoader
+  size_t            index;
+  String            filename;
+  /// \brief invalid if loading failed
+  mol::EntityHandle ent;
+  /// \brief description of the problem if loading failed, empty otherwise
+  String            error;
+};
+
+/// \brief loads many structure files on several threads
+///
+/// mmCIF and PDB files, recognized by their file extension like for
+/// LoadEntity(), are read with the given profile and processed with its
+/// processor, just like LoadMMCIF() and LoadPDB() do. Any other format is
+/// read with the import handler the IOManager finds for it.
+///
+/// Loading starts in the constructor. At most max_in_flight entities are
+/// being loaded or wait to be fetched with Next() at any time, which bounds
+/// the memory needed independently of the number of files. If ordered is
+/// true, Next() returns the entities in the order of the files, otherwise in
+/// the order they are done. Errors don't stop the loader, they are reported in
+/// the result of the file in question.
+class DLLEXPORT_OST_IO BatchLoader {
+public:
+  /// \param num_threads number of worker threads, one per core if 0
+  /// \param max_in_flight two per thread if 0
+  BatchLoader(const std::vector<String>& filenames, const IOProfile& profile,
+              int num_threads=0, size_t max_in_flight=0, bool ordered=true);
+
+  /// \brief stops loading the remaining files and waits for the workers
+  ~BatchLoader();
+
+  /// \brief whether there are entities left to fetch with Next()
+  bool HasNext() const;
+
+  /// \brief waits for the next entity
+  BatchLoadResult Next();
+
+  size_t GetFileCount() const { return filenames_.size(); }
+
+  int GetThreadCount() const { return num_threads_; }
+
+  size_t GetMaxInFlight() const { return max_in_flight_; }
+
+  /// \brief loads a single file with the rules described above, throws on
+  ///        errors
+  static mol::EntityHandle Load(const String& filename, IOProfile& profile);
+
+private:
+  BatchLoader(const BatchLoader&);
+  BatchLoader& operator=(const BatchLoader&);
+
+  class Worker;
+  friend class Worker;
+
+  void Work();
+
+  std::vector<String>               filenames_;
+  IOProfile                         profile_;
+  int                               num_threads_;
+  size_t                            max_in_flight_;
+  bool                              ordered_;
+  size_t                            next_;
+  size_t                            in_flight_;
+  size_t                            returned_;
+  bool                              stop_;
+  std::map<size_t, BatchLoadResult> done_;
+  std::deque<size_t>                done_order_;
+  mutable boost::mutex              mutex_;
+  boost::condition_variable         slot_free_;
+  boost::condition_variable         result_ready_;
+  boost::thread_group               threads_;
+};
+
+}}
+
+#endif
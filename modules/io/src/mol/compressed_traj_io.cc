@@ -0,0 +1,501 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include <ost/log.hh>
+#include <ost/profile.hh>
+#include <ost/io/io_exception.hh>
+#include "compressed_traj_io.hh"
+
+namespace ost { namespace io {
+
+/*
+  file layout, all numbers in native byte order:
+
+    header:  "OCTJ", uint32 version, uint32 atom count, float precision
+    frames:  uint32 size of the frame data, frame data
+    index:   uint64 offset of every frame, uint64 frame count, "OCTX"
+
+  frame data:
+
+    uint8 flags, 1 if the frame has a unit cell
+    6 floats with cell size and angles if the frame has a unit cell
+    3 int32 with the rounded coordinates of the first atom
+    differences of the remaining atoms to the previous one, zigzag encoded and
+    bit packed in blocks of BLOCK_SIZE values. Every block starts with a byte
+    giving the number of bits per value.
+*/
+
+namespace {
+
+const char HEADER_MAGIC[]={'O', 'C', 'T', 'J'};
+const char INDEX_MAGIC[]={'O', 'C', 'T', 'X'};
+const uint32_t VERSION=1;
+const size_t HEADER_SIZE=4+3*sizeof(uint32_t);
+const size_t TRAILER_SIZE=sizeof(uint64_t)+4;
+const size_t BLOCK_SIZE=48;
+const uint8_t FRAME_HAS_CELL=1;
+
+bool less_index(const mol::AtomHandle& a1, const mol::AtomHandle& a2)
+{
+  return a1.GetIndex()<a2.GetIndex();
+}
+
+inline uint64_t zigzag_encode(int64_t val)
+{
+  return (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t val)
+{
+  return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+}
+
+inline int bit_width(uint64_t val)
+{
+  int bits=0;
+  while (val) {
+    ++bits;
+    val>>=1;
+  }
+  return bits;
+}
+
+template <typename T>
+void append(std::vector<char>& buffer, const T& val)
+{
+  const char* p=reinterpret_cast<const char*>(&val);
+  buffer.insert(buffer.end(), p, p+sizeof(T));
+}
+
+int32_t quantize(Real val, Real precision)
+{
+  double q=std::floor(double(val)*precision+0.5);
+  if (!(std::abs(q)<double(std::numeric_limits<int32_t>::max()))) {
+    throw IOException("SaveCompressedTraj: coordinate out of range for the "
+                      "given precision");
+  }
+  return static_cast<int32_t>(q);
+}
+
+// reads values from a frame, throwing instead of reading past its end
+class FrameReader {
+public:
+  FrameReader(const char* begin, const char* end): p_(begin), end_(end) { }
+
+  template <typename T>
+  T Read()
+  {
+    this->Check(sizeof(T));
+    T val;
+    memcpy(&val, p_, sizeof(T));
+    p_+=sizeof(T);
+    return val;
+  }
+
+  // unpacks count values of the given bit width
+  void Unpack(int bits, size_t count, uint64_t* out)
+  {
+    this->Check((count*bits+7)/8);
+    uint64_t mask=(uint64_t(1) << bits)-1;
+    uint64_t acc=0;
+    int num_bits=0;
+    const unsigned char* p=reinterpret_cast<const unsigned char*>(p_);
+    for (size_t i=0; i<count; ++i) {
+      while (num_bits<bits) {
+        acc|=uint64_t(*p++) << num_bits;
+        num_bits+=8;
+      }
+      out[i]=acc & mask;
+      acc>>=bits;
+      num_bits-=bits;
+    }
+    p_+=(count*bits+7)/8;
+  }
+private:
+  void Check(size_t n)
+  {
+    if (static_cast<size_t>(end_-p_)<n) {
+      throw IOException("LoadCompressedTraj: corrupted frame");
+    }
+  }
+  const char* p_;
+  const char* end_;
+};
+
+}
+
+
+CompressedTrajWriter::CompressedTrajWriter(const String& filename,
+                                           uint atom_count, Real precision):
+  out_(filename.c_str(), std::ios::binary), atom_count_(atom_count),
+  precision_(precision), closed_(false), offset_(HEADER_SIZE)
+{
+  if (!out_) {
+    std::ostringstream msg;
+    msg << "SaveCompressedTraj: cannot open " << filename;
+    throw IOException(msg.str());
+  }
+  if (!(precision>0)) {
+    throw IOException("SaveCompressedTraj: precision must be positive");
+  }
+  out_.write(HEADER_MAGIC, 4);
+  uint32_t version=VERSION;
+  out_.write(reinterpret_cast<char*>(&version), sizeof(uint32_t));
+  uint32_t count=atom_count;
+  out_.write(reinterpret_cast<char*>(&count), sizeof(uint32_t));
+  float prec=precision;
+  out_.write(reinterpret_cast<char*>(&prec), sizeof(float));
+}
+
+
+CompressedTrajWriter::~CompressedTrajWriter()
+{
+  if (!closed_) {
+    try {
+      this->Close();
+    } catch (...) { }
+  }
+}
+
+
+void CompressedTrajWriter::AddFrame(const geom::Vec3List& coords)
+{
+  this->WriteFrame(coords, NULL, NULL);
+}
+
+
+void CompressedTrajWriter::AddFrame(const geom::Vec3List& coords,
+                                    const geom::Vec3& cell_size,
+                                    const geom::Vec3& cell_angles)
+{
+  this->WriteFrame(coords, &cell_size, &cell_angles);
+}
+
+
+void CompressedTrajWriter::WriteFrame(const geom::Vec3List& coords,
+                                      const geom::Vec3* cell_size,
+                                      const geom::Vec3* cell_angles)
+{
+  if (closed_) {
+    throw IOException("SaveCompressedTraj: cannot add frame to closed file");
+  }
+  if (coords.size()!=atom_count_) {
+    std::ostringstream msg;
+    msg << "SaveCompressedTraj: expected " << atom_count_ << " atoms, got "
+        << coords.size();
+    throw IOException(msg.str());
+  }
+  buffer_.clear();
+  append(buffer_, uint32_t(0)); // size, filled in below
+  append(buffer_, uint8_t(cell_size ? FRAME_HAS_CELL : 0));
+  if (cell_size) {
+    for (int k=0; k<3; ++k) {
+      append(buffer_, float((*cell_size)[k]));
+    }
+    for (int k=0; k<3; ++k) {
+      append(buffer_, float((*cell_angles)[k]));
+    }
+  }
+  if (atom_count_>0) {
+    int32_t last[3];
+    for (int k=0; k<3; ++k) {
+      last[k]=quantize(coords[0][k], precision_);
+      append(buffer_, last[k]);
+    }
+    uint64_t block[BLOCK_SIZE];
+    size_t num_values=(atom_count_-1)*3;
+    size_t n=0;
+    for (size_t i=1; i<atom_count_; ++i) {
+      for (int k=0; k<3; ++k) {
+        int32_t q=quantize(coords[i][k], precision_);
+        block[n%BLOCK_SIZE]=zigzag_encode(int64_t(q)-last[k]);
+        last[k]=q;
+        ++n;
+        if (n%BLOCK_SIZE!=0 && n!=num_values) {
+          continue;
+        }
+        size_t count=(n-1)%BLOCK_SIZE+1;
+        uint64_t max_val=0;
+        for (size_t j=0; j<count; ++j) {
+          max_val|=block[j];
+        }
+        int bits=bit_width(max_val);
+        buffer_.push_back(static_cast<char>(bits));
+        uint64_t acc=0;
+        int num_bits=0;
+        for (size_t j=0; j<count; ++j) {
+          acc|=block[j] << num_bits;
+          num_bits+=bits;
+          while (num_bits>=8) {
+            buffer_.push_back(static_cast<char>(acc & 0xff));
+            acc>>=8;
+            num_bits-=8;
+          }
+        }
+        if (num_bits>0) {
+          buffer_.push_back(static_cast<char>(acc & 0xff));
+        }
+      }
+    }
+  }
+  uint32_t size=buffer_.size()-sizeof(uint32_t);
+  memcpy(&buffer_[0], &size, sizeof(uint32_t));
+  out_.write(&buffer_[0], buffer_.size());
+  if (!out_) {
+    throw IOException("SaveCompressedTraj: error while writing frame");
+  }
+  offsets_.push_back(offset_);
+  offset_+=buffer_.size();
+}
+
+
+void CompressedTrajWriter::Close()
+{
+  if (closed_) {
+    return;
+  }
+  closed_=true;
+  if (!offsets_.empty()) {
+    out_.write(reinterpret_cast<char*>(&offsets_[0]),
+               offsets_.size()*sizeof(uint64_t));
+  }
+  uint64_t frame_count=offsets_.size();
+  out_.write(reinterpret_cast<char*>(&frame_count), sizeof(uint64_t));
+  out_.write(INDEX_MAGIC, 4);
+  out_.close();
+  if (!out_) {
+    throw IOException("SaveCompressedTraj: error while writing index");
+  }
+}
+
+
+CompressedTrajCoordSource::CompressedTrajCoordSource(const mol::AtomHandleList& atoms,
+                                                     const String& filename,
+                                                     uint stride):
+  mol::CoordSource(atoms), atom_count_(0), frame_count_(0),
+  stride_(std::max(1u, stride)), precision_(1.0),
+  last_frame_id_(std::numeric_limits<uint>::max())
+{
+  this->SetMutable(false);
+  try {
+    file_.open(filename);
+  } catch (std::exception& e) {
+    std::ostringstream msg;
+    msg << "LoadCompressedTraj: cannot open " << filename;
+    throw IOException(msg.str());
+  }
+  if (file_.size()<HEADER_SIZE || memcmp(file_.data(), HEADER_MAGIC, 4)) {
+    throw IOException("LoadCompressedTraj: not a compressed trajectory");
+  }
+  FrameReader header(file_.data()+4, file_.data()+HEADER_SIZE);
+  uint32_t version=header.Read<uint32_t>();
+  if (version!=VERSION) {
+    std::ostringstream msg;
+    msg << "LoadCompressedTraj: unsupported version " << version;
+    throw IOException(msg.str());
+  }
+  atom_count_=header.Read<uint32_t>();
+  precision_=header.Read<float>();
+  if (atoms.size()!=atom_count_) {
+    LOG_ERROR("LoadCompressedTraj: atom count mismatch: " << atoms.size()
+               << " in coordinate file, " << atom_count_
+               << " in each traj frame");
+    throw IOException("invalid trajectory");
+  }
+  this->ReadIndex(HEADER_SIZE);
+  frame_count_=(offsets_.size()+stride_-1)/stride_;
+  LOG_VERBOSE("LoadCompressedTraj: mapped " << frame_count_ << " frames with "
+              << atom_count_ << " atoms each");
+}
+
+
+void CompressedTrajCoordSource::ReadIndex(size_t frame_start)
+{
+  const char* data=file_.data();
+  size_t size=file_.size();
+  if (size>=frame_start+TRAILER_SIZE &&
+      !memcmp(data+size-4, INDEX_MAGIC, 4)) {
+    uint64_t frame_count;
+    memcpy(&frame_count, data+size-TRAILER_SIZE, sizeof(uint64_t));
+    size_t index_size=frame_count*sizeof(uint64_t);
+    if (frame_count<=size/sizeof(uint64_t) &&
+        index_size<=size-frame_start-TRAILER_SIZE) {
+      size_t index_start=size-TRAILER_SIZE-index_size;
+      offsets_.resize(frame_count);
+      if (frame_count>0) {
+        memcpy(&offsets_[0], data+index_start, index_size);
+      }
+      for (size_t i=0; i<offsets_.size(); ++i) {
+        if (offsets_[i]<frame_start ||
+            offsets_[i]+sizeof(uint32_t)>index_start) {
+          throw IOException("LoadCompressedTraj: corrupted index");
+        }
+      }
+      return;
+    }
+  }
+  LOG_VERBOSE("LoadCompressedTraj: no index found, scanning frames");
+  this->ScanFrames(frame_start);
+}
+
+
+void CompressedTrajCoordSource::ScanFrames(size_t frame_start)
+{
+  // only complete frames are used, the last one of a trajectory that is still
+  // being written may be truncated.
+  const char* data=file_.data();
+  size_t size=file_.size();
+  size_t offset=frame_start;
+  offsets_.clear();
+  while (offset+sizeof(uint32_t)<=size) {
+    uint32_t frame_size;
+    memcpy(&frame_size, data+offset, sizeof(uint32_t));
+    if (frame_size>size-offset-sizeof(uint32_t)) {
+      break;
+    }
+    offsets_.push_back(offset);
+    offset+=sizeof(uint32_t)+frame_size;
+  }
+}
+
+
+mol::CoordFramePtr CompressedTrajCoordSource::DecodeFrame(uint frame_id) const
+{
+  const char* data=file_.data();
+  size_t offset=offsets_[static_cast<size_t>(frame_id)*stride_];
+  uint32_t frame_size;
+  memcpy(&frame_size, data+offset, sizeof(uint32_t));
+  const char* begin=data+offset+sizeof(uint32_t);
+  if (frame_size>file_.size()-offset-sizeof(uint32_t)) {
+    throw IOException("LoadCompressedTraj: corrupted frame");
+  }
+  FrameReader reader(begin, begin+frame_size);
+  mol::CoordFramePtr frame(new mol::CoordFrame(atom_count_));
+  uint8_t flags=reader.Read<uint8_t>();
+  if (flags & FRAME_HAS_CELL) {
+    geom::Vec3 cell_size, cell_angles;
+    for (int k=0; k<3; ++k) {
+      cell_size[k]=reader.Read<float>();
+    }
+    for (int k=0; k<3; ++k) {
+      cell_angles[k]=reader.Read<float>();
+    }
+    frame->SetCellSize(cell_size);
+    frame->SetCellAngles(cell_angles);
+  }
+  if (atom_count_==0) {
+    return frame;
+  }
+  Real factor=1.0/precision_;
+  int64_t last[3];
+  for (int k=0; k<3; ++k) {
+    last[k]=reader.Read<int32_t>();
+    (*frame)[0][k]=factor*last[k];
+  }
+  uint64_t block[BLOCK_SIZE];
+  size_t num_values=(atom_count_-1)*3;
+  Real* out=(*frame)[0].Data()+3;
+  for (size_t n=0; n<num_values; n+=BLOCK_SIZE) {
+    size_t count=std::min(BLOCK_SIZE, num_values-n);
+    int bits=reader.Read<uint8_t>();
+    if (bits>33) {
+      throw IOException("LoadCompressedTraj: corrupted frame");
+    }
+    reader.Unpack(bits, count, block);
+    for (size_t j=0; j<count; ++j) {
+      int k=(n+j)%3;
+      last[k]+=zigzag_decode(block[j]);
+      out[n+j]=factor*last[k];
+    }
+  }
+  return frame;
+}
+
+
+mol::CoordFramePtr CompressedTrajCoordSource::GetFrame(uint frame_id) const
+{
+  if (frame_id>=frame_count_) {
+    std::ostringstream msg;
+    msg << "LoadCompressedTraj: frame " << frame_id << " out of range, "
+        << "trajectory has " << frame_count_ << " frames";
+    throw IOException(msg.str());
+  }
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (frame_id==last_frame_id_) {
+      return last_frame_;
+    }
+  }
+  // decoding only reads the mapped file, so threads can decode different
+  // frames at the same time. Only the cache update needs the lock.
+  mol::CoordFramePtr frame=this->DecodeFrame(frame_id);
+  boost::mutex::scoped_lock lock(mutex_);
+  last_frame_=frame;
+  last_frame_id_=frame_id;
+  return frame;
+}
+
+
+mol::CoordGroupHandle LoadCompressedTraj(const mol::EntityHandle& ent,
+                                         const String& trj_fn,
+                                         unsigned int stride,
+                                         bool lazy_load)
+{
+  mol::AtomHandleList alist(ent.GetAtomList());
+  std::sort(alist.begin(),alist.end(),less_index);
+  CompressedTrajCoordSourcePtr source(new CompressedTrajCoordSource(alist,
+                                                                    trj_fn,
+                                                                    stride));
+  if (lazy_load) {
+    LOG_VERBOSE("LoadCompressedTraj: importing with lazy_load=true");
+    return mol::CoordGroupHandle(source);
+  }
+  LOG_VERBOSE("LoadCompressedTraj: importing with lazy_load=false");
+  Profile profile_load("LoadCompressedTraj");
+  mol::CoordGroupHandle cg=CreateCoordGroup(alist);
+  for (uint i=0; i<source->GetFrameCount(); ++i) {
+    mol::CoordFramePtr frame=source->GetFrame(i);
+    cg.AddFrame(*frame, frame->GetCellSize(), frame->GetCellAngles());
+  }
+  return cg;
+}
+
+
+void SaveCompressedTraj(const mol::CoordGroupHandle& coord_group,
+                        const String& trj_filename, unsigned int stride,
+                        Real precision)
+{
+  if (stride==0) stride=1;
+  CompressedTrajWriter writer(trj_filename, coord_group.GetAtomCount(),
+                              precision);
+  int frame_count=coord_group.GetFrameCount();
+  for (int i=0; i<frame_count; i+=stride) {
+    mol::CoordFramePtr frame=coord_group.GetFrame(i);
+    writer.AddFrame(*frame, frame->GetCellSize(), frame->GetCellAngles());
+  }
+  writer.Close();
+}
+
+}} // ns
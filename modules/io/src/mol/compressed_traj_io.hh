@@ -0,0 +1,143 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_IO_COMPRESSED_TRAJ_IO_HH
+#define OST_IO_COMPRESSED_TRAJ_IO_HH
+
+/*
+  compressed trajectory IO
+ */
+
+#include <fstream>
+#include <vector>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/thread/mutex.hpp>
+#include <ost/stdint.hh>
+#include <ost/io/module_config.hh>
+#include <ost/mol/coord_group.hh>
+
+namespace ost { namespace io {
+
+/*! \brief writer for compressed trajectories
+
+    Coordinates are rounded to multiples of 1/precision Angstrom. Within a
+    frame, every atom is stored as difference to the previous atom, and the
+    differences are bit packed in blocks using as many bits as the largest
+    difference of the block needs. Frames don't depend on each other, an index
+    of the frame offsets at the end of the file gives constant time access to
+    any frame.
+
+    Frames are written as they are added, the index is written by Close().
+*/
+class DLLEXPORT_OST_IO CompressedTrajWriter {
+public:
+  CompressedTrajWriter(const String& filename, uint atom_count,
+                       Real precision=100.0);
+
+  ~CompressedTrajWriter();
+
+  void AddFrame(const geom::Vec3List& coords);
+
+  void AddFrame(const geom::Vec3List& coords, const geom::Vec3& cell_size,
+                const geom::Vec3& cell_angles);
+
+  uint GetFrameCount() const { return offsets_.size(); }
+
+  void Close();
+private:
+  CompressedTrajWriter(const CompressedTrajWriter&);
+  CompressedTrajWriter& operator=(const CompressedTrajWriter&);
+
+  void WriteFrame(const geom::Vec3List& coords, const geom::Vec3* cell_size,
+                  const geom::Vec3* cell_angles);
+
+  std::ofstream         out_;
+  uint                  atom_count_;
+  Real                  precision_;
+  bool                  closed_;
+  uint64_t              offset_;
+  std::vector<uint64_t> offsets_;
+  std::vector<char>     buffer_;
+};
+
+/*! \brief lazy coordinate source for compressed trajectories
+
+    The file is memory mapped, frames are decoded on demand. The most recently
+    decoded frame is kept, so repeated access to the same frame is cheap. If
+    the index is missing, e.g. because the trajectory is still being written,
+    the complete frames are located by scanning the file once.
+*/
+class DLLEXPORT_OST_IO CompressedTrajCoordSource : public mol::CoordSource {
+public:
+  CompressedTrajCoordSource(const mol::AtomHandleList& atoms,
+                            const String& filename, uint stride=1);
+
+  virtual uint GetFrameCount() const { return frame_count_; }
+
+  virtual mol::CoordFramePtr GetFrame(uint frame_id) const;
+
+  /// \brief coordinates are stored as multiples of 1/precision Angstrom
+  Real GetPrecision() const { return precision_; }
+
+  virtual void AddFrame(const std::vector<geom::Vec3>& coords) {}
+  virtual void AddFrame(const std::vector<geom::Vec3>& coords,
+                        const geom::Vec3& box_size,
+                        const geom::Vec3& box_angles) {}
+  virtual void InsertFrame(int pos, const std::vector<geom::Vec3>& coords) {}
+private:
+  void ReadIndex(size_t frame_start);
+  void ScanFrames(size_t frame_start);
+  mol::CoordFramePtr DecodeFrame(uint frame_id) const;
+
+  boost::iostreams::mapped_file_source file_;
+  uint                                 atom_count_;
+  uint                                 frame_count_;
+  uint                                 stride_;
+  Real                                 precision_;
+  std::vector<uint64_t>                offsets_;
+  mutable uint                         last_frame_id_;
+  mutable mol::CoordFramePtr           last_frame_;
+  mutable boost::mutex                 mutex_;
+};
+
+typedef boost::shared_ptr<CompressedTrajCoordSource> CompressedTrajCoordSourcePtr;
+
+
+/*! \brief import a compressed trajectory with an existing entity
+
+    The atom layout of the entity must match the trajectory. With lazy_load,
+    frames are only decoded when they are accessed.
+*/
+mol::CoordGroupHandle DLLEXPORT_OST_IO LoadCompressedTraj(const mol::EntityHandle& ent,
+                                                          const String& trj_filename,
+                                                          unsigned int stride=1,
+                                                          bool lazy_load=false);
+
+/*! \brief export coord group as compressed trajectory
+
+    Coordinates are rounded to multiples of 1/precision Angstrom, the optional
+    stride parameter will cause every nth frame to be exported.
+ */
+void DLLEXPORT_OST_IO SaveCompressedTraj(const mol::CoordGroupHandle& coord_group,
+                                         const String& trj_filename,
+                                         unsigned int stride=1,
+                                         Real precision=100.0);
+
+}} // ns
+
+#endif
@@ -23,8 +23,16 @@
 
 #include <fstream>
 #include <algorithm>
+#include <limits>
+#include <cstring>
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
 #include <boost/filesystem/convenience.hpp>
 
 #include <ost/stdint.hh>
@@ -237,16 +245,6 @@ bool read_frame(std::istream& istream, const DCDHeader& header,
   }
   return true;
 }
-
-bool read_frame(std::istream& istream, const DCDHeader& header, 
-                size_t frame_size, bool ucell_flag, bool gap_flag, 
-                bool swap_flag, std::vector<float>& xlist,
-                std::vector<geom::Vec3>& frame,uint frame_num)
-{
-  geom::Vec3 cell_size=geom::Vec3(),cell_angles=geom::Vec3();
-  return read_frame(istream,header, frame_size,ucell_flag, gap_flag, 
-                    swap_flag, xlist,frame,frame_num, cell_size, cell_angles);
-}
   
   
 mol::CoordGroupHandle load_dcd(const mol::AtomHandleList& alist, // this atom list is already sorted!
@@ -306,76 +304,227 @@ mol::CoordGroupHandle load_dcd(const mol::AtomHandleList& alist, // this atom li
   return cg;
 }
 
-class  DCDCoordSource : public mol::CoordSource {
-public:
-  DCDCoordSource(const mol::AtomHandleList& atoms, const String& filename, 
-                 uint stride, bool detect_swap, bool byte_swap): 
-    mol::CoordSource(atoms), filename_(filename), 
-    stream_(filename.c_str(), std::ios::binary), loaded_(false), stride_(stride),
-    detect_swap_(detect_swap), byte_swap_(byte_swap)
-  {
-    frame_count_=0;
-    this->SetMutable(false);
-    frame_=mol::CoordFramePtr(new mol::CoordFrame(atoms.size()));
+} // anon ns
+
+
+MappedDCDCoordSource::MappedDCDCoordSource(const mol::AtomHandleList& atoms, 
+                                           const String& filename, 
+                                           uint stride, uint cache_size, 
+                                           uint prefetch, bool detect_swap, 
+                                           bool byte_swap):
+  mol::CoordSource(atoms), ucell_flag_(false), swap_flag_(false), 
+  gap_flag_(false), atom_count_(0), frame_count_(0), 
+  stride_(std::max(1u, stride)), frame_start_(0), frame_size_(0), 
+  cache_size_(cache_size), prefetch_(prefetch), 
+  last_frame_(std::numeric_limits<uint>::max())
+{
+  this->SetMutable(false);
+  try {
+    file_.open(filename);
+  } catch (std::exception& e) {
+    std::ostringstream msg;
+    msg << "LoadCHARMMTraj: cannot open " << filename;
+    throw IOException(msg.str());
   }
-    
-  
-  virtual uint GetFrameCount() const
-  { 
-    if (!frame_count_)
-      const_cast<DCDCoordSource*>(this)->FetchFrame(0);
-    return frame_count_; 
+  boost::iostreams::stream<boost::iostreams::array_source> 
+    istream(file_.data(), file_.size());
+  DCDHeader header;
+  if (!read_dcd_header(istream, header, swap_flag_, ucell_flag_, gap_flag_, 
+                       detect_swap, byte_swap)) {
+    throw IOException("LoadCHARMMTraj: premature end of file in header");
   }
-  
-  virtual mol::CoordFramePtr GetFrame(uint frame_id) const {
-    const_cast<DCDCoordSource*>(this)->FetchFrame(frame_id);
-    return frame_;
+  if (atoms.size()!=static_cast<size_t>(header.t_atom_count)) {
+    LOG_ERROR("LoadCHARMMTraj: atom count mismatch: " << atoms.size() 
+               << " in coordinate file, " << header.t_atom_count 
+               << " in each traj frame");
+    throw IOException("invalid trajectory");
   }
+  if (!istream) {
+    throw IOException("LoadCHARMMTraj: premature end of file in header");
+  }
+  atom_count_=header.t_atom_count;
+  frame_start_=istream.tellg();
+  frame_size_=calc_frame_size(ucell_flag_, gap_flag_, atom_count_);
+  if (frame_size_==0) {
+    throw IOException("LoadCHARMMTraj: trajectory frames contain no data");
+  }
+  // truncated files are common for running simulations, only count the 
+  // frames that are actually there.
+  size_t num_frames=(file_.size()-frame_start_)/frame_size_;
+  if (header.num>0) {
+    num_frames=std::min(num_frames, static_cast<size_t>(header.num));
+  }
+  frame_count_=(num_frames+stride_-1)/stride_;
+  LOG_VERBOSE("LoadCHARMMTraj: mapped " << frame_count_ << " frames with "
+              << atom_count_ << " atoms each");
+}
 
-  virtual void AddFrame(const std::vector<geom::Vec3>& coords) {}
-  virtual void AddFrame(const std::vector<geom::Vec3>& coords,const geom::Vec3& box_size,const geom::Vec3& box_angles) {}
-  virtual void InsertFrame(int pos, const std::vector<geom::Vec3>& coords) {}
-private:
-  
-  void FetchFrame(uint frame);
-  String               filename_;
-  DCDHeader            header_;
-  bool                 ucell_flag_;
-  bool                 swap_flag_;
-  bool                 gap_flag_;
-  std::ifstream        stream_;
-  bool                 loaded_;
-  uint                 frame_count_;
-  uint                 curr_frame_;
-  uint                 stride_;
-  bool                 detect_swap_, byte_swap_;
-  size_t               frame_start_;
-  mol::CoordFramePtr   frame_;
-};
 
+uint MappedDCDCoordSource::GetCacheSize() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return cache_size_;
+}
 
-void DCDCoordSource::FetchFrame(uint frame)
+void MappedDCDCoordSource::SetCacheSize(uint cache_size)
 {
-  if (!loaded_) {
-    read_dcd_header(stream_, header_, swap_flag_, ucell_flag_, gap_flag_, detect_swap_,byte_swap_);
-    frame_start_=stream_.tellg();
-    loaded_=true;
-    frame_count_=header_.num/stride_;
-  }
-  size_t frame_size=calc_frame_size(ucell_flag_, gap_flag_, 
-                                    header_.t_atom_count);  
-  size_t pos=frame_start_+frame_size*frame*stride_;
-  stream_.seekg(pos,std::ios_base::beg);
-  std::vector<float> xlist(header_.t_atom_count);
-  if (!read_frame(stream_, header_, frame_size, ucell_flag_, gap_flag_, 
-                  swap_flag_, xlist, *frame_.get(), frame)) {
-  }  
+  boost::mutex::scoped_lock lock(mutex_);
+  cache_size_=cache_size;
+  while (cache_.size()>cache_size_) {
+    cache_index_.erase(cache_.back().first);
+    cache_.pop_back();
+  }
 }
 
-typedef boost::shared_ptr<DCDCoordSource> DCDCoordSourcePtr;
+uint MappedDCDCoordSource::GetPrefetch() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return prefetch_;
+}
 
+void MappedDCDCoordSource::SetPrefetch(uint prefetch)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  prefetch_=prefetch;
+}
 
-} // anon ns
+
+size_t MappedDCDCoordSource::FrameOffset(uint frame_id) const
+{
+  return frame_start_+frame_size_*static_cast<size_t>(frame_id)*stride_;
+}
+
+
+const char* MappedDCDCoordSource::CoordStart(uint frame_id) const
+{
+  const char* p=file_.data()+this->FrameOffset(frame_id);
+  if (ucell_flag_) {
+    p+=sizeof(int)+sizeof(double)*6+sizeof(int);
+  }
+  if (gap_flag_) {
+    p+=sizeof(int);
+  }
+  return p;
+}
+
+
+void MappedDCDCoordSource::CheckFrameId(uint frame_id) const
+{
+  if (frame_id>=frame_count_) {
+    std::ostringstream msg;
+    msg << "LoadCHARMMTraj: frame " << frame_id << " out of range, trajectory "
+        << "has " << frame_count_ << " frames";
+    throw IOException(msg.str());
+  }
+}
+
+
+DCDFrameView MappedDCDCoordSource::GetFrameView(uint frame_id) const
+{
+  this->CheckFrameId(frame_id);
+  if (swap_flag_) {
+    throw IOException("LoadCHARMMTraj: frames of byte-swapped trajectories "
+                      "can't be viewed in place");
+  }
+  size_t block=sizeof(float)*atom_count_+(gap_flag_ ? 2*sizeof(int) : 0);
+  const char* p=this->CoordStart(frame_id);
+  DCDFrameView view;
+  view.x=reinterpret_cast<const float*>(p);
+  view.y=reinterpret_cast<const float*>(p+block);
+  view.z=reinterpret_cast<const float*>(p+2*block);
+  view.atom_count=atom_count_;
+  return view;
+}
+
+
+mol::CoordFramePtr MappedDCDCoordSource::DecodeFrame(uint frame_id) const
+{
+  mol::CoordFramePtr frame(new mol::CoordFrame(atom_count_));
+  if (ucell_flag_) {
+    double tmp[6];
+    memcpy(tmp, file_.data()+this->FrameOffset(frame_id)+sizeof(int), 
+           sizeof(double)*6);
+    if (swap_flag_) swap_double(tmp, 6);
+    // a,alpha,b,beta,gamma,c (don't ask)
+    frame->SetCellSize(geom::Vec3(tmp[0], tmp[2], tmp[5]));
+    frame->SetCellAngles(geom::Vec3(acos(tmp[1]), acos(tmp[3]), 
+                                    acos(tmp[4])));
+  }
+  size_t block=sizeof(float)*atom_count_+(gap_flag_ ? 2*sizeof(int) : 0);
+  const char* p=this->CoordStart(frame_id);
+  std::vector<float> xlist(atom_count_);
+  for (int k=0; k<3; ++k, p+=block) {
+    memcpy(&xlist[0], p, sizeof(float)*atom_count_);
+    if (swap_flag_) swap_float(&xlist[0], atom_count_);
+    for (uint j=0; j<atom_count_; ++j) {
+      (*frame)[j][k]=xlist[j];
+    }
+  }
+  return frame;
+}
+
+
+void MappedDCDCoordSource::Prefetch(uint frame_id) const
+{
+#ifndef _MSC_VER
+  static const size_t page_size=sysconf(_SC_PAGESIZE);
+  uint end=std::min(frame_count_, frame_id+prefetch_);
+  for (uint i=frame_id; i<end; ++i) {
+    size_t begin=this->FrameOffset(i)/page_size*page_size;
+    posix_madvise(const_cast<char*>(file_.data())+begin, 
+                  this->FrameOffset(i)+frame_size_-begin, 
+                  POSIX_MADV_WILLNEED);
+  }
+#endif
+}
+
+
+mol::CoordFramePtr MappedDCDCoordSource::GetFrame(uint frame_id) const
+{
+  this->CheckFrameId(frame_id);
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (frame_id==last_frame_+1 && prefetch_>0) {
+      this->Prefetch(frame_id+1);
+    }
+    last_frame_=frame_id;
+    std::map<uint, FrameList::iterator>::iterator i=cache_index_.find(frame_id);
+    if (i!=cache_index_.end()) {
+      cache_.splice(cache_.begin(), cache_, i->second);
+      return i->second->second;
+    }
+  }
+  // decoding only reads the mapped file, so threads can decode different
+  // frames at the same time. Another thread may have cached the frame in
+  // the meantime.
+  mol::CoordFramePtr frame=this->DecodeFrame(frame_id);
+  boost::mutex::scoped_lock lock(mutex_);
+  if (cache_size_>0 && cache_index_.find(frame_id)==cache_index_.end()) {
+    cache_.push_front(std::make_pair(frame_id, frame));
+    cache_index_[frame_id]=cache_.begin();
+    if (cache_.size()>cache_size_) {
+      cache_index_.erase(cache_.back().first);
+      cache_.pop_back();
+    }
+  }
+  return frame;
+}
+
+
+MappedDCDCoordSourcePtr MapCHARMMTraj(const mol::EntityHandle& ent,
+                                      const String& trj_fn,
+                                      unsigned int stride,
+                                      unsigned int cache_size,
+                                      bool detect_swap,
+                                      bool byte_swap)
+{
+  mol::AtomHandleList alist(ent.GetAtomList());
+  std::sort(alist.begin(),alist.end(),less_index);
+  return MappedDCDCoordSourcePtr(new MappedDCDCoordSource(alist, trj_fn, 
+                                                          stride, cache_size,
+                                                          8, detect_swap, 
+                                                          byte_swap));
+}
 
 
 mol::CoordGroupHandle LoadCHARMMTraj(const mol::EntityHandle& ent,
@@ -389,7 +538,9 @@ mol::CoordGroupHandle LoadCHARMMTraj(const mol::EntityHandle& ent,
   std::sort(alist.begin(),alist.end(),less_index);
   if (lazy_load) {
     LOG_VERBOSE("LoadCHARMMTraj: importing with lazy_load=true");
-    DCDCoordSourcePtr source(new DCDCoordSource(alist, trj_fn, stride, detect_swap, byte_swap));
+    MappedDCDCoordSourcePtr source(new MappedDCDCoordSource(alist, trj_fn, stride,
+                                                            16, 8, detect_swap,
+                                                            byte_swap));
     return mol::CoordGroupHandle(source);
   }
   LOG_VERBOSE("LoadCHARMMTraj: importing with lazy_load=false");  
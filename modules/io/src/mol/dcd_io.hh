@@ -24,11 +24,96 @@
   Authors: Ansgar Philippsen, Marco Biasini
  */
 
+#include <list>
+#include <map>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/thread/mutex.hpp>
 #include <ost/io/module_config.hh>
 #include <ost/mol/coord_group.hh>
 #include <ost/io/mol/io_profile.hh>
 namespace ost { namespace io {
 
+/*! \brief zero-copy view of the coordinates of one trajectory frame
+
+    The x, y and z coordinates are stored as separate arrays which point 
+    directly into the memory-mapped trajectory file. They stay valid as long 
+    as the coordinate source they have been obtained from.
+*/
+struct DLLEXPORT_OST_IO DCDFrameView {
+  const float* x;
+  const float* y;
+  const float* z;
+  uint         atom_count;
+};
+
+/*! \brief lazy coordinate source for memory-mapped CHARMM trajectories
+    
+    Frames are decoded on demand. The last cache_size decoded frames are kept
+    in a least-recently-used cache. When frames are accessed in sequential 
+    order, the operating system is asked to read the next prefetch frames 
+    ahead of time.
+*/
+class DLLEXPORT_OST_IO MappedDCDCoordSource : public mol::CoordSource {
+public:
+  MappedDCDCoordSource(const mol::AtomHandleList& atoms, 
+                       const String& filename, uint stride=1, 
+                       uint cache_size=16, uint prefetch=8,
+                       bool detect_swap=true, bool byte_swap=false);
+
+  virtual uint GetFrameCount() const { return frame_count_; }
+
+  virtual mol::CoordFramePtr GetFrame(uint frame_id) const;
+
+  /// \brief get coordinates of frame without decoding them
+  /// 
+  /// Throws an IOException if the trajectory needs byte swapping, since the 
+  /// coordinates can then not be used in place.
+  DCDFrameView GetFrameView(uint frame_id) const;
+
+  /// \brief whether the trajectory is stored with non-native byte order
+  bool IsByteSwapped() const { return swap_flag_; }
+
+  uint GetCacheSize() const;
+
+  void SetCacheSize(uint cache_size);
+
+  uint GetPrefetch() const;
+
+  void SetPrefetch(uint prefetch);
+
+  virtual void AddFrame(const std::vector<geom::Vec3>& coords) {}
+  virtual void AddFrame(const std::vector<geom::Vec3>& coords,
+                        const geom::Vec3& box_size,
+                        const geom::Vec3& box_angles) {}
+  virtual void InsertFrame(int pos, const std::vector<geom::Vec3>& coords) {}
+private:
+  typedef std::list<std::pair<uint, mol::CoordFramePtr> > FrameList;
+
+  size_t FrameOffset(uint frame_id) const;
+  const char* CoordStart(uint frame_id) const;
+  mol::CoordFramePtr DecodeFrame(uint frame_id) const;
+  void Prefetch(uint frame_id) const;
+  void CheckFrameId(uint frame_id) const;
+
+  boost::iostreams::mapped_file_source file_;
+  bool                                 ucell_flag_;
+  bool                                 swap_flag_;
+  bool                                 gap_flag_;
+  uint                                 atom_count_;
+  uint                                 frame_count_;
+  uint                                 stride_;
+  size_t                               frame_start_;
+  size_t                               frame_size_;
+  uint                                 cache_size_;
+  uint                                 prefetch_;
+  mutable uint                         last_frame_;
+  mutable FrameList                    cache_;
+  mutable std::map<uint, FrameList::iterator> cache_index_;
+  mutable boost::mutex                 mutex_;
+};
+
+typedef boost::shared_ptr<MappedDCDCoordSource> MappedDCDCoordSourcePtr;
+
 
 
 /*! \brief import a CHARMM trajectory in dcd format with an existing entity
@@ -42,6 +127,19 @@ mol::CoordGroupHandle DLLEXPORT_OST_IO LoadCHARMMTraj(const mol::EntityHandle& e
                                                       bool detect_swap=true,
                                                       bool byte_swap=false);
 
+/*! \brief memory-map a CHARMM trajectory in dcd format
+    
+    In contrast to LoadCHARMMTraj, the coordinate source is returned directly,
+    which gives access to the zero-copy frame views. Wrap it in a 
+    mol::CoordGroupHandle to use it like any other trajectory.
+*/
+MappedDCDCoordSourcePtr DLLEXPORT_OST_IO MapCHARMMTraj(const mol::EntityHandle& ent,
+                                                       const String& trj_filename,
+                                                       unsigned int stride=1,
+                                                       unsigned int cache_size=16,
+                                                       bool detect_swap=true,
+                                                       bool byte_swap=false);
+
 
 /*! \brief export coord group as PDB file and DCD trajectory
     if the pdb filename is an empty string, it won't be exported
@@ -33,6 +33,7 @@
 #include "entity_io_mmcif_handler.hh"
 #include <ost/profile.hh>
 #include <ost/io/mol/mmcif_reader.hh>
+#include <ost/io/mol/mmcif_writer.hh>
 namespace ost { namespace io {
 
 using boost::format;
@@ -47,6 +48,8 @@ bool EntityIOMMCIFHandler::RequiresProcessor() const
 void EntityIOMMCIFHandler::Export(const mol::EntityView& ent,
                                 const boost::filesystem::path& loc) const 
 {
+  MMCifWriter writer(loc);
+  writer.Write(ent);
 }
 
 void EntityIOMMCIFHandler::Import(mol::EntityHandle& ent, 
@@ -67,6 +70,8 @@ void EntityIOMMCIFHandler::Import(mol::EntityHandle& ent,
 void EntityIOMMCIFHandler::Export(const mol::EntityView& ent,
                                 std::ostream& stream) const 
 {
+  MMCifWriter writer(stream);
+  writer.Write(ent);
 }
 
 void EntityIOMMCIFHandler::Import(mol::EntityHandle& ent,
@@ -85,8 +90,10 @@ void EntityIOMMCIFHandler::Import(mol::EntityHandle& ent,
   info.ConnectBranchLinks();
 }
 
-bool EntityIOMMCIFHandler::ProvidesImport(const boost::filesystem::path& loc,
-                                        const String& type)
+namespace {
+
+bool mmcif_handler_is_responsible_for(const boost::filesystem::path& loc,
+                                      const String& type)
 {
   if (type=="auto") {
     String match_suf_string=loc.string();
@@ -100,10 +107,18 @@ bool EntityIOMMCIFHandler::ProvidesImport(const boost::filesystem::path& loc,
   return type=="cif";
 }
 
+}
+
+bool EntityIOMMCIFHandler::ProvidesImport(const boost::filesystem::path& loc,
+                                        const String& type)
+{
+  return mmcif_handler_is_responsible_for(loc, type);
+}
+
 bool EntityIOMMCIFHandler::ProvidesExport(const boost::filesystem::path& loc,
                                         const String& type)
 {
-  return false;
+  return mmcif_handler_is_responsible_for(loc, type);
 }
 
 
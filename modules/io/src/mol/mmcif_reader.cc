@@ -62,8 +62,7 @@ void MMCifReader::Init()
   has_model_            = false;
   restrict_chains_      = "";
   subst_res_id_         = "";
-  curr_chain_           = mol::ChainHandle();
-  curr_residue_         = mol::ResidueHandle();
+  builder_.Clear();
   seqres_               = seq::CreateSequenceList();
   read_seqres_          = false;
   warned_rule_based_    = false;
@@ -72,8 +71,7 @@ void MMCifReader::Init()
 
 void MMCifReader::ClearState()
 {
-  curr_chain_           = mol::ChainHandle();
-  curr_residue_         = mol::ResidueHandle();
+  builder_.Clear();
   chain_count_          = 0;
   residue_count_        = 0;
   atom_count_           = 0;
@@ -116,6 +114,11 @@ bool MMCifReader::OnBeginLoop(const StarLoopDesc& header)
   category_ = DONT_KNOW;
   // set whole array to -1
   memset(indices_, -1, MAX_ITEMS_IN_ROW * sizeof(int));
+  // categories nobody asked for are skipped by the parser without splitting
+  // their rows
+  if (!this->IsCategoryRead(header.GetCategory())) {
+    return false;
+  }
   // walk through possible categories
   if (header.GetCategory() == "atom_site") {
     category_ = ATOM_SITE;
@@ -140,6 +143,17 @@ bool MMCifReader::OnBeginLoop(const StarLoopDesc& header)
     indices_[AUTH_SEQ_ID]        = header.GetIndex("auth_seq_id");
     indices_[PDBX_PDB_INS_CODE]  = header.GetIndex("pdbx_PDB_ins_code");
     indices_[PDBX_PDB_MODEL_NUM] = header.GetIndex("pdbx_PDB_model_num");
+    if (!atom_site_items_.empty()) {
+      if (atom_site_items_.find("occupancy") == atom_site_items_.end()) {
+        indices_[OCCUPANCY] = -1;
+      }
+      if (atom_site_items_.find("B_iso_or_equiv") == atom_site_items_.end()) {
+        indices_[B_ISO_OR_EQUIV] = -1;
+      }
+      if (atom_site_items_.find("group_PDB") == atom_site_items_.end()) {
+        indices_[GROUP_PDB] = -1;
+      }
+    }
 
     // post processing
     if (category_counts_[category_] > 0) {
@@ -448,9 +462,54 @@ bool MMCifReader::ParseAtomIdent(const std::vector<StringRef>& columns,
   return true;
 }
 
-void MMCifReader::ParseAndAddAtom(const std::vector<StringRef>& columns)
+struct MMCifReader::AtomSiteRows : public StarLoopRows {
+  geom::Vec3List    pos;
+  std::vector<Real> occupancies;
+  std::vector<Real> b_factors;
+  std::vector<bool> converted; ///< false if any of the values is invalid
+};
+
+StarLoopRowsPtr MMCifReader::ConvertDataRows(const StarLoopDesc& header,
+                                          const std::vector<StringRef>& values,
+                                             size_t num_rows) const
+{
+  if (category_ != ATOM_SITE) {
+    return StarLoopRowsPtr();
+  }
+  // invalid values are left to ParseAndAddAtom(), which knows how to report
+  // them
+  boost::shared_ptr<AtomSiteRows> rows(new AtomSiteRows);
+  rows->pos.resize(num_rows);
+  rows->occupancies.resize(num_rows, 1.0);
+  rows->b_factors.resize(num_rows, 0.0);
+  rows->converted.resize(num_rows, true);
+  const size_t row_size = header.GetSize();
+  for (size_t r = 0; r < num_rows; ++r) {
+    const StringRef* row = &values[r * row_size];
+    bool converted = true;
+    for (int i = CARTN_X; i <= CARTN_Z; ++i) {
+      std::pair<bool, float> result = row[indices_[i]].to_float();
+      converted = converted && result.first;
+      rows->pos[r][i - CARTN_X] = result.second;
+    }
+    if (indices_[OCCUPANCY] != -1) {
+      std::pair<bool, float> result = row[indices_[OCCUPANCY]].to_float();
+      converted = converted && result.first;
+      rows->occupancies[r] = result.second;
+    }
+    if (indices_[B_ISO_OR_EQUIV] != -1) {
+      std::pair<bool, float> result = row[indices_[B_ISO_OR_EQUIV]].to_float();
+      converted = converted && result.first;
+      rows->b_factors[r] = result.second;
+    }
+    rows->converted[r] = converted;
+  }
+  return rows;
+}
+
+void MMCifReader::ParseAndAddAtom(const std::vector<StringRef>& columns,
+                                  const AtomSiteRows* rows, size_t index)
 {
-  mol::XCSEditor editor=ent_handle_.EditXCS(mol::BUFFERED_EDIT); // potbl
   char alt_loc=0;
   String auth_chain_name;
   String cif_chain_name;
@@ -483,24 +542,31 @@ void MMCifReader::ParseAndAddAtom(const std::vector<StringRef>& columns)
   Real occ = 1.00f, temp = 0;
   geom::Vec3 apos;
   
-  for (int i = CARTN_X; i <= CARTN_Z; ++i) {
-    std::pair<bool, float> result = this->TryGetFloat(columns[indices_[i]],
+  if (rows && rows->converted[index]) {
+    apos = rows->pos[index];
+    occ = rows->occupancies[index];
+    temp = rows->b_factors[index];
+  } else {
+    for (int i = CARTN_X; i <= CARTN_Z; ++i) {
+      std::pair<bool, float> result = this->TryGetFloat(columns[indices_[i]],
                                                       "atom_site.cartn_[xyz]",
                                                       profile_.fault_tolerant);
-    if (!result.first) { // unit test
-      if (profile_.fault_tolerant) { // unit test
-        return;
+      if (!result.first) { // unit test
+        if (profile_.fault_tolerant) { // unit test
+          return;
+        }
       }
+      apos[i - CARTN_X] = result.second;
     }
-    apos[i - CARTN_X] = result.second;
-  }
 
-  if (indices_[OCCUPANCY] != -1) { // unit test
-    occ = this->TryGetReal(columns[indices_[OCCUPANCY]], "atom_site.occupancy");
-  }
-  if (indices_[B_ISO_OR_EQUIV] != -1) { // unit test
-    temp = this->TryGetReal(columns[indices_[B_ISO_OR_EQUIV]],
-                            "atom_site.B_iso_or_equiv");
+    if (indices_[OCCUPANCY] != -1) { // unit test
+      occ = this->TryGetReal(columns[indices_[OCCUPANCY]],
+                             "atom_site.occupancy");
+    }
+    if (indices_[B_ISO_OR_EQUIV] != -1) { // unit test
+      temp = this->TryGetReal(columns[indices_[B_ISO_OR_EQUIV]],
+                              "atom_site.B_iso_or_equiv");
+    }
   }
 
   // determine element
@@ -513,15 +579,15 @@ void MMCifReader::ParseAndAddAtom(const std::vector<StringRef>& columns)
   // determine chain and residue update
   bool update_chain = false;
   bool update_residue = false;
-  if(!curr_chain_) { // unit test
+  if(builder_.GetChainCount()==0) { // unit test
       update_chain=true;
       update_residue=true;
-  } else if(curr_chain_.GetName() != cif_chain_name) { // unit test
+  } else if(builder_.GetChainName() != cif_chain_name) { // unit test
     update_chain=true;
     update_residue=true;
   }
 
-  if(!curr_residue_) { // unit test
+  if(builder_.GetResidueCount()==0) { // unit test
     update_residue=true;
     subst_res_id_ = cif_chain_name +
                     columns[indices_[AUTH_SEQ_ID]].str() +
@@ -544,58 +610,50 @@ void MMCifReader::ParseAndAddAtom(const std::vector<StringRef>& columns)
                                            "Missing residue number information",
                                                this->GetCurrentLinenum()));
     }
-  } else if(curr_residue_.GetNumber() != res_num) { // unit test
+  } else if(builder_.GetResidueNumber() != res_num) { // unit test
     update_residue=true;
   }
 
   if(update_chain) { // unit test
-    curr_chain_ = ent_handle_.FindChain(cif_chain_name);
-    if(!curr_chain_.IsValid()) { // unit test
+    if(!builder_.HasChain(cif_chain_name)) { // unit test
       LOG_DEBUG("new chain " << cif_chain_name);
-      curr_chain_=editor.InsertChain(cif_chain_name);
-      curr_chain_.SetStringProp("pdb_auth_chain_name", auth_chain_name);
       ++chain_count_;
-      // store entity id
+      // store entity id, the chain gets its auth name once it exists
       String ent_id = columns[indices_[LABEL_ENTITY_ID]].str();
-      chain_id_pairs_.push_back(std::pair<mol::ChainHandle,String>(curr_chain_,
-                                                                   ent_id));
+      chain_id_pairs_.push_back(std::pair<String,String>(cif_chain_name,
+                                                         ent_id));
+      auth_chain_names_.push_back(auth_chain_name);
       info_.AddMMCifEntityIdTr(cif_chain_name, ent_id);
     }
-    assert(curr_chain_.IsValid());
+    builder_.AddChain(cif_chain_name);
   } else if (chain_id_pairs_.back().second != // unit test
              columns[indices_[LABEL_ENTITY_ID]].str()) {
     // check that label_entity_id stays the same
     throw IOException(this->FormatDiagnostic(STAR_DIAG_ERROR,
         "Change of 'atom_site.label_entity_id' item for chain " +
-        curr_chain_.GetName() + "! Expected: " + chain_id_pairs_.back().second +
-        ", found: " + columns[indices_[LABEL_ENTITY_ID]].str() + ".",
+        builder_.GetChainName() + "! Expected: " +
+        chain_id_pairs_.back().second + ", found: " +
+        columns[indices_[LABEL_ENTITY_ID]].str() + ".",
                                              this->GetCurrentLinenum()));
   }
 
   if(update_residue) { // unit test
-    curr_residue_=mol::ResidueHandle();
-    if (valid_res_num && profile_.join_spread_atom_records) { // unit test
-      curr_residue_=curr_chain_.FindResidue(res_num);
-    }
-    if (!curr_residue_.IsValid()) { // unit test
+    if (!valid_res_num || !profile_.join_spread_atom_records ||
+        !builder_.SelectResidue(res_num)) { // unit test
       LOG_DEBUG("new residue " << res_name << " " << res_num);
       if (valid_res_num) {
-        curr_residue_ = editor.AppendResidue(curr_chain_,
-                                             res_name.str(),
-                                             res_num);
+        builder_.AddResidue(res_name.str(), res_num);
       } else {
-        curr_residue_ = editor.AppendResidue(curr_chain_, res_name.str());
+        builder_.AddResidue(res_name.str());
       }
       warned_name_mismatch_=false;
       ++residue_count_; 
     }
-    assert(curr_residue_.IsValid());
   }
 
   // finally add atom
   LOG_DEBUG("adding atom " << aname << " (" << s_ele << ") @" << apos);
-  mol::AtomHandle ah;
-  if (curr_residue_.GetName()!=res_name.str()) { // unit test
+  if (builder_.GetResidueKey()!=res_name.str()) { // unit test
     if (!profile_.fault_tolerant && alt_loc=='.') { // unit test
       std::stringstream ss;
       ss << "Residue with number " << res_num << " has more than one name.";
@@ -610,19 +668,22 @@ void MMCifReader::ParseAndAddAtom(const std::vector<StringRef>& columns)
       } else {
         LOG_WARNING("Residue with number " << res_num 
                     << " contains a microheterogeneity. Everything but atoms "
-                    "for the residue '" << curr_residue_.GetName() 
+                    "for the residue '" << builder_.GetResidueKey() 
                     << "' will be ignored");
       }
     }
     warned_name_mismatch_=true;
     return;
   }
+  // record type
+  bool is_hetatm=indices_[GROUP_PDB] == -1 ? false :
+                 columns[indices_[GROUP_PDB]][0]=='H';
   if (alt_loc!='.') { // unit test
     // Check if there is already a atom with the same name.
-    mol::AtomHandle me=curr_residue_.FindAtom(aname);
-    if (me.IsValid()) { // unit test
+    int me=builder_.FindAtom(aname);
+    if (me>=0) { // unit test
       try {
-        editor.AddAltAtomPos(String(1, alt_loc), me, apos);
+        builder_.AddAltAtomPos(me, String(1, alt_loc), apos, occ, temp);
       } catch (Error&) {
         LOG_INFO("Ignoring atom alt location since there is already an atom "
                  "with name " << aname << ", but without an alt loc");
@@ -630,34 +691,26 @@ void MMCifReader::ParseAndAddAtom(const std::vector<StringRef>& columns)
       }
       return;
     } else {
-      ah = editor.InsertAltAtom(curr_residue_, aname,
-                                String(1, alt_loc), apos, s_ele);
+      builder_.AddAltAtom(aname, String(1, alt_loc), apos, s_ele, occ, temp,
+                          is_hetatm);
       ++atom_count_;
       }
   } else {
-    mol::AtomHandle atom=curr_residue_.FindAtom(aname);
-    if (atom.IsValid() && !profile_.quack_mode) { // unit test
+    if (builder_.FindAtom(aname)>=0 && !profile_.quack_mode) { // unit test
       if (profile_.fault_tolerant) { // unit test
         LOG_WARNING("duplicate atom '" << aname << "' in residue " 
-                    << curr_residue_);
+                    << builder_.GetResidueQualifiedName());
         return;
       }
       throw IOException(this->FormatDiagnostic(STAR_DIAG_ERROR,
                                                "Duplicate atom '"+aname+
                                                "' in residue "+
-                                               curr_residue_.GetQualifiedName(),
+                                     builder_.GetResidueQualifiedName(),
                                                this->GetCurrentLinenum()));
     }
-    ah = editor.InsertAtom(curr_residue_, aname, apos, s_ele);
+    builder_.AddAtom(aname, apos, s_ele, occ, temp, is_hetatm);
     ++atom_count_;
   }
-  ah.SetBFactor(temp);
-
-  ah.SetOccupancy(occ);
-
-  // record type
-  ah.SetHetAtom(indices_[GROUP_PDB] == -1 ? false :  
-                columns[indices_[GROUP_PDB]][0]=='H');
 }
 
 MMCifReader::MMCifEntityDescMap::iterator MMCifReader::GetEntityDescMapIterator(
@@ -1486,6 +1539,19 @@ void MMCifReader::ParsePdbxDatabaseStatus(
   }
 }
 
+void MMCifReader::OnConvertedDataRow(const StarLoopDesc& header, 
+                                     const std::vector<StringRef>& columns,
+                                     const StarLoopRows& rows, size_t index)
+{
+  const AtomSiteRows* atom_site_rows=dynamic_cast<const AtomSiteRows*>(&rows);
+  if (category_ == ATOM_SITE && atom_site_rows) {
+    LOG_TRACE("processing converted atom_site entry");
+    this->ParseAndAddAtom(columns, atom_site_rows, index);
+    return;
+  }
+  this->OnDataRow(header, columns);
+}
+
 void MMCifReader::OnDataRow(const StarLoopDesc& header, 
                             const std::vector<StringRef>& columns)
 {
@@ -1786,35 +1852,41 @@ void MMCifReader::OnEndData()
 {
   mol::XCSEditor editor=ent_handle_.EditXCS(mol::BUFFERED_EDIT);
 
+  // add the atom_site rows to the entity
+  builder_.Build(editor);
+  builder_.Clear();
+
   // process chain types
-  std::vector<std::pair<mol::ChainHandle, String> >::const_iterator css;
+  std::vector<std::pair<String, String> >::const_iterator css;
   MMCifEntityDescMap::const_iterator edm_it;
   MMCifPdbxEntityBranchLinkMap::const_iterator blm_it;
   std::vector<MMCifPdbxEntityBranchLink>::const_iterator bl_it;
   String pdb_auth_chain_name;
   for (css = chain_id_pairs_.begin(); css != chain_id_pairs_.end(); ++css) {
+    mol::ChainHandle chain = ent_handle_.FindChain(css->first);
+    chain.SetStringProp("pdb_auth_chain_name",
+                        auth_chain_names_[css-chain_id_pairs_.begin()]);
     // chain description
     edm_it = entity_desc_map_.find(css->second);
     if (edm_it != entity_desc_map_.end()) {
-      editor.SetChainType(css->first, edm_it->second.type);
-      editor.SetChainDescription(css->first, edm_it->second.details);
+      editor.SetChainType(chain, edm_it->second.type);
+      editor.SetChainDescription(chain, edm_it->second.details);
       if (edm_it->second.seqres.length() > 0) {
-        seqres_.AddSequence(seq::CreateSequence(css->first.GetName(),
+        seqres_.AddSequence(seq::CreateSequence(chain.GetName(),
                                                 edm_it->second.seqres));
-        pdb_auth_chain_name = css->first.GetStringProp("pdb_auth_chain_name");
-        info_.AddMMCifPDBChainTr(css->first.GetName(), pdb_auth_chain_name);
-        info_.AddPDBMMCifChainTr(pdb_auth_chain_name, css->first.GetName());
+        pdb_auth_chain_name = chain.GetStringProp("pdb_auth_chain_name");
+        info_.AddMMCifPDBChainTr(chain.GetName(), pdb_auth_chain_name);
+        info_.AddPDBMMCifChainTr(pdb_auth_chain_name, chain.GetName());
       } else if (edm_it->second.type!=mol::CHAINTYPE_WATER) {
         // mark everything that doesn't have SEQRES and isn't of type
         // water as ligand
-        mol::ChainHandle chain=css->first;
         mol::ResidueHandleList residues=chain.GetResidueList();
         for (mol::ResidueHandleList::iterator 
              i=residues.begin(), e=residues.end(); i!=e; ++i) {
           (*i).SetIsLigand(true);
         }
       }
-    } else {
+    } else if (this->IsCategoryRead("entity")) {
       LOG_WARNING("No entity description found for atom_site.label_entity_id '"
                   << css->second << "'");
     }
@@ -1824,11 +1896,11 @@ void MMCifReader::OnEndData()
     if (blm_it != entity_branch_link_map_.end()) {
       for (bl_it = blm_it->second.begin(); bl_it != blm_it->second.end();
            ++bl_it) {
-        mol::ResidueHandle res1 = css->first.FindResidue(to_res_num(
-                                                         bl_it->res_num_1, ' '));
-        mol::ResidueHandle res2 = css->first.FindResidue(to_res_num(
-                                                         bl_it->res_num_2, ' '));
-        info_.AddEntityBranchLink(css->first.GetName(),
+        mol::ResidueHandle res1 = chain.FindResidue(to_res_num(
+                                                    bl_it->res_num_1, ' '));
+        mol::ResidueHandle res2 = chain.FindResidue(to_res_num(
+                                                    bl_it->res_num_2, ' '));
+        info_.AddEntityBranchLink(chain.GetName(),
                                   res1.FindAtom(bl_it->atm_nm_1),
                                   res2.FindAtom(bl_it->atm_nm_2),
                                   bl_it->bond_order);
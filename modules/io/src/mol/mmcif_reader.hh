@@ -20,10 +20,12 @@
 #define OST_MMCIF_READER_HH
 
 #include <map>
+#include <set>
 
 #include <ost/geom/geom.hh>
 #include <ost/seq/sequence_list.hh>
 #include <ost/mol/residue_handle.hh>
+#include <ost/mol/bulk_builder.hh>
 #include <ost/mol/chain_type.hh>
 #include <ost/conop/compound_lib.hh>
 #include <ost/io/mol/io_profile.hh>
@@ -113,6 +115,52 @@ public:
     auth_chain_id_ = id;
   }
 
+  /// \brief Restrict reading to a set of categories
+  ///
+  /// Loops and data items of all other categories are skipped without
+  /// converting their values, so the corresponding information is missing in
+  /// the \link MMCifInfo MMCifInfo\endlink object and in the entity (e.g.
+  /// chain types need entity, SEQRES needs entity_poly, secondary structure
+  /// needs struct_conf and struct_sheet_range). atom_site is always read. An
+  /// empty list, the default, reads all categories known to the reader.
+  ///
+  /// \param categories category names, e.g. "entity"
+  void SetCategories(const std::vector<String>& categories)
+  {
+    categories_=std::set<String>(categories.begin(), categories.end());
+  }
+
+  /// \brief Get the categories reading is restricted to
+  ///
+  /// \return Sorted category names, empty if all categories are read
+  std::vector<String> GetCategories() const
+  {
+    return std::vector<String>(categories_.begin(), categories_.end());
+  }
+
+  /// \brief Restrict the optional atom_site items to be read
+  ///
+  /// Items needed to build the entity, like names, residue numbers, model
+  /// numbers and coordinates, are always read. Of the optional items
+  /// occupancy, B_iso_or_equiv and group_PDB, only the listed ones are
+  /// converted, atoms get an occupancy of 1, a B-factor of 0 and are not
+  /// flagged as HETATM otherwise. An empty list, the default, reads all items.
+  ///
+  /// \param items atom_site item names, e.g. "B_iso_or_equiv"
+  void SetAtomSiteItems(const std::vector<String>& items)
+  {
+    atom_site_items_=std::set<String>(items.begin(), items.end());
+  }
+
+  /// \brief Get the optional atom_site items reading is restricted to
+  ///
+  /// \return Sorted item names, empty if all items are read
+  std::vector<String> GetAtomSiteItems() const
+  {
+    return std::vector<String>(atom_site_items_.begin(),
+                               atom_site_items_.end());
+  }
+
   /// \brief check mmcif input to be read. Substitutional function for
   /// \link StarParser StarParser\endlink.
   ///
@@ -135,6 +183,19 @@ public:
   virtual void OnDataRow(const StarLoopDesc& header, 
                          const std::vector<StringRef>& columns);
 
+  /// \brief convert coordinates, occupancies and B-factors of atom_site rows
+  ///
+  /// Runs in the threads splitting large loops, see SetNumThreads(). The
+  /// values are stored in columns and picked up by ParseAndAddAtom().
+  virtual StarLoopRowsPtr ConvertDataRows(const StarLoopDesc& header,
+                                          const std::vector<StringRef>& values,
+                                          size_t num_rows) const;
+
+  /// \brief read a row of data converted by ConvertDataRows()
+  virtual void OnConvertedDataRow(const StarLoopDesc& header, 
+                                  const std::vector<StringRef>& columns,
+                                  const StarLoopRows& rows, size_t index);
+
   /// \brief Finalise parsing.
   virtual void OnEndData();
 
@@ -211,10 +272,17 @@ protected:
                       StringRef& atom_name,
                       char& alt_loc);
 
+  /// \brief atom_site values converted by ConvertDataRows()
+  struct AtomSiteRows;
+
   /// \brief Fetch atom information and store it.
   ///
   /// \param columns data row
-  void ParseAndAddAtom(const std::vector<StringRef>& columns);
+  /// \param rows if given, the coordinates, occupancy and B-factor are taken
+  ///        from row index of rows instead of being converted from columns
+  /// \param index see rows
+  void ParseAndAddAtom(const std::vector<StringRef>& columns,
+                       const AtomSiteRows* rows=NULL, size_t index=0);
 
   /// \brief Fetch mmCIF entity information
   ///
@@ -351,6 +419,15 @@ protected:
   /// \param type Type to be classified
   MMCifSecStructElement DetermineSecStructType(const StringRef& type) const;
 
+  /// \brief Check whether a category is read, see SetCategories()
+  ///
+  /// \param category category name
+  bool IsCategoryRead(const String& category) const
+  {
+    return categories_.empty() || category=="atom_site" ||
+           categories_.find(category)!=categories_.end();
+  }
+
   /// \brief Transform data from struct_conf entry into secondary structure
   ///
   /// \param ent Entity to assign secondary structure to
@@ -698,10 +775,12 @@ private:
   const IOProfile& profile_;
   mol::EntityHandle& ent_handle_;
   String restrict_chains_;
+  std::set<String> categories_;      ///< categories to read, empty for all
+  std::set<String> atom_site_items_; ///< optional atom_site items, empty: all
   bool auth_chain_id_;       ///< use chain IDs given by authors rather than pdb
   bool seqres_can_;          ///< read canonical 1-letter residues?
-  mol::ChainHandle curr_chain_;
-  mol::ResidueHandle curr_residue_;
+  mol::BulkBuilder builder_; ///< atom_site rows, added to the entity in
+                             ///< OnEndData()
   int chain_count_;
   int residue_count_;
   int atom_count_;
@@ -710,8 +789,9 @@ private:
   String subst_res_id_; ///< work around for missing label_seq_id's
   bool has_model_;      ///< keep track of models through different atom_sites
   int curr_model_;      ///< if we have pdbx_PDB_model_num, store no.
-  std::vector<std::pair<mol::ChainHandle, String> > chain_id_pairs_;
-  ///< chain and label_entity_id
+  std::vector<std::pair<String, String> > chain_id_pairs_;
+  ///< chain name and label_entity_id
+  std::vector<String> auth_chain_names_; ///< for chains in chain_id_pairs_
   MMCifEntityDescMap entity_desc_map_; ///< stores entity items
   seq::SequenceList seqres_;
   bool read_seqres_;
@@ -0,0 +1,670 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#include <string.h>
+#include <cmath>
+#include <sstream>
+#include <set>
+
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/filesystem/convenience.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <ost/base.hh>
+#include <ost/boost_filesystem_helper.hh>
+#include <ost/io/io_exception.hh>
+#include <ost/mol/atom_handle.hh>
+#include <ost/mol/residue_handle.hh>
+#include <ost/mol/chain_handle.hh>
+#include <ost/mol/entity_handle.hh>
+#include <ost/mol/entity_view.hh>
+#include <ost/mol/entity_visitor.hh>
+#include <ost/mol/chain_type.hh>
+#include "mmcif_writer.hh"
+
+namespace ost { namespace io {
+
+namespace {
+
+// collects text in a fixed size buffer and hands it to the stream in large
+// blocks. Numbers are formatted by hand, going through the stream for every
+// field is what makes writing large structures slow.
+class CIFBuffer {
+public:
+  CIFBuffer(std::ostream& stream): stream_(stream), data_(1<<16), pos_(0) { }
+
+  void Put(char c)
+  {
+    if (pos_==data_.size()) {
+      this->Flush();
+    }
+    data_[pos_++]=c;
+  }
+
+  void Put(const char* s, size_t n)
+  {
+    if (pos_+n>data_.size()) {
+      this->Flush();
+      if (n>data_.size()) {
+        stream_.write(s, n);
+        return;
+      }
+    }
+    memcpy(&data_[pos_], s, n);
+    pos_+=n;
+  }
+
+  void Put(const String& s) { this->Put(s.data(), s.size()); }
+
+  // writes a value, quoted if it could be mistaken for something else
+  void PutValue(const String& s)
+  {
+    if (!NeedsQuotes(s)) {
+      this->Put(s);
+    } else if (s.find('\n')!=String::npos ||
+               (s.find('\'')!=String::npos && s.find('"')!=String::npos)) {
+      // text field, the semicolons have to be at the start of a line
+      this->Put("\n;", 2);
+      this->Put(s);
+      this->Put("\n;\n", 3);
+    } else {
+      char quote=s.find('\'')==String::npos ? '\'' : '"';
+      this->Put(quote);
+      this->Put(s);
+      this->Put(quote);
+    }
+  }
+
+  void PutInt(long long val)
+  {
+    char tmp[24];
+    size_t n=0;
+    bool minus=val<0;
+    unsigned long long v=minus ? -static_cast<unsigned long long>(val) : val;
+    do {
+      tmp[n++]='0'+v%10;
+      v/=10;
+    } while (v);
+    if (minus) {
+      tmp[n++]='-';
+    }
+    if (pos_+n>data_.size()) {
+      this->Flush();
+    }
+    for (size_t i=0; i<n; ++i) {
+      data_[pos_+i]=tmp[n-i-1];
+    }
+    pos_+=n;
+  }
+
+  // fixed point with prec digits after the decimal point, prec<=10
+  void PutFixed(Real val, int prec)
+  {
+    static const long long scale[]={1LL, 10LL, 100LL, 1000LL, 10000LL,
+                                    100000LL, 1000000LL, 10000000LL,
+                                    100000000LL, 1000000000LL, 10000000000LL};
+    if (!std::isfinite(val)) {
+      this->Put('?');
+      return;
+    }
+    long long v=llround(static_cast<double>(val)*scale[prec]);
+    if (v<0) {
+      this->Put('-');
+      v=-v;
+    }
+    this->PutInt(v/scale[prec]);
+    if (prec==0) {
+      return;
+    }
+    this->Put('.');
+    long long frac=v%scale[prec];
+    char tmp[12];
+    for (int i=prec-1; i>=0; --i) {
+      tmp[i]='0'+frac%10;
+      frac/=10;
+    }
+    this->Put(tmp, prec);
+  }
+
+  void Flush()
+  {
+    stream_.write(&data_[0], pos_);
+    pos_=0;
+  }
+
+  static bool NeedsQuotes(const String& s)
+  {
+    if (s.empty() || s=="." || s=="?") {
+      return true;
+    }
+    bool reserved=false;
+    switch (s[0]) {
+      case '_': case '#': case '$': case '\'': case '"': case '[': case ']':
+      case ';':
+        return true;
+      case 'd': case 'D': case 's': case 'S': case 'l': case 'L': case 'g':
+      case 'G':
+        reserved=s.find('_')!=String::npos;
+        break;
+    }
+    for (String::const_iterator i=s.begin(), e=s.end(); i!=e; ++i) {
+      if (isspace(*i)) {
+        return true;
+      }
+    }
+    // only check for reserved words if the value could be one, the case
+    // insensitive comparisons are slow.
+    return reserved && (boost::istarts_with(s, "data_") ||
+                        boost::istarts_with(s, "save_") ||
+                        boost::iequals(s, "loop_") ||
+                        boost::iequals(s, "stop_") ||
+                        boost::iequals(s, "global_"));
+  }
+private:
+  std::ostream&     stream_;
+  std::vector<char> data_;
+  size_t            pos_;
+};
+
+void write_loop_header(CIFBuffer& buf, const char* category,
+                       const char** items)
+{
+  buf.Put("#\nloop_\n", 8);
+  for (const char** i=items; *i; ++i) {
+    buf.Put('_');
+    buf.Put(category, strlen(category));
+    buf.Put('.');
+    buf.Put(*i, strlen(*i));
+    buf.Put('\n');
+  }
+}
+
+// chains built in code usually don't have a type, tell polymers from the
+// rest by the kind of residues they contain.
+mol::ChainType resolve_chain_type(const mol::ChainHandle& chain)
+{
+  mol::ChainType type=chain.GetType();
+  if (type!=mol::CHAINTYPE_UNKNOWN && type!=mol::CHAINTYPE_N_CHAINTYPES) {
+    return type;
+  }
+  mol::ResidueHandleList residues=chain.GetResidueList();
+  bool water=!residues.empty();
+  for (mol::ResidueHandleList::const_iterator i=residues.begin(),
+       e=residues.end(); i!=e; ++i) {
+    if (i->IsPeptideLinking() || i->IsNucleotideLinking()) {
+      return mol::CHAINTYPE_POLY;
+    }
+    if (i->GetName()!="HOH") {
+      water=false;
+    }
+  }
+  return water ? mol::CHAINTYPE_WATER : mol::CHAINTYPE_NON_POLY;
+}
+
+// entity.type as opposed to the more detailed entity_poly.type
+const char* entity_type(mol::ChainType type)
+{
+  switch (type) {
+    case mol::CHAINTYPE_NON_POLY:
+      return "non-polymer";
+    case mol::CHAINTYPE_WATER:
+      return "water";
+    case mol::CHAINTYPE_MACROLIDE:
+      return "macrolide";
+    case mol::CHAINTYPE_BRANCHED:
+    case mol::CHAINTYPE_OLIGOSACCHARIDE:
+      return "branched";
+    default:
+      return "polymer";
+  }
+}
+
+bool is_polymer(mol::ChainType type)
+{
+  return strcmp(entity_type(type), "polymer")==0;
+}
+
+struct ChainEntry {
+  String         name;
+  String         auth_name;
+  String         entity_id;
+  bool           is_polymer;
+  bool           has_label_seq;
+};
+
+struct EntityEntry {
+  String              id;
+  mol::ChainType      type;
+  String              description;
+  std::vector<String> sequence;
+};
+
+class ChainCollector : public mol::EntityVisitor {
+public:
+  virtual bool VisitChain(const mol::ChainHandle& chain)
+  {
+    chains.push_back(chain);
+    residues.push_back(std::vector<String>());
+    return true;
+  }
+
+  virtual bool VisitResidue(const mol::ResidueHandle& res)
+  {
+    residues.back().push_back(res.GetKey());
+    return false;
+  }
+  mol::ChainHandleList              chains;
+  std::vector<std::vector<String> > residues;
+};
+
+class AtomSiteWriter : public mol::EntityVisitor {
+public:
+  AtomSiteWriter(CIFBuffer& buf, const std::vector<ChainEntry>& chains):
+    buf_(buf), chains_(chains), chain_(NULL), next_chain_(0), counter_(0),
+    seq_id_(0)
+  { }
+
+  virtual bool VisitChain(const mol::ChainHandle& chain)
+  {
+    chain_=&chains_[next_chain_++];
+    seq_id_=0;
+    return true;
+  }
+
+  virtual bool VisitResidue(const mol::ResidueHandle& res)
+  {
+    ++seq_id_;
+    res_name_=res.GetKey();
+    res_num_=res.GetNumber().GetNum();
+    ins_code_=res.GetNumber().GetInsCode();
+    return true;
+  }
+
+  virtual bool VisitAtom(const mol::AtomHandle& atom)
+  {
+    ++counter_;
+    if (atom.IsHetAtom()) {
+      buf_.Put("HETATM ", 7);
+    } else {
+      buf_.Put("ATOM ", 5);
+    }
+    buf_.PutInt(counter_);
+    buf_.Put(' ');
+    const String& ele=atom.GetElement();
+    if (ele.empty()) {
+      buf_.Put('?');
+    } else {
+      buf_.PutValue(ele);
+    }
+    buf_.Put(' ');
+    buf_.PutValue(atom.GetName());
+    buf_.Put(" . ", 3);
+    buf_.PutValue(res_name_);
+    buf_.Put(' ');
+    buf_.PutValue(chain_->name);
+    buf_.Put(' ');
+    buf_.PutValue(chain_->entity_id);
+    buf_.Put(' ');
+    if (chain_->has_label_seq) {
+      buf_.PutInt(seq_id_);
+    } else {
+      buf_.Put('.');
+    }
+    buf_.Put(' ');
+    buf_.Put(ins_code_ ? ins_code_ : '?');
+    geom::Vec3 pos=atom.GetPos();
+    for (int i=0; i<3; ++i) {
+      buf_.Put(' ');
+      buf_.PutFixed(pos[i], 3);
+    }
+    buf_.Put(' ');
+    buf_.PutFixed(atom.GetOccupancy(), 2);
+    buf_.Put(' ');
+    buf_.PutFixed(atom.GetBFactor(), 2);
+    buf_.Put(' ');
+    buf_.PutInt(res_num_);
+    buf_.Put(' ');
+    buf_.PutValue(chain_->auth_name);
+    buf_.Put(" 1\n", 3);
+    return true;
+  }
+private:
+  CIFBuffer&                     buf_;
+  const std::vector<ChainEntry>& chains_;
+  const ChainEntry*              chain_;
+  size_t                         next_chain_;
+  long long                      counter_;
+  int                            seq_id_;
+  String                         res_name_;
+  int                            res_num_;
+  char                           ins_code_;
+};
+
+const char* ENTITY_ITEMS[]={"id", "type", "pdbx_description", NULL};
+const char* ENTITY_POLY_ITEMS[]={"entity_id", "type", NULL};
+const char* ENTITY_POLY_SEQ_ITEMS[]={"entity_id", "num", "mon_id", "hetero",
+                                    NULL};
+const char* STRUCT_ASYM_ITEMS[]={"id", "entity_id", NULL};
+const char* ASSEMBLY_ITEMS[]={"id", "details", "method_details", NULL};
+const char* ASSEMBLY_GEN_ITEMS[]={"assembly_id", "oper_expression",
+                                  "asym_id_list", NULL};
+const char* OPER_LIST_ITEMS[]={"id", "type",
+                               "matrix[1][1]", "matrix[1][2]", "matrix[1][3]",
+                               "matrix[2][1]", "matrix[2][2]", "matrix[2][3]",
+                               "matrix[3][1]", "matrix[3][2]", "matrix[3][3]",
+                               "vector[1]", "vector[2]", "vector[3]", NULL};
+const char* ATOM_SITE_ITEMS[]={"group_PDB", "id", "type_symbol",
+                               "label_atom_id", "label_alt_id",
+                               "label_comp_id", "label_asym_id",
+                               "label_entity_id", "label_seq_id",
+                               "pdbx_PDB_ins_code", "Cartn_x", "Cartn_y",
+                               "Cartn_z", "occupancy", "B_iso_or_equiv",
+                               "auth_seq_id", "auth_asym_id",
+                               "pdbx_PDB_model_num", NULL};
+
+void put_or_unknown(CIFBuffer& buf, const String& value)
+{
+  if (value.empty()) {
+    buf.Put('?');
+  } else {
+    buf.PutValue(value);
+  }
+}
+
+void write_oper(CIFBuffer& buf, const MMCifInfoTransOp& op)
+{
+  buf.PutValue(op.GetID());
+  buf.Put(' ');
+  put_or_unknown(buf, op.GetType());
+  geom::Mat3 rot=op.GetMatrix();
+  for (int i=0; i<3; ++i) {
+    for (int j=0; j<3; ++j) {
+      buf.Put(' ');
+      buf.PutFixed(rot(i, j), 10);
+    }
+  }
+  geom::Vec3 vec=op.GetVector();
+  for (int i=0; i<3; ++i) {
+    buf.Put(' ');
+    buf.PutFixed(vec[i], 10);
+  }
+  buf.Put('\n');
+}
+
+void write_biounits(CIFBuffer& buf, const MMCifInfo& info)
+{
+  const std::vector<MMCifInfoBioUnit>& biounits=info.GetBioUnits();
+  if (biounits.empty()) {
+    return;
+  }
+  write_loop_header(buf, "pdbx_struct_assembly", ASSEMBLY_ITEMS);
+  std::set<String> written;
+  for (size_t i=0; i<biounits.size(); ++i) {
+    // biounits are stored per pdbx_struct_assembly_gen row, but merged when
+    // they share the id
+    if (!written.insert(biounits[i].GetID()).second) {
+      continue;
+    }
+    buf.PutValue(biounits[i].GetID());
+    buf.Put(' ');
+    put_or_unknown(buf, biounits[i].GetDetails());
+    buf.Put(' ');
+    put_or_unknown(buf, biounits[i].GetMethodDetails());
+    buf.Put('\n');
+  }
+
+  std::vector<MMCifInfoTransOpPtr> ops=info.GetOperations();
+  std::set<String> op_ids;
+  for (size_t i=0; i<ops.size(); ++i) {
+    op_ids.insert(ops[i]->GetID());
+  }
+  write_loop_header(buf, "pdbx_struct_assembly_gen", ASSEMBLY_GEN_ITEMS);
+  for (size_t i=0; i<biounits.size(); ++i) {
+    const MMCifInfoBioUnit& bu=biounits[i];
+    const std::vector<std::pair<int, int> >& chain_intvl=
+      bu.GetChainIntervalList();
+    const std::vector<std::pair<int, int> >& op_intvl=
+      bu.GetOperationsIntervalList();
+    const std::vector<std::vector<MMCifInfoTransOpPtr> >& bu_ops=
+      bu.GetOperations();
+    for (size_t j=0; j<chain_intvl.size() && j<op_intvl.size(); ++j) {
+      std::stringstream expr;
+      bool parens=op_intvl[j].second-op_intvl[j].first>1;
+      for (int k=op_intvl[j].first; k<op_intvl[j].second; ++k) {
+        if (parens) {
+          expr << '(';
+        }
+        for (size_t l=0; l<bu_ops[k].size(); ++l) {
+          expr << (l ? "," : "") << bu_ops[k][l]->GetID();
+          if (op_ids.insert(bu_ops[k][l]->GetID()).second) {
+            ops.push_back(bu_ops[k][l]);
+          }
+        }
+        if (parens) {
+          expr << ')';
+        }
+      }
+      std::stringstream chains;
+      for (int k=chain_intvl[j].first; k<chain_intvl[j].second; ++k) {
+        chains << (k>chain_intvl[j].first ? "," : "") << bu.GetChainList()[k];
+      }
+      buf.PutValue(bu.GetID());
+      buf.Put(' ');
+      buf.PutValue(expr.str());
+      buf.Put(' ');
+      buf.PutValue(chains.str());
+      buf.Put('\n');
+    }
+  }
+
+  if (!ops.empty()) {
+    write_loop_header(buf, "pdbx_struct_oper_list", OPER_LIST_ITEMS);
+    for (size_t i=0; i<ops.size(); ++i) {
+      write_oper(buf, *ops[i]);
+    }
+  }
+}
+
+}
+
+MMCifWriter::MMCifWriter(std::ostream& stream):
+  outfile_(), outstream_(stream)
+{
+  out_.push(outstream_);
+}
+
+MMCifWriter::MMCifWriter(const boost::filesystem::path& filename):
+  outfile_(BFPathToString(filename).c_str()), outstream_(outfile_),
+  filename_(BFPathToString(filename))
+{
+  if (!outfile_.is_open()) {
+    throw IOException("Failed to open: " + filename_);
+  }
+  if (boost::iequals(".gz", boost::filesystem::extension(filename))) {
+    out_.push(boost::iostreams::gzip_compressor());
+  }
+  out_.push(outstream_);
+}
+
+MMCifWriter::MMCifWriter(const String& filename):
+  outfile_(filename.c_str()), outstream_(outfile_), filename_(filename)
+{
+  if (!outfile_.is_open()) {
+    throw IOException("Failed to open: " + filename);
+  }
+  if (boost::iequals(".gz", boost::filesystem::extension(filename))) {
+    out_.push(boost::iostreams::gzip_compressor());
+  }
+  out_.push(outstream_);
+}
+
+template <typename H>
+void MMCifWriter::WriteDataBlock(H ent)
+{
+  if (!out_) {
+    if (!filename_.empty()) {
+      std::stringstream ss;
+      ss << "Can't write mmCIF to file '" << filename_ << "'";
+      throw IOException(ss.str());
+    }
+    throw IOException("Can't write mmCIF. Bad stream");
+  }
+  String name=data_name_.empty() ? ent.GetName() : data_name_;
+  if (name.empty()) {
+    name="ost";
+  }
+  for (String::iterator i=name.begin(), e=name.end(); i!=e; ++i) {
+    if (isspace(*i)) {
+      *i='_';
+    }
+  }
+
+  // chains and entities first, they are needed for the atom_site rows
+  ChainCollector collector;
+  ent.Apply(collector);
+  std::vector<ChainEntry> chains(collector.chains.size());
+  std::vector<EntityEntry> entities;
+  std::map<String, size_t> entity_index;
+  std::set<String> used_ids;
+  for (size_t i=0; i<chains.size(); ++i) {
+    String id=info_.GetMMCifEntityIdTr(collector.chains[i].GetName());
+    if (!id.empty()) {
+      used_ids.insert(id);
+    }
+  }
+  int next_id=1;
+  for (size_t i=0; i<chains.size(); ++i) {
+    const mol::ChainHandle& chain=collector.chains[i];
+    ChainEntry& entry=chains[i];
+    entry.name=chain.GetName();
+    entry.auth_name=chain.GetStringProp("pdb_auth_chain_name", entry.name);
+    entry.entity_id=info_.GetMMCifEntityIdTr(entry.name);
+    if (entry.entity_id.empty()) {
+      do {
+        entry.entity_id=boost::lexical_cast<String>(next_id++);
+      } while (!used_ids.insert(entry.entity_id).second);
+    }
+    std::map<String, size_t>::const_iterator k=
+      entity_index.find(entry.entity_id);
+    if (k==entity_index.end()) {
+      EntityEntry entity;
+      entity.id=entry.entity_id;
+      entity.type=resolve_chain_type(chain);
+      entity.description=chain.GetDescription();
+      k=entity_index.insert(std::make_pair(entity.id, entities.size())).first;
+      entities.push_back(entity);
+    }
+    EntityEntry& entity=entities[k->second];
+    entry.is_polymer=is_polymer(entity.type);
+    // label_seq_id counts the residues of a polymer chain from 1 and points
+    // into entity_poly_seq, which is written from the first chain of the
+    // entity. Chains of the same entity with a different sequence only get
+    // the author residue numbers.
+    const std::vector<String>& residues=collector.residues[i];
+    if (entry.is_polymer && entity.sequence.empty()) {
+      entity.sequence=residues;
+    }
+    entry.has_label_seq=entry.is_polymer && !residues.empty() &&
+                        entity.sequence==residues;
+  }
+
+  CIFBuffer buf(out_);
+  buf.Put("data_", 5);
+  buf.Put(name);
+  buf.Put("\n#\n_entry.id ", 13);
+  buf.PutValue(name);
+  buf.Put('\n');
+
+  if (!entities.empty()) {
+    write_loop_header(buf, "entity", ENTITY_ITEMS);
+    bool has_poly_type=false;
+    for (size_t i=0; i<entities.size(); ++i) {
+      buf.PutValue(entities[i].id);
+      buf.Put(' ');
+      buf.Put(entity_type(entities[i].type));
+      buf.Put(' ');
+      put_or_unknown(buf, entities[i].description);
+      buf.Put('\n');
+      has_poly_type|=is_polymer(entities[i].type) &&
+                     entities[i].type!=mol::CHAINTYPE_POLY;
+    }
+    if (has_poly_type) {
+      write_loop_header(buf, "entity_poly", ENTITY_POLY_ITEMS);
+      for (size_t i=0; i<entities.size(); ++i) {
+        if (is_polymer(entities[i].type) &&
+            entities[i].type!=mol::CHAINTYPE_POLY) {
+          buf.PutValue(entities[i].id);
+          buf.Put(' ');
+          buf.PutValue(mol::StringFromChainType(entities[i].type));
+          buf.Put('\n');
+        }
+      }
+    }
+    bool has_poly_seq=false;
+    for (size_t i=0; i<entities.size(); ++i) {
+      const std::vector<String>& seq=entities[i].sequence;
+      if (seq.empty()) {
+        continue;
+      }
+      if (!has_poly_seq) {
+        write_loop_header(buf, "entity_poly_seq", ENTITY_POLY_SEQ_ITEMS);
+        has_poly_seq=true;
+      }
+      for (size_t j=0; j<seq.size(); ++j) {
+        buf.PutValue(entities[i].id);
+        buf.Put(' ');
+        buf.PutInt(j+1);
+        buf.Put(' ');
+        buf.PutValue(seq[j]);
+        buf.Put(" n\n", 3);
+      }
+    }
+    write_loop_header(buf, "struct_asym", STRUCT_ASYM_ITEMS);
+    for (size_t i=0; i<chains.size(); ++i) {
+      buf.PutValue(chains[i].name);
+      buf.Put(' ');
+      buf.PutValue(chains[i].entity_id);
+      buf.Put('\n');
+    }
+  }
+
+  write_biounits(buf, info_);
+
+  write_loop_header(buf, "atom_site", ATOM_SITE_ITEMS);
+  AtomSiteWriter writer(buf, chains);
+  ent.Apply(writer);
+  buf.Put("#\n", 2);
+  buf.Flush();
+  out_.flush();
+  if (!out_) {
+    throw IOException("Failed to write mmCIF data");
+  }
+}
+
+void MMCifWriter::Write(const mol::EntityView& ent)
+{
+  this->WriteDataBlock(ent);
+}
+
+void MMCifWriter::Write(const mol::EntityHandle& ent)
+{
+  this->WriteDataBlock(ent);
+}
+
+}}
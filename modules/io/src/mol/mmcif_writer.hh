@@ -0,0 +1,101 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_MMCIF_WRITER_HH
+#define OST_MMCIF_WRITER_HH
+
+#include <fstream>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <ost/io/module_config.hh>
+#include <ost/io/io_exception.hh>
+#include <ost/io/mol/mmcif_info.hh>
+
+namespace ost {
+
+namespace mol {
+
+class EntityView;
+class EntityHandle;
+
+}
+
+namespace io {
+
+/// \brief writer for the mmcif file format
+///
+/// Writes one data block per call to Write() with the following categories:
+///
+/// \li entry
+/// \li entity, entity_poly, entity_poly_seq
+/// \li struct_asym
+/// \li pdbx_struct_assembly, pdbx_struct_assembly_gen, pdbx_struct_oper_list
+///     (only if a MMCifInfo with biounits was set)
+/// \li atom_site
+///
+/// The atom_site rows are formatted by hand into a fixed size buffer which is
+/// handed to the output stream in large blocks, so the memory needed does not
+/// depend on the number of atoms. Chain names are written as label_asym_id,
+/// the pdb_auth_chain_name string property, if present, as auth_asym_id.
+/// Residue numbers are written as auth_seq_id. The label_seq_id of polymer
+/// residues counts from 1 along the chain and refers to the entity_poly_seq
+/// written from the first chain of the entity. Chains of the same entity with
+/// a different sequence, and non-polymers, get no label_seq_id.
+/// Entity ids are taken from the MMCifInfo, chains without entity id get an
+/// entity of their own. Only the current position of atoms with alternative
+/// locations is written. Files ending in .gz are compressed.
+class DLLEXPORT_OST_IO MMCifWriter {
+  typedef boost::iostreams::filtering_stream<boost::iostreams::output> OutStream;
+public:
+  MMCifWriter(const String& filename);
+
+  MMCifWriter(const boost::filesystem::path& filename);
+
+  MMCifWriter(std::ostream& outstream);
+
+  /// \brief set the name of the data block, defaults to the entity name
+  void SetDataName(const String& name) { data_name_=name; }
+
+  const String& GetDataName() const { return data_name_; }
+
+  /// \brief set entity ids and biounits to be written
+  void SetInfo(const MMCifInfo& info) { info_=info; }
+
+  const MMCifInfo& GetInfo() const { return info_; }
+
+  void Write(const mol::EntityView& ent);
+
+  void Write(const mol::EntityHandle& ent);
+
+private:
+  template <typename H>
+  void WriteDataBlock(H ent);
+
+  std::ofstream outfile_;
+  std::ostream& outstream_;
+  String        filename_;
+  String        data_name_;
+  MMCifInfo     info_;
+  OutStream     out_;
+};
+
+}}
+
+#endif
@@ -2,6 +2,11 @@
 #include <ost/mol/residue_handle.hh>
 #include <ost/mol/chain_handle.hh>
 #include <ost/mol/xcs_editor.hh>
+#include <ost/mol/bulk_builder.hh>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
 
 #include "omf.hh"
 
@@ -359,19 +364,18 @@ namespace{
     }
   }
 
-  void Dump(std::ostream& stream, const std::vector<int>& vec) {
+  // dumps vec packed into the smallest integer type given the number of
+  // elements n_16 and n_8 it would need with int16_t and int8_t packing
+  void DumpPacked(std::ostream& stream, const std::vector<int>& vec,
+                  int n_16, int n_8) {
 
     int8_t encoding = 32;
 
     // check whether we can pack tighter
-    int n_16 = IntegerPackingSize(vec, std::numeric_limits<int16_t>::min(), 
-                                  std::numeric_limits<int16_t>::max());
     if(n_16*sizeof(int16_t) < vec.size()*sizeof(int)) {
       // less bytes required...
       encoding = 16;
       //even tighter?
-      int n_8 = IntegerPackingSize(vec, std::numeric_limits<int8_t>::min(), 
-                                   std::numeric_limits<int8_t>::max());
       if(n_8*sizeof(int8_t) < n_16*sizeof(int16_t)) {
         encoding = 8;
       }
@@ -392,6 +396,123 @@ namespace{
     }
   }
 
+  void Dump(std::ostream& stream, const std::vector<int>& vec) {
+    int n_16 = IntegerPackingSize(vec, std::numeric_limits<int16_t>::min(), 
+                                  std::numeric_limits<int16_t>::max());
+    int n_8 = IntegerPackingSize(vec, std::numeric_limits<int8_t>::min(), 
+                                 std::numeric_limits<int8_t>::max());
+    DumpPacked(stream, vec, n_16, n_8);
+  }
+
+  // number of elements a single value needs with integer packing, same as
+  // IntegerPackingSize
+  inline int PackedSize(int val, int min, int max) {
+    if(val > max) {
+      return val/max + 1;
+    } else if(val < min) {
+      return std::abs(val)/std::abs(min) + 1;
+    }
+    return 1;
+  }
+
+  // quantizes the n values in[0], in[stride], ... with factor, delta encodes
+  // them and dumps them like Dump(stream, std::vector<int>) would do with the
+  // result of RealToIntVec and DeltaEncoding. deltas is only used as buffer.
+  void DumpQuantizedDeltas(std::ostream& stream, const Real* in, size_t stride,
+                           size_t n, Real factor, std::vector<int>& deltas) {
+    deltas.resize(n);
+    int n_16 = 0;
+    int n_8 = 0;
+    int last = 0;
+    for(size_t i = 0; i < n; ++i) {
+      int val = std::round(factor*in[i*stride]);
+      int delta = val - last;
+      last = val;
+      deltas[i] = delta;
+      n_16 += PackedSize(delta, std::numeric_limits<int16_t>::min(),
+                         std::numeric_limits<int16_t>::max());
+      n_8 += PackedSize(delta, std::numeric_limits<int8_t>::min(),
+                        std::numeric_limits<int8_t>::max());
+    }
+    DumpPacked(stream, deltas, n_16, n_8);
+  }
+
+  // reads vectors written with Dump(stream, std::vector<int>) and decodes
+  // integer packing, delta encoding and quantization in one go. The buffers
+  // are reused between calls.
+  class DeltaDecoder {
+  public:
+    DeltaDecoder(): encoding_(32) { }
+
+    // reads the next vector and returns an upper bound for the number of
+    // values it decodes to
+    size_t Read(std::istream& stream) {
+      stream.read(reinterpret_cast<char*>(&encoding_), sizeof(int8_t));
+      if(encoding_ == 8) {
+        LoadIntVec(stream, int8_vec_);
+        return int8_vec_.size();
+      } else if(encoding_ == 16) {
+        LoadIntVec(stream, int16_vec_);
+        return int16_vec_.size();
+      } else if(encoding_ == 32) {
+        LoadIntVec(stream, int32_vec_);
+        return int32_vec_.size();
+      }
+      throw ost::Error("Encountered unknown encoding when loading int vec." );
+    }
+
+    // writes factor times the decoded values to out[0], out[stride], ... and
+    // returns their number which is at most max_n
+    size_t Decode(Real factor, Real* out, size_t stride, size_t max_n) const {
+      if(encoding_ == 8) {
+        return Decode(int8_vec_, true, factor, out, stride, max_n);
+      } else if(encoding_ == 16) {
+        return Decode(int16_vec_, true, factor, out, stride, max_n);
+      }
+      return Decode(int32_vec_, false, factor, out, stride, max_n);
+    }
+
+  private:
+    template<typename T>
+    size_t Decode(const std::vector<T>& in, bool packed, Real factor,
+                  Real* out, size_t stride, size_t max_n) const {
+      const int min = std::numeric_limits<T>::min();
+      const int max = std::numeric_limits<T>::max();
+      const size_t in_size = in.size();
+      size_t n = 0;
+      int val = 0;
+      size_t idx = 0;
+      while(idx < in_size) {
+        int delta = in[idx++];
+        if(packed && (delta == max || delta == min)) {
+          int sentinel = delta;
+          while(true) {
+            if(idx >= in_size) {
+              throw ost::Error("Cannot read corrupted OMF stream");
+            }
+            int next = in[idx++];
+            delta += next;
+            if(next != sentinel) {
+              break;
+            }
+          }
+        }
+        if(n >= max_n) {
+          throw ost::Error("Cannot read corrupted OMF stream");
+        }
+        val += delta;
+        out[n*stride] = factor*val;
+        ++n;
+      }
+      return n;
+    }
+
+    int8_t encoding_;
+    std::vector<int8_t> int8_vec_;
+    std::vector<int16_t> int16_vec_;
+    std::vector<int> int32_vec_;
+  };
+
   // dump and load vectors with strings
   void Load(std::istream& stream, std::vector<String>& vec) {
     std::vector<uint8_t> string_sizes;
@@ -516,47 +637,32 @@ namespace{
     Dump(stream, run_length_encoded);
   }
 
-  void LoadPosVec(std::istream& stream, std::vector<Real>& vec) {
-    std::vector<int> delta_encoded;
-    Load(stream, delta_encoded);
-    std::vector<int> int_vec;
-    DeltaDecoding(delta_encoded, int_vec);
-    IntToRealVec(int_vec, vec, 0.001);     
-  }
-
   void LoadPositions(std::istream& stream, geom::Vec3List& positions) {
-    std::vector<Real> x_pos;
-    std::vector<Real> y_pos;
-    std::vector<Real> z_pos;
-    LoadPosVec(stream, x_pos);
-    LoadPosVec(stream, y_pos);
-    LoadPosVec(stream, z_pos);
-    positions.resize(x_pos.size());
-    for(uint i = 0; i < positions.size(); ++i) {
-      positions[i] = geom::Vec3(x_pos[i], y_pos[i], z_pos[i]);
+    // the coordinates are stored as separate x, y and z vectors, they're
+    // decoded directly into the Vec3 components
+    static_assert(sizeof(geom::Vec3) == 3*sizeof(Real),
+                  "Vec3List must store the coordinates contiguously");
+    DeltaDecoder decoder;
+    positions.resize(decoder.Read(stream));
+    Real* data = positions.empty() ? NULL : positions[0].Data();
+    size_t n = decoder.Decode(0.001, data, 3, positions.size());
+    positions.resize(n);
+    data = positions.empty() ? NULL : positions[0].Data();
+    for(int dim = 1; dim < 3; ++dim) {
+      decoder.Read(stream);
+      if(decoder.Decode(0.001, data + dim, 3, n) != n) {
+        throw ost::Error("Cannot read corrupted OMF stream");
+      }
     }
   }
 
-  void DumpPosVec(std::ostream& stream, const std::vector<Real>& vec) {
-    std::vector<int> int_vec;
-    RealToIntVec(vec, int_vec, 1000);
-    std::vector<int> delta_compressed;
-    DeltaEncoding(int_vec, delta_compressed);
-    Dump(stream, delta_compressed);    
-  }
-
   void DumpPositions(std::ostream& stream, const geom::Vec3List& positions) {
-    std::vector<Real> x_pos(positions.size());
-    std::vector<Real> y_pos(positions.size());
-    std::vector<Real> z_pos(positions.size());
-    for(uint i = 0; i < positions.size(); ++i) {
-      x_pos[i] = positions[i][0];
-      y_pos[i] = positions[i][1];
-      z_pos[i] = positions[i][2];
+    std::vector<int> deltas;
+    const Real* data = positions.empty() ? NULL : positions[0].Data();
+    for(int dim = 0; dim < 3; ++dim) {
+      DumpQuantizedDeltas(stream, data + dim, 3, positions.size(), 1000,
+                          deltas);
     }
-    DumpPosVec(stream, x_pos);
-    DumpPosVec(stream, y_pos);
-    DumpPosVec(stream, z_pos);
   }
 
   void LoadBFactors(std::istream& stream, std::vector<Real>& bfactors) {
@@ -564,11 +670,10 @@ namespace{
     int8_t bfactor_encoding = 0;
     stream.read(reinterpret_cast<char*>(&bfactor_encoding), sizeof(int8_t));
     if(bfactor_encoding == 0) {
-      std::vector<int> delta_encoded;
-      Load(stream, delta_encoded);
-      std::vector<int> int_vec;
-      DeltaDecoding(delta_encoded, int_vec);
-      IntToRealVec(int_vec, bfactors, 0.01);
+      DeltaDecoder decoder;
+      bfactors.resize(decoder.Read(stream));
+      Real* data = bfactors.empty() ? NULL : &bfactors[0];
+      bfactors.resize(decoder.Decode(0.01, data, 1, bfactors.size()));
     } else if(bfactor_encoding == 42) {
       std::vector<int> runlength_encoded;
       Load(stream, runlength_encoded);
@@ -597,9 +702,9 @@ namespace{
       // continue with delta encoding
       int8_t bfactor_encoding = 0;
       stream.write(reinterpret_cast<char*>(&bfactor_encoding), sizeof(int8_t));
-      std::vector<int> delta_encoded;
-      DeltaEncoding(int_vec, delta_encoded);
-      Dump(stream, delta_encoded);
+      std::vector<int> deltas;
+      const Real* data = bfactors.empty() ? NULL : &bfactors[0];
+      DumpQuantizedDeltas(stream, data, 1, bfactors.size(), 100, deltas);
     }
   }
 
@@ -662,6 +767,88 @@ namespace{
 
 namespace ost { namespace io {
 
+// raw bytes of an indexed OMF, either a memory mapped file or a copy of a
+// string
+class OMFDataSource {
+public:
+  static OMFDataSourcePtr FromFile(const String& fn) {
+    OMFDataSourcePtr source(new OMFDataSource);
+    source->file_.open(fn);
+    source->data_ = source->file_.data();
+    source->size_ = source->file_.size();
+    return source;
+  }
+
+  static OMFDataSourcePtr FromString(const String& s) {
+    OMFDataSourcePtr source(new OMFDataSource);
+    source->str_ = s;
+    source->data_ = source->str_.data();
+    source->size_ = source->str_.size();
+    return source;
+  }
+
+  const char* GetData() const { return data_; }
+
+  size_t GetSize() const { return size_; }
+
+private:
+  OMFDataSource(): data_(NULL), size_(0) { }
+
+  boost::iostreams::mapped_file_source file_;
+  String str_;
+  const char* data_;
+  size_t size_;
+};
+
+namespace {
+
+  const uint32_t OMF_MAGIC_NUMBER = 42;
+  const uint32_t OMF_VERSION = 1;
+  const uint32_t OMF_INDEXED_VERSION = 2;
+  const uint32_t OMF_COMPRESSED_BLOCKS = 1;
+  const uint32_t OMF_ARCHIVE_MAGIC_NUMBER = 43;
+  const uint32_t OMF_ARCHIVE_VERSION = 1;
+
+  // reads a single block of the indexed format, decompressing on the fly if
+  // needed
+  class BlockStream : public boost::iostreams::filtering_istream {
+  public:
+    BlockStream(const char* data, size_t size, bool compressed) {
+      if(compressed) {
+        this->push(boost::iostreams::zlib_decompressor());
+      }
+      this->push(boost::iostreams::array_source(data, size));
+    }
+  };
+
+  String EncodeBlock(const String& raw, bool compress) {
+    if(!compress) {
+      return raw;
+    }
+    String compressed;
+    boost::iostreams::filtering_ostream out;
+    out.push(boost::iostreams::zlib_compressor());
+    out.push(boost::iostreams::back_inserter(compressed));
+    out.write(raw.data(), raw.size());
+    out.reset();
+    return compressed;
+  }
+
+  uint32_t PeekVersion(const char* data, size_t size) {
+    if(size < 2*sizeof(uint32_t)) {
+      throw ost::Error("Cannot read corrupted OMF stream");
+    }
+    uint32_t magic_number;
+    memcpy(&magic_number, data, sizeof(uint32_t));
+    if(magic_number != OMF_MAGIC_NUMBER) {
+      throw ost::Error("Cannot read corrupted OMF stream");
+    }
+    uint32_t version;
+    memcpy(&version, data + sizeof(uint32_t), sizeof(uint32_t));
+    return version;
+  }
+}
+
 ResidueDefinition::ResidueDefinition(const ost::mol::ResidueHandle& res) {
   name = res.GetName();
   olc = res.GetOneLetterCode();
@@ -1000,7 +1187,16 @@ OMFPtr OMF::FromFile(const String& fn) {
   if (!in_stream) {
     throw ost::Error("Could not open " + fn);
   }
+  char head[2*sizeof(uint32_t)];
+  in_stream.read(head, sizeof(head));
   OMFPtr loaded_omf(new OMF);
+  if(in_stream && PeekVersion(head, sizeof(head)) == OMF_INDEXED_VERSION) {
+    in_stream.close();
+    loaded_omf->FromIndexedSource(OMFDataSource::FromFile(fn));
+    return loaded_omf;
+  }
+  in_stream.clear();
+  in_stream.seekg(0);
   loaded_omf->FromStream(in_stream);
   return loaded_omf;
 }
@@ -1014,8 +1210,12 @@ void OMF::ToFile(const String& fn) const {
 }
 
 OMFPtr OMF::FromString(const String& s) {
-  std::istringstream in_stream(s);
   OMFPtr loaded_omf(new OMF);
+  if(PeekVersion(s.data(), s.size()) == OMF_INDEXED_VERSION) {
+    loaded_omf->FromIndexedSource(OMFDataSource::FromString(s));
+    return loaded_omf;
+  }
+  std::istringstream in_stream(s);
   loaded_omf->FromStream(in_stream);
   return loaded_omf;
 }
@@ -1026,13 +1226,61 @@ String OMF::ToString() const {
   return out_stream.str();
 }
 
+void OMF::ToIndexedFile(const String& fn, bool compress) const {
+  std::ofstream out_stream(fn.c_str(), std::ios::binary);
+  if (!out_stream) {
+    throw ost::Error("Could not open " + fn);
+  }
+  this->ToIndexedStream(out_stream, compress);
+}
+
+String OMF::ToIndexedString(bool compress) const {
+  std::ostringstream out_stream;
+  this->ToIndexedStream(out_stream, compress);
+  return out_stream.str();
+}
+
+std::vector<String> OMF::GetChainNames() const {
+  std::vector<String> names;
+  if(source_) {
+    for(auto it = chain_blocks_.begin(); it != chain_blocks_.end(); ++it) {
+      names.push_back(it->first);
+    }
+  } else {
+    for(auto it = chain_data_.begin(); it != chain_data_.end(); ++it) {
+      names.push_back(it->first);
+    }
+  }
+  return names;
+}
+
+ChainDataPtr OMF::GetChainData(const String& name) const {
+  auto it = chain_data_.find(name);
+  if(it != chain_data_.end()) {
+    return it->second;
+  }
+  auto block_it = chain_blocks_.find(name);
+  if(block_it == chain_blocks_.end()) {
+    throw ost::Error("No chain of name " + name);
+  }
+  BlockStream stream(source_->GetData() + block_it->second.first,
+                     block_it->second.second, compressed_blocks_);
+  ChainDataPtr data(new ChainData);
+  data->FromStream(stream);
+  if(stream.fail()) {
+    throw ost::Error("Cannot read corrupted OMF stream");
+  }
+  return data;
+}
+
 ost::mol::EntityHandle OMF::GetAU() const{
   ost::mol::EntityHandle ent = mol::CreateEntity();
   ost::mol::XCSEditor ed = ent.EditXCS(mol::BUFFERED_EDIT);
 
-  for(auto it = chain_data_.begin(); it!=chain_data_.end(); ++it) {
-    ost::mol::ChainHandle ch = ed.InsertChain(it->first); 
-    this->FillChain(ch, ed, it->second);
+  std::vector<String> chain_names = this->GetChainNames();
+  for(auto it = chain_names.begin(); it!=chain_names.end(); ++it) {
+    ost::mol::ChainHandle ch = ed.InsertChain(*it); 
+    this->FillChain(ch, ed, this->GetChainData(*it));
   }
 
   // deal with inter-chain bonds
@@ -1049,13 +1297,11 @@ ost::mol::EntityHandle OMF::GetAU() const{
 
 ost::mol::EntityHandle OMF::GetAUChain(const String& name) const{
 
-  if(chain_data_.find(name) == chain_data_.end()) {
-    throw ost::Error("No chain of name " + name);
-  }
+  ChainDataPtr data = this->GetChainData(name);
   ost::mol::EntityHandle ent = mol::CreateEntity();
   ost::mol::XCSEditor ed = ent.EditXCS(mol::BUFFERED_EDIT);
   ost::mol::ChainHandle ch = ed.InsertChain(name);  
-  this->FillChain(ch, ed, chain_data_.at(name));
+  this->FillChain(ch, ed, data);
   return ent;
 }
 
@@ -1106,11 +1352,19 @@ ost::mol::EntityHandle OMF::GetBU(int bu_idx) const{
     }
   }
 
+  // decode every chain only once, even if it's used by several operations
+  std::map<String, ChainDataPtr> bu_chain_data;
+  for(auto it = au_chain_names.begin(); it != au_chain_names.end(); ++it) {
+    if(bu_chain_data.find(*it) == bu_chain_data.end()) {
+      bu_chain_data[*it] = this->GetChainData(*it);
+    }
+  }
+
   ChainNameGenerator gen;
   for(uint bu_ch_idx = 0; bu_ch_idx < au_chain_names.size(); ++bu_ch_idx) {
     String bu_ch_name = gen.Get();
     ost::mol::ChainHandle added_chain = ed.InsertChain(bu_ch_name);
-    this->FillChain(added_chain, ed, chain_data_.at(au_chain_names[bu_ch_idx]),
+    this->FillChain(added_chain, ed, bu_chain_data[au_chain_names[bu_ch_idx]],
                     transforms[bu_ch_idx]);
   }
 
@@ -1119,15 +1373,25 @@ ost::mol::EntityHandle OMF::GetBU(int bu_idx) const{
 
 void OMF::ToStream(std::ostream& stream) const {
 
-  uint32_t magic_number = 42;
+  uint32_t magic_number = OMF_MAGIC_NUMBER;
   stream.write(reinterpret_cast<char*>(&magic_number), sizeof(uint32_t));
 
-  uint32_t version = 1;
+  uint32_t version = OMF_VERSION;
   stream.write(reinterpret_cast<char*>(&version), sizeof(uint32_t));
 
   Dump(stream, residue_definitions_);
   Dump(stream, biounit_definitions_);
-  Dump(stream, chain_data_);
+  if(source_) {
+    // chains of an indexed OMF are only decoded on demand
+    std::map<String, ChainDataPtr> chain_data;
+    std::vector<String> chain_names = this->GetChainNames();
+    for(auto it = chain_names.begin(); it != chain_names.end(); ++it) {
+      chain_data[*it] = this->GetChainData(*it);
+    }
+    Dump(stream, chain_data);
+  } else {
+    Dump(stream, chain_data_);
+  }
   Dump(stream, bond_chain_names_);
   Dump(stream, bond_atoms_);
   Dump(stream, bond_orders_);
@@ -1137,13 +1401,13 @@ void OMF::FromStream(std::istream& stream) {
 
   uint32_t magic_number;
   stream.read(reinterpret_cast<char*>(&magic_number), sizeof(uint32_t));
-  if(magic_number != 42) {
+  if(magic_number != OMF_MAGIC_NUMBER) {
     throw ost::Error("Cannot read corrupted OMF stream");
   }
 
   uint32_t version;
   stream.read(reinterpret_cast<char*>(&version), sizeof(uint32_t));
-  if(version != 1) {
+  if(version != OMF_VERSION) {
     std::stringstream ss;
     ss << "OST version only supports OMF version 1. Got "<<version;
     throw ost::Error(ss.str());
@@ -1161,6 +1425,269 @@ void OMF::FromStream(std::istream& stream) {
   }
 }
 
+void OMF::ToIndexedStream(std::ostream& stream, bool compress) const {
+
+  // layout: magic number, version, flags, size of the header block, header
+  // block, chain blocks. The header block contains everything but the chains
+  // and the offsets of the chain blocks relative to the end of the header
+  // block.
+  std::vector<String> chain_names = this->GetChainNames();
+  std::vector<String> chain_blocks;
+  std::vector<uint64_t> offsets;
+  std::vector<uint64_t> sizes;
+  uint64_t offset = 0;
+  for(auto it = chain_names.begin(); it != chain_names.end(); ++it) {
+    std::ostringstream chain_stream;
+    this->GetChainData(*it)->ToStream(chain_stream);
+    chain_blocks.push_back(EncodeBlock(chain_stream.str(), compress));
+    offsets.push_back(offset);
+    sizes.push_back(chain_blocks.back().size());
+    offset += chain_blocks.back().size();
+  }
+
+  std::ostringstream header_stream;
+  Dump(header_stream, residue_definitions_);
+  Dump(header_stream, biounit_definitions_);
+  Dump(header_stream, bond_chain_names_);
+  Dump(header_stream, bond_atoms_);
+  Dump(header_stream, bond_orders_);
+  Dump(header_stream, chain_names);
+  DumpIntVec(header_stream, offsets);
+  DumpIntVec(header_stream, sizes);
+  String header = EncodeBlock(header_stream.str(), compress);
+
+  uint32_t magic_number = OMF_MAGIC_NUMBER;
+  stream.write(reinterpret_cast<char*>(&magic_number), sizeof(uint32_t));
+  uint32_t version = OMF_INDEXED_VERSION;
+  stream.write(reinterpret_cast<char*>(&version), sizeof(uint32_t));
+  uint32_t flags = compress ? OMF_COMPRESSED_BLOCKS : 0;
+  stream.write(reinterpret_cast<char*>(&flags), sizeof(uint32_t));
+  uint64_t header_size = header.size();
+  stream.write(reinterpret_cast<char*>(&header_size), sizeof(uint64_t));
+  stream.write(header.data(), header.size());
+  for(auto it = chain_blocks.begin(); it != chain_blocks.end(); ++it) {
+    stream.write(it->data(), it->size());
+  }
+}
+
+void OMF::FromIndexedSource(OMFDataSourcePtr source) {
+
+  const size_t preamble_size = 3*sizeof(uint32_t) + sizeof(uint64_t);
+  const char* data = source->GetData();
+  if(source->GetSize() < preamble_size) {
+    throw ost::Error("Cannot read corrupted OMF stream");
+  }
+  uint32_t flags;
+  memcpy(&flags, data + 2*sizeof(uint32_t), sizeof(uint32_t));
+  uint64_t header_size;
+  memcpy(&header_size, data + 3*sizeof(uint32_t), sizeof(uint64_t));
+  if(header_size > source->GetSize() - preamble_size) {
+    throw ost::Error("Cannot read corrupted OMF stream");
+  }
+  compressed_blocks_ = flags & OMF_COMPRESSED_BLOCKS;
+
+  BlockStream stream(data + preamble_size, header_size, compressed_blocks_);
+  std::vector<String> chain_names;
+  std::vector<uint64_t> offsets;
+  std::vector<uint64_t> sizes;
+  Load(stream, residue_definitions_);
+  Load(stream, biounit_definitions_);
+  Load(stream, bond_chain_names_);
+  Load(stream, bond_atoms_);
+  Load(stream, bond_orders_);
+  Load(stream, chain_names);
+  LoadIntVec(stream, offsets);
+  LoadIntVec(stream, sizes);
+  if(stream.fail() || offsets.size() != chain_names.size() ||
+     sizes.size() != chain_names.size()) {
+    throw ost::Error("Cannot read corrupted OMF stream");
+  }
+
+  size_t blocks_begin = preamble_size + header_size;
+  size_t blocks_size = source->GetSize() - blocks_begin;
+  chain_blocks_.clear();
+  for(uint i = 0; i < chain_names.size(); ++i) {
+    if(offsets[i] > blocks_size || sizes[i] > blocks_size - offsets[i]) {
+      throw ost::Error("Cannot read corrupted OMF stream");
+    }
+    chain_blocks_[chain_names[i]] = std::make_pair(blocks_begin + offsets[i],
+                                                   sizes[i]);
+  }
+  chain_data_.clear();
+  source_ = source;
+}
+
+OMFArchiveWriter::OMFArchiveWriter(const String& fn, bool compress):
+  stream_(fn.c_str(), std::ios::binary), compress_(compress), closed_(false),
+  offset_(0) {
+  if(!stream_) {
+    throw ost::Error("Could not open " + fn);
+  }
+  // layout: magic number, version, flags, entry blocks, index block, offset
+  // of the index block. Offsets are relative to the start of the file.
+  uint32_t magic_number = OMF_ARCHIVE_MAGIC_NUMBER;
+  stream_.write(reinterpret_cast<char*>(&magic_number), sizeof(uint32_t));
+  uint32_t version = OMF_ARCHIVE_VERSION;
+  stream_.write(reinterpret_cast<char*>(&version), sizeof(uint32_t));
+  uint32_t flags = compress ? OMF_COMPRESSED_BLOCKS : 0;
+  stream_.write(reinterpret_cast<char*>(&flags), sizeof(uint32_t));
+  offset_ = 3*sizeof(uint32_t);
+}
+
+OMFArchiveWriter::~OMFArchiveWriter() {
+  if(!closed_) {
+    try {
+      this->Close();
+    } catch(...) { }
+  }
+}
+
+void OMFArchiveWriter::Add(const String& id, const OMF& omf) {
+  if(closed_) {
+    throw ost::Error("Cannot add to closed OMF archive");
+  }
+  if(id_set_.find(id) != id_set_.end()) {
+    throw ost::Error("OMF archive already contains entry " + id);
+  }
+
+  // the entry only refers to the shared residue definitions, its own
+  // dictionary is replaced by the indices into the shared one
+  std::vector<int> res_def_indices;
+  for(auto it = omf.residue_definitions_.begin(); 
+      it != omf.residue_definitions_.end(); ++it) {
+    std::ostringstream def_stream;
+    it->ToStream(def_stream);
+    String key = def_stream.str();
+    auto map_it = residue_definition_map_.find(key);
+    if(map_it == residue_definition_map_.end()) {
+      int idx = residue_definitions_.size();
+      residue_definitions_.push_back(*it);
+      residue_definition_map_[key] = idx;
+      res_def_indices.push_back(idx);
+    } else {
+      res_def_indices.push_back(map_it->second);
+    }
+  }
+  OMF stripped(omf);
+  stripped.residue_definitions_.clear();
+
+  std::ostringstream entry_stream;
+  Dump(entry_stream, res_def_indices);
+  stripped.ToStream(entry_stream);
+  String block = EncodeBlock(entry_stream.str(), compress_);
+  stream_.write(block.data(), block.size());
+  if(!stream_) {
+    throw ost::Error("Could not write OMF archive");
+  }
+
+  ids_.push_back(id);
+  id_set_.insert(id);
+  offsets_.push_back(offset_);
+  sizes_.push_back(block.size());
+  offset_ += block.size();
+}
+
+void OMFArchiveWriter::Close() {
+  if(closed_) {
+    return;
+  }
+  closed_ = true;
+  std::ostringstream index_stream;
+  Dump(index_stream, residue_definitions_);
+  Dump(index_stream, ids_);
+  DumpIntVec(index_stream, offsets_);
+  DumpIntVec(index_stream, sizes_);
+  String index = EncodeBlock(index_stream.str(), compress_);
+  stream_.write(index.data(), index.size());
+  uint64_t index_offset = offset_;
+  stream_.write(reinterpret_cast<char*>(&index_offset), sizeof(uint64_t));
+  stream_.close();
+  if(!stream_) {
+    throw ost::Error("Could not write OMF archive");
+  }
+}
+
+OMFArchivePtr OMFArchive::FromFile(const String& fn) {
+  OMFArchivePtr archive(new OMFArchive);
+  OMFDataSourcePtr source = OMFDataSource::FromFile(fn);
+  const char* data = source->GetData();
+  size_t size = source->GetSize();
+  const size_t preamble_size = 3*sizeof(uint32_t);
+  if(size < preamble_size + sizeof(uint64_t)) {
+    throw ost::Error("Cannot read corrupted OMF archive");
+  }
+  uint32_t header[3];
+  memcpy(header, data, preamble_size);
+  if(header[0] != OMF_ARCHIVE_MAGIC_NUMBER) {
+    throw ost::Error("Cannot read corrupted OMF archive");
+  }
+  if(header[1] != OMF_ARCHIVE_VERSION) {
+    std::stringstream ss;
+    ss << "OST version only supports OMF archive version 1. Got "<<header[1];
+    throw ost::Error(ss.str());
+  }
+  archive->compressed_blocks_ = header[2] & OMF_COMPRESSED_BLOCKS;
+
+  uint64_t index_offset;
+  size_t index_end = size - sizeof(uint64_t);
+  memcpy(&index_offset, data + index_end, sizeof(uint64_t));
+  if(index_offset < preamble_size || index_offset > index_end) {
+    throw ost::Error("Cannot read corrupted OMF archive");
+  }
+  BlockStream stream(data + index_offset, index_end - index_offset,
+                     archive->compressed_blocks_);
+  std::vector<uint64_t> offsets;
+  std::vector<uint64_t> sizes;
+  Load(stream, archive->residue_definitions_);
+  Load(stream, archive->ids_);
+  LoadIntVec(stream, offsets);
+  LoadIntVec(stream, sizes);
+  if(stream.fail() || offsets.size() != archive->ids_.size() ||
+     sizes.size() != archive->ids_.size()) {
+    throw ost::Error("Cannot read corrupted OMF archive");
+  }
+  for(uint i = 0; i < offsets.size(); ++i) {
+    if(offsets[i] > index_offset || sizes[i] > index_offset - offsets[i]) {
+      throw ost::Error("Cannot read corrupted OMF archive");
+    }
+    archive->blocks_.push_back(std::make_pair(offsets[i], sizes[i]));
+    archive->id_map_[archive->ids_[i]] = i;
+  }
+  archive->source_ = source;
+  return archive;
+}
+
+bool OMFArchive::HasEntry(const String& id) const {
+  return id_map_.find(id) != id_map_.end();
+}
+
+OMFPtr OMFArchive::GetEntry(const String& id) const {
+  auto it = id_map_.find(id);
+  if(it == id_map_.end()) {
+    throw ost::Error("No entry of id " + id + " in OMF archive");
+  }
+  return this->GetEntryByIndex(it->second);
+}
+
+OMFPtr OMFArchive::GetEntryByIndex(size_t idx) const {
+  if(idx >= blocks_.size()) {
+    throw ost::Error("Invalid index for OMF archive entry");
+  }
+  BlockStream stream(source_->GetData() + blocks_[idx].first,
+                     blocks_[idx].second, compressed_blocks_);
+  std::vector<int> res_def_indices;
+  Load(stream, res_def_indices);
+  OMFPtr omf(new OMF);
+  omf->FromStream(stream);
+  for(auto it = res_def_indices.begin(); it != res_def_indices.end(); ++it) {
+    if(*it < 0 || *it >= static_cast<int>(residue_definitions_.size())) {
+      throw ost::Error("Cannot read corrupted OMF archive");
+    }
+    omf->residue_definitions_.push_back(residue_definitions_[*it]);
+  }
+  return omf;
+}
+
 void OMF::FillChain(ost::mol::ChainHandle& chain, ost::mol::XCSEditor& ed,
                     const ChainDataPtr data, geom::Mat4 t) const {
 
@@ -1181,33 +1708,44 @@ void OMF::FillChain(ost::mol::ChainHandle& chain, ost::mol::XCSEditor& ed,
     positions = &transformed_positions; // bend around
   }
 
+  // collect the whole chain first and add it in one go, that's considerably
+  // cheaper than going through the editor for every single atom
+  ost::mol::BulkBuilder builder;
+  builder.Reserve(1, data->res_def_indices.size(), positions->size());
+  builder.AddChain(chain.GetName());
   int at_idx = 0;
   for(uint res_idx = 0; res_idx < data->res_def_indices.size(); ++res_idx) {
     const ResidueDefinition& res_def = 
     residue_definitions_[data->res_def_indices[res_idx]];
     ost::mol::ResNum num = ost::mol::ResNum(data->rnums[res_idx], 
                                             data->insertion_codes[res_idx]);
-    ost::mol::ResidueHandle res = ed.AppendResidue(chain, res_def.name, num);
-    res.SetOneLetterCode(res_def.olc);
-    res.SetChemType(ost::mol::ChemType(res_def.chem_type));
-    res.SetChemClass(ost::mol::ChemClass(res_def.chem_class));
-    res.SetSecStructure(ost::mol::SecStructure(data->sec_structures[res_idx]));
-
+    builder.AddResidue(res_def.name, num);
     for(uint i = 0; i < res_def.anames.size(); ++i) {
-      ed.InsertAtom(res, res_def.anames[i], (*positions)[at_idx], 
-                    res_def.elements[i], data->occupancies[at_idx], 
-                    data->bfactors[at_idx], res_def.is_hetatm[i]);
+      builder.AddAtom(res_def.anames[i], (*positions)[at_idx], 
+                      res_def.elements[i], data->occupancies[at_idx], 
+                      data->bfactors[at_idx], res_def.is_hetatm[i]);
       ++at_idx;
     }
+  }
+  ost::mol::AtomHandleList added_atoms = builder.Build(ed);
 
-    ost::mol::AtomHandleList added_atoms = res.GetAtomList();
+  ost::mol::ResidueHandleList residues = chain.GetResidueList();
+  at_idx = 0;
+  for(uint res_idx = 0; res_idx < data->res_def_indices.size(); ++res_idx) {
+    const ResidueDefinition& res_def = 
+    residue_definitions_[data->res_def_indices[res_idx]];
+    ost::mol::ResidueHandle& res = residues[res_idx];
+    res.SetOneLetterCode(res_def.olc);
+    res.SetChemType(ost::mol::ChemType(res_def.chem_type));
+    res.SetChemClass(ost::mol::ChemClass(res_def.chem_class));
+    res.SetSecStructure(ost::mol::SecStructure(data->sec_structures[res_idx]));
     for(uint bond_idx = 0; bond_idx < res_def.bond_orders.size(); ++bond_idx) {
-      ed.Connect(added_atoms[res_def.bonds[2*bond_idx]], 
-                 added_atoms[res_def.bonds[2*bond_idx+1]], 
+      ed.Connect(added_atoms[at_idx + res_def.bonds[2*bond_idx]], 
+                 added_atoms[at_idx + res_def.bonds[2*bond_idx+1]], 
                  res_def.bond_orders[bond_idx]);
     }
+    at_idx += res_def.anames.size();
   }
-  ost::mol::AtomHandleList added_atoms = chain.GetAtomList();
   for(uint bond_idx = 0; bond_idx < data->bond_orders.size(); ++bond_idx) {
     ed.Connect(added_atoms[data->bonds[2*bond_idx]], 
                added_atoms[data->bonds[2*bond_idx+1]], 
@@ -33,9 +33,13 @@ namespace ost { namespace io {
 class ChainData;
 class BioUnitData;
 class OMF;
+class OMFDataSource;
+class OMFArchive;
 typedef boost::shared_ptr<OMF> OMFPtr;
 typedef boost::shared_ptr<ChainData> ChainDataPtr;
 typedef boost::shared_ptr<BioUnitData> BioUnitDataPtr;
+typedef boost::shared_ptr<OMFDataSource> OMFDataSourcePtr;
+typedef boost::shared_ptr<OMFArchive> OMFArchivePtr;
 
 struct ResidueDefinition {
 
@@ -144,6 +148,19 @@ public:
 
   String ToString() const;
 
+  /// \brief write the indexed variant of the format
+  ///
+  /// Every chain goes into a block of its own which can be decoded
+  /// independently, an index in front of the blocks tells where they are.
+  /// FromFile() maps such files into memory and only decodes the chains that
+  /// are actually requested, e.g. by GetAUChain() or GetBU(). If compress is
+  /// true, every block is compressed with zlib.
+  void ToIndexedFile(const String& fn, bool compress=false) const;
+
+  String ToIndexedString(bool compress=false) const;
+
+  std::vector<String> GetChainNames() const;
+
   ost::mol::EntityHandle GetAU() const;
 
   ost::mol::EntityHandle GetAUChain(const String& name) const;
@@ -151,13 +168,22 @@ public:
   ost::mol::EntityHandle GetBU(int bu_idx) const;
 
 private:
+  friend class OMFArchive;
+  friend class OMFArchiveWriter;
+
   // only construct with static functions
-  OMF() { }
+  OMF(): compressed_blocks_(false) { }
 
   void ToStream(std::ostream& stream) const;
 
   void FromStream(std::istream& stream);
 
+  void ToIndexedStream(std::ostream& stream, bool compress) const;
+
+  void FromIndexedSource(OMFDataSourcePtr source);
+
+  ChainDataPtr GetChainData(const String& name) const;
+
   void FillChain(ost::mol::ChainHandle& chain, ost::mol::XCSEditor& ed,
                  const ChainDataPtr data, 
                  geom::Mat4 transform = geom::Mat4()) const;
@@ -174,6 +200,81 @@ private:
   std::vector<String> bond_chain_names_;
   std::vector<int> bond_atoms_;
   std::vector<int> bond_orders_;
+
+  // only set for the indexed format. chain_data_ stays empty, the chains are
+  // decoded from their block in source_ when needed. The blocks are given as
+  // offset and size relative to the data of source_.
+  OMFDataSourcePtr source_;
+  std::map<String, std::pair<size_t, size_t> > chain_blocks_;
+  bool compressed_blocks_;
+};
+
+
+/// \brief writes many OMF entries into one archive file
+///
+/// Entries are appended to the file as they are added, only the residue
+/// definition dictionary and the index are kept in memory. Residue
+/// definitions are shared by all entries, so every unique residue definition
+/// is stored only once per archive. The dictionary and the index are written
+/// behind the entries by Close().
+class OMFArchiveWriter {
+
+public:
+  OMFArchiveWriter(const String& fn, bool compress=false);
+
+  ~OMFArchiveWriter();
+
+  void Add(const String& id, const OMF& omf);
+
+  void Close();
+
+private:
+  OMFArchiveWriter(const OMFArchiveWriter&);
+  OMFArchiveWriter& operator=(const OMFArchiveWriter&);
+
+  std::ofstream stream_;
+  bool compress_;
+  bool closed_;
+  uint64_t offset_;
+  std::vector<ResidueDefinition> residue_definitions_;
+  std::unordered_map<String, int> residue_definition_map_;
+  std::vector<String> ids_;
+  std::unordered_set<String> id_set_;
+  std::vector<uint64_t> offsets_;
+  std::vector<uint64_t> sizes_;
+};
+
+
+/// \brief read access to an archive written with OMFArchiveWriter
+///
+/// The archive is memory mapped, entries are only decoded when requested.
+/// Since nothing is cached, all getters can be called from several threads
+/// at the same time.
+class OMFArchive {
+
+public:
+  static OMFArchivePtr FromFile(const String& fn);
+
+  size_t GetSize() const { return ids_.size(); }
+
+  const std::vector<String>& GetIds() const { return ids_; }
+
+  bool HasEntry(const String& id) const;
+
+  OMFPtr GetEntry(const String& id) const;
+
+  OMFPtr GetEntryByIndex(size_t idx) const;
+
+private:
+  // only construct with static functions
+  OMFArchive(): compressed_blocks_(false) { }
+
+  OMFDataSourcePtr source_;
+  std::vector<ResidueDefinition> residue_definitions_;
+  std::vector<String> ids_;
+  std::unordered_map<String, size_t> id_map_;
+  std::vector<std::pair<size_t, size_t> > blocks_;
+  bool compressed_blocks_;
 };
 
 }} //ns
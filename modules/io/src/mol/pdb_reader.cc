@@ -460,6 +460,19 @@ void PDBReader::Import(mol::EntityHandle& ent,
                << atom_count_ << " atoms; with "
                << helix_list_.size() << " helices and "
                << strand_list_.size() << " strands");
+  {
+    mol::XCSEditor editor=ent.EditXCS(mol::BUFFERED_EDIT);
+    mol::AtomHandleList atoms=builder_.Build(editor);
+    for (size_t i=0; i<anisous_.size(); ++i) {
+      atoms[anisous_[i].first].SetAnisou(anisous_[i].second);
+    }
+    for (size_t i=0; i<radii_.size(); ++i) {
+      atoms[radii_[i].first].SetRadius(radii_[i].second);
+    }
+    for (size_t i=0; i<charges_.size(); ++i) {
+      atoms[charges_[i].first].SetCharge(charges_[i].second);
+    }
+  }
   this->AssignSecStructure(ent);
   this->AssignMolIds(ent);
   for (HetList::const_iterator i=hets_.begin(), e=hets_.end(); i!=e; ++i) {
@@ -537,8 +550,10 @@ void PDBReader::AssignSecStructure(mol::EntityHandle ent)
 
 void PDBReader::ClearState()
 {
-  curr_chain_=mol::ChainHandle();
-  curr_residue_=mol::ResidueHandle();
+  builder_.Clear();
+  anisous_.clear();
+  radii_.clear();
+  charges_.clear();
   seqres_=seq::SequenceList();
   chain_count_=0;
   residue_count_=0;
@@ -628,7 +643,7 @@ void PDBReader::ParseAnisou(const StringRef& line, int line_num,
     anisou[i]=result.second;
   }
   String aname(atom_name.str());
-  if (!curr_residue_.IsValid()) {
+  if (builder_.GetResidueCount()==0) {
     if (profile_.fault_tolerant || 
         profile_.calpha_only || 
         profile_.no_hetatms) {
@@ -637,8 +652,8 @@ void PDBReader::ParseAnisou(const StringRef& line, int line_num,
     const char* fmt_str="invalid ANISOU record for inexistent atom on line %d";
     throw IOException(str(format(fmt_str) % line_num));      
   }
-  mol::AtomHandle atom=curr_residue_.FindAtom(aname);
-  if (!atom.IsValid()) {
+  int atom=builder_.FindAtom(aname);
+  if (atom<0) {
     if (profile_.fault_tolerant ||
         profile_.calpha_only  ||
         profile_.no_hetatms ||
@@ -648,14 +663,13 @@ void PDBReader::ParseAnisou(const StringRef& line, int line_num,
     const char* fmt_str="invalid ANISOU record for inexistent atom on line %d";
     throw IOException(str(format(fmt_str) % line_num));      
   }
-  //get properties which are already set and extend them by adding the ANISOU info
-  
-
+  // the atom only exists once the builder has run, the ANISOU info is
+  // attached to it at the end of Import()
   geom::Mat3 mat(anisou[0], anisou[3], anisou[4],
                  anisou[3], anisou[1], anisou[5],
                  anisou[4], anisou[5], anisou[2]);
   mat/=10000;
-  atom.SetAnisou(mat);
+  anisous_.push_back(std::make_pair(size_t(atom), mat));
 }
 
 void PDBReader::ParseAndAddAtom(const StringRef& line, int line_num,
@@ -665,7 +679,6 @@ void PDBReader::ParseAndAddAtom(const StringRef& line, int line_num,
   if (!this->EnsureLineLength(line, 54)) {
     return;
   }
-  mol::XCSEditor editor=ent.EditXCS(mol::BUFFERED_EDIT);
   char alt_loc=0;
   String chain_name;
   StringRef res_name, atom_name;
@@ -734,63 +747,44 @@ void PDBReader::ParseAndAddAtom(const StringRef& line, int line_num,
   // determine chain and residue update
   bool update_chain=false;
   bool update_residue=false;
-  if(!curr_chain_) {
+  if(builder_.GetChainCount()==0) {
     update_chain=true;
     update_residue=true;
-  } else if(curr_chain_.GetName()!=chain_name) {
+  } else if(builder_.GetChainName()!=chain_name) {
     update_chain=true;
     update_residue=true;
   }
 
-  if(!curr_residue_) {
+  if(builder_.GetResidueCount()==0) {
     update_residue=true;
-  } else if(curr_residue_.GetNumber()!=res_num) {
+  } else if(!update_residue && builder_.GetResidueNumber()!=res_num) {
     update_residue=true;
   }
 
   if(update_chain) {
-    curr_chain_=ent.FindChain(chain_name);
-    if(!curr_chain_.IsValid()) {
+    if(!builder_.HasChain(chain_name)) {
       LOG_DEBUG("new chain " << chain_name);
-      curr_chain_=editor.InsertChain(chain_name);
       ++chain_count_;
     }
-    assert(curr_chain_.IsValid());
+    builder_.AddChain(chain_name);
   }
   if(update_residue) {
-    curr_residue_=mol::ResidueHandle();
-    if (profile_.join_spread_atom_records) {
-      curr_residue_=curr_chain_.FindResidue(res_num);
-    }
-    if (!curr_residue_.IsValid()) {
-      if(curr_chain_.GetResidueCount()>0 && profile_.join_spread_atom_records) {
-        int loc=curr_chain_.GetResidueCount()-1;
-        for(;loc>=0;--loc) {
-          if(curr_chain_.GetResidueByIndex(loc).GetNumber()<res_num) break;
-        }
-        if(loc<0) {
-          curr_residue_=editor.InsertResidueBefore(curr_chain_,0,res_num,res_name.str());
-        } else {
-          curr_residue_=editor.InsertResidueAfter(curr_chain_,loc,res_num,res_name.str());
-        }
-        if(!curr_residue_) {
-          // this should not happen...
-          curr_residue_=editor.AppendResidue(curr_chain_, res_name.str(), res_num);
-        }
-        LOG_DEBUG("inserted new residue " << res_name << " " << res_num << " after " << loc);
+    if (!profile_.join_spread_atom_records ||
+        !builder_.SelectResidue(res_num)) {
+      if(profile_.join_spread_atom_records) {
+        builder_.InsertResidue(res_name.str(), res_num);
+        LOG_DEBUG("inserted new residue " << res_name << " " << res_num);
       } else {
-        curr_residue_=editor.AppendResidue(curr_chain_, res_name.str(), res_num);
+        builder_.AddResidue(res_name.str(), res_num);
         LOG_DEBUG("appended new residue " << res_name << " " << res_num);
       }
       warned_name_mismatch_=false;
       ++residue_count_; 
     }
-    assert(curr_residue_.IsValid());
   }
   // finally add atom
   LOG_DEBUG("adding atom " << aname << " (" << s_ele << " '" << alt_loc << "'" << ") @" << apos);
-  mol::AtomHandle ah;
-  if (curr_residue_.GetName()!=res_name.str()) {
+  if (builder_.GetResidueKey()!=res_name.str()) {
     if (!profile_.fault_tolerant && alt_loc==' ') {
       std::stringstream ss;
       ss << "error on line " << line_num << ": "
@@ -805,7 +799,7 @@ void PDBReader::ParseAndAddAtom(const StringRef& line, int line_num,
         } else {
           LOG_WARNING("Residue with number " << res_num 
                       << " contains a microheterogeneity. Everything but atoms for "
-                      << "the residue '" << curr_residue_.GetName() 
+                      << "the residue '" << builder_.GetResidueKey() 
                       << "' will be ignored");
         }
       }
@@ -815,12 +809,14 @@ void PDBReader::ParseAndAddAtom(const StringRef& line, int line_num,
   }
   Real b=temp.first ? temp.second : 0.0;
   Real o=occ.first ? occ.second : 1.0;
+  bool is_hetatm=record_type[0]=='H';
+  size_t atom=0;
   if (!profile_.quack_mode && alt_loc!=' ') {
     // Check if there is already a atom with the same name.
-    mol::AtomHandle me=curr_residue_.FindAtom(aname);
-    if (me.IsValid()) {
+    int me=builder_.FindAtom(aname);
+    if (me>=0) {
       try {
-        editor.AddAltAtomPos(String(1, alt_loc), me, apos, o, b);
+        builder_.AddAltAtomPos(me, String(1, alt_loc), apos, o, b);
       } catch (Error&) {
         LOG_INFO("Ignoring atom alt location since there is already an atom "
                      "with name " << aname << ", but without an alt loc");
@@ -828,35 +824,31 @@ void PDBReader::ParseAndAddAtom(const StringRef& line, int line_num,
       }
       return;
     } else {
-      ah=editor.InsertAltAtom(curr_residue_, aname,
-                              String(1, alt_loc), apos, s_ele, o, b);
+      atom=builder_.AddAltAtom(aname, String(1, alt_loc), apos, s_ele, o, b,
+                               is_hetatm);
       ++atom_count_;
     }
   } else {
-    mol::AtomHandle atom=curr_residue_.FindAtom(aname);
-    if (atom.IsValid() && !profile_.quack_mode) {
+    if (builder_.FindAtom(aname)>=0 && !profile_.quack_mode) {
       if (profile_.fault_tolerant) {
         LOG_WARNING("duplicate atom '" << aname << "' in residue " 
-                    << curr_residue_);
+                    << builder_.GetResidueQualifiedName());
         return;
       }
       throw IOException("duplicate atom '"+aname+"' in residue "+
-                        curr_residue_.GetQualifiedName());
+                        builder_.GetResidueQualifiedName());
     }
-    ah=editor.InsertAtom(curr_residue_, aname, apos, s_ele);
+    atom=builder_.AddAtom(aname, apos, s_ele, o, b, is_hetatm);
     ++atom_count_;
   }
   if(is_pqr_) {
     if (radius.first) {
-      ah.SetRadius(radius.second);
+      radii_.push_back(std::make_pair(atom, radius.second));
     }
   }
-  ah.SetBFactor(b);
-  ah.SetOccupancy(o);
   if (charge.first) {
-    ah.SetCharge(charge.second);
+    charges_.push_back(std::make_pair(atom, charge.second));
   }
-  ah.SetHetAtom(record_type[0]=='H');
 }
 
 void PDBReader::ParseHelixEntry(const StringRef& line)
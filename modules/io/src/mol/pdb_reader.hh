@@ -31,6 +31,7 @@
 #include <ost/mol/chain_handle.hh>
 #include <ost/mol/atom_handle.hh>
 #include <ost/mol/xcs_editor.hh>
+#include <ost/mol/bulk_builder.hh>
 
 #include <ost/io/module_config.hh>
 #include <ost/io/mol/io_profile.hh>
@@ -90,8 +91,13 @@ private:
   void ParseStrandEntry(const StringRef& line);
   void Init(const boost::filesystem::path& loc);
   bool EnsureLineLength(const StringRef& line, size_t size);
-  mol::ChainHandle curr_chain_;
-  mol::ResidueHandle curr_residue_;
+  /// \brief chains, residues and atoms of the current model, added to the
+  ///     entity at the end of Import()
+  mol::BulkBuilder builder_;
+  /// \brief ANISOU, radius and charge of atoms, by index in builder_
+  std::vector<std::pair<size_t, geom::Mat3> > anisous_;
+  std::vector<std::pair<size_t, Real> > radii_;
+  std::vector<std::pair<size_t, Real> > charges_;
   int chain_count_;
   int residue_count_;
   int atom_count_;
@@ -21,8 +21,13 @@
   Author: Marco Biasini
  */
 #include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <cassert>
+#include <deque>
 #include <sstream>
 #include <ost/log.hh>
 #include <ost/io/io_exception.hh>
@@ -30,10 +35,83 @@
 
 namespace ost { namespace io {
 
+namespace {
+
+// a piece of a loop body consisting of whole lines
+struct LoopChunk {
+  LoopChunk(const char* b, const char* e, int l):
+    begin(b), end(e), first_line(l)
+  { }
+  const char*            begin;
+  const char*            end;
+  int                    first_line;
+  std::vector<StringRef> values;
+  // number of values up to and including a line and the line number, for 
+  // every line with values. Needed to report the right line in diagnostics.
+  std::vector<std::pair<size_t, int> > line_ends;
+  // set if every line holds one row, see StarParser::ConvertDataRows()
+  StarLoopRowsPtr        rows;
+};
+
+// splits a chunk into values and lets the parser convert them
+class LoopChunkSplitter {
+public:
+  LoopChunkSplitter(const StarParser& parser, const StarLoopDesc& header,
+                    LoopChunk& chunk):
+    parser_(parser), header_(header), chunk_(chunk)
+  { }
+
+  void operator()()
+  {
+    int line_num=chunk_.first_line;
+    bool one_row_per_line=true;
+    for (const char* p=chunk_.begin; p<chunk_.end; ++line_num) {
+      const char* eol=static_cast<const char*>(memchr(p, '\n', 
+                                                      chunk_.end-p));
+      if (!eol) {
+        eol=chunk_.end;
+      }
+      StringRef tline=StringRef(p, eol-p).rtrim();
+      if (!tline.empty() && tline[0]!='#') {
+        size_t line_begin=chunk_.values.size();
+        StarParser::SplitLine(tline, chunk_.values, false);
+        if (chunk_.values.size()-line_begin!=header_.GetSize()) {
+          one_row_per_line=false;
+        }
+        chunk_.line_ends.push_back(std::make_pair(chunk_.values.size(), 
+                                                  line_num));
+      }
+      p=eol+1;
+    }
+    if (!one_row_per_line || chunk_.values.empty()) {
+      return;
+    }
+    for (size_t i=0; i<chunk_.values.size(); ++i) {
+      chunk_.values[i]=chunk_.values[i].trim();
+    }
+    try {
+      chunk_.rows=parser_.ConvertDataRows(header_, chunk_.values, 
+                                          chunk_.line_ends.size());
+    } catch (...) {
+      // the rows are converted again by OnDataRow(), which reports the error
+      chunk_.rows.reset();
+    }
+  }
+private:
+  const StarParser&   parser_;
+  const StarLoopDesc& header_;
+  LoopChunk&          chunk_;
+};
+
+// loops are only split in parallel if they have at least two chunks
+const size_t LOOP_CHUNK_SIZE=1<<18;
+
+}
+
 StarParser::StarParser(std::istream& stream, bool items_as_row):
   filename_("<stream>"), line_num_(0),
-  has_current_line_(false), current_line_(),
-  items_row_header_(), file_open_(true),
+  has_current_line_(false), current_line_(), buffer_pos_(NULL), 
+  buffer_end_(NULL), num_threads_(1), items_row_header_(), file_open_(true),
   items_row_values_()
 {
   items_as_row_ = items_as_row;
@@ -45,11 +123,12 @@ StarParser::StarParser(std::istream& stream, bool items_as_row):
   stream_.push(stream);
 }
 
-StarParser::StarParser(const String& filename, bool items_as_row):
-  fstream_(filename.c_str()), filename_(filename),
-  line_num_(0), has_current_line_(false), current_line_(),
-  items_row_header_(), file_open_(true),
-  items_row_values_()
+StarParser::StarParser(const String& filename, bool items_as_row,
+                       bool in_memory):
+  fstream_(filename.c_str(), std::ios::in | std::ios::binary), 
+  filename_(filename), line_num_(0), has_current_line_(false), 
+  current_line_(), buffer_pos_(NULL), buffer_end_(NULL), num_threads_(1),
+  items_row_header_(), file_open_(true), items_row_values_()
 {
   items_as_row_=items_as_row;
   if (filename.length() >= 3 &&
@@ -61,9 +140,36 @@ StarParser::StarParser(const String& filename, bool items_as_row):
 
   if (!fstream_) {
     file_open_ = false;
+  } else if (in_memory) {
+    this->MapFile(filename);
   }
 }
 
+void StarParser::MapFile(const String& filename)
+{
+  if (filename.length() >= 3 &&
+      filename.substr(filename.length() - 3) == ".gz") {
+    // the decompressed size is unknown, grow the buffer as we go.
+    boost::iostreams::copy(stream_, 
+                           boost::iostreams::back_inserter(inflated_));
+    stream_.reset();
+    fstream_.close();
+    buffer_pos_=inflated_.empty() ? "" : &inflated_[0];
+    buffer_end_=buffer_pos_+inflated_.size();
+    return;
+  }
+  // empty files can't be mapped
+  if (boost::filesystem::file_size(filename)==0) {
+    buffer_pos_=buffer_end_="";
+    return;
+  }
+  mapped_file_.open(filename);
+  stream_.reset();
+  fstream_.close();
+  buffer_pos_=mapped_file_.data();
+  buffer_end_=buffer_pos_+mapped_file_.size();
+}
+
 String StarParser::FormatDiagnostic(StarDiagType type, const String& message,
                                     int line) const
 {
@@ -292,7 +398,16 @@ void StarParser::ParseLoop()
     }
   }
   bool process_rows=this->OnBeginLoop(header);
-  std::vector<String> tmp_values;
+  if (process_rows && this->IsBuffered() && num_threads_!=1) {
+    // the remaining rows, if any, are handled below
+    this->ParseLoopRowsParallel(header);
+  }
+  std::vector<StringRef> tmp_values;
+  // values that don't point into a buffer that outlives the row, i.e. 
+  // multiline values and, when reading line by line, all values. A deque 
+  // doesn't move its elements when growing, so the StringRefs stay valid.
+  std::deque<String> value_storage;
+  bool buffered=this->IsBuffered();
   // optimized for the common case where all values are present on the same 
   // line.
   while (this->GetLine(line)) {
@@ -307,11 +422,14 @@ void StarParser::ParseLoop()
         break;
       case ';':
         if (process_rows) {
-          tmp_values.push_back(String());
-          this->ParseMultilineValue(tmp_values.back());
+          value_storage.push_back(String());
+          this->ParseMultilineValue(value_storage.back());
+          tmp_values.push_back(StringRef(value_storage.back().data(),
+                                         value_storage.back().length()));
           if (tmp_values.size()==header.GetSize()) {
             this->CallOnDataRow(header, tmp_values);
             tmp_values.clear();
+            value_storage.clear();
           }          
         } else {
           String s;
@@ -330,14 +448,20 @@ void StarParser::ParseLoop()
         }
       default:
         if (process_rows) {
-          std::vector<StringRef> split_elements;
-          StarParser::SplitLine(tline, split_elements);
-          for(uint i = 0; i < split_elements.size(); ++i) {
-            tmp_values.push_back(split_elements[i].str());
+          size_t first=tmp_values.size();
+          StarParser::SplitLine(tline, tmp_values, false);
+          if (!buffered) {
+            // the line gets overwritten when reading the next one
+            for (size_t i=first; i<tmp_values.size(); ++i) {
+              value_storage.push_back(tmp_values[i].str());
+              tmp_values[i]=StringRef(value_storage.back().data(),
+                                      value_storage.back().length());
+            }
           }
           if (tmp_values.size()==header.GetSize()) {
             this->CallOnDataRow(header, tmp_values);           
             tmp_values.clear();
+            value_storage.clear();
           }
         }
         this->ConsumeLine();
@@ -349,6 +473,99 @@ void StarParser::ParseLoop()
   }
 }
 
+void StarParser::ParseLoopRowsParallel(const StarLoopDesc& header)
+{
+  // find the end of the loop and split it into chunks of whole lines. This 
+  // follows the rules of ParseLoop().
+  const char* start=has_current_line_ ? line_ref_.begin() : buffer_pos_;
+  int line_num=has_current_line_ ? line_num_ : line_num_+1;
+  std::vector<LoopChunk> chunks;
+  chunks.push_back(LoopChunk(start, start, line_num));
+  const char* p=start;
+  for (; p<buffer_end_; ++line_num) {
+    const char* eol=static_cast<const char*>(memchr(p, '\n', buffer_end_-p));
+    if (!eol) {
+      eol=buffer_end_;
+    }
+    StringRef tline=StringRef(p, eol-p).rtrim();
+    if (!tline.empty()) {
+      if (tline[0]==';') {
+        return;
+      }
+      if (tline[0]=='_' || StringRef("loop_", 5)==tline ||
+          (tline.length()>=5 && StringRef("data_", 5)==tline.substr(0, 5))) {
+        break;
+      }
+    }
+    if (static_cast<size_t>(p-chunks.back().begin)>=LOOP_CHUNK_SIZE) {
+      chunks.back().end=p;
+      chunks.push_back(LoopChunk(p, p, line_num));
+    }
+    p=eol+1;
+  }
+  const char* end=std::min(p, buffer_end_);
+  chunks.back().end=end;
+  if (chunks.size()<2) {
+    return;
+  }
+  size_t num_threads=num_threads_;
+  if (num_threads_<=0) {
+    num_threads=std::max(1u, boost::thread::hardware_concurrency());
+  }
+  // the values of a batch of chunks are split while the rows of the previous 
+  // batch are handed to OnDataRow(), so only two batches are kept in memory.
+  size_t batch_size=num_threads;
+  boost::thread_group first_batch;
+  for (size_t i=0; i<std::min(batch_size, chunks.size()); ++i) {
+    first_batch.create_thread(LoopChunkSplitter(*this, header, chunks[i]));
+  }
+  first_batch.join_all();
+  std::vector<StringRef> row;
+  for (size_t b=0; b<chunks.size(); b+=batch_size) {
+    boost::thread_group threads;
+    size_t batch_end=std::min(b+batch_size, chunks.size());
+    size_t next_end=std::min(b+2*batch_size, chunks.size());
+    for (size_t i=batch_end; i<next_end; ++i) {
+      threads.create_thread(LoopChunkSplitter(*this, header, chunks[i]));
+    }
+    try {
+      for (size_t i=b; i<batch_end; ++i) {
+        LoopChunk& chunk=chunks[i];
+        // converted rows start with the chunk, which they don't if the 
+        // previous chunk ended with an incomplete row
+        const StarLoopRows* rows=row.empty() ? chunk.rows.get() : NULL;
+        size_t line=0;
+        for (size_t j=0; j<chunk.values.size(); ++j) {
+          row.push_back(chunk.values[j]);
+          if (row.size()==header.GetSize()) {
+            while (chunk.line_ends[line].first<=j) {
+              ++line;
+            }
+            line_num_=chunk.line_ends[line].second;
+            if (rows) {
+              this->OnConvertedDataRow(header, row, *rows, line);
+            } else {
+              this->CallOnDataRow(header, row);
+            }
+            row.clear();
+          }
+        }
+        std::vector<StringRef>().swap(chunk.values);
+        std::vector<std::pair<size_t, int> >().swap(chunk.line_ends);
+        chunk.rows.reset();
+      }
+    } catch (...) {
+      threads.join_all();
+      throw;
+    }
+    threads.join_all();
+  }
+  // continue with the line that ends the loop
+  buffer_pos_=end;
+  line_num_=line_num-1;
+  has_current_line_=false;
+}
+
 void StarParser::ParseLastDataItemRow()
 {
   if (items_row_header_.GetCategory().size() > 0) {
@@ -584,4 +801,12 @@ void StarParser::CallOnDataRow(const StarLoopDesc& header,
   this->OnDataRow(header, string_refs);
 }
 
+void StarParser::CallOnDataRow(const StarLoopDesc& header,
+                               std::vector<StringRef>& columns) {
+  for (size_t i=0; i<columns.size(); ++i) {
+    columns[i]=columns[i].trim();
+  }
+  this->OnDataRow(header, columns);
+}
+
 }}
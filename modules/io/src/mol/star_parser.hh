@@ -24,11 +24,14 @@
   Author: Marco Biasini
  */
 #include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <map>
+#include <boost/shared_ptr.hpp>
 #include <ost/string_ref.hh>
 #include <ost/io/module_config.hh>
 
@@ -95,6 +98,16 @@ private:
   std::map<String, int> index_map_;
 };
 
+/// \brief values of loop rows converted by StarParser::ConvertDataRows()
+///
+/// Subclasses of StarParser derive from it to store whatever they convert.
+class DLLEXPORT_OST_IO StarLoopRows {
+public:
+  virtual ~StarLoopRows() { }
+};
+
+typedef boost::shared_ptr<StarLoopRows> StarLoopRowsPtr;
+
 /// \brief parser for the STAR file format
 /// 
 /// \section star_format STAR format description
@@ -120,7 +133,18 @@ public:
   ///                    header, values as row) and then parsed like a loop
   ///                    (OnBeginLoop(), OnDataRow(), OnEndLoop())
   explicit StarParser(std::istream& stream, bool items_as_row=false);
-  explicit StarParser(const String& filename, bool items_as_row=false);
+  /// \brief create a StarParser reading from a file
+  ///
+  /// \param filename file to read, gzip compressed if it ends with .gz
+  /// \param items_as_row see above
+  /// \param in_memory if true, uncompressed files are memory-mapped and 
+  ///                  compressed files are decompressed into one buffer 
+  ///                  before parsing. The values handed to OnDataRow() then
+  ///                  point straight into that buffer and no strings are
+  ///                  allocated for them. If false, the file is read line by 
+  ///                  line.
+  explicit StarParser(const String& filename, bool items_as_row=false,
+                      bool in_memory=true);
   virtual ~StarParser() { }
 // callback interface
 public:
@@ -140,6 +164,34 @@ public:
                          const std::vector<StringRef>& columns) 
   {
   }
+  /// \brief convert the rows of a large loop in one of the threads splitting
+  ///     it into values, see SetNumThreads()
+  ///
+  /// Called for chunks of rows in which every line holds exactly one row.
+  /// Several threads run it at the same time while the main thread calls
+  /// OnDataRow(), so it must neither change nor depend on the state of the
+  /// parser apart from what OnBeginLoop() set up. It must not throw.
+  ///
+  /// \param values the trimmed values of num_rows rows, one after the other
+  /// \return the converted rows, handed to OnConvertedDataRow(). If NULL, 
+  ///     OnDataRow() is called for the rows.
+  virtual StarLoopRowsPtr ConvertDataRows(const StarLoopDesc& header,
+                                          const std::vector<StringRef>& values,
+                                          size_t num_rows) const
+  {
+    return StarLoopRowsPtr();
+  }
+  /// \brief invoked instead of OnDataRow() for rows converted by 
+  ///     ConvertDataRows()
+  ///
+  /// \param rows the result of ConvertDataRows()
+  /// \param index index of the row in rows
+  virtual void OnConvertedDataRow(const StarLoopDesc& header, 
+                                  const std::vector<StringRef>& columns,
+                                  const StarLoopRows& rows, size_t index)
+  {
+    this->OnDataRow(header, columns);
+  }
   /// \brief invoked when a data item is encountered
   virtual void OnDataItem(const StarDataItem& item) { }
   
@@ -220,6 +272,24 @@ public:
   {
     return line_num_;
   }
+
+  /// \brief set the number of threads used to split large loops into values
+  ///
+  /// Only used when the whole file is held in memory, see the constructor. 
+  /// The rows of a loop are split into values in chunks by num_threads
+  /// threads while OnDataRow() is called for the rows of the previous chunks
+  /// in order. The threads also run ConvertDataRows() on the chunks. If
+  /// num_threads is 0, one thread per core is used. Loops which contain
+  /// multiline values are always read by a single thread.
+  void SetNumThreads(int num_threads)
+  {
+    num_threads_=num_threads;
+  }
+
+  int GetNumThreads() const
+  {
+    return num_threads_;
+  }
 public:
   void Parse();
   
@@ -228,6 +298,9 @@ public:
                         std::vector<StringRef>& parts, bool clear=true);
 private:
   void ParseLoop();
+  /// \brief Splits the rows of a loop in parallel, see SetNumThreads(). 
+  ///        Leaves the input untouched if the loop isn't worth it.
+  void ParseLoopRowsParallel(const StarLoopDesc& header);
   /// \brief Calls the loop parsing functions on the last data item fetched to
   ///        be read as loop
   void ParseLastDataItemRow();
@@ -240,23 +313,39 @@ private:
   /// \brief read next line, replacing the current line
   bool NextLine(StringRef& str)
   {
-    if (std::getline(stream_, current_line_)) {
-      str=StringRef(current_line_.data(), current_line_.length());
-      ++line_num_;
-      has_current_line_=true;
-      return true;
+    if (buffer_pos_) {
+      if (buffer_pos_>=buffer_end_) {
+        return false;
+      }
+      const char* eol=static_cast<const char*>(memchr(buffer_pos_, '\n',
+                                                      buffer_end_-buffer_pos_));
+      if (!eol) {
+        eol=buffer_end_;
+      }
+      line_ref_=StringRef(buffer_pos_, eol-buffer_pos_);
+      buffer_pos_=eol+1;
+    } else if (std::getline(stream_, current_line_)) {
+      line_ref_=StringRef(current_line_.data(), current_line_.length());
+    } else {
+      return false;
     }
-    return false;
+    str=line_ref_;
+    ++line_num_;
+    has_current_line_=true;
+    return true;
   }
   /// \brief return current line, or if no current line is set, read next line
   bool GetLine(StringRef& ref)
   {
     if (has_current_line_) {
-      ref=StringRef(current_line_.data(), current_line_.size());
+      ref=line_ref_;
       return true;        
     }
     return this->NextLine(ref);
   }
+
+  /// \brief whether the lines handed out stay valid until parsing is done
+  bool IsBuffered() const { return buffer_pos_!=NULL; }
   
   void ConsumeLine() 
   {
@@ -272,6 +361,9 @@ private:
   // vector and calls OnDataRow to minimize the change in interface.
   void CallOnDataRow(const StarLoopDesc& header, 
                      const std::vector<String>& columns);
+  void CallOnDataRow(const StarLoopDesc& header, 
+                     std::vector<StringRef>& columns);
+  void MapFile(const String& filename);
 
   void ParseDataItemIdent(const StringRef ident,
                           StringRef& cat, StringRef& name);
@@ -286,7 +378,13 @@ private:
   int           line_num_;
   bool          has_current_line_;
   String        current_line_;
+  StringRef     line_ref_;
+  boost::iostreams::mapped_file_source mapped_file_;
+  std::vector<char> inflated_;
+  const char*   buffer_pos_;
+  const char*   buffer_end_;
   bool          items_as_row_;
+  int           num_threads_;
   StarLoopDesc  items_row_header_;
   bool          file_open_;
   std::vector<String> items_row_values_;
@@ -0,0 +1,118 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+#include <ost/conop/heuristic.hh>
+#include <ost/io/io_exception.hh>
+#include <ost/io/mol/batch_loader.hh>
+#include <ost/mol/mol.hh>
+
+using namespace ost;
+using namespace ost::io;
+
+namespace {
+
+std::vector<String> test_files()
+{
+  std::vector<String> files;
+  for (int i=0; i<4; ++i) {
+    files.push_back("testfiles/mmcif/3T6C.cif.gz");
+    files.push_back("testfiles/pdb/1AKE.pdb");
+    files.push_back("testfiles/mmcif/multiple_transforms.cif.gz");
+    files.push_back("testfiles/does_not_exist.pdb");
+  }
+  return files;
+}
+
+IOProfile test_profile()
+{
+  IOProfile profile;
+  profile.fault_tolerant=true;
+  profile.processor=conop::ProcessorPtr(new conop::HeuristicProcessor);
+  return profile;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( io );
+
+BOOST_AUTO_TEST_CASE(batch_loader_ordered)
+{
+  std::vector<String> files=test_files();
+  IOProfile profile=test_profile();
+  mol::EntityHandle cif=BatchLoader::Load(files[0], profile);
+  mol::EntityHandle pdb=BatchLoader::Load(files[1], profile);
+  BOOST_CHECK_THROW(BatchLoader::Load(files[3], profile), Error);
+
+  for (int num_threads=1; num_threads<=4; num_threads+=3) {
+    BatchLoader loader(files, test_profile(), num_threads, 2);
+    BOOST_CHECK_EQUAL(loader.GetThreadCount(), num_threads);
+    BOOST_CHECK_EQUAL(loader.GetMaxInFlight(), size_t(2));
+    for (size_t i=0; i<files.size(); ++i) {
+      BOOST_REQUIRE(loader.HasNext());
+      BatchLoadResult result=loader.Next();
+      BOOST_CHECK_EQUAL(result.index, i);
+      BOOST_CHECK_EQUAL(result.filename, files[i]);
+      if (i%4==0) {
+        BOOST_CHECK_EQUAL(result.ent.GetAtomCount(), cif.GetAtomCount());
+        BOOST_CHECK_EQUAL(result.ent.GetBondCount(), cif.GetBondCount());
+      } else if (i%4==1) {
+        BOOST_CHECK_EQUAL(result.ent.GetAtomCount(), pdb.GetAtomCount());
+        BOOST_CHECK_EQUAL(result.ent.GetBondCount(), pdb.GetBondCount());
+      } else if (i%4==3) {
+        BOOST_CHECK(!result.ent.IsValid());
+        BOOST_CHECK(!result.error.empty());
+      }
+      if (i%4!=3) {
+        BOOST_CHECK(result.ent.IsValid());
+        BOOST_CHECK(result.error.empty());
+      }
+    }
+    BOOST_CHECK(!loader.HasNext());
+    BOOST_CHECK_THROW(loader.Next(), IOException);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(batch_loader_unordered)
+{
+  std::vector<String> files=test_files();
+  BatchLoader loader(files, test_profile(), 3, 0, false);
+  BOOST_CHECK_EQUAL(loader.GetMaxInFlight(), size_t(6));
+  std::set<size_t> seen;
+  while (loader.HasNext()) {
+    BatchLoadResult result=loader.Next();
+    BOOST_CHECK_EQUAL(result.filename, files[result.index]);
+    BOOST_CHECK_EQUAL(result.ent.IsValid(), result.index%4!=3);
+    seen.insert(result.index);
+  }
+  BOOST_CHECK_EQUAL(seen.size(), files.size());
+}
+
+BOOST_AUTO_TEST_CASE(batch_loader_early_exit)
+{
+  // destroying the loader before all entities have been fetched must not
+  // block
+  std::vector<String> files=test_files();
+  BatchLoader loader(files, test_profile(), 2, 1);
+  BOOST_CHECK(loader.Next().ent.IsValid());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,145 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <ost/io/mol/compressed_traj_io.hh>
+#include <ost/io/io_exception.hh>
+#include <ost/mol/entity_handle.hh>
+#include <ost/mol/residue_handle.hh>
+#include <ost/mol/chain_handle.hh>
+#include <ost/mol/atom_handle.hh>
+#include <ost/mol/xcs_editor.hh>
+#include <ost/mol/coord_group.hh>
+
+using namespace ost;
+using namespace ost::io;
+
+namespace {
+
+struct Fixture {
+  Fixture()
+  {
+    eh=mol::CreateEntity();
+    mol::XCSEditor ed=eh.EditXCS();
+    mol::ChainHandle chain=ed.InsertChain("A");
+    mol::ResidueHandle res=ed.AppendResidue(chain,mol::ResidueKey("UNK"));
+    std::ostringstream aname;
+    for(size_t i=0;i<natoms;++i) {
+      aname.str("");
+      aname << "X" << i;
+      atoms.push_back(ed.InsertAtom(res,aname.str(),geom::Vec3()));
+    }
+    cg=mol::CreateCoordGroup(atoms);
+    // includes large jumps between consecutive atoms and values that need
+    // all the bits of the rounded coordinates
+    for(size_t f=0;f<nframes;++f) {
+      geom::Vec3List atom_pos(natoms);
+      for(size_t i=0;i<natoms;++i) {
+        atom_pos[i]=geom::Vec3(0.37*i+f, -1.5*i*i, (i%7==3) ? -9999.99 : 0.01*f);
+      }
+      cg.AddFrame(atom_pos,geom::Vec3(f+1,f+2,f+3),geom::Vec3(1.0,1.1,1.2));
+    }
+  }
+  static const size_t natoms=101;
+  static const size_t nframes=10;
+  mol::EntityHandle eh;
+  mol::AtomHandleList atoms;
+  mol::CoordGroupHandle cg;
+};
+
+void check_frames(const mol::CoordGroupHandle& cg,
+                  const mol::CoordGroupHandle& cg2, uint stride, Real tol)
+{
+  BOOST_REQUIRE_EQUAL(cg2.GetFrameCount(),(cg.GetFrameCount()+stride-1)/stride);
+  for(uint f=0;f<cg2.GetFrameCount();++f) {
+    mol::CoordFramePtr frame=cg.GetFrame(f*stride);
+    mol::CoordFramePtr frame2=cg2.GetFrame(f);
+    BOOST_CHECK(geom::Distance(frame->GetCellSize(),
+                               frame2->GetCellSize())<1e-5);
+    BOOST_CHECK(geom::Distance(frame->GetCellAngles(),
+                               frame2->GetCellAngles())<1e-5);
+    for(size_t i=0;i<frame->size();++i) {
+      for(int k=0;k<3;++k) {
+        BOOST_CHECK_SMALL((*frame)[i][k]-(*frame2)[i][k],tol);
+      }
+    }
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( io );
+
+BOOST_AUTO_TEST_CASE(test_io_compressed_traj)
+{
+  Fixture f;
+  SaveCompressedTraj(f.cg,"test_io_compressed_traj_out.ctrj");
+  check_frames(f.cg,LoadCompressedTraj(f.eh,"test_io_compressed_traj_out.ctrj"),
+               1,0.0051);
+  check_frames(f.cg,LoadCompressedTraj(f.eh,"test_io_compressed_traj_out.ctrj",
+                                       3,true),3,0.0051);
+
+  SaveCompressedTraj(f.cg,"test_io_compressed_traj_out.ctrj",1,1000.0);
+  CompressedTrajCoordSourcePtr src(new CompressedTrajCoordSource(f.atoms,
+                                   "test_io_compressed_traj_out.ctrj"));
+  BOOST_CHECK_EQUAL(src->GetPrecision(),Real(1000.0));
+  check_frames(f.cg,mol::CoordGroupHandle(src),1,0.0011);
+  BOOST_CHECK_THROW(src->GetFrame(Fixture::nframes),IOException);
+
+  mol::AtomHandleList too_few(f.atoms.begin(),f.atoms.begin()+3);
+  BOOST_CHECK_THROW(CompressedTrajCoordSource(too_few,
+                                              "test_io_compressed_traj_out.ctrj"),
+                    IOException);
+  BOOST_CHECK_THROW(SaveCompressedTraj(f.cg,"test_io_compressed_traj_out.ctrj",
+                                       1,1e6),
+                    IOException);
+}
+
+BOOST_AUTO_TEST_CASE(test_io_compressed_traj_truncated)
+{
+  // a trajectory that is still being written has no index yet and may end
+  // with an incomplete frame
+  Fixture f;
+  {
+    CompressedTrajWriter writer("test_io_compressed_traj_trunc.ctrj",
+                                Fixture::natoms);
+    for(uint i=0;i<Fixture::nframes;++i) {
+      writer.AddFrame(f.cg.GetFramePositions(i),f.cg.GetFrame(i)->GetCellSize(),
+                      f.cg.GetFrame(i)->GetCellAngles());
+    }
+    BOOST_CHECK_EQUAL(writer.GetFrameCount(),uint(Fixture::nframes));
+    writer.Close();
+  }
+  std::ifstream in("test_io_compressed_traj_trunc.ctrj",std::ios::binary);
+  String data((std::istreambuf_iterator<char>(in)),
+              std::istreambuf_iterator<char>());
+  // drop index and half of the last frame
+  size_t index_size=(Fixture::nframes+1)*8+4;
+  size_t frame_size=(data.size()-index_size-16)/Fixture::nframes;
+  std::ofstream out("test_io_compressed_traj_trunc.ctrj",std::ios::binary);
+  out.write(data.data(),data.size()-index_size-frame_size/2);
+  out.close();
+  mol::CoordGroupHandle cg2=LoadCompressedTraj(f.eh,
+                                               "test_io_compressed_traj_trunc.ctrj");
+  BOOST_CHECK_EQUAL(cg2.GetFrameCount(),uint(Fixture::nframes-1));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
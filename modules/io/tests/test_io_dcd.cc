@@ -21,6 +21,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <ost/io/mol/dcd_io.hh>
+#include <ost/io/io_exception.hh>
 #include <ost/mol/entity_handle.hh>
 #include <ost/mol/residue_handle.hh>
 #include <ost/mol/chain_handle.hh>
@@ -86,4 +87,83 @@ BOOST_AUTO_TEST_CASE(test_io_dcd_charmm_frames)
   }
 }
 
+BOOST_AUTO_TEST_CASE(test_io_dcd_mapped)
+{
+  mol::EntityHandle eh=mol::CreateEntity();
+  mol::XCSEditor ed=eh.EditXCS();
+  mol::ChainHandle chain=ed.InsertChain("A");
+  mol::ResidueHandle res=ed.AppendResidue(chain,mol::ResidueKey("UNK"));
+
+  static unsigned int natoms=7;
+  static unsigned int nframes=10;
+
+  mol::AtomHandleList atoms(natoms);
+  std::ostringstream aname;
+  for(size_t i=0;i<natoms;++i) {
+    aname.str("");
+    aname << "X" << i;
+    atoms[i]=ed.InsertAtom(res,aname.str(),geom::Vec3());
+  }
+  mol::CoordGroupHandle cg=mol::CreateCoordGroup(atoms);
+  for(size_t f=0;f<nframes;++f) {
+    geom::Vec3List atom_pos(natoms);
+    for(size_t i=0;i<natoms;++i) {
+      atom_pos[i]=geom::Vec3(UniformRandom(),UniformRandom(),UniformRandom());
+    }
+    cg.AddFrame(atom_pos,geom::Vec3(f+1,f+2,f+3),geom::Vec3(1.0,1.1,1.2));
+  }
+  SaveCHARMMTraj(cg,"","test_io_dcd_mapped_out.dcd");
+
+  MappedDCDCoordSourcePtr src=MapCHARMMTraj(eh,"test_io_dcd_mapped_out.dcd",
+                                            1,4);
+  BOOST_CHECK_EQUAL(src->GetFrameCount(),nframes);
+  BOOST_CHECK(!src->IsByteSwapped());
+  for(uint f=0;f<nframes;++f) {
+    mol::CoordFramePtr frame=src->GetFrame(f);
+    DCDFrameView view=src->GetFrameView(f);
+    BOOST_CHECK_EQUAL(view.atom_count,natoms);
+    BOOST_CHECK(geom::Distance(frame->GetCellSize(),
+                               geom::Vec3(f+1,f+2,f+3))<1e-5);
+    BOOST_CHECK(geom::Distance(frame->GetCellAngles(),
+                               geom::Vec3(1.0,1.1,1.2))<1e-5);
+    geom::Vec3List atom_pos=cg.GetFramePositions(f);
+    for(size_t i=0;i<natoms;++i) {
+      BOOST_CHECK(geom::Distance((*frame)[i],atom_pos[i])<1e-5);
+      BOOST_CHECK(geom::Distance(geom::Vec3(view.x[i],view.y[i],view.z[i]),
+                                 atom_pos[i])<1e-5);
+    }
+  }
+  BOOST_CHECK_THROW(src->GetFrameView(nframes),IOException);
+  BOOST_CHECK_THROW(src->GetFrame(nframes),IOException);
+
+  // only the 4 most recently used frames are kept
+  mol::CoordFramePtr frame=src->GetFrame(6);
+  BOOST_CHECK(src->GetFrame(6)==frame);
+  src->GetFrame(0);
+  src->GetFrame(1);
+  src->GetFrame(2);
+  BOOST_CHECK(src->GetFrame(6)==frame);
+  src->GetFrame(3);
+  src->GetFrame(4);
+  src->GetFrame(5);
+  src->GetFrame(7);
+  BOOST_CHECK(src->GetFrame(6)!=frame);
+  src->SetCacheSize(0);
+  BOOST_CHECK(src->GetFrame(6)!=src->GetFrame(6));
+
+  mol::CoordGroupHandle cg2=LoadCHARMMTraj(eh,"test_io_dcd_mapped_out.dcd",3,
+                                           true);
+  mol::CoordGroupHandle cg3=LoadCHARMMTraj(eh,"test_io_dcd_mapped_out.dcd",3,
+                                           false);
+  BOOST_CHECK_EQUAL(cg2.GetFrameCount(),uint(4));
+  BOOST_CHECK_EQUAL(cg3.GetFrameCount(),uint(4));
+  for(uint f=0;f<cg2.GetFrameCount();++f) {
+    geom::Vec3List pos2=cg2.GetFramePositions(f);
+    geom::Vec3List pos3=cg3.GetFramePositions(f);
+    for(size_t i=0;i<natoms;++i) {
+      BOOST_CHECK(geom::Distance(pos2[i],pos3[i])<1e-5);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -1,6 +1,10 @@
+import os
+import shutil
+import tempfile
 import unittest
 from ost import geom
 from ost import io
+from ost import mol
 
 def compare_atoms(a1, a2):
     if abs(a1.occupancy - a2.occupancy) > 0.01:
@@ -85,6 +89,97 @@ class TestOMF(unittest.TestCase):
         loaded_ent = loaded_omf.GetAU()
         self.assertTrue(compare_ent(ent, loaded_ent))
 
+    def test_positions(self):
+        # values around the limits of the integer packing and large jumps
+        # between consecutive atoms
+        values = [0.0, 999.999, -999.999, 32.767, -32.768, 0.127, -0.128,
+                  0.0, 500.0, -0.001]
+        ent = mol.CreateEntity()
+        ed = ent.EditXCS()
+        ch = ed.InsertChain("A")
+        for i in range(len(values)):
+            res = ed.AppendResidue(ch, "GLY")
+            pos = geom.Vec3(values[i], -values[-i-1], values[(3*i)%len(values)])
+            ed.InsertAtom(res, "CA", pos, "C", 1.0, abs(values[i])/10)
+        omf = io.OMF.FromBytes(io.OMF.FromEntity(ent).ToBytes())
+        loaded_ent = omf.GetAU()
+        for a1, a2 in zip(ent.atoms, loaded_ent.atoms):
+            self.assertTrue(geom.Distance(a1.GetPos(), a2.GetPos()) < 0.002)
+            self.assertAlmostEqual(a1.b_factor, a2.b_factor, delta=0.01)
+
+    def test_indexed(self):
+        ent, seqres, info = io.LoadMMCIF("testfiles/mmcif/3T6C.cif.gz", 
+                                         seqres=True,
+                                         info=True)
+        omf = io.OMF.FromMMCIF(ent, info)
+        for compress in [False, True]:
+            loaded_omf = io.OMF.FromBytes(omf.ToIndexedBytes(compress))
+            self.assertEqual(loaded_omf.GetChainNames(), omf.GetChainNames())
+            self.assertTrue(compare_ent(ent, loaded_omf.GetAU()))
+            for chain_name in loaded_omf.GetChainNames():
+                chain_ent = loaded_omf.GetAUChain(chain_name)
+                self.assertTrue(compare_chains(ent.FindChain(chain_name),
+                                               chain_ent.FindChain(chain_name)))
+            self.assertEqual(loaded_omf.GetBU(0).GetAtomCount(),
+                             omf.GetBU(0).GetAtomCount())
+            # converting back to the non-indexed format gives the same data
+            self.assertEqual(loaded_omf.ToBytes(), omf.ToBytes())
+        self.assertRaises(Exception, loaded_omf.GetAUChain, "not_there")
+
+    def test_indexed_file(self):
+        ent, seqres, info = io.LoadMMCIF("testfiles/mmcif/3T6C.cif.gz", 
+                                         seqres=True,
+                                         info=True)
+        omf = io.OMF.FromMMCIF(ent, info)
+        tmp_dir = tempfile.mkdtemp()
+        try:
+            fn = os.path.join(tmp_dir, "test.omf")
+            for compress in [False, True]:
+                omf.ToIndexedFile(fn, compress)
+                # indexed files are memory-mapped and decoded on demand
+                loaded_omf = io.OMF.FromFile(fn)
+                self.assertEqual(loaded_omf.GetChainNames(),
+                                 omf.GetChainNames())
+                for chain_name in loaded_omf.GetChainNames():
+                    chain_ent = loaded_omf.GetAUChain(chain_name)
+                    self.assertTrue(compare_chains(ent.FindChain(chain_name),
+                                                   chain_ent.FindChain(chain_name)))
+                self.assertTrue(compare_ent(ent, loaded_omf.GetAU()))
+                self.assertEqual(loaded_omf.ToBytes(), omf.ToBytes())
+                del loaded_omf
+        finally:
+            shutil.rmtree(tmp_dir)
+
+    def test_archive(self):
+        ent, seqres, info = io.LoadMMCIF("testfiles/mmcif/3T6C.cif.gz", 
+                                         seqres=True,
+                                         info=True)
+        omf = io.OMF.FromMMCIF(ent, info)
+        omf_a = io.OMF.FromEntity(ent.Select("cname=A").Copy())
+        tmp_dir = tempfile.mkdtemp()
+        try:
+            fn = os.path.join(tmp_dir, "test.omfa")
+            for compress in [False, True]:
+                writer = io.OMFArchiveWriter(fn, compress)
+                writer.Add("3t6c", omf)
+                writer.Add("3t6c_A", omf_a)
+                self.assertRaises(Exception, writer.Add, "3t6c", omf)
+                writer.Close()
+                archive = io.OMFArchive.FromFile(fn)
+                self.assertEqual(len(archive), 2)
+                self.assertEqual(archive.GetIds(), ["3t6c", "3t6c_A"])
+                self.assertTrue("3t6c_A" in archive)
+                self.assertFalse("1crn" in archive)
+                self.assertRaises(Exception, archive.GetEntry, "1crn")
+                self.assertEqual(archive.GetEntry("3t6c").ToBytes(),
+                                 omf.ToBytes())
+                self.assertEqual(archive.GetEntryByIndex(1).ToBytes(),
+                                 omf_a.ToBytes())
+                self.assertTrue(compare_ent(ent,
+                                            archive.GetEntry("3t6c").GetAU()))
+        finally:
+            shutil.rmtree(tmp_dir)
+
 if __name__== '__main__':
   from ost import testutils
   testutils.RunTests()
@@ -1283,6 +1283,105 @@ BOOST_AUTO_TEST_CASE(mmcif_testreader)
   BOOST_TEST_MESSAGE("  done.");
 }
 
+BOOST_AUTO_TEST_CASE(mmcif_parallel_atom_site)
+{
+  BOOST_TEST_MESSAGE("  Running mmcif_parallel_atom_site tests...");
+  // large enough for the atom_site loop to be converted on several threads
+  {
+    std::ofstream out("test_mmcif_parallel_atom_site.cif");
+    out << "data_big\nloop_\n_atom_site.group_PDB\n_atom_site.type_symbol\n"
+        << "_atom_site.label_atom_id\n_atom_site.label_comp_id\n"
+        << "_atom_site.label_asym_id\n_atom_site.label_entity_id\n"
+        << "_atom_site.label_seq_id\n"
+        << "_atom_site.label_alt_id\n_atom_site.Cartn_x\n"
+        << "_atom_site.Cartn_y\n_atom_site.Cartn_z\n_atom_site.occupancy\n"
+        << "_atom_site.B_iso_or_equiv\n_atom_site.auth_seq_id\n"
+        << "_atom_site.id\n_atom_site.pdbx_PDB_ins_code\n"
+        << "_atom_site.auth_asym_id\n";
+    int id=1;
+    for (int r=1; r<=10000; ++r) {
+      const char* names[]={"N", "CA", "C"};
+      for (int a=0; a<3; ++a) {
+        int alt_count=(r%10==0 && a==1) ? 2 : 1;
+        for (int alt=0; alt<alt_count; ++alt) {
+          out << "ATOM " << names[a][0] << " " << names[a] << " GLY "
+              << (r<=5000 ? "A 1 " : "B 2 ") << r << " "
+              << (alt_count==1 ? "." : (alt==0 ? "A" : "B")) << " "
+              << r*0.5 << " " << -a-alt << " " << id*0.001 << " "
+              << (alt_count==1 ? "1.00 " : "0.50 ") << (id%100)*0.25
+              << " " << r << " " << id << (r<=5000 ? " ? A\n" : " ? B\n");
+          ++id;
+        }
+      }
+    }
+  }
+  IOProfile profile;
+  mol::EntityHandle serial_eh=mol::CreateEntity();
+  MMCifReader serial_p("test_mmcif_parallel_atom_site.cif", serial_eh,
+                       profile);
+  BOOST_REQUIRE_NO_THROW(serial_p.Parse());
+  BOOST_CHECK_EQUAL(serial_eh.GetChainCount(), 2);
+  BOOST_CHECK_EQUAL(serial_eh.GetAtomCount(), 30000);
+  mol::EntityHandle parallel_eh=mol::CreateEntity();
+  MMCifReader parallel_p("test_mmcif_parallel_atom_site.cif", parallel_eh,
+                         profile);
+  parallel_p.SetNumThreads(4);
+  BOOST_REQUIRE_NO_THROW(parallel_p.Parse());
+  mol::AtomHandleList serial_atoms=serial_eh.GetAtomList();
+  mol::AtomHandleList parallel_atoms=parallel_eh.GetAtomList();
+  BOOST_REQUIRE_EQUAL(serial_atoms.size(), parallel_atoms.size());
+  for (size_t i=0; i<serial_atoms.size(); ++i) {
+    mol::AtomHandle a=serial_atoms[i], b=parallel_atoms[i];
+    BOOST_CHECK_EQUAL(a.GetQualifiedName(), b.GetQualifiedName());
+    BOOST_CHECK_EQUAL(a.GetPos(), b.GetPos());
+    BOOST_CHECK_EQUAL(a.GetOccupancy(), b.GetOccupancy());
+    BOOST_CHECK_EQUAL(a.GetBFactor(), b.GetBFactor());
+  }
+  mol::ResidueHandle res=parallel_eh.FindResidue("B", mol::ResNum(10000));
+  BOOST_REQUIRE(res.IsValid());
+  BOOST_CHECK(res.HasAltAtoms());
+  BOOST_CHECK_EQUAL(res.GetAltAtomGroupNames().size(), size_t(2));
+  BOOST_CHECK(res.SwitchAtomPos("B"));
+  BOOST_CHECK_EQUAL(res.FindAtom("CA").GetPos()[1], Real(-2));
+  BOOST_TEST_MESSAGE("  done.");
+}
+
+BOOST_AUTO_TEST_CASE(mmcif_test_categories)
+{
+  BOOST_TEST_MESSAGE("  Running mmcif_test_categories tests...");
+  mol::EntityHandle eh = mol::CreateEntity();
+  std::ifstream s("testfiles/mmcif/atom_site.mmcif");
+  IOProfile profile;
+  MMCifReader mmcif_p(s, eh, profile);
+  std::vector<String> categories;
+  categories.push_back("entity");
+  categories.push_back("exptl");
+  mmcif_p.SetCategories(categories);
+  std::vector<String> items;
+  items.push_back("occupancy");
+  mmcif_p.SetAtomSiteItems(items);
+  BOOST_CHECK(mmcif_p.GetCategories() == categories);
+  BOOST_CHECK(mmcif_p.GetAtomSiteItems() == items);
+  mmcif_p.SetRestrictChains("A O C");
+  BOOST_REQUIRE_NO_THROW(mmcif_p.Parse());
+
+  // atom_site is always read
+  BOOST_REQUIRE_EQUAL(eh.GetChainCount(),    3);
+  BOOST_REQUIRE_EQUAL(eh.GetResidueCount(), 14);
+  BOOST_REQUIRE_EQUAL(eh.GetAtomCount(),    35);
+  mol::AtomHandle atom = eh.FindChain("A").GetResidueList()[0].GetAtomList()[0];
+  BOOST_CHECK_EQUAL(atom.GetBFactor(), 0.0);
+  BOOST_CHECK_EQUAL(atom.GetOccupancy(), 1.0);
+  BOOST_CHECK(eh.FindChain("O").GetType() == mol::CHAINTYPE_WATER);
+  BOOST_CHECK(mmcif_p.GetInfo().GetMethod().str() == "Deep-fry");
+  // skipped categories
+  mol::ResidueHandleList rl = eh.FindChain("A").GetResidueList();
+  BOOST_CHECK(!rl[0].GetSecStructure().IsHelical());
+  BOOST_CHECK(mmcif_p.GetInfo().GetBioUnits().empty());
+  BOOST_CHECK(mmcif_p.GetInfo().GetStructDetails().GetEntryID() == "");
+  BOOST_TEST_MESSAGE("  done.");
+}
+
 // helper for mmcif_test_chain_mappings
 inline void CheckChainMap(mol::EntityHandle eh, const MMCifInfo& info,
                           const String& cif_name, const String& pdb_name,
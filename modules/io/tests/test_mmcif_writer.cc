@@ -0,0 +1,189 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <ost/mol/mol.hh>
+#include <ost/io/mol/mmcif_reader.hh>
+#include <ost/io/mol/mmcif_writer.hh>
+
+using namespace ost;
+using namespace ost::io;
+
+namespace {
+
+mol::EntityHandle make_entity()
+{
+  mol::EntityHandle ent=mol::CreateEntity();
+  mol::XCSEditor ed=ent.EditXCS();
+  mol::ChainHandle ch=ed.InsertChain("A");
+  ch.SetStringProp("pdb_auth_chain_name", "X");
+  ed.SetChainType(ch, mol::CHAINTYPE_POLY_PEPTIDE_L);
+  ed.SetChainDescription(ch, "some protein, 'quoted'");
+  // with an insertion code and a gap, so label_seq_id and auth_seq_id differ
+  mol::ResNum nums[]={mol::ResNum(5), mol::ResNum(5, 'A'), mol::ResNum(9)};
+  for (int i=0; i<3; ++i) {
+    mol::ResidueHandle res=ed.AppendResidue(ch, "GLY", nums[i]);
+    ed.InsertAtom(res, "N", geom::Vec3(i, -1.25, 0.5), "N", 1.0, 12.5);
+    ed.InsertAtom(res, "CA", geom::Vec3(i, 0.001, -0.0004), "C", 0.5, 20.0);
+  }
+  ch=ed.InsertChain("B");
+  ed.SetChainType(ch, mol::CHAINTYPE_NON_POLY);
+  mol::ResidueHandle res=ed.AppendResidue(ch, "NAG");
+  ed.InsertAtom(res, "C1'", geom::Vec3(10.5, -20.25, 1234.5678), "C", 1.0,
+                30.0, true);
+  ch=ed.InsertChain("W");
+  res=ed.AppendResidue(ch, "HOH");
+  ed.InsertAtom(res, "O", geom::Vec3(-1, -2, -3), "O", 1.0, 40.0, true);
+  return ent;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( io );
+
+BOOST_AUTO_TEST_CASE(mmcif_writer_roundtrip)
+{
+  mol::EntityHandle ent=make_entity();
+  MMCifInfo info;
+  MMCifInfoTransOpPtr op(new MMCifInfoTransOp);
+  op->SetID("1");
+  op->SetType("identity operation");
+  op->SetMatrix(1, 0, 0, 0, 1, 0, 0, 0, 1);
+  MMCifInfoTransOpPtr op2(new MMCifInfoTransOp);
+  op2->SetID("2");
+  op2->SetType("rotation");
+  op2->SetMatrix(0, -1, 0, 1, 0, 0, 0, 0, 1);
+  op2->SetVector(1.5, -2.25, 3);
+  std::vector<MMCifInfoTransOpPtr> ops;
+  ops.push_back(op);
+  ops.push_back(op2);
+  MMCifInfoBioUnit bu;
+  bu.SetID("1");
+  bu.SetDetails("author_defined_assembly");
+  bu.AddChain("A");
+  bu.AddChain("B");
+  bu.AddOperations(ops);
+  info.AddBioUnit(bu);
+  info.AddOperation(op);
+  info.AddOperation(op2);
+  info.AddMMCifEntityIdTr("A", "7");
+
+  std::stringstream out;
+  MMCifWriter writer(out);
+  writer.SetInfo(info);
+  writer.SetDataName("test entry");
+  writer.Write(ent);
+  BOOST_CHECK_EQUAL(out.str().substr(0, 16), String("data_test_entry\n"));
+  BOOST_CHECK(out.str().find("\n7 2 GLY n\n")!=String::npos);
+  BOOST_CHECK(out.str().find(" A 7 2 A ")!=String::npos);
+
+  mol::EntityHandle ent2=mol::CreateEntity();
+  MMCifReader reader(out, ent2, IOProfile());
+  reader.Parse();
+  BOOST_REQUIRE_EQUAL(ent2.GetChainCount(), 3);
+  BOOST_CHECK_EQUAL(ent2.GetAtomCount(), ent.GetAtomCount());
+  mol::ChainHandle a=ent2.FindChain("A");
+  BOOST_CHECK_EQUAL(a.GetType(), mol::CHAINTYPE_POLY_PEPTIDE_L);
+  BOOST_CHECK_EQUAL(a.GetDescription(), "some protein, 'quoted'");
+  BOOST_CHECK_EQUAL(a.GetStringProp("pdb_auth_chain_name"), "X");
+  BOOST_CHECK_EQUAL(reader.GetInfo().GetMMCifEntityIdTr("A"), "7");
+  BOOST_CHECK_EQUAL(ent2.FindChain("B").GetType(), mol::CHAINTYPE_NON_POLY);
+  BOOST_CHECK_EQUAL(ent2.FindChain("W").GetType(), mol::CHAINTYPE_WATER);
+  // chains without entity id got entities of their own
+  BOOST_CHECK(reader.GetInfo().GetMMCifEntityIdTr("B")!=
+              reader.GetInfo().GetMMCifEntityIdTr("W"));
+
+  mol::AtomHandleList atoms=ent.GetAtomList(), atoms2=ent2.GetAtomList();
+  for (size_t i=0; i<atoms.size(); ++i) {
+    BOOST_CHECK_EQUAL(atoms[i].GetName(), atoms2[i].GetName());
+    BOOST_CHECK_EQUAL(atoms[i].GetResidue().GetName(),
+                      atoms2[i].GetResidue().GetName());
+    BOOST_CHECK_EQUAL(atoms[i].GetElement(), atoms2[i].GetElement());
+    BOOST_CHECK(geom::Distance(atoms[i].GetPos(), atoms2[i].GetPos())<1e-3);
+    BOOST_CHECK_CLOSE(atoms[i].GetBFactor(), atoms2[i].GetBFactor(), 1e-3);
+    BOOST_CHECK_CLOSE(atoms[i].GetOccupancy(), atoms2[i].GetOccupancy(),
+                      1e-3);
+    BOOST_CHECK_EQUAL(atoms[i].IsHetAtom(), atoms2[i].IsHetAtom());
+  }
+  // the reader numbers polymer residues by label_seq_id
+  BOOST_CHECK_EQUAL(ent2.FindChain("A").GetResidueList()[2].GetNumber(),
+                    mol::ResNum(3));
+
+  const std::vector<MMCifInfoBioUnit>& biounits=reader.GetInfo().GetBioUnits();
+  BOOST_REQUIRE_EQUAL(biounits.size(), size_t(1));
+  BOOST_CHECK_EQUAL(biounits[0].GetDetails(), "author_defined_assembly");
+  BOOST_CHECK_EQUAL(biounits[0].GetChainList().size(), size_t(2));
+  BOOST_REQUIRE_EQUAL(biounits[0].GetOperations().size(), size_t(1));
+  BOOST_REQUIRE_EQUAL(biounits[0].GetOperations()[0].size(), size_t(2));
+  MMCifInfoTransOpPtr op3=biounits[0].GetOperations()[0][1];
+  BOOST_CHECK_EQUAL(op3->GetType(), "rotation");
+  BOOST_CHECK(geom::Distance(op3->GetVector(), op2->GetVector())<1e-5);
+  BOOST_CHECK(geom::Equal(op3->GetMatrix(), op2->GetMatrix()));
+}
+
+BOOST_AUTO_TEST_CASE(mmcif_writer_view)
+{
+  mol::EntityHandle ent=make_entity();
+  mol::EntityView view=ent.Select("cname=A and aname=CA");
+  std::stringstream out;
+  MMCifWriter writer(out);
+  writer.Write(view);
+  mol::EntityHandle ent2=mol::CreateEntity();
+  MMCifReader reader(out, ent2, IOProfile());
+  reader.Parse();
+  BOOST_CHECK_EQUAL(ent2.GetChainCount(), 1);
+  BOOST_CHECK_EQUAL(ent2.GetAtomCount(), 3);
+  BOOST_CHECK_EQUAL(ent2.GetAtomList()[2].GetQualifiedName(), "A.GLY3.CA");
+}
+
+BOOST_AUTO_TEST_CASE(mmcif_writer_label_seq_id)
+{
+  // chain C belongs to the same entity as A, but misses a residue, so its
+  // residues can't refer to the entity_poly_seq written from A
+  mol::EntityHandle ent=make_entity();
+  mol::XCSEditor ed=ent.EditXCS();
+  mol::ChainHandle ch=ed.InsertChain("C");
+  ed.SetChainType(ch, mol::CHAINTYPE_POLY_PEPTIDE_L);
+  mol::ResidueHandle res=ed.AppendResidue(ch, "GLY", mol::ResNum(5));
+  ed.InsertAtom(res, "CA", geom::Vec3(1, 2, 3), "C");
+  MMCifInfo info;
+  info.AddMMCifEntityIdTr("A", "1");
+  info.AddMMCifEntityIdTr("C", "1");
+  std::stringstream out;
+  MMCifWriter writer(out);
+  writer.SetInfo(info);
+  writer.Write(ent);
+  String text=out.str();
+  BOOST_CHECK(text.find("\n1 3 GLY n\n")!=String::npos);
+  BOOST_CHECK(text.find("\n1 4 ")==String::npos);
+  BOOST_CHECK(text.find(" A 1 3 ? ")!=String::npos);
+  BOOST_CHECK(text.find(" C 1 . ? ")!=String::npos);
+}
+
+BOOST_AUTO_TEST_CASE(mmcif_writer_bad_filename)
+{
+  boost::filesystem::path path("testfiles/does-not-exist/out.cif");
+  BOOST_CHECK_THROW(MMCifWriter writer(path), IOException);
+  BOOST_CHECK_THROW(MMCifWriter writer(path.string()), IOException);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
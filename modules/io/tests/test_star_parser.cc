@@ -77,6 +77,9 @@ class LoopTestParser: public StarParser {
 public:
   LoopTestParser(std::istream& stream): StarParser(stream), count_(0)
   { }
+  LoopTestParser(const String& filename, bool in_memory): 
+    StarParser(filename, false, in_memory), count_(0)
+  { }
   virtual bool OnBeginLoop(const StarLoopDesc& header)
   {
     BOOST_CHECK_EQUAL(header.GetCategory(), "loop");
@@ -97,6 +100,59 @@ private:
   int count_;
 };
 
+class RowCollectParser: public StarParser {
+public:
+  RowCollectParser(const String& filename): StarParser(filename) { }
+  virtual void OnDataRow(const StarLoopDesc& header, 
+                         const std::vector<StringRef>& columns) 
+  {
+    String row;
+    for (size_t i=0; i<columns.size(); ++i) {
+      row+=columns[i].str()+"|";
+    }
+    rows.push_back(row);
+    row_lines.push_back(this->GetCurrentLinenum());
+  }
+  virtual void OnDataItem(const StarDataItem& item)
+  {
+    items.push_back(item.GetName().str()+"="+item.GetValue().str());
+  }
+  std::vector<String> rows;
+  std::vector<int>    row_lines;
+  std::vector<String> items;
+};
+
+// converts the first value of every row in the threads splitting the loop
+class ConvertingRowParser: public RowCollectParser {
+public:
+  struct Rows: public StarLoopRows {
+    std::vector<int> first;
+  };
+  ConvertingRowParser(const String& filename): 
+    RowCollectParser(filename), converted(0)
+  { }
+  virtual StarLoopRowsPtr ConvertDataRows(const StarLoopDesc& header,
+                                          const std::vector<StringRef>& values,
+                                          size_t num_rows) const
+  {
+    boost::shared_ptr<Rows> rows(new Rows);
+    for (size_t i=0; i<num_rows; ++i) {
+      rows->first.push_back(values[i*header.GetSize()].to_int().second);
+    }
+    return rows;
+  }
+  virtual void OnConvertedDataRow(const StarLoopDesc& header, 
+                                  const std::vector<StringRef>& columns,
+                                  const StarLoopRows& rows, size_t index)
+  {
+    BOOST_CHECK_EQUAL(static_cast<const Rows&>(rows).first[index],
+                      columns[0].to_int().second);
+    ++converted;
+    this->OnDataRow(header, columns);
+  }
+  int converted;
+};
+
 class MultiDataParser : public StarParser {
 public:
   MultiDataParser(std::istream& stream): StarParser(stream), visit_one(false),
@@ -122,6 +178,9 @@ class HardLoopTestParser : public StarParser {
 public:
   HardLoopTestParser(std::istream& stream): StarParser(stream), cur_char_('A')
   { }
+  HardLoopTestParser(const String& filename, bool in_memory): 
+    StarParser(filename, false, in_memory), cur_char_('A')
+  { }
   
   virtual bool OnBeginLoop(const StarLoopDesc& header)
   {
@@ -163,6 +222,9 @@ public:
   ItemsAsRowTestParser(std::istream& stream): StarParser(stream, true),
                                               category("")
   { }
+  ItemsAsRowTestParser(const String& filename, bool in_memory): 
+    StarParser(filename, true, in_memory), category("")
+  { }
 
   virtual bool OnBeginLoop(const StarLoopDesc& header)
   {
@@ -359,6 +421,91 @@ BOOST_AUTO_TEST_CASE(star_loop)
   BOOST_TEST_MESSAGE("  done.");
 }
 
+BOOST_AUTO_TEST_CASE(star_loop_from_file)
+{
+  // the in-memory mode hands out values pointing into the mapped file, the
+  // other one copies them. Both must give the same result.
+  for (int in_memory=0; in_memory<2; ++in_memory) {
+    LoopTestParser star_p("testfiles/loop.cif", in_memory);
+    star_p.Parse();
+    BOOST_CHECK_EQUAL(star_p.lines[0][0], "d");
+    BOOST_CHECK_EQUAL(star_p.lines[1][0], "4 x");
+    BOOST_CHECK_EQUAL(star_p.lines[1][2], "6");
+    BOOST_CHECK_EQUAL(star_p.lines[4][0], "13");
+    BOOST_CHECK_EQUAL(star_p.lines[4][2], "15");
+    HardLoopTestParser hard_p("testfiles/multiline-loop.cif", in_memory);
+    hard_p.Parse();
+    BOOST_CHECK_EQUAL(hard_p.cur_char_, 'S');
+    ItemsAsRowTestParser row_p("testfiles/items-as-row.cif", in_memory);
+    row_p.Parse();
+    BOOST_CHECK_EQUAL(row_p.s2, "a b c");
+    BOOST_CHECK_EQUAL(row_p.s3, "a\nb\nc");
+    BOOST_CHECK_EQUAL(row_p.i4, 4);
+    BOOST_CHECK_EQUAL(row_p.s8, "1.44");
+  }
+}
+
+BOOST_AUTO_TEST_CASE(star_loop_parallel)
+{
+  // large enough to be split into several chunks
+  {
+    std::ofstream out("test_star_parallel_loop.cif");
+    out << "data_big\nloop_\n_big.a\n_big.b\n_big.c\n";
+    for (int i=0; i<40000; ++i) {
+      if (i%1000==0) {
+        out << "# comment\n\n";
+      }
+      if (i%777==0) {
+        out << i << " 'a b'\n  \"x\"\n";
+      } else {
+        out << i << " " << i*2 << " value" << i%13 << "\n";
+      }
+    }
+    out << "_item.x 1\nloop_\n_small.a\n1\n";
+  }
+  RowCollectParser serial_p("test_star_parallel_loop.cif");
+  serial_p.Parse();
+  BOOST_CHECK_EQUAL(serial_p.rows.size(), size_t(40001));
+  BOOST_CHECK_EQUAL(serial_p.rows[777], "777|a b|x|");
+  for (int num_threads=0; num_threads<=4; num_threads+=2) {
+    RowCollectParser parallel_p("test_star_parallel_loop.cif");
+    parallel_p.SetNumThreads(num_threads);
+    parallel_p.Parse();
+    BOOST_CHECK(parallel_p.rows==serial_p.rows);
+    BOOST_CHECK(parallel_p.row_lines==serial_p.row_lines);
+    BOOST_CHECK(parallel_p.items==serial_p.items);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(star_loop_parallel_convert)
+{
+  // the first chunk has a row spread over two lines and isn't converted
+  {
+    std::ofstream out("test_star_parallel_loop.cif");
+    out << "data_big\nloop_\n_big.a\n_big.b\n_big.c\n";
+    for (int i=0; i<100000; ++i) {
+      if (i==5) {
+        out << i << " 'a b'\n  \"x\"\n";
+      } else {
+        out << i << " " << i*2 << " value" << i%13 << "\n";
+      }
+    }
+  }
+  RowCollectParser serial_p("test_star_parallel_loop.cif");
+  serial_p.Parse();
+  BOOST_CHECK_EQUAL(serial_p.rows.size(), size_t(100000));
+  ConvertingRowParser serial_conv_p("test_star_parallel_loop.cif");
+  serial_conv_p.Parse();
+  BOOST_CHECK_EQUAL(serial_conv_p.converted, 0);
+  ConvertingRowParser parallel_p("test_star_parallel_loop.cif");
+  parallel_p.SetNumThreads(4);
+  parallel_p.Parse();
+  BOOST_CHECK(parallel_p.converted>0);
+  BOOST_CHECK(parallel_p.converted<100000);
+  BOOST_CHECK(parallel_p.rows==serial_p.rows);
+  BOOST_CHECK(parallel_p.row_lines==serial_p.row_lines);
+}
+
 BOOST_AUTO_TEST_CASE(star_items_as_row)
 {
   BOOST_TEST_MESSAGE("  Running star_items_as_row tests...");
@@ -36,11 +36,13 @@ Real WrapAccessibilityHandle(ost::mol::EntityHandle& ent,
                              const String& asa_abs, 
                              const String& asa_rel,
                              const String& asa_atom,
-                             ost::mol::alg::AccessibilityAlgorithm algorithm) {
+                             ost::mol::alg::AccessibilityAlgorithm algorithm,
+                             int num_threads) {
                                  
   return ost::mol::alg::Accessibility(ent, probe_radius, include_hydrogens, 
                                       include_hetatm, include_water, oligo_mode,
-                                      selection, asa_abs, asa_rel, asa_atom, algorithm);
+                                      selection, asa_abs, asa_rel, asa_atom, algorithm,
+                                      num_threads);
 }
 
 Real WrapAccessibilityView(ost::mol::EntityView& ent, 
@@ -52,11 +54,13 @@ Real WrapAccessibilityView(ost::mol::EntityView& ent,
                            const String& selection,
                            const String& asa_abs, const String& asa_rel,
                            const String& asa_atom,
-                           ost::mol::alg::AccessibilityAlgorithm algorithm) {
+                           ost::mol::alg::AccessibilityAlgorithm algorithm,
+                           int num_threads) {
 
   return ost::mol::alg::Accessibility(ent, probe_radius, include_hydrogens, 
                                       include_hetatm, include_water, oligo_mode,
-                                      selection, asa_abs, asa_rel, asa_atom, algorithm);
+                                      selection, asa_abs, asa_rel, asa_atom, algorithm,
+                                      num_threads);
 }
 
 } // ns
@@ -82,7 +86,8 @@ void export_accessibility() {
                                                    arg("asa_abs")="asaAbs",
                                                    arg("asa_rel")="asaRel",
                                                    arg("asa_atom")="asaAtom",
-                                                   arg("algorithm")=ost::mol::alg::NACCESS));
+                                                   arg("algorithm")=ost::mol::alg::NACCESS,
+                                                   arg("num_threads")=1));
 
     def("Accessibility", WrapAccessibilityView, (arg("ent"), 
                                                  arg("probe_radius")=1.4,
@@ -94,6 +99,7 @@ void export_accessibility() {
                                                  arg("asa_abs")="asaAbs",
                                                  arg("asa_rel")="asaRel",
                                                  arg("asa_atom")="asaAtom",
-                                                 arg("algorithm")=ost::mol::alg::NACCESS));
+                                                 arg("algorithm")=ost::mol::alg::NACCESS,
+                                                 arg("num_threads")=1));
 }
 
@@ -36,20 +36,44 @@ BOOST_PYTHON_FUNCTION_OVERLOADS(extractrmsd, ExtractRMSD, 3, 4)
 */
 void export_TrajectoryAnalysis()
 {
-  def("AnalyzeAtomPos",&AnalyzeAtomPos, (arg("traj"), arg("atom"), arg("stride")=1));
-  def("AnalyzeCenterOfMassPos",&AnalyzeCenterOfMassPos, (arg("traj"), arg("selection"), arg("stride")=1));
-  def("AnalyzeDistanceBetwAtoms",&AnalyzeDistanceBetwAtoms, (arg("traj"), arg("atom"), arg("atom"), arg("stride")=1));
-  def("AnalyzeAngle",&AnalyzeAngle, (arg("traj"), arg("atom"), arg("atom"), arg("atom"), arg("stride")=1));
-  def("AnalyzeDihedralAngle",&AnalyzeDihedralAngle, (arg("traj"), arg("atom"), arg("atom"), arg("atom"), arg("atom"), arg("stride")=1));
-  def("AnalyzeDistanceBetwCenterOfMass",&AnalyzeDistanceBetwCenterOfMass, (arg("traj"), arg("selection"), arg("selection"), arg("stride")=1));
-  def("AnalyzeRMSD",&AnalyzeRMSD, (arg("traj"), arg("reference_view"), arg("selection"), arg("stride")=1));
-  def("AnalyzeRMSF",&AnalyzeRMSF, (arg("traj"), arg("selection"), arg("first")=0, arg("last")=-1, arg("stride")=1));
-  def("AnalyzeMinDistance", &AnalyzeMinDistance, (arg("traj"), arg("view1"), arg("view2"), arg("stride")=1));
-  def("AnalyzeMinDistanceBetwCenterOfMassAndView", &AnalyzeMinDistanceBetwCenterOfMassAndView, (arg("traj"), arg("view_cm"), arg("view_atoms"), arg("stride")=1));
-  def("AnalyzeAromaticRingInteraction", &AnalyzeAromaticRingInteraction, (arg("traj"), arg("view_ring1"), arg("view_ring2"), arg("stride")=1));
-  def("AnalyzeAlphaHelixAxis", &AnalyzeAlphaHelixAxis, (arg("traj"), arg("protein_segment"), arg("directions"), arg("centers"), arg("stride")=1));
-  def("AnalyzeBestFitLine", &AnalyzeBestFitLine, (arg("traj"), arg("protein_segment"), arg("directions"), arg("centers"), arg("stride")=1));
-  def("AnalyzeBestFitPlane", &AnalyzeBestFitPlane, (arg("traj"), arg("protein_segment"), arg("normals"), arg("origins"), arg("stride")=1));
-  def("AnalyzeHelicity", &AnalyzeHelicity, (arg("traj"), arg("protein_segment"), arg("stride")=1));
-  def("CreateMeanStructure", &CreateMeanStructure, (arg("traj"), arg("selection"), arg("from")=0, arg("to")=-1, arg("stride")=1 ));
+  def("AnalyzeAtomPos",&AnalyzeAtomPos, (arg("traj"), arg("atom"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeCenterOfMassPos",&AnalyzeCenterOfMassPos, (arg("traj"), arg("selection"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeDistanceBetwAtoms",&AnalyzeDistanceBetwAtoms, (arg("traj"), arg("atom"), arg("atom"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeAngle",&AnalyzeAngle, (arg("traj"), arg("atom"), arg("atom"), arg("atom"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeDihedralAngle",&AnalyzeDihedralAngle, (arg("traj"), arg("atom"), arg("atom"), arg("atom"), arg("atom"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeDistanceBetwCenterOfMass",&AnalyzeDistanceBetwCenterOfMass, (arg("traj"), arg("selection"), arg("selection"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeRMSD",&AnalyzeRMSD, (arg("traj"), arg("reference_view"), arg("selection"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeRMSF",&AnalyzeRMSF, (arg("traj"), arg("selection"), arg("first")=0, arg("last")=-1, arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeMinDistance", &AnalyzeMinDistance, (arg("traj"), arg("view1"), arg("view2"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeMinDistanceBetwCenterOfMassAndView", &AnalyzeMinDistanceBetwCenterOfMassAndView, (arg("traj"), arg("view_cm"), arg("view_atoms"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeAromaticRingInteraction", &AnalyzeAromaticRingInteraction, (arg("traj"), arg("view_ring1"), arg("view_ring2"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeAlphaHelixAxis", &AnalyzeAlphaHelixAxis, (arg("traj"), arg("protein_segment"), arg("directions"), arg("centers"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeBestFitLine", &AnalyzeBestFitLine, (arg("traj"), arg("protein_segment"), arg("directions"), arg("centers"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeBestFitPlane", &AnalyzeBestFitPlane, (arg("traj"), arg("protein_segment"), arg("normals"), arg("origins"), arg("stride")=1, arg("num_threads")=1));
+  def("AnalyzeHelicity", &AnalyzeHelicity, (arg("traj"), arg("protein_segment"), arg("stride")=1, arg("num_threads")=1));
+  def("CreateMeanStructure", &CreateMeanStructure, (arg("traj"), arg("selection"), arg("from")=0, arg("to")=-1, arg("stride")=1, arg("num_threads")=1));
+
+  class_<TrajectoryPipeline>("TrajectoryPipeline", init<>())
+    .def("AddAtomPos", &TrajectoryPipeline::AddAtomPos, (arg("name"), arg("atom")))
+    .def("AddCenterOfMassPos", &TrajectoryPipeline::AddCenterOfMassPos, (arg("name"), arg("selection")))
+    .def("AddDistanceBetwAtoms", &TrajectoryPipeline::AddDistanceBetwAtoms, (arg("name"), arg("atom"), arg("atom")))
+    .def("AddAngle", &TrajectoryPipeline::AddAngle, (arg("name"), arg("atom"), arg("atom"), arg("atom")))
+    .def("AddDihedralAngle", &TrajectoryPipeline::AddDihedralAngle, (arg("name"), arg("atom"), arg("atom"), arg("atom"), arg("atom")))
+    .def("AddDistanceBetwCenterOfMass", &TrajectoryPipeline::AddDistanceBetwCenterOfMass, (arg("name"), arg("selection"), arg("selection")))
+    .def("AddRMSD", &TrajectoryPipeline::AddRMSD, (arg("name"), arg("reference_view"), arg("selection")))
+    .def("AddRadiusOfGyration", &TrajectoryPipeline::AddRadiusOfGyration, (arg("name"), arg("selection")))
+    .def("AddMinDistance", &TrajectoryPipeline::AddMinDistance, (arg("name"), arg("view1"), arg("view2")))
+    .def("AddMinDistanceBetwCenterOfMassAndView", &TrajectoryPipeline::AddMinDistanceBetwCenterOfMassAndView, (arg("name"), arg("view_cm"), arg("view_atoms")))
+    .def("AddAromaticRingInteraction", &TrajectoryPipeline::AddAromaticRingInteraction, (arg("name"), arg("view_ring1"), arg("view_ring2")))
+    .def("AddHelicity", &TrajectoryPipeline::AddHelicity, (arg("name"), arg("protein_segment")))
+    .def("Run", &TrajectoryPipeline::Run, (arg("traj"), arg("stride")=1, arg("num_threads")=1))
+    .def("GetFrameCount", &TrajectoryPipeline::GetFrameCount)
+    .def("GetColumnNames", &TrajectoryPipeline::GetColumnNames, return_value_policy<copy_const_reference>())
+    .def("HasColumn", &TrajectoryPipeline::HasColumn, (arg("name")))
+    .def("IsVectorColumn", &TrajectoryPipeline::IsVectorColumn, (arg("name")))
+    .def("GetColumn", &TrajectoryPipeline::GetColumn, (arg("name")), return_value_policy<copy_const_reference>())
+    .def("GetVectorColumn", &TrajectoryPipeline::GetVectorColumn, (arg("name")), return_value_policy<copy_const_reference>())
+    .add_property("frame_count", &TrajectoryPipeline::GetFrameCount)
+    .add_property("column_names", make_function(&TrajectoryPipeline::GetColumnNames, return_value_policy<copy_const_reference>()))
+  ;
 }
@@ -61,8 +61,12 @@ std::pair<mol::EntityView,mol::alg::ClashingInfo> (*fc_a)(const mol::EntityView&
 std::pair<mol::EntityView,mol::alg::ClashingInfo> (*fc_b)(const mol::EntityHandle&, const mol::alg::ClashingDistances&, bool)=&mol::alg::FilterClashes;
 std::pair<mol::EntityView,mol::alg::StereoChemistryInfo> (*csc_a)(const mol::EntityView&, const mol::alg::StereoChemicalParams&, const mol::alg::StereoChemicalParams&, Real, Real, bool)=&mol::alg::CheckStereoChemistry;
 std::pair<mol::EntityView,mol::alg::StereoChemistryInfo> (*csc_b)(const mol::EntityHandle&, const mol::alg::StereoChemicalParams&, const mol::alg::StereoChemicalParams&, Real, Real, bool)=&mol::alg::CheckStereoChemistry;
-mol::CoordGroupHandle (*superpose_frames1)(mol::CoordGroupHandle&, mol::EntityView&, int, int, int)=&mol::alg::SuperposeFrames;
-mol::CoordGroupHandle (*superpose_frames2)(mol::CoordGroupHandle&,  mol::EntityView&, mol::EntityView&, int, int)=&mol::alg::SuperposeFrames;
+mol::CoordGroupHandle (*superpose_frames1)(mol::CoordGroupHandle&, mol::EntityView&, int, int, int, int)=&mol::alg::SuperposeFrames;
+mol::CoordGroupHandle (*superpose_frames2)(mol::CoordGroupHandle&,  mol::EntityView&, mol::EntityView&, int, int, int)=&mol::alg::SuperposeFrames;
+void (*superpose_frames_in_place1)(mol::CoordGroupHandle&, mol::EntityView&, int, int, int, int)=&mol::alg::SuperposeFramesInPlace;
+void (*superpose_frames_in_place2)(mol::CoordGroupHandle&,  mol::EntityView&, mol::EntityView&, int, int, int)=&mol::alg::SuperposeFramesInPlace;
+mol::CoordGroupHandle (*superpose_frames_lazy1)(mol::CoordGroupHandle&, mol::EntityView&, int, int, int, int)=&mol::alg::SuperposeFramesLazy;
+mol::CoordGroupHandle (*superpose_frames_lazy2)(mol::CoordGroupHandle&,  mol::EntityView&, mol::EntityView&, int, int, int)=&mol::alg::SuperposeFramesLazy;
 
 
 Real lddt_d(const mol::EntityView& model, list& reference_list, const mol::alg::GlobalRDMap& distance_list, mol::alg::lDDTSettings& settings){
@@ -295,6 +299,58 @@ void print_lddt_per_residue_stats_wrapper(list& scores, bool structural_checks,
  return mol::alg::PrintlDDTPerResidueStats(scores_vector, structural_checks, cutoffs_size);
 }
 
+list get_model_local_scores_wrapper(const mol::alg::lDDTModelScore& score) {
+  list local_scores_list;
+  for (std::vector<mol::alg::lDDTLocalScore>::const_iterator sit = score.local_scores.begin(); sit != score.local_scores.end(); ++sit) {
+    local_scores_list.append(*sit);
+  }
+  return local_scores_list;
+}
+
+std::vector<Real> cutoff_list_to_vector(const list& cutoff_list) {
+  int cutoff_list_length = boost::python::extract<int>(cutoff_list.attr("__len__")());
+  std::vector<Real> cutoff_list_vector(cutoff_list_length);
+  for (int i=0; i<cutoff_list_length; i++) {
+    cutoff_list_vector[i] = boost::python::extract<Real>(cutoff_list[i]);
+  }
+  return cutoff_list_vector;
+}
+
+mol::alg::lDDTModelScore lddt_table_score_wrapper(const mol::alg::lDDTDistanceTable& table,
+                                                  const mol::EntityView& model,
+                                                  const list& cutoff_list) {
+  return table.Score(model, cutoff_list_to_vector(cutoff_list));
+}
+
+list lddt_e(const list& model_list, const mol::alg::lDDTDistanceTable& table,
+            const list& cutoff_list, int num_threads) {
+  int model_list_length = boost::python::extract<int>(model_list.attr("__len__")());
+  std::vector<mol::EntityView> model_list_vector(model_list_length);
+  for (int i=0; i<model_list_length; i++) {
+    model_list_vector[i] = boost::python::extract<mol::EntityView>(model_list[i]);
+  }
+  std::vector<mol::alg::lDDTModelScore> scores = mol::alg::LocalDistDiffTest(model_list_vector, table, cutoff_list_to_vector(cutoff_list), num_threads);
+  list scores_list;
+  for (std::vector<mol::alg::lDDTModelScore>::const_iterator sit = scores.begin(); sit != scores.end(); ++sit) {
+    scores_list.append(*sit);
+  }
+  return scores_list;
+}
+
+mol::alg::lDDTDistanceTable create_distance_table_wrapper(const list& reference_list,
+                                                          list& cutoff_list,
+                                                          int sequence_separation,
+                                                          Real max_dist)
+{
+  int reference_list_length = boost::python::extract<int>(reference_list.attr("__len__")());
+  std::vector<ost::mol::EntityView> reference_list_vector(reference_list_length);
+  for (int i=0; i<reference_list_length; i++) {
+    reference_list_vector[i] = boost::python::extract<ost::mol::EntityView>(reference_list[i]);
+  }
+  std::vector<Real> cutoff_list_vector = cutoff_list_to_vector(cutoff_list);
+  return mol::alg::CreateDistanceTable(reference_list_vector, cutoff_list_vector, sequence_separation, max_dist);
+}
+
 geom::Vec3 cbeta_vectors(const geom::Vec3& n_pos, const geom::Vec3& ca_pos, 
                          const geom::Vec3& c_pos, Real l) {
   return mol::alg::CBetaPosition(n_pos, ca_pos, c_pos, l);
@@ -326,6 +382,7 @@ BOOST_PYTHON_MODULE(_ost_mol_alg)
   def("LocalDistDiffTest", lddt_c, (arg("local_lddt_property_string")=""));
   def("LocalDistDiffTest", lddt_b, (arg("ref_index")=0, arg("mdl_index")=1));
   def("LocalDistDiffTest", &lddt_d, (arg("model"), arg("reference_list"), ("distance_list"), arg("settings")));
+  def("LocalDistDiffTest", &lddt_e, (arg("models"), arg("distance_table"), arg("cutoff_list"), arg("num_threads")=0));
   def("FilterClashes", fc_a, (arg("ent"), arg("clashing_distances"), arg("always_remove_bb")=false));
   def("FilterClashes", fc_b, (arg("ent"), arg("clashing_distances"), arg("always_remove_bb")=false));
   def("CheckStereoChemistry", csc_a, (arg("ent"), arg("bonds"), arg("angles"), arg("bond_tolerance"), arg("angle_tolerance"), arg("always_remove_bb")=false));
@@ -336,9 +393,22 @@ BOOST_PYTHON_MODULE(_ost_mol_alg)
 
   def("SuperposeFrames", superpose_frames1, 
       (arg("source"), arg("sel")=ost::mol::EntityView(), arg("begin")=0, 
-       arg("end")=-1, arg("ref")=-1));
+       arg("end")=-1, arg("ref")=-1, arg("num_threads")=1));
   def("SuperposeFrames", superpose_frames2, 
-  (arg("source"), arg("sel"), arg("ref_view"),arg("begin")=0, arg("end")=-1));
+  (arg("source"), arg("sel"), arg("ref_view"),arg("begin")=0, arg("end")=-1,
+   arg("num_threads")=1));
+  def("SuperposeFramesInPlace", superpose_frames_in_place1, 
+      (arg("source"), arg("sel")=ost::mol::EntityView(), arg("begin")=0, 
+       arg("end")=-1, arg("ref")=-1, arg("num_threads")=1));
+  def("SuperposeFramesInPlace", superpose_frames_in_place2, 
+  (arg("source"), arg("sel"), arg("ref_view"),arg("begin")=0, arg("end")=-1,
+   arg("num_threads")=1));
+  def("SuperposeFramesLazy", superpose_frames_lazy1, 
+      (arg("source"), arg("sel")=ost::mol::EntityView(), arg("begin")=0, 
+       arg("end")=-1, arg("ref")=-1, arg("num_threads")=1));
+  def("SuperposeFramesLazy", superpose_frames_lazy2, 
+  (arg("source"), arg("sel"), arg("ref_view"),arg("begin")=0, arg("end")=-1,
+   arg("num_threads")=1));
 
   
   class_<mol::alg::ClashingDistances> ("ClashingDistances",init<>())
@@ -407,6 +477,21 @@ BOOST_PYTHON_MODULE(_ost_mol_alg)
       .add_property("references", &get_references_wrapper)
       .add_property("is_valid", &mol::alg::lDDTScorer::IsValid);
 
+  class_<mol::alg::lDDTModelScore>("lDDTModelScore", no_init)
+    .def_readonly("conserved_dist", &mol::alg::lDDTModelScore::conserved_dist)
+    .def_readonly("total_dist", &mol::alg::lDDTModelScore::total_dist)
+    .def_readonly("global_score", &mol::alg::lDDTModelScore::global_score)
+    .add_property("local_scores", &get_model_local_scores_wrapper);
+
+  class_<mol::alg::lDDTDistanceTable>("lDDTDistanceTable", init<const mol::alg::GlobalRDMap&, optional<int> >())
+    .def(init<const mol::EntityView&, Real, optional<int> >())
+    .def("Score", &lddt_table_score_wrapper, (arg("model"), arg("cutoff_list")))
+    .def("Save", &mol::alg::lDDTDistanceTable::Save, (arg("filename")))
+    .def("Load", &mol::alg::lDDTDistanceTable::Load, (arg("filename"))).staticmethod("Load")
+    .def("GetDistanceCount", &mol::alg::lDDTDistanceTable::GetDistanceCount)
+    .def("GetResidueCount", &mol::alg::lDDTDistanceTable::GetResidueCount)
+    .def("GetSequenceSeparation", &mol::alg::lDDTDistanceTable::GetSequenceSeparation);
+
   class_<mol::alg::StereoChemicalProps>("StereoChemicalProps",
                            init<mol::alg::StereoChemicalParams&,
                            mol::alg::StereoChemicalParams&,
@@ -424,6 +509,9 @@ BOOST_PYTHON_MODULE(_ost_mol_alg)
   def("PreparelDDTGlobalRDMap",
       &prepare_lddt_global_rdmap_wrapper,
       (arg("reference_list"), arg("cutoffs"), arg("sequence_separation"), arg("radius")));
+  def("CreateDistanceTable",
+      &create_distance_table_wrapper,
+      (arg("reference_list"), arg("cutoffs"), arg("sequence_separation"), arg("radius")));
   def("CheckStructure",
       &mol::alg::CheckStructure,
       (arg("ent"), arg("bond_table"), arg("angle_table"), arg("nonbonded_table"),
@@ -5,12 +5,30 @@
 #include <set>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <ost/parallel_for.hh>
 #include <ost/mol/chain_view.hh>
 #include <ost/mol/residue_view.hh>
 #include <ost/mol/atom_view.hh>
 
+#if !OST_DOUBLE_PRECISION && defined(__AVX2__)
+#include <immintrin.h>
+#define OST_ASA_AVX2
+#elif !OST_DOUBLE_PRECISION && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define OST_ASA_SSE
+#endif
+
 namespace{
 
+#if defined(OST_ASA_AVX2)
+const int ASA_BLOCK_SIZE = 8;
+#elif defined(OST_ASA_SSE)
+const int ASA_BLOCK_SIZE = 4;
+#else
+const int ASA_BLOCK_SIZE = 1;
+#endif
+
 struct Cube {
   
   Cube() {
@@ -198,13 +216,174 @@ struct CubeOccupationGrid{
   bool* occupied_cubes;
 };
 
+// All neighbour tests below are evaluated in blocks of ASA_BLOCK_SIZE
+// neighbours. Single precision builds use SSE or, if the compiler targets it,
+// AVX2 instructions for that. The SIMD tests are only used as a slightly
+// permissive filter, every hit is verified with exactly the same scalar
+// arithmetic as before, which keeps the results independent of the
+// instruction set.
+const Real ASA_KERNEL_MARGIN = Real(1e-3);
+
+// scratch space of one thread. The buffers are reused for all atoms processed
+// by that thread instead of being reallocated for every single atom.
+struct ASAWorkspace {
+
+  ASAWorkspace() {
+    x.reserve(200);
+    y.reserve(200);
+    z.reserve(200);
+    radii.reserve(200);
+  }
+
+  // all atoms in the current and neighbouring cubes
+  std::vector<Real> x;
+  std::vector<Real> y;
+  std::vector<Real> z;
+  std::vector<Real> radii;
+
+  // atoms whose sphere actually intersects with the sphere of the processed
+  // atom, padded to a multiple of ASA_BLOCK_SIZE
+  std::vector<Real> n_x;
+  std::vector<Real> n_y;
+  std::vector<Real> n_z;
+  std::vector<Real> n_radii;
+  std::vector<Real> n_dsqr;
+  std::vector<Real> n_d;
+  std::vector<Real> n_beta;
+
+  std::vector<int> hits;
+  std::vector<std::pair<Real, Real> > arcs;
+};
+
+void PadToBlockSize(std::vector<Real>& v, Real value) {
+  while(v.size() % ASA_BLOCK_SIZE != 0) v.push_back(value);
+}
+
+// collects the indices of all neighbours whose circle in the z plane at 
+// z_grid possibly intersects with the circle of radius z_slice_r of the
+// processed atom. n must be a multiple of ASA_BLOCK_SIZE.
+void FindSliceHits(Real z_grid, Real z_slice_r, const Real* z, const Real* r,
+                   const Real* d, int n, std::vector<int>& hits) {
+  hits.clear();
+#if defined(OST_ASA_AVX2)
+  const __m256 v_z_grid = _mm256_set1_ps(z_grid);
+  const __m256 v_limit = _mm256_set1_ps(z_slice_r + ASA_KERNEL_MARGIN);
+  const __m256 v_min_sqr = _mm256_set1_ps(-ASA_KERNEL_MARGIN);
+  const __m256 v_zero = _mm256_setzero_ps();
+  for(int i = 0; i < n; i += 8) {
+    __m256 dz = _mm256_sub_ps(v_z_grid, _mm256_loadu_ps(z + i));
+    __m256 rad = _mm256_loadu_ps(r + i);
+    __m256 sqr = _mm256_sub_ps(_mm256_mul_ps(rad, rad), _mm256_mul_ps(dz, dz));
+    __m256 summed_r = _mm256_add_ps(_mm256_sqrt_ps(_mm256_max_ps(sqr, v_zero)),
+                                    v_limit);
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(sqr, v_min_sqr, _CMP_GT_OQ),
+                               _mm256_cmp_ps(_mm256_loadu_ps(d + i), summed_r,
+                                             _CMP_LT_OQ));
+    int mask = _mm256_movemask_ps(hit);
+    for(int j = 0; mask != 0; ++j, mask >>= 1) {
+      if(mask & 1) hits.push_back(i + j);
+    }
+  }
+#elif defined(OST_ASA_SSE)
+  const __m128 v_z_grid = _mm_set1_ps(z_grid);
+  const __m128 v_limit = _mm_set1_ps(z_slice_r + ASA_KERNEL_MARGIN);
+  const __m128 v_min_sqr = _mm_set1_ps(-ASA_KERNEL_MARGIN);
+  const __m128 v_zero = _mm_setzero_ps();
+  for(int i = 0; i < n; i += 4) {
+    __m128 dz = _mm_sub_ps(v_z_grid, _mm_loadu_ps(z + i));
+    __m128 rad = _mm_loadu_ps(r + i);
+    __m128 sqr = _mm_sub_ps(_mm_mul_ps(rad, rad), _mm_mul_ps(dz, dz));
+    __m128 summed_r = _mm_add_ps(_mm_sqrt_ps(_mm_max_ps(sqr, v_zero)),
+                                 v_limit);
+    __m128 hit = _mm_and_ps(_mm_cmpgt_ps(sqr, v_min_sqr),
+                            _mm_cmplt_ps(_mm_loadu_ps(d + i), summed_r));
+    int mask = _mm_movemask_ps(hit);
+    for(int j = 0; mask != 0; ++j, mask >>= 1) {
+      if(mask & 1) hits.push_back(i + j);
+    }
+  }
+#else
+  for(int i = 0; i < n; ++i) {
+    Real dz = z_grid - z[i];
+    Real sqr = r[i]*r[i] - dz*dz;
+    if(sqr > -ASA_KERNEL_MARGIN && 
+       d[i] < std::sqrt(std::max(sqr, Real(0.0))) + z_slice_r + 
+              ASA_KERNEL_MARGIN) {
+      hits.push_back(i);
+    }
+  }
+#endif
+}
+
+// checks whether the point (px, py, pz) lies within any of the n neighbour
+// spheres given by their centers and squared radii. n must be a multiple of
+// ASA_BLOCK_SIZE.
+bool PointCovered(Real px, Real py, Real pz, const Real* x, const Real* y,
+                  const Real* z, const Real* squared_r, int n) {
+#if defined(OST_ASA_AVX2)
+  const __m256 v_px = _mm256_set1_ps(px);
+  const __m256 v_py = _mm256_set1_ps(py);
+  const __m256 v_pz = _mm256_set1_ps(pz);
+  const __m256 v_margin = _mm256_set1_ps(ASA_KERNEL_MARGIN);
+  for(int i = 0; i < n; i += 8) {
+    __m256 dx = _mm256_sub_ps(v_px, _mm256_loadu_ps(x + i));
+    __m256 dy = _mm256_sub_ps(v_py, _mm256_loadu_ps(y + i));
+    __m256 dz = _mm256_sub_ps(v_pz, _mm256_loadu_ps(z + i));
+    __m256 dist_squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx),
+                                                      _mm256_mul_ps(dy, dy)),
+                                        _mm256_mul_ps(dz, dz));
+    __m256 limit = _mm256_add_ps(_mm256_loadu_ps(squared_r + i), v_margin);
+    if(_mm256_movemask_ps(_mm256_cmp_ps(dist_squared, limit, _CMP_LT_OQ))) {
+      for(int j = i; j < i + 8; ++j) {
+        Real a = px - x[j];
+        Real b = py - y[j];
+        Real c = pz - z[j];
+        if(a*a + b*b + c*c < squared_r[j]) return true;
+      }
+    }
+  }
+  return false;
+#elif defined(OST_ASA_SSE)
+  const __m128 v_px = _mm_set1_ps(px);
+  const __m128 v_py = _mm_set1_ps(py);
+  const __m128 v_pz = _mm_set1_ps(pz);
+  const __m128 v_margin = _mm_set1_ps(ASA_KERNEL_MARGIN);
+  for(int i = 0; i < n; i += 4) {
+    __m128 dx = _mm_sub_ps(v_px, _mm_loadu_ps(x + i));
+    __m128 dy = _mm_sub_ps(v_py, _mm_loadu_ps(y + i));
+    __m128 dz = _mm_sub_ps(v_pz, _mm_loadu_ps(z + i));
+    __m128 dist_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                                _mm_mul_ps(dy, dy)),
+                                     _mm_mul_ps(dz, dz));
+    __m128 limit = _mm_add_ps(_mm_loadu_ps(squared_r + i), v_margin);
+    if(_mm_movemask_ps(_mm_cmplt_ps(dist_squared, limit))) {
+      for(int j = i; j < i + 4; ++j) {
+        Real a = px - x[j];
+        Real b = py - y[j];
+        Real c = pz - z[j];
+        if(a*a + b*b + c*c < squared_r[j]) return true;
+      }
+    }
+  }
+  return false;
+#else
+  for(int i = 0; i < n; ++i) {
+    Real a = px - x[i];
+    Real b = py - y[i];
+    Real c = pz - z[i];
+    if(a*a + b*b + c*c < squared_r[i]) return true;
+  }
+  return false;
+#endif
+}
+
 Real GetAtomAccessibilityNACCESS(Real x_pos, Real y_pos, Real z_pos,
-                                 Real radius,
-                                 const std::vector<Real>& x,
-                                 const std::vector<Real>& y,
-                                 const std::vector<Real>& z, 
-                                 const std::vector<Real>& radii) {
+                                 Real radius, ASAWorkspace& ws) {
                                   
+  const std::vector<Real>& x = ws.x;
+  const std::vector<Real>& y = ws.y;
+  const std::vector<Real>& z = ws.z;
+  const std::vector<Real>& radii = ws.radii;
   int num_close_atoms = x.size();
 
   if(num_close_atoms == 0) {
@@ -212,27 +391,57 @@ Real GetAtomAccessibilityNACCESS(Real x_pos, Real y_pos, Real z_pos,
     return Real(4.0) * M_PI * radius * radius;
   } 
 
-  std::vector<Real> dx(num_close_atoms);
-  std::vector<Real> dy(num_close_atoms);
-  std::vector<Real> dsqr(num_close_atoms);
-  std::vector<Real> d(num_close_atoms);
+  std::vector<Real>& dx = ws.n_x;
+  std::vector<Real>& dy = ws.n_y;
+  std::vector<Real>& close_z = ws.n_z;
+  std::vector<Real>& close_radii = ws.n_radii;
+  std::vector<Real>& dsqr = ws.n_dsqr;
+  std::vector<Real>& d = ws.n_d;
+  std::vector<Real>& beta = ws.n_beta;
+  dx.clear();
+  dy.clear();
+  close_z.clear();
+  close_radii.clear();
+  dsqr.clear();
+  d.clear();
+  beta.clear();
 
   for(int i = 0; i < num_close_atoms; ++i) {
     Real a = x_pos - x[i];
     Real b = y_pos - y[i];  
     Real c = a*a + b*b;
-    dx[i] = a;
-    dy[i] = b;
-    dsqr[i] = c;
-    d[i] = std::sqrt(c);
+    Real e = z_pos - z[i];
+    Real summed_radii = radius + radii[i];
+    // atoms whose sphere does not intersect with the sphere of the current 
+    // atom never contribute an arc in any of the z slices. The margin keeps
+    // this filter on the safe side.
+    if(c + e*e > summed_radii * summed_radii * Real(1.0001)) {
+      continue;
+    }
+    dx.push_back(a);
+    dy.push_back(b);
+    close_z.push_back(z[i]);
+    close_radii.push_back(radii[i]);
+    dsqr.push_back(c);
+    d.push_back(std::sqrt(c));
+    // estimate beta: the angle between l and the x-axis
+    // l: line between the two circle centers
+    beta.push_back(std::atan2(b, a) + M_PI);
   }
 
+  // padded entries never intersect with any z slice
+  PadToBlockSize(close_z, std::numeric_limits<Real>::max());
+  PadToBlockSize(close_radii, Real(0.0));
+  PadToBlockSize(d, Real(0.0));
+  int num_padded = close_z.size();
+
   Real area = 0.0;
   int num_z_slices = 20;
   Real z_res = Real(2.0) * radius / num_z_slices;
   Real z_grid = z_pos - radius + Real(0.5) * z_res;
   Real pi_two = Real(2.0) * M_PI;
-  std::vector<std::pair<Real, Real> > arcs;
+  std::vector<std::pair<Real, Real> >& arcs = ws.arcs;
+  std::vector<int>& hits = ws.hits;
 
   for(int z_slice_idx = 0; z_slice_idx < num_z_slices; ++z_slice_idx) {
     
@@ -246,10 +455,15 @@ Real GetAtomAccessibilityNACCESS(Real x_pos, Real y_pos, Real z_pos,
     Real z_slice_r = std::sqrt(z_slice_squared_r);
     bool fully_enclosed = false;
 
-    for(int idx = 0; idx < num_close_atoms; ++idx) {
+    FindSliceHits(z_grid, z_slice_r, close_z.data(), close_radii.data(),
+                  d.data(), num_padded, hits);
+
+    for(std::vector<int>::const_iterator it = hits.begin(); 
+        it != hits.end(); ++it) {
 
-      Real close_atom_dz = z_grid - z[idx];
-      Real close_atom_radius = radii[idx];
+      int idx = *it;
+      Real close_atom_dz = z_grid - close_z[idx];
+      Real close_atom_radius = close_radii[idx];
       
 
       // the radius of the circle given by the intersection of the sphere
@@ -296,13 +510,9 @@ Real GetAtomAccessibilityNACCESS(Real x_pos, Real y_pos, Real z_pos,
         if(trig_test <=-1.0) trig_test = Real(-0.99999);
         Real alpha = std::acos(trig_test);
 
-        // estimate beta: the angle between l and the x-axis
-        // l: line between the two circle centers
-        Real beta = std::atan2(dy[idx], dx[idx]) + M_PI;
-
         // start and end of arc relative to x-axis
-        Real arc_start = beta - alpha;
-        Real arc_end = beta + alpha;
+        Real arc_start = beta[idx] - alpha;
+        Real arc_end = beta[idx] + alpha;
     
         // enforce range [0.0, 2*pi]
         if(arc_start < 0.0) arc_start += pi_two;
@@ -365,12 +575,12 @@ struct DSSPHelper{
 
 
 Real GetAtomAccessibilityDSSP(Real x_pos, Real y_pos, Real z_pos,
-                              Real radius,
-                              const std::vector<Real>& x,
-                              const std::vector<Real>& y,
-                              const std::vector<Real>& z, 
-                              const std::vector<Real>& radii) {
+                              Real radius, ASAWorkspace& ws) {
 
+  const std::vector<Real>& x = ws.x;
+  const std::vector<Real>& y = ws.y;
+  const std::vector<Real>& z = ws.z;
+  const std::vector<Real>& radii = ws.radii;
   int num_close_atoms = x.size();
   
   if(num_close_atoms == 0) {
@@ -396,6 +606,29 @@ Real GetAtomAccessibilityDSSP(Real x_pos, Real y_pos, Real z_pos,
   }
 
   std::sort(helpers.begin(), helpers.end());
+
+  // closest atoms first, they're most likely to cover a point
+  std::vector<Real>& helper_x = ws.n_x;
+  std::vector<Real>& helper_y = ws.n_y;
+  std::vector<Real>& helper_z = ws.n_z;
+  std::vector<Real>& helper_squared_r = ws.n_radii;
+  helper_x.clear();
+  helper_y.clear();
+  helper_z.clear();
+  helper_squared_r.clear();
+  for(std::vector<DSSPHelper>::const_iterator it = helpers.begin();
+      it != helpers.end(); ++it) {
+    helper_x.push_back(it->x_pos);
+    helper_y.push_back(it->y_pos);
+    helper_z.push_back(it->z_pos);
+    helper_squared_r.push_back(it->squared_radius);
+  }
+  // padded entries never cover a point
+  PadToBlockSize(helper_x, Real(0.0));
+  PadToBlockSize(helper_y, Real(0.0));
+  PadToBlockSize(helper_z, Real(0.0));
+  PadToBlockSize(helper_squared_r, Real(-1.0));
+  int num_helpers = helper_x.size();
   
   const ost::mol::alg::DSSPAccessibilityParam& param = 
   ost::mol::alg::DSSPAccessibilityParam::GetInstance();
@@ -405,26 +638,14 @@ Real GetAtomAccessibilityDSSP(Real x_pos, Real y_pos, Real z_pos,
   Real fibo_weight = param.GetPointWeight();
   Real summed_fibo_weight = 0.0;
   Real fibo_x, fibo_y, fibo_z;
-  uint num_helpers = helpers.size();
 
   for(uint i = 0; i < fibonacci_x.size(); ++i) {
     fibo_x = fibonacci_x[i] * radius;
     fibo_y = fibonacci_y[i] * radius;
     fibo_z = fibonacci_z[i] * radius;
 
-    bool covered = false;
-
-    for(uint j = 0; j < num_helpers; ++j) {
-      dx = fibo_x - helpers[j].x_pos;
-      dy = fibo_y - helpers[j].y_pos;
-      dz = fibo_z - helpers[j].z_pos;
-      dist_squared = dx*dx + dy*dy + dz*dz;
-      if(dist_squared < helpers[j].squared_radius) {
-        covered = true;
-        break;
-      }
-    }
-    if(!covered) {
+    if(!PointCovered(fibo_x, fibo_y, fibo_z, helper_x.data(), helper_y.data(),
+                     helper_z.data(), helper_squared_r.data(), num_helpers)) {
       summed_fibo_weight += fibo_weight;
     } 
   }
@@ -433,20 +654,16 @@ Real GetAtomAccessibilityDSSP(Real x_pos, Real y_pos, Real z_pos,
 }
 
 Real GetAtomAccessibility(Real x_pos, Real y_pos, Real z_pos,
-                          Real radius,
-                          const std::vector<Real>& x,
-                          const std::vector<Real>& y,
-                          const std::vector<Real>& z, 
-                          const std::vector<Real>& radii,
+                          Real radius, ASAWorkspace& ws,
                           ost::mol::alg::AccessibilityAlgorithm algorithm) {
   switch(algorithm){
     case ost::mol::alg::NACCESS: return GetAtomAccessibilityNACCESS(x_pos, y_pos,
                                                                     z_pos, radius,
-                                                                    x, y, z, radii);
+                                                                    ws);
 
     case ost::mol::alg::DSSP: return GetAtomAccessibilityDSSP(x_pos, y_pos,
                                                               z_pos, radius,
-                                                              x, y, z, radii);
+                                                              ws);
 
   }
 
@@ -459,15 +676,13 @@ void SolveCube(const CubeGrid& cube_grid, int cube_idx,
                const std::vector<Real>& x, const std::vector<Real>& y, 
                const std::vector<Real>& z, const std::vector<Real>& radii, 
                ost::mol::alg::AccessibilityAlgorithm algorithm,
-               std::vector<Real>& asa) {
+               std::vector<Real>& asa, ASAWorkspace& ws) {
 
   //prepare some stuff
-  std::vector<Real> close_atom_x, close_atom_y, close_atom_z, close_atom_radii;
-
-  close_atom_x.reserve(200);
-  close_atom_y.reserve(200);
-  close_atom_z.reserve(200);
-  close_atom_radii.reserve(200);
+  std::vector<Real>& close_atom_x = ws.x;
+  std::vector<Real>& close_atom_y = ws.y;
+  std::vector<Real>& close_atom_z = ws.z;
+  std::vector<Real>& close_atom_radii = ws.radii;
 
   Cube* central_cube = cube_grid.GetCube(cube_idx);;
   std::vector<Cube*> neighbouring_cubes;
@@ -520,11 +735,54 @@ void SolveCube(const CubeGrid& cube_grid, int cube_idx,
     
     // DOIT DOIT DOIT!!!
     asa[atom_idx] = GetAtomAccessibility(current_x, current_y, current_z, 
-                                         current_radius, 
-                                         close_atom_x, close_atom_y, 
-                                         close_atom_z, close_atom_radii,
-                                         algorithm);
+                                         current_radius, ws, algorithm);
+  }
+}
+
+
+// solves the cubes of a chunk. Every atom belongs to exactly one cube, so the
+// threads write to disjoint elements of asa. Each thread works with its own
+// copy of the solver and hence its own workspace.
+class CubeSolver {
+public:
+  CubeSolver(const CubeGrid& cube_grid, const std::vector<int>& cube_indices,
+             const std::vector<Real>& x, const std::vector<Real>& y,
+             const std::vector<Real>& z, const std::vector<Real>& radii,
+             ost::mol::alg::AccessibilityAlgorithm algorithm,
+             std::vector<Real>& asa):
+    cube_grid_(cube_grid), cube_indices_(cube_indices), x_(x), y_(y), z_(z),
+    radii_(radii), algorithm_(algorithm), asa_(asa)
+  { }
+
+  void operator()(size_t begin, size_t end) {
+    for(size_t i = begin; i < end; ++i) {
+      SolveCube(cube_grid_, cube_indices_[i], x_, y_, z_, radii_, 
+                algorithm_, asa_, ws_);
+    }
   }
+
+private:
+  const CubeGrid&                       cube_grid_;
+  const std::vector<int>&               cube_indices_;
+  const std::vector<Real>&              x_;
+  const std::vector<Real>&              y_;
+  const std::vector<Real>&              z_;
+  const std::vector<Real>&              radii_;
+  ost::mol::alg::AccessibilityAlgorithm algorithm_;
+  std::vector<Real>&                    asa_;
+  ASAWorkspace                          ws_;
+};
+
+
+void SolveCubes(const CubeGrid& cube_grid, const std::vector<int>& cube_indices,
+                const std::vector<Real>& x, const std::vector<Real>& y, 
+                const std::vector<Real>& z, const std::vector<Real>& radii, 
+                ost::mol::alg::AccessibilityAlgorithm algorithm,
+                int num_threads, std::vector<Real>& asa) {
+
+  ost::ParallelForChunks(cube_indices.size(), 16, num_threads,
+                         CubeSolver(cube_grid, cube_indices, x, y, z, radii,
+                                    algorithm, asa));
 }
 
 
@@ -594,7 +852,7 @@ void CalculateASAOligo(std::vector<Real>& x, std::vector<Real>& y,
                        std::vector<Real>& z, std::vector<Real>& radii,
                        std::vector<int> chain_indices, Real probe_radius, 
                        ost::mol::alg::AccessibilityAlgorithm algorithm,
-                       std::vector<Real>& asa,
+                       int num_threads, std::vector<Real>& asa,
                        std::vector<Real>& asa_single_chain) {
 
   int num_atoms = x.size();
@@ -609,15 +867,16 @@ void CalculateASAOligo(std::vector<Real>& x, std::vector<Real>& y,
     cube_grid.AddIndex(x[i], y[i], z[i], i);
   }
 
+  std::vector<int> cube_indices;
   int num_cubes = cube_grid.GetNumCubes();
   for(int cube_idx = 0; cube_idx < num_cubes; ++cube_idx) {
-
     if(cube_grid.IsInitialized(cube_idx)) {
       // there is at least one atom!
-      SolveCube(cube_grid, cube_idx, x, y, z, full_radii, 
-                algorithm, asa);
+      cube_indices.push_back(cube_idx);
     }
   }
+  SolveCubes(cube_grid, cube_indices, x, y, z, full_radii, algorithm, 
+             num_threads, asa);
 
   // let's start with the single chain stuff
   // the asa are assumed to be exactly the same for the majority of the atoms
@@ -658,6 +917,7 @@ void CalculateASAOligo(std::vector<Real>& x, std::vector<Real>& y,
       }
     }
 
+    cube_indices.clear();
     for(int cube_idx = 0; cube_idx < single_chain_cube_grid.GetNumCubes(); 
         ++cube_idx) {
 
@@ -666,10 +926,11 @@ void CalculateASAOligo(std::vector<Real>& x, std::vector<Real>& y,
           occupation_grid.HasOccupiedNeighbour(cube_idx))) {
         // there is at least one atom in the cube AND the environment has 
         // changes compared to the previous asa calculation
-        SolveCube(single_chain_cube_grid, cube_idx, x, y, z, full_radii, 
-                  algorithm, asa_single_chain);
+        cube_indices.push_back(cube_idx);
       }
     }
+    SolveCubes(single_chain_cube_grid, cube_indices, x, y, z, full_radii, 
+               algorithm, num_threads, asa_single_chain);
   }
 }
 
@@ -680,7 +941,7 @@ void CalculateASA(const std::vector<Real>& x,
                   const std::vector<Real>& radii, 
                   Real probe_radius, 
                   ost::mol::alg::AccessibilityAlgorithm algorithm,
-                  std::vector<Real>& asa) {
+                  int num_threads, std::vector<Real>& asa) {
 
   int num_atoms = x.size();
   asa.resize(num_atoms);
@@ -694,14 +955,16 @@ void CalculateASA(const std::vector<Real>& x,
     cube_grid.AddIndex(x[i], y[i], z[i], i);
   }
 
+  std::vector<int> cube_indices;
   int num_cubes = cube_grid.GetNumCubes();
   for(int cube_idx = 0; cube_idx < num_cubes; ++cube_idx) {
     if(cube_grid.IsInitialized(cube_idx)) {
       // there is at least one atom!
-      SolveCube(cube_grid, cube_idx, x, y, z, full_radii, 
-                algorithm, asa);
+      cube_indices.push_back(cube_idx);
     }
   }
+  SolveCubes(cube_grid, cube_indices, x, y, z, full_radii, algorithm, 
+             num_threads, asa);
 }
 
 
@@ -1441,7 +1704,8 @@ Real Accessibility(ost::mol::EntityView& ent,
                    const String& asa_abs, 
                    const String& asa_rel,
                    const String& asa_atom,
-                   AccessibilityAlgorithm algorithm) {
+                   AccessibilityAlgorithm algorithm,
+                   int num_threads) {
 
   String internal_selection = selection;
 
@@ -1508,7 +1772,8 @@ Real Accessibility(ost::mol::EntityView& ent,
     std::vector<Real> asa;
     std::vector<Real> asa_single_chain;
     CalculateASAOligo(x_pos, y_pos, z_pos, radii, chain_indices, 
-                      probe_radius, algorithm, asa, asa_single_chain);
+                      probe_radius, algorithm, num_threads, asa, 
+                      asa_single_chain);
 
     Real summed_asa = SetAccessibilityProps(selected_ent, atom_list, asa, 
                                             asa_atom, asa_abs, asa_rel, 
@@ -1531,7 +1796,8 @@ Real Accessibility(ost::mol::EntityView& ent,
     
     // do it! do it! do it!
     std::vector<Real> asa;
-    CalculateASA(x_pos, y_pos, z_pos, radii, probe_radius, algorithm, asa);
+    CalculateASA(x_pos, y_pos, z_pos, radii, probe_radius, algorithm, 
+                 num_threads, asa);
 
     Real summed_asa = SetAccessibilityProps(selected_ent, atom_list, asa, 
                                             asa_atom, asa_abs, asa_rel,
@@ -1550,12 +1816,14 @@ Real Accessibility(ost::mol::EntityHandle& ent,
                    const String& asa_abs, 
                    const String& asa_rel,
                    const String& asa_atom,
-                   AccessibilityAlgorithm algorithm) {
+                   AccessibilityAlgorithm algorithm,
+                   int num_threads) {
 
   ost::mol::EntityView entity_view = ent.CreateFullView();
   return Accessibility(entity_view, probe_radius, include_hydrogens,
                        include_hetatm, include_water, oligo_mode,
-                       selection, asa_abs, asa_rel, asa_atom, algorithm);
+                       selection, asa_abs, asa_rel, asa_atom, algorithm,
+                       num_threads);
 }
 
 }}} //ns
@@ -96,7 +96,8 @@ Real Accessibility(ost::mol::EntityView& ent,
                    const String& asa_abs = "asaAbs",
                    const String& asa_rel = "asaRel",
                    const String& asa_atom = "asaAtom",
-                   AccessibilityAlgorithm algorithm = NACCESS);
+                   AccessibilityAlgorithm algorithm = NACCESS,
+                   int num_threads = 1);
 
 
 Real Accessibility(ost::mol::EntityHandle& ent, 
@@ -109,7 +110,8 @@ Real Accessibility(ost::mol::EntityHandle& ent,
                    const String& asa_abs = "asaAbs",
                    const String& asa_rel = "asaRel",
                    const String& asa_atom = "asaAtom",
-                   AccessibilityAlgorithm algorithm = NACCESS);
+                   AccessibilityAlgorithm algorithm = NACCESS,
+                   int num_threads = 1);
 
 }}} //ns
 
@@ -16,10 +16,12 @@
 // along with this library; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 //------------------------------------------------------------------------------
+#include <algorithm>
 #include <ost/mol/entity_view.hh>
 #include <ost/mol/atom_view.hh>
 #include <ost/mol/residue_view.hh>
 #include <ost/mol/chain_view.hh>
+#include <ost/mol/neighbour_list.hh>
 #include "clash_score.hh"
 
 namespace ost { namespace mol { namespace alg {
@@ -43,48 +45,48 @@ Real StericEnergy(const geom::Vec3& pos1, Real r1,
 
 Real ClashScore(const EntityView& ent_a, const EntityView& ent_b)
 {
+  AtomViewList atoms_a=ent_a.GetAtomList();
+  AtomViewList atoms_b=ent_b.GetAtomList();
+  geom::Vec3List pos_a, pos_b;
+  std::vector<Real> radii_a, radii_b;
+  pos_a.reserve(atoms_a.size());
+  radii_a.reserve(atoms_a.size());
+  Real max_radius_a=0.0;
+  for (AtomViewList::const_iterator i=atoms_a.begin(), 
+       e=atoms_a.end(); i!=e; ++i) {
+    pos_a.push_back(i->GetPos());
+    radii_a.push_back(i->GetRadius());
+    max_radius_a=std::max(max_radius_a, radii_a.back());
+  }
+  pos_b.reserve(atoms_b.size());
+  radii_b.reserve(atoms_b.size());
+  for (AtomViewList::const_iterator i=atoms_b.begin(), 
+       e=atoms_b.end(); i!=e; ++i) {
+    pos_b.push_back(i->GetPos());
+    radii_b.push_back(i->GetRadius());
+  }
+  // collect candidates with the largest cutoff in one go, then apply the
+  // per-atom cutoff of ent_a.
+  IndexPairList pairs;
+  FindAllPairsWithin(pos_a, pos_b, max_radius_a+1.7, pairs);
   Real energy=0.0;
-  for (ChainViewList::const_iterator ci = ent_a.GetChainList().begin(),
-       ce = ent_a.GetChainList().end(); ci != ce; ++ci) {
-    for (ResidueViewList::const_iterator ri = ci->GetResidueList().begin(),
-         re = ci->GetResidueList().end(); ri != re; ++ri) {
-      for (AtomViewList::const_iterator ai = ri->GetAtomList().begin(),
-           ae = ri->GetAtomList().end(); ai!= ae; ++ai) {
-        AtomViewList clashees=ent_b.FindWithin(ai->GetPos(), 
-                                               ai->GetRadius()+1.7);
-
-        for (AtomViewList::iterator j=clashees.begin(), 
-            e2=clashees.end(); j!=e2; ++j) {
-            energy+=StericEnergy((*j).GetPos(), (*j).GetRadius()-0.25,
-                                  ai->GetPos(), ai->GetRadius()-0.25);           
-        }
-      }
+  for (IndexPairList::const_iterator i=pairs.begin(), 
+       e=pairs.end(); i!=e; ++i) {
+    Real cutoff=radii_a[i->first]+1.7;
+    if (i->dist2>cutoff*cutoff) {
+      continue;
     }
+    energy+=StericEnergy(pos_b[i->second], radii_b[i->second]-0.25,
+                         pos_a[i->first], radii_a[i->first]-0.25);
   }
   return energy;  
 }
 
 Real ClashScore(const EntityHandle& ent_a, const EntityView& ent_b)
 {
-  Real energy=0.0;
-  for (ChainViewList::const_iterator ci = ent_b.GetChainList().begin(),
-       ce = ent_b.GetChainList().end(); ci != ce; ++ci) {
-    for (ResidueViewList::const_iterator ri = ci->GetResidueList().begin(),
-         re = ci->GetResidueList().end(); ri != re; ++ri) {
-      for (AtomViewList::const_iterator ai = ri->GetAtomList().begin(),
-           ae = ri->GetAtomList().end(); ai!= ae; ++ai) {
-        AtomHandleList clashees=ent_a.FindWithin(ai->GetPos(), 
-                                                 ai->GetRadius()+1.7);
-
-        for (AtomHandleList::iterator j=clashees.begin(), 
-            e2=clashees.end(); j!=e2; ++j) {
-            energy+=StericEnergy((*j).GetPos(), (*j).GetRadius()-0.25,
-                                  ai->GetPos(), ai->GetRadius()-0.25);           
-        }
-      }
-    }
-  }
-  return energy;  
+  // same as the view version with the roles swapped: the cutoff is given by
+  // the atoms of ent_b.
+  return ClashScore(ent_b, ent_a.CreateFullView());
 }
 
 Real ClashScore(const AtomHandle& atom, const EntityView& ent_b)
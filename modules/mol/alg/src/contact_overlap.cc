@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <ost/log.hh>
 #include <ost/mol/mol.hh>
+#include <ost/mol/neighbour_list.hh>
 #include <ost/seq/alignment_handle.hh>
 #include <ost/seq/alg/merge_pairwise_alignments.hh>
 #include "contact_overlap.hh"
@@ -10,31 +12,51 @@ using namespace ost::seq;
 
 namespace ost { namespace mol { namespace alg {
 
+namespace {
+
+struct IndexPairLess {
+  bool operator()(const IndexPair& a, const IndexPair& b) const {
+    return a.first!=b.first ? a.first<b.first : a.second<b.second;
+  }
+};
+
+// pairs of CA atoms (i, j) with i < j within cutoff, in the order of the 
+// residues
+void ca_pairs(const ResidueViewList& residues, Real cutoff,
+              AtomViewList& ca_atoms, IndexPairList& pairs)
+{
+  geom::Vec3List ca_pos;
+  for (ResidueViewList::const_iterator
+       i=residues.begin(), e=residues.end(); i!=e; ++i) {
+    AtomView atom=i->FindAtom("CA");
+    if (atom.IsValid()) {
+      ca_atoms.push_back(atom);
+      ca_pos.push_back(atom.GetPos());
+    }
+  }
+  FindAllPairsWithin(ca_pos, cutoff, pairs);
+  std::sort(pairs.begin(), pairs.end(), IndexPairLess());
+}
+
+}
+
 ContactList Contacts(const ost::mol::EntityView& ent, Real min_dist,
                      Real max_dist)
 {
   Real min_sqr=min_dist*min_dist;
   Real max_sqr=max_dist*max_dist;
   ContactList contacts;
-  ResidueViewList residues=ent.GetResidueList();
-  for (ResidueViewList::const_iterator
-    i=residues.begin(), e=residues.end(); i!=e; ++i) {
-    AtomView atom_a=i->FindAtom("CA");
-    if (!atom_a.IsValid()) {
-      continue;
-    }
-    for (ResidueViewList::const_iterator
-         j=i+1, e2=residues.end(); j!=e2; ++j) {
-      AtomView atom_b=j->FindAtom("CA");
-      if (!atom_b.IsValid()) {
-        continue;
-      }
-      Real d=geom::Length2(atom_a.GetPos()-atom_b.GetPos());
-      if (min_sqr<d && max_sqr>d) {
-        contacts.push_back(Contact(atom_a.GetHandle(), atom_b.GetHandle()));
-      }
+  AtomViewList ca_atoms;
+  IndexPairList pairs;
+  ca_pairs(ent.GetResidueList(), max_dist, ca_atoms, pairs);
+  for (IndexPairList::const_iterator 
+       i=pairs.begin(), e=pairs.end(); i!=e; ++i) {
+    const AtomView& atom_a=ca_atoms[i->first];
+    const AtomView& atom_b=ca_atoms[i->second];
+    Real d=geom::Length2(atom_a.GetPos()-atom_b.GetPos());
+    if (min_sqr<d && max_sqr>d) {
+      contacts.push_back(Contact(atom_a.GetHandle(), atom_b.GetHandle()));
     }
-
   }
   return contacts;
 }
@@ -84,46 +106,38 @@ Real LocalDistanceTest(const EntityView& mdl, const EntityView& ref,
                        Real max_dist, Real tolerance, bool only_complete)
 {
   Real max_sqr=pow(max_dist+max_dist*tolerance, 2);
-  ContactList contacts;
-  ResidueViewList residues=ref.GetResidueList();
   Real in_ref=0.0;
   Real in_mdl=0.0;
-  for (ResidueViewList::const_iterator
-    i=residues.begin(), e=residues.end(); i!=e; ++i) {
-    AtomView atom_a=i->FindAtom("CA");
-    if (!atom_a.IsValid()) {
+  AtomViewList ca_atoms;
+  IndexPairList pairs;
+  ca_pairs(ref.GetResidueList(), max_dist+max_dist*tolerance, ca_atoms, pairs);
+  for (IndexPairList::const_iterator 
+       i=pairs.begin(), e=pairs.end(); i!=e; ++i) {
+    const AtomView& atom_a=ca_atoms[i->first];
+    const AtomView& atom_b=ca_atoms[i->second];
+    Real d=geom::Length2(atom_a.GetPos()-atom_b.GetPos());
+    if (max_sqr<d) {
       continue;
     }
-    for (ResidueViewList::const_iterator
-         j=i+1, e2=residues.end(); j!=e2; ++j) {
-      AtomView atom_b=j->FindAtom("CA");
-      if (!atom_b.IsValid()) {
-        continue;
-      }
-      Real d=geom::Length2(atom_a.GetPos()-atom_b.GetPos());
-      if (max_sqr<d) {
-        continue;
-      }
-      if (!only_complete) {
-        in_ref+=1.0;
-      }
+    if (!only_complete) {
+      in_ref+=1.0;
+    }
 
-      AtomView atom_c=mdl.FindAtom(atom_a.GetResidue().GetChain().GetName(),
-                                   atom_a.GetResidue().GetNumber(), "CA");
-      if (!atom_c.IsValid()) {
-        continue;
-      }
-      AtomView atom_d=mdl.FindAtom(atom_b.GetResidue().GetChain().GetName(),
-                                   atom_b.GetResidue().GetNumber(), "CA");
-      if (!atom_d.IsValid()) {
-        continue;
-      }
-      if (only_complete) {
-        in_ref+=1.0;
-      }
-      in_mdl+=Reward(sqrt(d), geom::Length(atom_c.GetPos()-atom_d.GetPos()),
-                     tolerance);
+    AtomView atom_c=mdl.FindAtom(atom_a.GetResidue().GetChain().GetName(),
+                                 atom_a.GetResidue().GetNumber(), "CA");
+    if (!atom_c.IsValid()) {
+      continue;
+    }
+    AtomView atom_d=mdl.FindAtom(atom_b.GetResidue().GetChain().GetName(),
+                                 atom_b.GetResidue().GetNumber(), "CA");
+    if (!atom_d.IsValid()) {
+      continue;
+    }
+    if (only_complete) {
+      in_ref+=1.0;
     }
+    in_mdl+=Reward(sqrt(d), geom::Length(atom_c.GetPos()-atom_d.GetPos()),
+                   tolerance);
   }
   if (in_ref==0.0) {
     return 0.0;
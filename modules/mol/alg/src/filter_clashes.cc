@@ -18,6 +18,7 @@
 //------------------------------------------------------------------------------
 #include <ost/log.hh>
 #include <ost/mol/mol.hh>
+#include <ost/mol/neighbour_list.hh>
 #include <sstream>
 #include <iomanip>
 #include <math.h>
@@ -595,27 +596,38 @@ std::pair<EntityView,ClashingInfo> FilterClashes(const EntityView& ent, const Cl
   LOG_INFO("Filtering non-bonded clashes")
   EntityView filtered=ent.CreateEmptyView();
   ResidueViewList residues=ent.GetResidueList();
+  // all candidate pairs are searched in one go. The atoms are visited in the 
+  // order of the atom list, so the pairs of the current atom directly follow 
+  // the ones of the atoms before.
+  AtomViewList all_atoms=ent.GetAtomList();
+  IndexPairList pairs;
+  FindAllPairsWithin(ent, ent, min_distances.GetMaxAdjustedDistance(), pairs);
+  IndexPairList::const_iterator next_pair=pairs.begin();
+  uint32_t atom_index=0;
   for (ResidueViewList::iterator 
        i=residues.begin(), e=residues.end(); i!=e; ++i) {
     bool remove_sc=false, remove_bb=false;
     ResidueView res=*i;
+    const AtomViewList& atoms=res.GetAtomList();
     if (res.GetOneLetterCode()=='?') {
       filtered.AddResidue(res, ViewAddFlag::INCLUDE_ATOMS);
+      atom_index+=atoms.size();
       continue;
     }  
-    const AtomViewList& atoms=res.GetAtomList();
     for (AtomViewList::const_iterator 
-         j=atoms.begin(), e2=atoms.end(); j!=e2; ++j) {
+         j=atoms.begin(), e2=atoms.end(); j!=e2; ++j, ++atom_index) {
       AtomView atom=*j;
 
       String ele1=atom.GetElement();
       if (ele1=="H" || ele1=="D") {
         continue;
       }
-      AtomViewList within=ent.FindWithin(atom.GetPos(),min_distances.GetMaxAdjustedDistance());
-      for (AtomViewList::iterator 
-           k=within.begin(), e3=within.end(); k!=e3; ++k) {
-        AtomView atom2=*k;
+      while (next_pair!=pairs.end() && next_pair->first<atom_index) {
+        ++next_pair;
+      }
+      for (IndexPairList::const_iterator 
+           k=next_pair, e3=pairs.end(); k!=e3 && k->first==atom_index; ++k) {
+        AtomView atom2=all_atoms[k->second];
         if (atom2==atom) {
           continue;
         }
@@ -1,7 +1,11 @@
 #include <iomanip>
 #include <sstream>
+#include <fstream>
+#include <limits>
 #include <ost/log.hh>
+#include <ost/parallel_for.hh>
 #include <ost/mol/mol.hh>
+#include <ost/mol/neighbour_list.hh>
 #include <ost/platform.hh>
 #include "local_dist_diff_test.hh"
 #include <boost/concept_check.hpp>
@@ -24,6 +28,53 @@ String vector_to_string(std::vector<Real> vec) {
   return str.str();
 }
 
+// atoms of ref within max_dist of each atom of ref, or all atoms of ref if 
+// max_dist is negative. The pairs are searched once for the whole view.
+class RefNeighbours {
+public:
+  RefNeighbours(const EntityView& ref, Real max_dist): 
+    atoms_(ref.GetAtomList()), all_(max_dist<0) 
+  {
+    if (all_) {
+      return;
+    }
+    FindAllPairsWithin(ref, ref, max_dist, pairs_);
+    first_pair_.assign(atoms_.size()+1, pairs_.size());
+    for (size_t i=pairs_.size(); i>0; --i) {
+      first_pair_[pairs_[i-1].first]=i-1;
+    }
+    for (size_t i=atoms_.size(); i>0; --i) {
+      first_pair_[i-1]=std::min(first_pair_[i-1], first_pair_[i]);
+    }
+    for (size_t i=0; i<atoms_.size(); ++i) {
+      indices_[atoms_[i].GetHashCode()]=i;
+    }
+  }
+
+  void Get(const AtomView& atom, AtomViewList& within) const
+  {
+    if (all_) {
+      within=atoms_;
+      return;
+    }
+    within.clear();
+    std::map<long, size_t>::const_iterator i=indices_.find(atom.GetHashCode());
+    if (i==indices_.end()) {
+      return;
+    }
+    for (size_t j=first_pair_[i->second]; j<first_pair_[i->second+1]; ++j) {
+      within.push_back(atoms_[pairs_[j].second]);
+    }
+  }
+private:
+  AtomViewList           atoms_;
+  bool                   all_;
+  IndexPairList          pairs_;
+  // pairs of atom i are [first_pair_[i], first_pair_[i+1])
+  std::vector<size_t>    first_pair_;
+  std::map<long, size_t> indices_;
+};
+
 // helper function
 bool within_tolerance(Real mdl_dist, const std::pair<Real,Real>& values, Real tol)
 {
@@ -616,21 +667,17 @@ GlobalRDMap CreateDistanceList(const EntityView& ref,Real max_dist)
    return dist_list;
  }
  ResidueViewList ref_residues=ref.GetChainList()[0].GetResidueList(); 
+ RefNeighbours neighbours(ref, max_dist);
  for (ResidueViewList::iterator i=ref_residues.begin(), e=ref_residues.end(); i!=e; ++i) {
    if (IsStandardResidue(i->GetName())) {
      ResidueRDMap res_dist_list;
      ResNum rnum = i->GetNumber();  
      AtomViewList ref_atoms=i->GetAtomList();
      AtomViewList within;
-     if (max_dist<0){
-       within=ref.GetAtomList();
-     }  
      for (AtomViewList::iterator ai=ref_atoms.begin(), ae=ref_atoms.end(); ai!=ae; ++ai) {
        UniqueAtomIdentifier first_atom(ai->GetResidue().GetChain().GetName(),ai->GetResidue().GetNumber(),ai->GetResidue().GetName(),ai->GetName());
        if (ai->GetElement()=="H") { continue; }
-       if (max_dist>=0){ 
-         within=ref.FindWithin(ai->GetPos(), max_dist);
-       }
+       neighbours.Get(*ai, within);
        for (AtomViewList::iterator aj=within.begin(), ae2=within.end(); aj!=ae2; ++aj) {      
          UniqueAtomIdentifier second_atom(aj->GetResidue().GetChain().GetName(),aj->GetResidue().GetNumber(),aj->GetResidue().GetName(),aj->GetName());
          if (aj->GetElement()=="H" ||
@@ -769,6 +816,547 @@ Real LocalDistDiffTest(const EntityView& v,
   return lddt;
 }
 
+struct lDDTDistanceTable::Lookup {
+  std::map<ResNum, uint32_t>                      residues;
+  std::map<std::pair<uint32_t, String>, uint32_t> atoms;
+  std::map<String, uint16_t>                      names;
+};
+
+lDDTDistanceTable::lDDTDistanceTable():
+  sequence_separation_(0), offsets_(1, 0)
+{ }
+
+lDDTDistanceTable::lDDTDistanceTable(const GlobalRDMap& glob_dist_list,
+                                     int sequence_separation):
+  sequence_separation_(sequence_separation)
+{
+  Lookup lookup;
+  for (GlobalRDMap::const_iterator i=glob_dist_list.begin(),
+       e=glob_dist_list.end(); i!=e; ++i) {
+    this->residue_index(i->first, lookup);
+  }
+  offsets_.reserve(residues_.size()+1);
+  offsets_.push_back(0);
+  for (GlobalRDMap::const_iterator i=glob_dist_list.begin(),
+       e=glob_dist_list.end(); i!=e; ++i) {
+    uint32_t res_a=lookup.residues[i->first];
+    for (ResidueRDMap::const_iterator j=i->second.begin(), 
+         e2=i->second.end(); j!=e2; ++j) {
+      const UniqueAtomIdentifier& first_atom=j->first.first;
+      const UniqueAtomIdentifier& second_atom=j->first.second;
+      uint32_t res_b=this->residue_index(second_atom.GetResNum(), lookup);
+      uint32_t atom_a=this->atom_index(res_a, first_atom.GetAtomName(), lookup);
+      uint32_t atom_b=this->atom_index(res_b, second_atom.GetAtomName(), 
+                                       lookup);
+      this->add_distance(atom_a, first_atom.GetResNum(), atom_b, 
+                         second_atom.GetResNum(), second_atom.GetResidueName(),
+                         j->second.first, j->second.second);
+    }
+    offsets_.push_back(distances_.size());
+  }
+}
+
+lDDTDistanceTable::lDDTDistanceTable(const EntityView& ref, Real max_dist,
+                                     int sequence_separation):
+  sequence_separation_(sequence_separation)
+{
+  offsets_.push_back(0);
+  if (!ref.GetChainCount()) {
+    return;
+  }
+  // same distances as in CreateDistanceList, but without going through the 
+  // GlobalRDMap.
+  ChainView chain=ref.GetChainList()[0];
+  ResidueViewList ref_residues=chain.GetResidueList();
+  std::map<ResNum, ResidueView> assessed;
+  for (ResidueViewList::iterator i=ref_residues.begin(), 
+       e=ref_residues.end(); i!=e; ++i) {
+    if (IsStandardResidue(i->GetName())) {
+      assessed[i->GetNumber()]=*i;
+    }
+  }
+  Lookup lookup;
+  for (std::map<ResNum, ResidueView>::iterator i=assessed.begin(), 
+       e=assessed.end(); i!=e; ++i) {
+    this->residue_index(i->first, lookup);
+  }
+  offsets_.reserve(residues_.size()+1);
+  RefNeighbours neighbours(ref, max_dist);
+  AtomViewList within;
+  for (std::map<ResNum, ResidueView>::iterator i=assessed.begin(), 
+       e=assessed.end(); i!=e; ++i) {
+    uint32_t res_a=lookup.residues[i->first];
+    AtomViewList ref_atoms=i->second.GetAtomList();
+    for (AtomViewList::iterator ai=ref_atoms.begin(), 
+         ae=ref_atoms.end(); ai!=ae; ++ai) {
+      if (ai->GetElement()=="H") { 
+        continue; 
+      }
+      uint32_t atom_a=this->atom_index(res_a, ai->GetName(), lookup);
+      geom::Vec3 pos_a=ai->GetPos();
+      neighbours.Get(*ai, within);
+      for (AtomViewList::iterator aj=within.begin(), 
+           ae2=within.end(); aj!=ae2; ++aj) {
+        ResidueView res_b=aj->GetResidue();
+        if (aj->GetElement()=="H" || res_b.GetChain()!=chain) {
+          continue;
+        }
+        uint32_t atom_b=this->atom_index(this->residue_index(res_b.GetNumber(),
+                                                             lookup),
+                                         aj->GetName(), lookup);
+        Real dist=geom::Length(pos_a-aj->GetPos());
+        this->add_distance(atom_a, i->first, atom_b, res_b.GetNumber(), 
+                           res_b.GetName(), dist, dist);
+      }
+    }
+    offsets_.push_back(distances_.size());
+  }
+}
+
+uint32_t lDDTDistanceTable::residue_index(const ResNum& rnum, Lookup& lookup)
+{
+  std::map<ResNum, uint32_t>::iterator i=lookup.residues.find(rnum);
+  if (i!=lookup.residues.end()) {
+    return i->second;
+  }
+  uint32_t index=residues_.size();
+  lookup.residues[rnum]=index;
+  residues_.push_back(rnum);
+  return index;
+}
+
+uint16_t lDDTDistanceTable::name_index(const String& name, Lookup& lookup)
+{
+  std::map<String, uint16_t>::iterator i=lookup.names.find(name);
+  if (i!=lookup.names.end()) {
+    return i->second;
+  }
+  if (names_.size()>=std::numeric_limits<uint16_t>::max()) {
+    throw Error("too many distinct atom names for lDDT distance table");
+  }
+  uint16_t index=names_.size();
+  lookup.names[name]=index;
+  names_.push_back(name);
+  return index;
+}
+
+uint32_t lDDTDistanceTable::atom_index(uint32_t residue, const String& name,
+                                       Lookup& lookup)
+{
+  std::pair<uint32_t, String> key(residue, name);
+  std::map<std::pair<uint32_t, String>, uint32_t>::iterator i=
+      lookup.atoms.find(key);
+  if (i!=lookup.atoms.end()) {
+    return i->second;
+  }
+  Atom atom;
+  atom.residue=residue;
+  atom.name=this->name_index(name, lookup);
+  atom.swapped_name=this->name_index(SwappedName(name), lookup);
+  uint32_t index=atoms_.size();
+  lookup.atoms[key]=index;
+  atoms_.push_back(atom);
+  return index;
+}
+
+void lDDTDistanceTable::add_distance(uint32_t atom_a, const ResNum& rnum_a, 
+                                     uint32_t atom_b, const ResNum& rnum_b, 
+                                     const String& rname_b, Real min_dist,
+                                     Real max_dist)
+{
+  int rnum1=rnum_a.GetNum();
+  int rnum2=rnum_b.GetNum();
+  // distances within the sequence separation are neither scored nor used to
+  // resolve ambiguous atom names.
+  if (std::abs(rnum1-rnum2)<=sequence_separation_) {
+    return;
+  }
+  Distance d;
+  d.atom_a=atom_a;
+  d.atom_b=atom_b;
+  d.min_dist=min_dist;
+  d.max_dist=max_dist;
+  d.scored=rnum1>rnum2+sequence_separation_;
+  d.fixed=!Swappable(rname_b, names_[atoms_[atom_b].name]);
+  distances_.push_back(d);
+}
+
+namespace {
+
+const uint32_t LDDT_TABLE_MAGIC=0x5444444c;
+const uint8_t LDDT_TABLE_VERSION=1;
+
+template <typename T>
+void write_value(std::ofstream& out_stream, T value)
+{
+  out_stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T read_value(std::ifstream& in_stream)
+{
+  T value=T();
+  in_stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+  return value;
+}
+
+}
+
+void lDDTDistanceTable::Save(const String& filename) const
+{
+  std::ofstream out_stream(filename.c_str(), std::ios::binary);
+  if (!out_stream) {
+    throw Error("could not open '"+filename+"' for writing");
+  }
+  write_value<uint32_t>(out_stream, LDDT_TABLE_MAGIC);
+  write_value<uint8_t>(out_stream, LDDT_TABLE_VERSION);
+  write_value<int32_t>(out_stream, sequence_separation_);
+  write_value<uint32_t>(out_stream, residues_.size());
+  for (std::vector<ResNum>::const_iterator i=residues_.begin(), 
+       e=residues_.end(); i!=e; ++i) {
+    write_value<int32_t>(out_stream, i->GetNum());
+    write_value<char>(out_stream, i->GetInsCode());
+  }
+  write_value<uint32_t>(out_stream, names_.size());
+  for (std::vector<String>::const_iterator i=names_.begin(), 
+       e=names_.end(); i!=e; ++i) {
+    write_value<uint8_t>(out_stream, i->size());
+    out_stream.write(i->c_str(), i->size());
+  }
+  write_value<uint32_t>(out_stream, atoms_.size());
+  for (std::vector<Atom>::const_iterator i=atoms_.begin(), 
+       e=atoms_.end(); i!=e; ++i) {
+    write_value<uint32_t>(out_stream, i->residue);
+    write_value<uint16_t>(out_stream, i->name);
+    write_value<uint16_t>(out_stream, i->swapped_name);
+  }
+  write_value<uint32_t>(out_stream, offsets_.size());
+  out_stream.write(reinterpret_cast<const char*>(&offsets_.front()),
+                   sizeof(uint32_t)*offsets_.size());
+  write_value<uint32_t>(out_stream, distances_.size());
+  for (std::vector<Distance>::const_iterator i=distances_.begin(), 
+       e=distances_.end(); i!=e; ++i) {
+    write_value<uint32_t>(out_stream, i->atom_a);
+    write_value<uint32_t>(out_stream, i->atom_b);
+    write_value<float>(out_stream, i->min_dist);
+    write_value<float>(out_stream, i->max_dist);
+    write_value<uint8_t>(out_stream, (i->scored ? 1 : 0) | (i->fixed ? 2 : 0));
+  }
+  if (!out_stream) {
+    throw Error("error while writing lDDT distance table to '"+filename+"'");
+  }
+}
+
+lDDTDistanceTable lDDTDistanceTable::Load(const String& filename)
+{
+  std::ifstream in_stream(filename.c_str(), std::ios::binary);
+  if (!in_stream) {
+    std::stringstream ss;
+    ss << "the file '" << filename << "' does not exist.";
+    throw Error(ss.str());
+  }
+  if (read_value<uint32_t>(in_stream)!=LDDT_TABLE_MAGIC) {
+    std::stringstream ss;
+    ss << "Could not read magic number in " << filename << ". Either the file ";
+    ss << "is corrupt or does not contain a lDDT distance table.";
+    throw Error(ss.str());
+  }
+  uint8_t version=read_value<uint8_t>(in_stream);
+  if (version!=LDDT_TABLE_VERSION) {
+    std::stringstream ss;
+    ss << "lDDT distance table in " << filename << " is of version " 
+       << int(version) << " but only version " << int(LDDT_TABLE_VERSION)
+       << " can be read.";
+    throw Error(ss.str());
+  }
+  lDDTDistanceTable table;
+  table.sequence_separation_=read_value<int32_t>(in_stream);
+  uint32_t num_residues=read_value<uint32_t>(in_stream);
+  for (uint32_t i=0; i<num_residues && in_stream; ++i) {
+    int num=read_value<int32_t>(in_stream);
+    char ins_code=read_value<char>(in_stream);
+    table.residues_.push_back(ResNum(num, ins_code));
+  }
+  uint32_t num_names=read_value<uint32_t>(in_stream);
+  for (uint32_t i=0; i<num_names && in_stream; ++i) {
+    String name(read_value<uint8_t>(in_stream), ' ');
+    in_stream.read(&name[0], name.size());
+    table.names_.push_back(name);
+  }
+  uint32_t num_atoms=read_value<uint32_t>(in_stream);
+  for (uint32_t i=0; i<num_atoms && in_stream; ++i) {
+    Atom atom;
+    atom.residue=read_value<uint32_t>(in_stream);
+    atom.name=read_value<uint16_t>(in_stream);
+    atom.swapped_name=read_value<uint16_t>(in_stream);
+    if (atom.residue>=num_residues || atom.name>=num_names || 
+        atom.swapped_name>=num_names) {
+      in_stream.setstate(std::ios::failbit);
+    }
+    table.atoms_.push_back(atom);
+  }
+  uint32_t num_offsets=read_value<uint32_t>(in_stream);
+  if (in_stream && (num_offsets==0 || num_offsets>num_residues+1)) {
+    in_stream.setstate(std::ios::failbit);
+  }
+  if (in_stream) {
+    table.offsets_.resize(num_offsets);
+    in_stream.read(reinterpret_cast<char*>(&table.offsets_.front()),
+                   sizeof(uint32_t)*num_offsets);
+  }
+  uint32_t num_distances=read_value<uint32_t>(in_stream);
+  if (in_stream) {
+    table.distances_.reserve(num_distances);
+  }
+  for (uint32_t i=0; i<num_distances && in_stream; ++i) {
+    Distance d;
+    d.atom_a=read_value<uint32_t>(in_stream);
+    d.atom_b=read_value<uint32_t>(in_stream);
+    d.min_dist=read_value<float>(in_stream);
+    d.max_dist=read_value<float>(in_stream);
+    uint8_t flags=read_value<uint8_t>(in_stream);
+    d.scored=(flags & 1)!=0;
+    d.fixed=(flags & 2)!=0;
+    if (d.atom_a>=num_atoms || d.atom_b>=num_atoms) {
+      in_stream.setstate(std::ios::failbit);
+    }
+    table.distances_.push_back(d);
+  }
+  // Score walks the distances of residue i from offsets_[i] to offsets_[i+1],
+  // so the offsets must not decrease. Only the assessed residues come in
+  // order, partners outside of them are appended as they are met.
+  for (size_t i=1; i<table.offsets_.size() && in_stream; ++i) {
+    if (table.offsets_[i]<table.offsets_[i-1]) {
+      in_stream.setstate(std::ios::failbit);
+    }
+  }
+  if (!in_stream || table.offsets_.front()!=0 ||
+      table.offsets_.back()!=table.distances_.size()) {
+    std::stringstream ss;
+    ss << "lDDT distance table in " << filename << " is truncated or corrupt.";
+    throw Error(ss.str());
+  }
+  return table;
+}
+
+lDDTModelScore lDDTDistanceTable::Score(const EntityView& mdl,
+                                        const std::vector<Real>& cutoff_list) const
+{
+  lDDTModelScore score;
+  size_t num_assessed=offsets_.size()-1;
+  long int num_cutoffs=cutoff_list.size();
+  std::vector<std::pair<long int, long int> > overlap(residues_.size(), 
+                                              std::pair<long int, long int>(0, 0));
+  std::vector<ResidueView> mdl_res(residues_.size());
+  if (mdl.GetChainCount()) {
+    ChainView mdl_chain=mdl.GetChainList()[0];
+    for (size_t i=0; i<residues_.size(); ++i) {
+      mdl_res[i]=mdl_chain.FindResidue(residues_[i]);
+    }
+  }
+  // positions of the reference atoms in the model, as named in the model and 
+  // with the names of symmetric side-chain atoms swapped
+  std::vector<geom::Vec3> pos(atoms_.size()), swapped_pos(atoms_.size());
+  std::vector<char> has_pos(atoms_.size(), 0), has_swapped_pos(atoms_.size(), 0);
+  for (size_t i=0; i<atoms_.size(); ++i) {
+    const ResidueView& res=mdl_res[atoms_[i].residue];
+    if (!res) {
+      continue;
+    }
+    AtomView av=res.FindAtom(names_[atoms_[i].name]);
+    if (av) {
+      pos[i]=av.GetPos();
+      has_pos[i]=1;
+    }
+    if (atoms_[i].swapped_name!=atoms_[i].name) {
+      av=res.FindAtom(names_[atoms_[i].swapped_name]);
+    }
+    if (av) {
+      swapped_pos[i]=av.GetPos();
+      has_swapped_pos[i]=1;
+    }
+  }
+  // for residues with symmetric side-chains, pick the naming that conserves 
+  // more of the distances to unambiguous atoms, see check_and_swap.
+  std::vector<char> swapped(residues_.size(), 0);
+  for (size_t i=0; i<num_assessed; ++i) {
+    if (offsets_[i]==offsets_[i+1] || !mdl_res[i]) {
+      continue;
+    }
+    String rname=mdl_res[i].GetName();
+    if (!(rname=="GLU" || rname=="ASP" || rname=="VAL" || rname=="TYR" ||
+          rname=="PHE" || rname=="LEU" || rname=="ARG")) {
+      continue;
+    }
+    std::pair<long int, long int> ov1(0, 0), ov2(0, 0);
+    for (size_t j=offsets_[i]; j<offsets_[i+1]; ++j) {
+      const Distance& d=distances_[j];
+      if (!d.fixed) {
+        continue;
+      }
+      ov1.second+=num_cutoffs;
+      ov2.second+=num_cutoffs;
+      if (!has_pos[d.atom_b]) {
+        continue;
+      }
+      for (int k=0; k<2; ++k) {
+        const std::vector<char>& has_first=k==0 ? has_pos : has_swapped_pos;
+        if (!has_first[d.atom_a]) {
+          continue;
+        }
+        const geom::Vec3& first_pos=k==0 ? pos[d.atom_a] : swapped_pos[d.atom_a];
+        Real mdl_dist=geom::Length(first_pos-pos[d.atom_b]);
+        std::pair<long int, long int>& ov=k==0 ? ov1 : ov2;
+        for (std::vector<Real>::const_reverse_iterator t=cutoff_list.rbegin(),
+             te=cutoff_list.rend(); t!=te; ++t) {
+          if (!within_tolerance(mdl_dist, std::make_pair(d.min_dist, d.max_dist), 
+                                *t)) {
+            break;
+          }
+          ov.first+=1;
+        }
+      }
+    }
+    swapped[i]=static_cast<Real>(ov1.first)/ov1.second<
+               static_cast<Real>(ov2.first)/ov2.second;
+  }
+  for (size_t i=0; i<atoms_.size(); ++i) {
+    uint32_t r=atoms_[i].residue;
+    if (swapped[r] && Swappable(mdl_res[r].GetName(), 
+                                names_[atoms_[i].name])) {
+      pos[i]=swapped_pos[i];
+      has_pos[i]=has_swapped_pos[i];
+    }
+  }
+  for (size_t i=0; i<num_assessed; ++i) {
+    for (size_t j=offsets_[i]; j<offsets_[i+1]; ++j) {
+      const Distance& d=distances_[j];
+      if (!d.scored) {
+        continue;
+      }
+      score.total_dist+=num_cutoffs;
+      if (mdl_res[i]) {
+        overlap[i].second+=num_cutoffs;
+      }
+      uint32_t r2=atoms_[d.atom_b].residue;
+      if (!mdl_res[r2]) {
+        continue;
+      }
+      overlap[r2].second+=num_cutoffs;
+      if (!(has_pos[d.atom_a] && has_pos[d.atom_b])) {
+        continue;
+      }
+      Real mdl_dist=geom::Length(pos[d.atom_a]-pos[d.atom_b]);
+      for (std::vector<Real>::const_reverse_iterator t=cutoff_list.rbegin(),
+           te=cutoff_list.rend(); t!=te; ++t) {
+        if (!within_tolerance(mdl_dist, std::make_pair(d.min_dist, d.max_dist), 
+                              *t)) {
+          break;
+        }
+        score.conserved_dist+=1;
+        overlap[i].first+=1;
+        overlap[r2].first+=1;
+      }
+    }
+  }
+  score.global_score=static_cast<Real>(score.conserved_dist)/
+                     (score.total_dist ? score.total_dist : 1);
+  // per-residue statistics, laid out like GetlDDTPerResidueStats
+  ChainViewList chains=mdl.GetChainList();
+  for (ChainViewList::const_iterator ci=chains.begin(), 
+       ce=chains.end(); ci!=ce; ++ci) {
+    ResidueViewList residues=ci->GetResidueList();
+    for (ResidueViewList::const_iterator rit=residues.begin(),
+         re=residues.end(); rit!=re; ++rit) {
+      String quality_problems_string="NA";
+      if (rit->HasProp("stereo_chemical_violation_sidechain") || 
+          rit->HasProp("steric_clash_sidechain")) {
+        quality_problems_string="Yes";
+      }
+      if (rit->HasProp("stereo_chemical_violation_backbone") || 
+          rit->HasProp("steric_clash_backbone")) {
+        quality_problems_string="Yes+";
+      }
+      std::vector<ResNum>::const_iterator k=
+          std::lower_bound(residues_.begin(), residues_.begin()+num_assessed,
+                           rit->GetNumber());
+      if (k==residues_.begin()+num_assessed || *k!=rit->GetNumber()) {
+        score.local_scores.push_back(lDDTLocalScore(ci->GetName(), 
+                                                    rit->GetName(),
+                                                    rit->GetNumber().GetNum(),
+                                                    "No", 
+                                                    quality_problems_string,
+                                                    -1, -1, -1));
+        continue;
+      }
+      size_t index=k-residues_.begin();
+      Real local_lddt=0.0;
+      int conserved_dist=0, total_dist=0;
+      if (ci==chains.begin() && mdl_res[index]==*rit) {
+        conserved_dist=overlap[index].first;
+        total_dist=overlap[index].second;
+        local_lddt=static_cast<Real>(conserved_dist)/
+                   (total_dist ? total_dist : 1);
+      }
+      score.local_scores.push_back(lDDTLocalScore(ci->GetName(), 
+                                                  rit->GetName(),
+                                                  rit->GetNumber().GetNum(),
+                                                  "Yes", 
+                                                  quality_problems_string,
+                                                  local_lddt, conserved_dist,
+                                                  total_dist));
+    }
+  }
+  return score;
+}
+
+lDDTModelScore LocalDistDiffTest(const EntityView& mdl, 
+                                 const lDDTDistanceTable& dist_table,
+                                 const std::vector<Real>& cutoff_list)
+{
+  return dist_table.Score(mdl, cutoff_list);
+}
+
+namespace {
+
+// scores the models of a chunk. The models are handed out one at a time,
+// since the cost of scoring varies a lot with the model size.
+class ModelScorer {
+public:
+  ModelScorer(const std::vector<EntityView>& models, 
+              const lDDTDistanceTable& dist_table,
+              const std::vector<Real>& cutoff_list,
+              std::vector<lDDTModelScore>& scores):
+    models_(models), dist_table_(dist_table), cutoff_list_(cutoff_list),
+    scores_(scores)
+  { }
+
+  void operator()(size_t begin, size_t end)
+  {
+    for (size_t i=begin; i<end; ++i) {
+      scores_[i]=dist_table_.Score(models_[i], cutoff_list_);
+    }
+  }
+private:
+  const std::vector<EntityView>& models_;
+  const lDDTDistanceTable&       dist_table_;
+  const std::vector<Real>&       cutoff_list_;
+  std::vector<lDDTModelScore>&   scores_;
+};
+
+}
+
+std::vector<lDDTModelScore> LocalDistDiffTest(const std::vector<EntityView>& models, 
+                                              const lDDTDistanceTable& dist_table,
+                                              const std::vector<Real>& cutoff_list, 
+                                              int num_threads)
+{
+  std::vector<lDDTModelScore> scores(models.size());
+  ParallelForChunks(models.size(), 1, num_threads,
+                    ModelScorer(models, dist_table, cutoff_list, scores));
+  return scores;
+}
+
 Real LocalDistDiffTest(const ost::seq::AlignmentHandle& aln,
                    Real cutoff, Real max_dist, int ref_index, int mdl_index)
 {
@@ -859,6 +1447,20 @@ GlobalRDMap PreparelDDTGlobalRDMap(const std::vector<EntityView>& ref_list,
   return glob_dist_list;
 }
 
+lDDTDistanceTable CreateDistanceTable(const std::vector<EntityView>& ref_list,
+                                      std::vector<Real>& cutoff_list,
+                                      int sequence_separation,
+                                      Real max_dist)
+{
+  if (ref_list.size()==1) {
+    return lDDTDistanceTable(ref_list[0], max_dist, sequence_separation);
+  }
+  return lDDTDistanceTable(PreparelDDTGlobalRDMap(ref_list, cutoff_list,
+                                                  sequence_separation,
+                                                  max_dist),
+                           sequence_separation);
+}
+
 void CheckStructure(EntityView& ent,
                     StereoChemicalParams& bond_table,
                     StereoChemicalParams& angle_table,
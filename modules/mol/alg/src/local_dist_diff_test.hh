@@ -19,6 +19,7 @@
 #ifndef OST_MOL_ALG_LOCAL_DIST_TEST_HH
 #define OST_MOL_ALG_LOCAL_DIST_TEST_HH
 
+#include <ost/stdint.hh>
 #include <ost/mol/alg/module_config.hh>
 #include <ost/mol/entity_handle.hh>
 #include <ost/seq/alignment_handle.hh>
@@ -116,6 +117,110 @@ class lDDTScorer
     void _PrepareGlobalRDMap();
 };
 
+/// \brief Global and per-residue scores of a model, as computed from a
+///        lDDTDistanceTable
+struct DLLEXPORT_OST_MOL_ALG lDDTModelScore {
+  lDDTModelScore(): conserved_dist(0), total_dist(0), global_score(0.0) {}
+
+  // number of conserved distances in the model
+  long int conserved_dist;
+  // number of total distances in the reference structure
+  long int total_dist;
+  Real global_score;
+  // one entry for each residue of the model, same as GetlDDTPerResidueStats
+  std::vector<lDDTLocalScore> local_scores;
+};
+
+/// \brief Packed representation of a global distance list
+///
+/// The distances of a GlobalRDMap are resolved once into contiguous arrays of 
+/// atom indices and distance ranges, grouped by residue and sorted by residue 
+/// number. Atom names are pooled. Distances that are neither scored nor used 
+/// to resolve ambiguous atom naming for the given sequence separation are 
+/// dropped. Scoring a model then boils down to a single lookup per reference 
+/// atom and a linear scan over the distances, instead of a map traversal and 
+/// atom lookup per distance. The table is immutable after construction and may
+/// be shared between threads.
+///
+/// For a single reference, the table can be built directly from the structure,
+/// without creating the much larger GlobalRDMap first. Tables can be saved to 
+/// and loaded from disk to avoid rebuilding them for every run.
+///
+/// Scores are identical to the ones obtained by LocalDistDiffTest for the same
+/// distance list, cutoffs and sequence separation. In contrast to 
+/// LocalDistDiffTest, the atoms of residues with symmetric side-chains are not
+/// renamed in the model and no residue properties are set.
+class DLLEXPORT_OST_MOL_ALG lDDTDistanceTable {
+public:
+  lDDTDistanceTable();
+
+  lDDTDistanceTable(const GlobalRDMap& glob_dist_list,
+                    int sequence_separation=0);
+
+  /// \brief create table for a single reference structure
+  ///
+  /// Contains the same distances as the GlobalRDMap returned by 
+  /// CreateDistanceList for ref and max_dist.
+  lDDTDistanceTable(const EntityView& ref, Real max_dist,
+                    int sequence_separation=0);
+
+  /// \brief score model against the distances of the table
+  ///
+  /// Only the first chain of the model is considered, with residues being 
+  /// matched by residue number and atoms by name.
+  lDDTModelScore Score(const EntityView& mdl, 
+                       const std::vector<Real>& cutoff_list) const;
+
+  /// \brief number of distances in the table
+  size_t GetDistanceCount() const { return distances_.size(); }
+
+  /// \brief number of residues for which distances are checked
+  size_t GetResidueCount() const { return offsets_.size()-1; }
+
+  int GetSequenceSeparation() const { return sequence_separation_; }
+
+  /// \brief save table in binary format
+  void Save(const String& filename) const;
+
+  /// \brief load table saved with Save()
+  static lDDTDistanceTable Load(const String& filename);
+private:
+  struct Lookup;
+  struct Atom {
+    uint32_t residue;
+    // index into names_
+    uint16_t name;
+    uint16_t swapped_name;
+  };
+  struct Distance {
+    uint32_t atom_a;
+    uint32_t atom_b;
+    Real     min_dist;
+    Real     max_dist;
+    // distance contributes to the score
+    bool     scored;
+    // distance is used to resolve ambiguous atom naming
+    bool     fixed;
+  };
+
+  uint32_t residue_index(const ResNum& rnum, Lookup& lookup);
+  uint32_t atom_index(uint32_t residue, const String& name, Lookup& lookup);
+  uint16_t name_index(const String& name, Lookup& lookup);
+  void add_distance(uint32_t atom_a, const ResNum& rnum_a, uint32_t atom_b, 
+                    const ResNum& rnum_b, const String& rname_b, Real min_dist,
+                    Real max_dist);
+
+  int                   sequence_separation_;
+  // residues with distances come first and are sorted, followed by the 
+  // residues only referenced as second partner.
+  std::vector<ResNum>   residues_;
+  std::vector<String>   names_;
+  std::vector<Atom>     atoms_;
+  std::vector<Distance> distances_;
+  // distances of residue i are distances_[offsets_[i]:offsets_[i+1]]
+  std::vector<uint32_t> offsets_;
+};
+
 std::pair<int,int> DLLEXPORT_OST_MOL_ALG ComputeCoverage(const EntityView& v,const GlobalRDMap& glob_dist_list);
 
 bool DLLEXPORT_OST_MOL_ALG IsResnumInGlobalRDMap(const ResNum& resnum, const GlobalRDMap& glob_dist_list);
@@ -174,6 +279,27 @@ Real DLLEXPORT_OST_MOL_ALG LocalDistDiffTest(const EntityView& v,
                        const GlobalRDMap& glob_dist_list,
                        lDDTSettings& settings);
 
+/// \brief Calculates the Local Distance Difference Test score of a model from
+///        a precomputed distance table
+///
+/// Equivalent to calling lDDTDistanceTable::Score.
+lDDTModelScore DLLEXPORT_OST_MOL_ALG 
+LocalDistDiffTest(const EntityView& mdl, const lDDTDistanceTable& dist_table,
+                  const std::vector<Real>& cutoff_list);
+
+/// \brief Calculates the Local Distance Difference Test scores of multiple 
+///        models in parallel
+///
+/// The models are distributed over num_threads threads. If num_threads is 0,
+/// one thread per available core is used. The scores are returned in the order
+/// of the models. Since the table is only read, the reference distances are 
+/// computed only once for all of the models.
+std::vector<lDDTModelScore> DLLEXPORT_OST_MOL_ALG
+LocalDistDiffTest(const std::vector<EntityView>& models, 
+                  const lDDTDistanceTable& dist_table,
+                  const std::vector<Real>& cutoff_list, 
+                  int num_threads=0);
+
 /// \brief Calculates the Local Distance Difference Test score for a given model starting from an alignment between a reference structure and the model. 
 ///
 /// Calculates the Local Distance Difference Test score given an alignment between a model and a taget structure.
@@ -226,6 +352,17 @@ GlobalRDMap DLLEXPORT_OST_MOL_ALG CreateDistanceList(const EntityView& ref,Real
 /// dealing with the naming convention of residues with ambiguous nomenclature. 
 GlobalRDMap DLLEXPORT_OST_MOL_ALG CreateDistanceListFromMultipleReferences(const std::vector<EntityView>& ref_list,std::vector<Real>& cutoff_list, int sequence_separation, Real max_dist);
 
+/// \brief Creates a distance table to score models against a list of reference
+///        structures
+///
+/// For a single reference, the table is built directly from the structure.
+/// For multiple references, the distance list is created with 
+/// CreateDistanceListFromMultipleReferences and then packed.
+lDDTDistanceTable DLLEXPORT_OST_MOL_ALG 
+CreateDistanceTable(const std::vector<EntityView>& ref_list,
+                    std::vector<Real>& cutoff_list, int sequence_separation, 
+                    Real max_dist);
+
 /// \brief Prints all distances in a global distance list to standard output
 void DLLEXPORT_OST_MOL_ALG PrintGlobalRDMap(const GlobalRDMap& glob_dist_list);
 
@@ -0,0 +1,98 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_MOL_ALG_PARALLEL_FRAMES_HH
+#define OST_MOL_ALG_PARALLEL_FRAMES_HH
+
+#include <algorithm>
+#include <ost/parallel_for.hh>
+#include <ost/mol/coord_group.hh>
+
+namespace ost { namespace mol { namespace alg {
+
+/// \brief number of frames visited when going from frame from to frame to
+///        (exclusive) in steps of stride
+inline size_t StridedFrameCount(int from, int to, unsigned int stride)
+{
+  if (to<=from) {
+    return 0;
+  }
+  return (static_cast<size_t>(to-from)+stride-1)/stride;
+}
+
+/// \brief number of chunks the frames are split into by ForEachFrame
+inline size_t FrameChunkCount(size_t num_frames, size_t chunk_size)
+{
+  return (num_frames+chunk_size-1)/chunk_size;
+}
+
+namespace detail {
+
+// calls the functor for all frames of a chunk
+template <typename F>
+class FrameChunk {
+public:
+  FrameChunk(const CoordGroupHandle& traj, F& func, int from,
+             unsigned int stride, size_t chunk_size):
+    traj_(traj), func_(func), from_(from), stride_(stride),
+    chunk_size_(chunk_size)
+  { }
+
+  void operator()(size_t begin, size_t end)
+  {
+    size_t chunk=begin/chunk_size_;
+    for (size_t k=begin; k<end; ++k) {
+      CoordFramePtr frame=traj_.GetFrame(from_+k*stride_);
+      func_(chunk, k, *frame);
+    }
+  }
+private:
+  const CoordGroupHandle& traj_;
+  F&                      func_;
+  int                     from_;
+  unsigned int            stride_;
+  size_t                  chunk_size_;
+};
+
+}
+
+/// \brief calls func for every stride-th frame in [from, to) of traj
+///
+/// The frames are split into chunks of chunk_size consecutive frames which
+/// are distributed over num_threads threads. If num_threads is 0, one thread
+/// per core is used. For the k-th visited frame, func is called as
+/// func(chunk, k, frame) where chunk is the index of the chunk the frame
+/// belongs to. Since calls for different frames may happen concurrently,
+/// func must only write to per-frame or per-chunk results. The chunks don't
+/// depend on the number of threads, so reductions over per-chunk results give
+/// the same value for any number of threads.
+template <typename F>
+void ForEachFrame(const CoordGroupHandle& traj, F& func, int from, int to,
+                  unsigned int stride=1, int num_threads=1,
+                  size_t chunk_size=16)
+{
+  stride=std::max(1u, stride);
+  chunk_size=std::max(size_t(1), chunk_size);
+  ParallelForChunks(StridedFrameCount(from, to, stride), chunk_size,
+                    num_threads, detail::FrameChunk<F>(traj, func, from, stride,
+                                                       chunk_size));
+}
+
+}}}
+
+#endif
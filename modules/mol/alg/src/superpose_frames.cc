@@ -17,10 +17,13 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 //------------------------------------------------------------------------------
 
-#include <Eigen/Eigenvalues>
+#include <Eigen/SVD>
+#include <Eigen/LU>
 #include <ost/message.hh>
 #include <ost/mol/mol.hh>
+#include <ost/mol/in_mem_coord_source.hh>
 #include <ost/mol/alg/superpose_frames.hh>
+#include "parallel_frames.hh"
 
 namespace ost { namespace mol { namespace alg {
 
@@ -30,112 +33,215 @@ bool less_index(const mol::AtomHandle& a1, const mol::AtomHandle& a2)
   return a1.GetIndex()<a2.GetIndex();
 }
 
-}
-
-typedef Eigen::Matrix<Real, 3, 3> EMat3;
-typedef Eigen::Matrix<Real, 1, 3> ECVec3;
-typedef Eigen::Matrix<Real, 3, 1> ERVec3;
-typedef Eigen::Matrix<Real, 3, Eigen::Dynamic> EMat3X;
-typedef Eigen::Matrix<Real, Eigen::Dynamic, 3> EMatX3;
+// rigid transformation, p'=rot*p+shift
+struct FrameTransform {
+  geom::Vec3 Apply(const geom::Vec3& p) const { return rot*p+shift; }
+  geom::Mat3 rot;
+  geom::Vec3 shift;
+};
 
+typedef std::vector<FrameTransform> FrameTransformList;
 
-inline geom::Vec3 rvec_to_gvec(const ERVec3 &vec) {
-  return geom::Vec3(vec.data());
-}
-
-inline geom::Vec3 cvec_to_gvec(const ECVec3 &vec) {
-  return geom::Vec3(vec.data());
-}
-
-inline geom::Mat3 emat_to_gmat(const EMat3 &mat)
-{
-  return geom::Mat3(mat.data());
-}
+// centered positions of the atoms frames are superposed onto. They are kept 
+// in double precision and as separate coordinate arrays, which keeps the 
+// inner product loop in SuperposeOnto simple enough to be vectorized.
+struct SuperpositionTarget {
+  void Set(const std::vector<geom::Vec3>& pos)
+  {
+    size_t n=pos.size();
+    double cx=0.0, cy=0.0, cz=0.0;
+    for (size_t j=0; j<n; ++j) {
+      cx+=pos[j][0]; cy+=pos[j][1]; cz+=pos[j][2];
+    }
+    cx/=n; cy/=n; cz/=n;
+    x.resize(n); y.resize(n); z.resize(n);
+    g=0.0;
+    for (size_t j=0; j<n; ++j) {
+      x[j]=pos[j][0]-cx; y[j]=pos[j][1]-cy; z[j]=pos[j][2]-cz;
+      g+=x[j]*x[j]+y[j]*y[j]+z[j]*z[j];
+    }
+    center=geom::Vec3(cx, cy, cz);
+  }
+  std::vector<double> x, y, z;
+  double g;
+  geom::Vec3 center;
+};
 
-inline ERVec3 gvec_to_rvec(const geom::Vec3 &vec)
+geom::Mat3 to_mat3(const double r[9])
 {
-  return ERVec3(&vec[0]);
+  return geom::Mat3(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], r[8]);
 }
 
-inline ECVec3 gvec_to_cvec(const geom::Vec3 &vec)
+// Determines the rotation superposing the moving onto the target positions
+// with the quaternion characteristic polynomial method (Theobald, Acta Cryst 
+// A61, 2005; Liu et al., J Comput Chem 31, 2010). a is the inner product 
+// matrix, a[3*i+j] being the sum over target_i*moving_j, e0 is half the sum 
+// of the squared norms of both position sets. Returns false if the 
+// rotation is ill-defined, e.g. for collinear positions.
+bool QCPRotation(const double a[9], double e0, geom::Mat3& rot)
 {
-  return ECVec3(&vec[0]);
+  const double eval_prec=1e-11;
+  const double evec_prec=1e-6;
+  double sxx=a[0], sxy=a[1], sxz=a[2];
+  double syx=a[3], syy=a[4], syz=a[5];
+  double szx=a[6], szy=a[7], szz=a[8];
+  double sxx2=sxx*sxx, syy2=syy*syy, szz2=szz*szz;
+  double sxy2=sxy*sxy, syz2=syz*syz, sxz2=sxz*sxz;
+  double syx2=syx*syx, szy2=szy*szy, szx2=szx*szx;
+  double syzszymsyyszz2=2.0*(syz*szy-syy*szz);
+  double sxx2syy2szz2syz2szy2=syy2+szz2-sxx2+syz2+szy2;
+  double c2=-2.0*(sxx2+syy2+szz2+sxy2+syx2+sxz2+szx2+syz2+szy2);
+  double c1=8.0*(sxx*syz*szy+syy*szx*sxz+szz*sxy*syx-
+                 sxx*syy*szz-syz*szx*sxy-szy*syx*sxz);
+  double sxzpszx=sxz+szx, syzpszy=syz+szy, sxypsyx=sxy+syx;
+  double syzmszy=syz-szy, sxzmszx=sxz-szx, sxymsyx=sxy-syx;
+  double sxxpsyy=sxx+syy, sxxmsyy=sxx-syy;
+  double sxy2sxz2syx2szx2=sxy2+sxz2-syx2-szx2;
+  double c0=sxy2sxz2syx2szx2*sxy2sxz2syx2szx2
+    +(sxx2syy2szz2syz2szy2+syzszymsyyszz2)*(sxx2syy2szz2syz2szy2-syzszymsyyszz2)
+    +(-(sxzpszx)*(syzmszy)+(sxymsyx)*(sxxmsyy-szz))*
+     (-(sxzmszx)*(syzpszy)+(sxymsyx)*(sxxmsyy+szz))
+    +(-(sxzpszx)*(syzpszy)-(sxypsyx)*(sxxpsyy-szz))*
+     (-(sxzmszx)*(syzmszy)-(sxypsyx)*(sxxpsyy+szz))
+    +(+(sxypsyx)*(syzpszy)+(sxzpszx)*(sxxmsyy+szz))*
+     (-(sxymsyx)*(syzmszy)+(sxzpszx)*(sxxpsyy+szz))
+    +(+(sxypsyx)*(syzmszy)+(sxzmszx)*(sxxmsyy-szz))*
+     (-(sxymsyx)*(syzpszy)+(sxzmszx)*(sxxpsyy-szz));
+  // Newton-Raphson for the largest eigenvalue of the key matrix, starting 
+  // from its upper bound e0
+  double lambda=e0;
+  bool converged=false;
+  for (int i=0; i<50; ++i) {
+    double old_lambda=lambda;
+    double x2=lambda*lambda;
+    double b=(x2+c2)*lambda;
+    double aa=b+c1;
+    double delta=(aa*lambda+c0)/(2.0*x2*lambda+b+aa);
+    lambda-=delta;
+    if (std::abs(lambda-old_lambda)<std::abs(eval_prec*lambda)) {
+      converged=true;
+      break;
+    }
+  }
+  if (!converged) {
+    return false;
+  }
+  // the eigenvector is any non-zero column of the adjoint of the key matrix
+  // minus lambda times identity
+  double a11=sxxpsyy+szz-lambda, a12=syzmszy, a13=-sxzmszx, a14=sxymsyx;
+  double a21=syzmszy, a22=sxxmsyy-szz-lambda, a23=sxypsyx, a24=sxzpszx;
+  double a31=a13, a32=a23, a33=syy-sxx-szz-lambda, a34=syzpszy;
+  double a41=a14, a42=a24, a43=a34, a44=szz-sxxpsyy-lambda;
+  double a3344_4334=a33*a44-a43*a34, a3244_4234=a32*a44-a42*a34;
+  double a3243_4233=a32*a43-a42*a33, a3143_4133=a31*a43-a41*a33;
+  double a3144_4134=a31*a44-a41*a34, a3142_4132=a31*a42-a41*a32;
+  double q1= a22*a3344_4334-a23*a3244_4234+a24*a3243_4233;
+  double q2=-a21*a3344_4334+a23*a3144_4134-a24*a3143_4133;
+  double q3= a21*a3244_4234-a22*a3144_4134+a24*a3142_4132;
+  double q4=-a21*a3243_4233+a22*a3143_4133-a23*a3142_4132;
+  double qsqr=q1*q1+q2*q2+q3*q3+q4*q4;
+  if (qsqr<evec_prec) {
+    q1= a12*a3344_4334-a13*a3244_4234+a14*a3243_4233;
+    q2=-a11*a3344_4334+a13*a3144_4134-a14*a3143_4133;
+    q3= a11*a3244_4234-a12*a3144_4134+a14*a3142_4132;
+    q4=-a11*a3243_4233+a12*a3143_4133-a13*a3142_4132;
+    qsqr=q1*q1+q2*q2+q3*q3+q4*q4;
+  }
+  if (qsqr<evec_prec) {
+    double a1324_1423=a13*a24-a14*a23, a1224_1422=a12*a24-a14*a22;
+    double a1223_1322=a12*a23-a13*a22, a1124_1421=a11*a24-a14*a21;
+    double a1123_1321=a11*a23-a13*a21, a1122_1221=a11*a22-a12*a21;
+    q1= a42*a1324_1423-a43*a1224_1422+a44*a1223_1322;
+    q2=-a41*a1324_1423+a43*a1124_1421-a44*a1123_1321;
+    q3= a41*a1224_1422-a42*a1124_1421+a44*a1122_1221;
+    q4=-a41*a1223_1322+a42*a1123_1321-a43*a1122_1221;
+    qsqr=q1*q1+q2*q2+q3*q3+q4*q4;
+    if (qsqr<evec_prec) {
+      q1= a32*a1324_1423-a33*a1224_1422+a34*a1223_1322;
+      q2=-a31*a1324_1423+a33*a1124_1421-a34*a1123_1321;
+      q3= a31*a1224_1422-a32*a1124_1421+a34*a1122_1221;
+      q4=-a31*a1223_1322+a32*a1123_1321-a33*a1122_1221;
+      qsqr=q1*q1+q2*q2+q3*q3+q4*q4;
+    }
+  }
+  if (qsqr<evec_prec) {
+    return false;
+  }
+  double norm=sqrt(qsqr);
+  q1/=norm; q2/=norm; q3/=norm; q4/=norm;
+  double a2=q1*q1, x2=q2*q2, y2=q3*q3, z2=q4*q4;
+  double xy=q2*q3, az=q1*q4, zx=q4*q2, ay=q1*q3, yz=q3*q4, ax=q1*q2;
+  double r[9]={a2+x2-y2-z2, 2*(xy+az),    2*(zx-ay),
+               2*(xy-az),    a2-x2+y2-z2, 2*(yz+ax),
+               2*(zx+ay),    2*(yz-ax),    a2-x2-y2+z2};
+  rot=to_mat3(r);
+  return true;
 }
 
-inline EMat3X row_sub(const EMat3X& m, const ERVec3& s)
+// Kabsch rotation from the singular value decomposition of the inner product
+// matrix. Only used when QCPRotation can't determine the rotation.
+geom::Mat3 SVDRotation(const double a[9])
 {
-  EMat3X r(m);
-  for (int col=0;  col<m.cols();++col) {
-    r.col(col)-=s;
+  Eigen::Matrix3d h;
+  for (int i=0; i<3; ++i) {
+    for (int j=0; j<3; ++j) {
+      h(i, j)=a[3*j+i];
+    }
+  }
+  Eigen::JacobiSVD<Eigen::Matrix3d> svd(h, Eigen::ComputeFullU | 
+                                           Eigen::ComputeFullV);
+  Eigen::Matrix3d d=Eigen::Matrix3d::Identity();
+  if ((svd.matrixV()*svd.matrixU().transpose()).determinant()<0) {
+    d(2, 2)=-1;
   }
-  return r;
+  Eigen::Matrix3d e_rot=svd.matrixV()*d*svd.matrixU().transpose();
+  double r[9];
+  for (int i=0; i<3; ++i) {
+    for (int j=0; j<3; ++j) {
+      r[3*i+j]=e_rot(i, j);
+    }
+  }
+  return to_mat3(r);
 }
 
-inline EMatX3 col_sub(const EMatX3& m, const ECVec3& s)
+// returns the transformation superposing the selected atoms of the frame onto
+// the target
+FrameTransform SuperposeOnto(const CoordFrame& frame, 
+                             const std::vector<unsigned long>& indices,
+                             const SuperpositionTarget& target)
 {
-  EMatX3 r(m);
-  for (int row=0;  row<m.rows();++row) {
-    r.row(row)-=s;
+  size_t n=indices.size();
+  std::vector<double> x(n), y(n), z(n);
+  double cx=0.0, cy=0.0, cz=0.0;
+  for (size_t j=0; j<n; ++j) {
+    const geom::Vec3& p=frame[indices[j]];
+    x[j]=p[0]; y[j]=p[1]; z[j]=p[2];
+    cx+=x[j]; cy+=y[j]; cz+=z[j];
+  }
+  cx/=n; cy/=n; cz/=n;
+  const double* tx=&target.x[0];
+  const double* ty=&target.y[0];
+  const double* tz=&target.z[0];
+  double a[9]={0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  double g=0.0;
+  for (size_t j=0; j<n; ++j) {
+    double px=x[j]-cx, py=y[j]-cy, pz=z[j]-cz;
+    a[0]+=tx[j]*px; a[1]+=tx[j]*py; a[2]+=tx[j]*pz;
+    a[3]+=ty[j]*px; a[4]+=ty[j]*py; a[5]+=ty[j]*pz;
+    a[6]+=tz[j]*px; a[7]+=tz[j]*py; a[8]+=tz[j]*pz;
+    g+=px*px+py*py+pz*pz;
   }
-  return r;
+  FrameTransform t;
+  if (!QCPRotation(a, 0.5*(g+target.g), t.rot)) {
+    t.rot=SVDRotation(a);
+  }
+  t.shift=target.center-t.rot*geom::Vec3(cx, cy, cz);
+  return t;
 }
 
-  
-void AddSuperposedFrame(CoordGroupHandle& superposed, EMatX3& ref_mat,EMatX3& ref_centered,ECVec3& ref_center,CoordFramePtr frame,std::vector<unsigned long>& indices)
-{
-  // This function superposes and then adds a CoordFrame (frame) to a CoordGroup (superposed).
-  // ref_mat, ref_centered and ref_center contain respectively the positions, centered positions and
-  // vector to center of the reference points for superposition.
-  // indices is a vector of the indices of the atoms to be superposed on the reference positions
-  EMat3X frame_centered=EMat3X::Zero(3, indices.size());
-  EMat3X frame_mat=EMat3X::Zero(3, indices.size());
-  ERVec3 frame_center;
-  for (size_t j=0; j<indices.size(); ++j) {
-    frame_mat.col(j)=gvec_to_rvec((*frame)[indices[j]]);
-  }
-  std::vector<geom::Vec3> frame_data=*frame;
-  frame_center=frame_mat.rowwise().sum()/frame_mat.cols();
-  frame_centered=row_sub(frame_mat, frame_center);
-  //single value decomposition
-  Eigen::JacobiSVD<EMat3> svd(frame_centered*ref_centered,Eigen::ComputeFullU | Eigen::ComputeFullV);
-  EMat3 matrixVT=svd.matrixV().transpose();
-  //determine rotation
-  Real detv=matrixVT.determinant();
-  Real dett=svd.matrixU().determinant();
-  Real det=detv*dett;
-  EMat3 e_rot;
-  if (det<0) {
-    EMat3 tmat=EMat3::Identity();
-    tmat(2,2)=-1;
-    e_rot=(svd.matrixU()*tmat)*matrixVT;
-  }else{
-    e_rot=svd.matrixU()*matrixVT;
-  }
-  //  prepare rmsd calculation
-  geom::Vec3 shift=rvec_to_gvec(ref_center);
-  geom::Vec3 com_vec=-cvec_to_gvec(frame_center);
-  geom::Mat3 rot=emat_to_gmat(e_rot);
-  geom::Mat4 mat4_com, mat4_rot, mat4_shift;
-  mat4_rot.PasteRotation(rot);
-  mat4_shift.PasteTranslation(shift);
-  mat4_com.PasteTranslation(com_vec);
-  geom::Mat4 tf=geom::Mat4(mat4_shift*mat4_rot*mat4_com);
-  for (std::vector<geom::Vec3>::iterator c=frame_data.begin(), 
-       e2=frame_data.end(); c!=e2; ++c) {
-    *c=geom::Vec3(tf*geom::Vec4(*c));
-  }
-  superposed.AddFrame(frame_data);
-}  
-
-
-CoordGroupHandle SuperposeFrames(CoordGroupHandle& cg, EntityView& sel,
-                                 int begin, int end, int ref)
+void GetSuperpositionIndices(const CoordGroupHandle& cg, const EntityView& sel,
+                             std::vector<unsigned long>& indices)
 {
-  //This function superposes the frames of a CoordGroup (cg) with indices between begin and end
-  //onto the frame with index ref. The superposition is done on a selection of atoms given by the EntityView sel.
-  int real_end=end==-1 ? cg.GetFrameCount() : end;
-  CoordFramePtr ref_frame;
-  std::vector<unsigned long> indices;
   if (!sel.IsValid()) {
     indices.reserve(cg.GetAtomCount());
     for (size_t i=0;i<cg.GetAtomCount(); ++i) {
@@ -149,91 +255,289 @@ CoordGroupHandle SuperposeFrames(CoordGroupHandle& cg, EntityView& sel,
       indices.push_back(i->GetIndex());
     }
   }
-  mol::AtomHandleList alist(cg.GetEntity().GetAtomList());
-  std::sort(alist.begin(), alist.end(),less_index);
-  CoordGroupHandle superposed=CreateCoordGroup(alist);
-  EMatX3 ref_mat=EMatX3::Zero(indices.size(), 3);
-  EMatX3 ref_centered=EMatX3::Zero(indices.size(), 3);
-  ECVec3 ref_center;
+  if (indices.empty()) {
+    throw ost::Error("no atoms selected for superposition");
+  }
+}
+
+void GetSelectedPositions(const CoordFrame& frame, 
+                          const std::vector<unsigned long>& indices,
+                          std::vector<geom::Vec3>& pos)
+{
+  pos.resize(indices.size());
+  for (size_t j=0; j<indices.size(); ++j) {
+    pos[j]=frame[indices[j]];
+  }
+}
+
+struct SuperposeOntoFunc {
+  SuperposeOntoFunc(const std::vector<unsigned long>& indices, 
+                    const SuperpositionTarget& target,
+                    FrameTransformList& transforms):
+    indices(indices), target(target), transforms(transforms)
+  { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    transforms[k]=SuperposeOnto(frame, indices, target);
+  }
+  const std::vector<unsigned long>& indices;
+  const SuperpositionTarget& target;
+  FrameTransformList& transforms;
+};
+
+// determines the transformations for frames begin to end. If ref is -1, 
+// every frame is superposed onto the superposed previous frame, which can
+// only be done one frame after the other. Otherwise, all frames are 
+// superposed onto frame ref, and the frames are distributed over num_threads 
+// threads.
+void ComputeTransforms(const CoordGroupHandle& cg, 
+                       const std::vector<unsigned long>& indices,
+                       int begin, int end, int ref, int num_threads,
+                       FrameTransformList& transforms)
+{
+  transforms.assign(std::max(0, end-begin), FrameTransform());
+  if (transforms.empty()) {
+    return;
+  }
+  SuperpositionTarget target;
+  std::vector<geom::Vec3> pos;
   if (ref!=-1) {
-    ref_frame=cg.GetFrame(ref);
-    for (size_t i=0; i<indices.size(); ++i) {
-      ref_mat.row(i)=gvec_to_cvec((*ref_frame)[indices[i]]);
+    GetSelectedPositions(*cg.GetFrame(ref), indices, pos);
+    target.Set(pos);
+    SuperposeOntoFunc func(indices, target, transforms);
+    ForEachFrame(cg, func, begin, end, 1, num_threads);
+    // the reference frame is kept as is
+    if (ref>=begin && ref<end) {
+      transforms[ref-begin]=FrameTransform();
     }
-    ref_center=ref_mat.colwise().sum()/ref_mat.rows();
-    ref_centered=col_sub(ref_mat, ref_center);
-  } else {
-    ref_frame=cg.GetFrame(begin);
+    return;
   }
-  for (int i=begin; i<real_end; ++i) {
-    if (ref==i || (ref==-1 && i==begin)) {
-      superposed.AddFrame(*ref_frame);
-      ref_frame=superposed.GetFrame(superposed.GetFrameCount()-1);
-      continue;
-    }
-    if (ref==-1) {
-      for (size_t j=0; j<indices.size(); ++j) {
-        ref_mat.row(j)=gvec_to_cvec((*ref_frame)[indices[j]]);
-      }
-      ref_center=ref_mat.colwise().sum()/ref_mat.rows();
-      ref_centered=col_sub(ref_mat, ref_center);
-    }
+  GetSelectedPositions(*cg.GetFrame(begin), indices, pos);
+  target.Set(pos);
+  for (int i=begin+1; i<end; ++i) {
     CoordFramePtr frame=cg.GetFrame(i);
-    AddSuperposedFrame(superposed,ref_mat,ref_centered,ref_center,frame,indices);    
-    if (ref==-1) {
-      ref_frame=superposed.GetFrame(superposed.GetFrameCount()-1);
+    FrameTransform& t=transforms[i-begin];
+    t=SuperposeOnto(*frame, indices, target);
+    for (size_t j=0; j<indices.size(); ++j) {
+      pos[j]=t.Apply((*frame)[indices[j]]);
     }
+    target.Set(pos);
   }
-  return superposed;
 }
-  
-  
-CoordGroupHandle SuperposeFrames(CoordGroupHandle& cg, EntityView& sel,
-                                  EntityView& ref_view, int begin, int end)
+
+void ComputeTransforms(const CoordGroupHandle& cg, 
+                       const std::vector<unsigned long>& indices,
+                       const EntityView& ref_view, int begin, int end, 
+                       int num_threads, FrameTransformList& transforms)
 {
-  //This function superposes the frames of a CoordGroup (cg) with indices between begin and end,
-  //using a selection of atoms (sel), onto an EntityView (ref_view).
   if (!ref_view.IsValid()){
     throw ost::Error("Invalid reference view");
   }
-  int real_end=end==-1 ? cg.GetFrameCount() : end;
-  CoordFramePtr ref_frame;
-  std::vector<unsigned long> indices;
-  if (!sel.IsValid()) {
-    indices.reserve(cg.GetAtomCount());
-    for (size_t i=0;i<cg.GetAtomCount(); ++i) {
-      indices.push_back(i);
-    }
-  } else {
-    AtomViewList atoms=sel.GetAtomList();
-    indices.reserve(atoms.size());
-    for (AtomViewList::const_iterator i=atoms.begin(), 
-         e=atoms.end(); i!=e; ++i) {
-      indices.push_back(i->GetIndex());
-    }
-  }
   if (int(indices.size())!=ref_view.GetAtomCount()){
     throw ost::Error("atom counts of the two views are not equal");
   }
-  mol::AtomHandleList alist(cg.GetEntity().GetAtomList());
-  std::sort(alist.begin(), alist.end(),less_index);
-  CoordGroupHandle superposed=CreateCoordGroup(alist);
-  EMatX3 ref_mat=EMatX3::Zero(indices.size(), 3);
-  EMatX3 ref_centered=EMatX3::Zero(indices.size(), 3);
-  ECVec3 ref_center;
+  transforms.assign(std::max(0, end-begin), FrameTransform());
   AtomViewList atoms=ref_view.GetAtomList();
-  int i=0;
+  std::vector<geom::Vec3> pos;
+  pos.reserve(atoms.size());
   for (AtomViewList::const_iterator a=atoms.begin(), 
-       e=atoms.end(); a!=e; a++, i++) {
-    ref_mat.row(i)=gvec_to_cvec((*a).GetPos());
+       e=atoms.end(); a!=e; ++a) {
+    pos.push_back(a->GetPos());
   }
-  ref_center=ref_mat.colwise().sum()/ref_mat.rows();
-  ref_centered=col_sub(ref_mat, ref_center);
-  for (int i=begin; i<real_end; ++i) {
-    CoordFramePtr frame=cg.GetFrame(i);
-    AddSuperposedFrame(superposed,ref_mat,ref_centered,ref_center,frame,indices);    
+  SuperpositionTarget target;
+  target.Set(pos);
+  SuperposeOntoFunc func(indices, target, transforms);
+  ForEachFrame(cg, func, begin, end, 1, num_threads);
+}
+
+AtomHandleList SortedAtomList(const CoordGroupHandle& cg)
+{
+  mol::AtomHandleList alist(cg.GetEntity().GetAtomList());
+  std::sort(alist.begin(), alist.end(),less_index);
+  return alist;
+}
+
+// writes the transformed frames to a list of new frames
+struct CopyTransformedFunc {
+  CopyTransformedFunc(const FrameTransformList& transforms, 
+                      CoordFrameList& frames):
+    transforms(transforms), frames(frames)
+  { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    CoordFramePtr copy(new CoordFrame(frame.size()));
+    for (size_t i=0; i<frame.size(); ++i) {
+      (*copy)[i]=transforms[k].Apply(frame[i]);
+    }
+    frames[k]=copy;
   }
-  return superposed;
+  const FrameTransformList& transforms;
+  CoordFrameList& frames;
+};
+
+// replaces the frame positions with the transformed ones
+struct TransformInPlaceFunc {
+  TransformInPlaceFunc(CoordGroupHandle& cg, int begin, 
+                       const FrameTransformList& transforms):
+    cg(cg), begin(begin), transforms(transforms)
+  { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    geom::Vec3List pos(frame.size());
+    for (size_t i=0; i<frame.size(); ++i) {
+      pos[i]=transforms[k].Apply(frame[i]);
+    }
+    cg.SetFramePositions(begin+k, pos);
+  }
+  CoordGroupHandle& cg;
+  int begin;
+  const FrameTransformList& transforms;
+};
+
+CoordGroupHandle CreateTransformedCoordGroup(const CoordGroupHandle& cg, 
+                                             int begin, int end,
+                                             const FrameTransformList& transforms,
+                                             int num_threads)
+{
+  InMemCoordSourcePtr source(new InMemCoordSource(SortedAtomList(cg)));
+  CoordFrameList frames(transforms.size());
+  CopyTransformedFunc func(transforms, frames);
+  ForEachFrame(cg, func, begin, end, 1, num_threads);
+  for (CoordFrameList::const_iterator i=frames.begin(), 
+       e=frames.end(); i!=e; ++i) {
+    source->AddFrame(*i);
+  }
+  return CoordGroupHandle(source);
+}
+
+void TransformInPlace(CoordGroupHandle& cg, int begin, int end,
+                      const FrameTransformList& transforms, int num_threads)
+{
+  TransformInPlaceFunc func(cg, begin, transforms);
+  ForEachFrame(cg, func, begin, end, 1, num_threads);
+}
+
+// coordinate source applying the superposition when a frame is requested. 
+// Only the transformations are stored, the frames are read from the 
+// superposed coord group.
+class SuperposedCoordSource : public CoordSource {
+public:
+  SuperposedCoordSource(const CoordGroupHandle& cg, int begin, 
+                        const FrameTransformList& transforms):
+    CoordSource(SortedAtomList(cg)), cg_(cg), begin_(begin), 
+    transforms_(transforms)
+  {
+    this->SetMutable(false);
+    this->SetFrameDelta(cg.GetDelta());
+    this->SetStartTime(cg.GetStartTime()+begin*cg.GetDelta());
+  }
+
+  virtual uint GetFrameCount() const { return transforms_.size(); }
+
+  virtual CoordFramePtr GetFrame(uint frame_id) const
+  {
+    if (frame_id>=transforms_.size()) {
+      throw ost::Error("frame index out of range");
+    }
+    CoordFramePtr frame=cg_.GetFrame(begin_+frame_id);
+    CoordFramePtr copy(new CoordFrame(*frame));
+    const FrameTransform& t=transforms_[frame_id];
+    for (CoordFrame::iterator i=copy->begin(), e=copy->end(); i!=e; ++i) {
+      *i=t.Apply(*i);
+    }
+    return copy;
+  }
+
+  virtual void AddFrame(const std::vector<geom::Vec3>& coords) {}
+  virtual void AddFrame(const std::vector<geom::Vec3>& coords,
+                        const geom::Vec3& box_size,
+                        const geom::Vec3& box_angles) {}
+  virtual void InsertFrame(int pos, const std::vector<geom::Vec3>& coords) {}
+private:
+  CoordGroupHandle   cg_;
+  int                begin_;
+  FrameTransformList transforms_;
+};
+
+}
+
+CoordGroupHandle SuperposeFrames(CoordGroupHandle& cg, EntityView& sel,
+                                 int begin, int end, int ref, int num_threads)
+{
+  //This function superposes the frames of a CoordGroup (cg) with indices between begin and end
+  //onto the frame with index ref. The superposition is done on a selection of atoms given by the EntityView sel.
+  int real_end=end==-1 ? cg.GetFrameCount() : end;
+  std::vector<unsigned long> indices;
+  GetSuperpositionIndices(cg, sel, indices);
+  FrameTransformList transforms;
+  ComputeTransforms(cg, indices, begin, real_end, ref, num_threads, transforms);
+  return CreateTransformedCoordGroup(cg, begin, real_end, transforms, 
+                                     num_threads);
 }
   
+  
+CoordGroupHandle SuperposeFrames(CoordGroupHandle& cg, EntityView& sel,
+                                 EntityView& ref_view, int begin, int end,
+                                 int num_threads)
+{
+  //This function superposes the frames of a CoordGroup (cg) with indices between begin and end,
+  //using a selection of atoms (sel), onto an EntityView (ref_view).
+  int real_end=end==-1 ? cg.GetFrameCount() : end;
+  std::vector<unsigned long> indices;
+  GetSuperpositionIndices(cg, sel, indices);
+  FrameTransformList transforms;
+  ComputeTransforms(cg, indices, ref_view, begin, real_end, num_threads, 
+                    transforms);
+  return CreateTransformedCoordGroup(cg, begin, real_end, transforms, 
+                                     num_threads);
+}
+
+void SuperposeFramesInPlace(CoordGroupHandle& cg, EntityView& sel,
+                            int begin, int end, int ref, int num_threads)
+{
+  int real_end=end==-1 ? cg.GetFrameCount() : end;
+  std::vector<unsigned long> indices;
+  GetSuperpositionIndices(cg, sel, indices);
+  FrameTransformList transforms;
+  ComputeTransforms(cg, indices, begin, real_end, ref, num_threads, transforms);
+  TransformInPlace(cg, begin, real_end, transforms, num_threads);
+}
+
+void SuperposeFramesInPlace(CoordGroupHandle& cg, EntityView& sel,
+                            EntityView& ref_view, int begin, int end,
+                            int num_threads)
+{
+  int real_end=end==-1 ? cg.GetFrameCount() : end;
+  std::vector<unsigned long> indices;
+  GetSuperpositionIndices(cg, sel, indices);
+  FrameTransformList transforms;
+  ComputeTransforms(cg, indices, ref_view, begin, real_end, num_threads, 
+                    transforms);
+  TransformInPlace(cg, begin, real_end, transforms, num_threads);
+}
+
+CoordGroupHandle SuperposeFramesLazy(CoordGroupHandle& cg, EntityView& sel,
+                                     int begin, int end, int ref, 
+                                     int num_threads)
+{
+  int real_end=end==-1 ? cg.GetFrameCount() : end;
+  std::vector<unsigned long> indices;
+  GetSuperpositionIndices(cg, sel, indices);
+  FrameTransformList transforms;
+  ComputeTransforms(cg, indices, begin, real_end, ref, num_threads, transforms);
+  return CoordGroupHandle(CoordSourcePtr(new SuperposedCoordSource(cg, begin, 
+                                                                   transforms)));
+}
+
+CoordGroupHandle SuperposeFramesLazy(CoordGroupHandle& cg, EntityView& sel,
+                                     EntityView& ref_view, int begin, int end,
+                                     int num_threads)
+{
+  int real_end=end==-1 ? cg.GetFrameCount() : end;
+  std::vector<unsigned long> indices;
+  GetSuperpositionIndices(cg, sel, indices);
+  FrameTransformList transforms;
+  ComputeTransforms(cg, indices, ref_view, begin, real_end, num_threads, 
+                    transforms);
+  return CoordGroupHandle(CoordSourcePtr(new SuperposedCoordSource(cg, begin, 
+                                                                   transforms)));
+}
+
 }}}
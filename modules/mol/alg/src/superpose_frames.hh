@@ -25,14 +25,52 @@
 namespace ost { namespace mol { namespace alg {
 
 /// \brief returns a superposed version of coord group, superposed on a reference frame
+///
+/// If ref is -1, every frame is superposed onto the superposed previous frame.
+/// In all other cases, the frames are distributed over num_threads threads,
+/// 0 meaning one thread per core.
 CoordGroupHandle DLLEXPORT_OST_MOL_ALG SuperposeFrames(CoordGroupHandle& cg, 
                                                        EntityView& sel,
                                                        int begin=0, int end=-1, 
-                                                       int ref=-1);
+                                                       int ref=-1,
+                                                       int num_threads=1);
 /// \brief returns a superposed version of coord group, superposed on a reference view
 CoordGroupHandle DLLEXPORT_OST_MOL_ALG SuperposeFrames(CoordGroupHandle& cg, 
                                                        EntityView& sel, EntityView& ref_view,
-                                                       int begin=0, int end=-1);
+                                                       int begin=0, int end=-1,
+                                                       int num_threads=1);
+
+/// \brief superposes frames begin to end of a mutable coord group in place
+void DLLEXPORT_OST_MOL_ALG SuperposeFramesInPlace(CoordGroupHandle& cg, 
+                                                  EntityView& sel,
+                                                  int begin=0, int end=-1, 
+                                                  int ref=-1,
+                                                  int num_threads=1);
+/// \brief superposes frames begin to end of a mutable coord group in place
+///        onto a reference view
+void DLLEXPORT_OST_MOL_ALG SuperposeFramesInPlace(CoordGroupHandle& cg, 
+                                                  EntityView& sel, 
+                                                  EntityView& ref_view,
+                                                  int begin=0, int end=-1,
+                                                  int num_threads=1);
+
+/// \brief returns a coord group that superposes the frames when they are read
+///
+/// Only the superposition of each frame is stored, the coordinates are read
+/// from cg every time a frame is requested. Useful for trajectories that 
+/// don't fit in memory twice, e.g. memory-mapped DCD files.
+CoordGroupHandle DLLEXPORT_OST_MOL_ALG SuperposeFramesLazy(CoordGroupHandle& cg, 
+                                                           EntityView& sel,
+                                                           int begin=0, int end=-1, 
+                                                           int ref=-1,
+                                                           int num_threads=1);
+/// \brief returns a coord group that superposes the frames onto a reference
+///        view when they are read
+CoordGroupHandle DLLEXPORT_OST_MOL_ALG SuperposeFramesLazy(CoordGroupHandle& cg, 
+                                                           EntityView& sel, 
+                                                           EntityView& ref_view,
+                                                           int begin=0, int end=-1,
+                                                           int num_threads=1);
 }}}
 
 #endif
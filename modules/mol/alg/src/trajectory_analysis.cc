@@ -21,6 +21,7 @@
  * Author Niklaus Johner
  */
 #include <stdexcept>
+#include <algorithm>
 #include <ost/base.hh>
 #include <ost/geom/vec3.hh>
 #include <ost/base.hh>
@@ -28,107 +29,400 @@
 #include <ost/mol/mol.hh>
 #include <ost/mol/view_op.hh>
 #include "trajectory_analysis.hh"
+#include "parallel_frames.hh"
 
 namespace ost { namespace mol { namespace alg {
 
-geom::Vec3List AnalyzeAtomPos(const CoordGroupHandle& traj, const AtomHandle& a1, unsigned int stride)
+namespace {
+
+// The functors below compute the per-frame quantities of the analysis 
+// functions. They are called concurrently by ForEachFrame and only write to
+// the element of the result belonging to the frame (or chunk) at hand.
+
+struct AtomPosFunc {
+  AtomPosFunc(int i1, size_t n): i1(i1), pos(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    pos[k]=frame.GetAtomPos(i1);
+  }
+  int i1;
+  geom::Vec3List pos;
+};
+
+struct DistanceFunc {
+  DistanceFunc(int i1, int i2, size_t n): i1(i1), i2(i2), dist(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    dist[k]=frame.GetDistanceBetwAtoms(i1,i2);
+  }
+  int i1, i2;
+  std::vector<Real> dist;
+};
+
+struct AngleFunc {
+  AngleFunc(int i1, int i2, int i3, size_t n): i1(i1), i2(i2), i3(i3), ang(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    ang[k]=frame.GetAngle(i1,i2,i3);
+  }
+  int i1, i2, i3;
+  std::vector<Real> ang;
+};
+
+struct DihedralAngleFunc {
+  DihedralAngleFunc(int i1, int i2, int i3, int i4, size_t n): 
+    i1(i1), i2(i2), i3(i3), i4(i4), ang(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    ang[k]=frame.GetDihedralAngle(i1,i2,i3,i4);
+  }
+  int i1, i2, i3, i4;
+  std::vector<Real> ang;
+};
+
+struct CenterOfMassPosFunc {
+  CenterOfMassPosFunc(size_t n): pos(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    pos[k]=frame.GetCenterOfMassPos(indices,masses);
+  }
+  std::vector<unsigned long> indices;
+  std::vector<Real> masses;
+  geom::Vec3List pos;
+};
+
+struct DistanceBetwCenterOfMassFunc {
+  DistanceBetwCenterOfMassFunc(size_t n): dist(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    dist[k]=frame.GetDistanceBetwCenterOfMass(indices1,masses1,indices2,masses2);
+  }
+  std::vector<unsigned long> indices1,indices2;
+  std::vector<Real> masses1,masses2;
+  std::vector<Real> dist;
+};
+
+struct RMSDFunc {
+  RMSDFunc(size_t n): rmsd(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    rmsd[k]=frame.GetRMSD(ref_pos,sele_indices);
+  }
+  std::vector<unsigned long> sele_indices;
+  std::vector<geom::Vec3> ref_pos;
+  std::vector<Real> rmsd;
+};
+
+struct MinDistanceFunc {
+  MinDistanceFunc(size_t n): dist(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    dist[k]=frame.GetMinDistance(indices1,indices2);
+  }
+  std::vector<unsigned long> indices1,indices2;
+  std::vector<Real> dist;
+};
+
+struct MinDistBetwCenterOfMassAndViewFunc {
+  MinDistBetwCenterOfMassAndViewFunc(size_t n): dist(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    dist[k]=frame.GetMinDistBetwCenterOfMassAndView(indices_cm, masses_cm, 
+                                                    indices_atoms);
+  }
+  std::vector<unsigned long> indices_cm,indices_atoms;
+  std::vector<Real> masses_cm;
+  std::vector<Real> dist;
+};
+
+struct AromaticRingInteractionFunc {
+  AromaticRingInteractionFunc(size_t n): dist(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    Real d1=frame.GetMinDistBetwCenterOfMassAndView(indices_ring1, masses_ring1,
+                                                    indices_ring2);
+    Real d2=frame.GetMinDistBetwCenterOfMassAndView(indices_ring2, masses_ring2,
+                                                    indices_ring1);
+    dist[k]=std::min(d1,d2);
+  }
+  std::vector<unsigned long> indices_ring1,indices_ring2;
+  std::vector<Real> masses_ring1,masses_ring2;
+  std::vector<Real> dist;
+};
+
+struct AlphaHelixAxisFunc {
+  AlphaHelixAxisFunc(size_t n): directions(n), centers(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    std::pair<geom::Line3, Real> cylinder=frame.FitCylinder(indices_ca);
+    geom::Line3 axis=cylinder.first;
+    Real sign=geom::Dot(axis.GetDirection(),
+                        frame[indices_ca[indices_ca.size()-1]]-axis.GetOrigin());
+    sign=sign/fabs(sign);
+    directions[k]=sign*axis.GetDirection();
+    centers[k]=axis.GetOrigin();
+  }
+  std::vector<unsigned long> indices_ca;
+  geom::Vec3List directions;
+  geom::Vec3List centers;
+};
+
+struct BestFitLineFunc {
+  BestFitLineFunc(size_t n): directions(n), centers(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    geom::Line3 axis=frame.GetODRLine(indices_ca);
+    directions[k]=axis.GetDirection();
+    centers[k]=axis.GetOrigin();
+  }
+  std::vector<unsigned long> indices_ca;
+  geom::Vec3List directions;
+  geom::Vec3List centers;
+};
+
+struct BestFitPlaneFunc {
+  BestFitPlaneFunc(size_t n): normals(n), origins(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    geom::Plane best_plane=frame.GetODRPlane(indices_ca);
+    normals[k]=best_plane.GetNormal();
+    origins[k]=best_plane.GetOrigin();
+  }
+  std::vector<unsigned long> indices_ca;
+  geom::Vec3List normals;
+  geom::Vec3List origins;
+};
+
+struct RadiusOfGyrationFunc {
+  RadiusOfGyrationFunc(size_t n): rg(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    geom::Vec3 cm=frame.GetCenterOfMassPos(indices,masses);
+    Real sum=0.0, mass=0.0;
+    for (size_t j=0; j<indices.size(); ++j) {
+      geom::Vec3 v=frame[indices[j]]-cm;
+      sum+=masses[j]*geom::Dot(v,v);
+      mass+=masses[j];
+    }
+    rg[k]=sqrt(sum/mass);
+  }
+  std::vector<unsigned long> indices;
+  std::vector<Real> masses;
+  std::vector<Real> rg;
+};
+
+struct HelicityFunc {
+  HelicityFunc(size_t n): helicity(n) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    helicity[k]=frame.GetAlphaHelixContent(indices_ca,indices_c,indices_o,
+                                           indices_n);
+  }
+  std::vector<unsigned long> indices_c,indices_o,indices_n,indices_ca;
+  std::vector<Real> helicity;
+};
+
+// upper bound for the number of partial sums kept by the reductions below.
+// The partial sums are added up in order, which keeps the results independent
+// of the number of threads.
+const size_t MAX_PARTIAL_SUMS=64;
+
+size_t ReductionChunkSize(size_t num_frames)
+{
+  return std::max(size_t(1), 
+                  (num_frames+MAX_PARTIAL_SUMS-1)/MAX_PARTIAL_SUMS);
+}
+
+// sums up the positions of the selected atoms
+struct PositionSumFunc {
+  PositionSumFunc(const std::vector<unsigned long>& indices, size_t num_chunks):
+    indices(indices), sums(num_chunks, 
+                           geom::Vec3List(indices.size(), geom::Vec3()))
+  { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    geom::Vec3List& sum=sums[chunk];
+    for (size_t j=0; j<indices.size(); ++j) {
+      sum[j]+=frame[indices[j]];
+    }
+  }
+  geom::Vec3List Sum() const {
+    geom::Vec3List total(indices.size(), geom::Vec3());
+    for (size_t i=0; i<sums.size(); ++i) {
+      for (size_t j=0; j<indices.size(); ++j) {
+        total[j]+=sums[i][j];
+      }
+    }
+    return total;
+  }
+  const std::vector<unsigned long>& indices;
+  std::vector<geom::Vec3List> sums;
+};
+
+// sums up the squared deviations of the selected atoms from their mean 
+// positions
+struct SquaredDeviationFunc {
+  SquaredDeviationFunc(const std::vector<unsigned long>& indices, 
+                       const geom::Vec3List& mean_pos, size_t num_chunks):
+    indices(indices), mean_pos(mean_pos), sums(num_chunks, Real(0.0))
+  { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    for (size_t j=0; j<indices.size(); ++j) {
+      geom::Vec3 v=frame[indices[j]]-mean_pos[j];
+      sums[chunk]+=geom::Dot(v,v);
+    }
+  }
+  Real Sum() const {
+    Real total=0.0;
+    for (size_t i=0; i<sums.size(); ++i) {
+      total+=sums[i];
+    }
+    return total;
+  }
+  const std::vector<unsigned long>& indices;
+  const geom::Vec3List& mean_pos;
+  std::vector<Real> sums;
+};
+
+}
+
+// a per-frame quantity evaluated by TrajectoryPipeline
+class TrajectoryStage {
+public:
+  virtual ~TrajectoryStage() { }
+  virtual void Prepare(size_t num_frames)=0;
+  virtual void Process(size_t chunk, size_t k, const CoordFrame& frame)=0;
+  virtual bool IsVector() const=0;
+  virtual void Store(const String& name, 
+                     std::map<String, std::vector<Real> >& columns,
+                     std::map<String, geom::Vec3List>& vector_columns)=0;
+};
+
+namespace {
+
+void StoreColumn(const String& name, std::vector<Real>& values,
+                 std::map<String, std::vector<Real> >& columns,
+                 std::map<String, geom::Vec3List>& vector_columns)
+{
+  columns[name].swap(values);
+}
+
+void StoreColumn(const String& name, geom::Vec3List& values,
+                 std::map<String, std::vector<Real> >& columns,
+                 std::map<String, geom::Vec3List>& vector_columns)
+{
+  vector_columns[name].swap(values);
+}
+
+bool IsVectorType(const std::vector<Real>*) { return false; }
+
+bool IsVectorType(const geom::Vec3List*) { return true; }
+
+// turns one of the functors above into a pipeline stage. column points to
+// the member holding the per-frame results.
+template <typename F, typename C>
+class FuncStage : public TrajectoryStage {
+public:
+  FuncStage(const F& func, C F::*column): func_(func), column_(column) { }
+
+  virtual void Prepare(size_t num_frames) {
+    (func_.*column_).assign(num_frames, typename C::value_type());
+  }
+  virtual void Process(size_t chunk, size_t k, const CoordFrame& frame) {
+    func_(chunk, k, frame);
+  }
+  virtual bool IsVector() const {
+    return IsVectorType(static_cast<const C*>(NULL));
+  }
+  virtual void Store(const String& name, 
+                     std::map<String, std::vector<Real> >& columns,
+                     std::map<String, geom::Vec3List>& vector_columns) {
+    StoreColumn(name, func_.*column_, columns, vector_columns);
+  }
+private:
+  F      func_;
+  C F::* column_;
+};
+
+template <typename F, typename C>
+TrajectoryStagePtr MakeStage(const F& func, C F::*column)
+{
+  return TrajectoryStagePtr(new FuncStage<F, C>(func, column));
+}
+
+struct PipelineFunc {
+  PipelineFunc(const std::vector<TrajectoryStagePtr>& stages): stages(stages) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    for (size_t i=0; i<stages.size(); ++i) {
+      stages[i]->Process(chunk, k, frame);
+    }
+  }
+  const std::vector<TrajectoryStagePtr>& stages;
+};
+
+}
+
+geom::Vec3List AnalyzeAtomPos(const CoordGroupHandle& traj, const AtomHandle& a1, unsigned int stride,
+                              int num_threads)
 //This function extracts the position of an atom from a trajectory and returns it as a vector of geom::Vec3
 {
   CheckHandleValidity(traj);
-  geom::Vec3List pos;
-  pos.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  int i1=a1.GetIndex();
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    pos.push_back(frame->GetAtomPos(i1));
-  }
-  return pos;
+  int n_frames=traj.GetFrameCount();
+  AtomPosFunc func(a1.GetIndex(), StridedFrameCount(0, n_frames, stride));
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.pos;
 }
 
 std::vector<Real> AnalyzeDistanceBetwAtoms(const CoordGroupHandle& traj, const AtomHandle& a1, const AtomHandle& a2, 
-                                  unsigned int stride)
+                                  unsigned int stride, int num_threads)
 //This function extracts the distance between two atoms from a trajectory and returns it as a vector
 {
   CheckHandleValidity(traj);
-  std::vector<Real> dist;
-  dist.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  int i1=a1.GetIndex();
-  int i2=a2.GetIndex();
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    dist.push_back(frame->GetDistanceBetwAtoms(i1,i2));
-  }
-  return dist;
+  int n_frames=traj.GetFrameCount();
+  DistanceFunc func(a1.GetIndex(), a2.GetIndex(), 
+                    StridedFrameCount(0, n_frames, stride));
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.dist;
 } 
 
 std::vector<Real> AnalyzeAngle(const CoordGroupHandle& traj, const AtomHandle& a1, const AtomHandle& a2, 
-                               const AtomHandle& a3, unsigned int stride)
+                               const AtomHandle& a3, unsigned int stride, int num_threads)
 //This function extracts the angle between three atoms from a trajectory and returns it as a vector
 {
   CheckHandleValidity(traj);
-  std::vector<Real> ang;
-  ang.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  int i1=a1.GetIndex(),i2=a2.GetIndex(),i3=a3.GetIndex();
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    ang.push_back(frame->GetAngle(i1,i2,i3));
-  }
-  return ang;
+  int n_frames=traj.GetFrameCount();
+  AngleFunc func(a1.GetIndex(), a2.GetIndex(), a3.GetIndex(),
+                 StridedFrameCount(0, n_frames, stride));
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.ang;
 }
 
 std::vector<Real> AnalyzeDihedralAngle(const CoordGroupHandle& traj, const AtomHandle& a1, const AtomHandle& a2, 
-                                  const AtomHandle& a3, const AtomHandle& a4, unsigned int stride)
+                                  const AtomHandle& a3, const AtomHandle& a4, unsigned int stride,
+                                  int num_threads)
 //This function extracts the dihedral angle between four atoms from a trajectory and returns it as a vector
 {
   CheckHandleValidity(traj);
-  std::vector<Real> ang;
-  ang.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  int i1=a1.GetIndex(),i2=a2.GetIndex(),i3=a3.GetIndex(),i4=a4.GetIndex();
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    ang.push_back(frame->GetDihedralAngle(i1,i2,i3,i4));
-  }
-  return ang;
+  int n_frames=traj.GetFrameCount();
+  DihedralAngleFunc func(a1.GetIndex(), a2.GetIndex(), a3.GetIndex(), 
+                         a4.GetIndex(), StridedFrameCount(0, n_frames, stride));
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.ang;
 }
 
-geom::Vec3List AnalyzeCenterOfMassPos(const CoordGroupHandle& traj, const EntityView& sele,unsigned int stride)
+geom::Vec3List AnalyzeCenterOfMassPos(const CoordGroupHandle& traj, const EntityView& sele,unsigned int stride,
+                                      int num_threads)
 //This function extracts the position of the CenterOfMass of a selection (entity view) from a trajectory 
 //and returns it as a vector. 
   {
   CheckHandleValidity(traj);
-  geom::Vec3List pos;
-  pos.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  std::vector<unsigned long> indices;
-  std::vector<Real> masses;
-  GetIndicesAndMasses(sele, indices, masses);
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    pos.push_back(frame->GetCenterOfMassPos(indices,masses));
-  }
-  return pos;
+  int n_frames=traj.GetFrameCount();
+  CenterOfMassPosFunc func(StridedFrameCount(0, n_frames, stride));
+  GetIndicesAndMasses(sele, func.indices, func.masses);
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.pos;
 }
 
 std::vector<Real> AnalyzeDistanceBetwCenterOfMass(const CoordGroupHandle& traj, const EntityView& sele1,
-                                    const EntityView& sele2, unsigned int stride)
+                                    const EntityView& sele2, unsigned int stride, int num_threads)
 //This function extracts the distance between the CenterOfMass of two selection (entity views) from a trajectory 
 //and returns it as a vector. 
   {
   CheckHandleValidity(traj);
-  std::vector<Real> dist;
-  dist.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  std::vector<unsigned long> indices1,indices2;
-  std::vector<Real> masses1,masses2;
-  GetIndicesAndMasses(sele1, indices1, masses1);
-  GetIndicesAndMasses(sele2, indices2, masses2);
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    dist.push_back(frame->GetDistanceBetwCenterOfMass(indices1,masses1,indices2,masses2));
-  }
-  return dist;
+  int n_frames=traj.GetFrameCount();
+  DistanceBetwCenterOfMassFunc func(StridedFrameCount(0, n_frames, stride));
+  GetIndicesAndMasses(sele1, func.indices1, func.masses1);
+  GetIndicesAndMasses(sele2, func.indices2, func.masses2);
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.dist;
 }
 
 std::vector<Real> AnalyzeRMSD(const CoordGroupHandle& traj, const EntityView& reference_view,
-                                    const EntityView& sele_view, unsigned int stride)
+                                    const EntityView& sele_view, unsigned int stride, int num_threads)
 // This function extracts the rmsd between two entity views and returns it as a vector
 // The views don't have to be from the same entity
 // If you want to compare to frame i of the trajectory t, first use t.CopyFrame(i) for example:
@@ -140,21 +434,16 @@ std::vector<Real> AnalyzeRMSD(const CoordGroupHandle& traj, const EntityView& re
   if (count_ref!=count_sele){
     throw Error("atom counts of the two views are not equal");
   }  
-  std::vector<Real> rmsd;
-  rmsd.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  std::vector<unsigned long> sele_indices;
-  std::vector<geom::Vec3> ref_pos;
-  GetIndices(sele_view, sele_indices);
-  GetPositions(reference_view, ref_pos);
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    rmsd.push_back(frame->GetRMSD(ref_pos,sele_indices));
-  }
-  return rmsd;
+  int n_frames=traj.GetFrameCount();
+  RMSDFunc func(StridedFrameCount(0, n_frames, stride));
+  GetIndices(sele_view, func.sele_indices);
+  GetPositions(reference_view, func.ref_pos);
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.rmsd;
 }
  
 std::vector<Real>  AnalyzeMinDistance(const CoordGroupHandle& traj, const EntityView& view1,
-                                      const EntityView& view2,unsigned int stride)
+                                      const EntityView& view2,unsigned int stride, int num_threads)
 // This function extracts the minimal distance between two sets of atoms (view1 and view2) for
 // each frame in a trajectory and returns it as a vector.
   {
@@ -165,20 +454,17 @@ std::vector<Real>  AnalyzeMinDistance(const CoordGroupHandle& traj, const Entity
   if (!view2.HasAtoms()){
     throw Error("second EntityView is empty");
   }  
-  std::vector<Real> dist;
-  dist.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  std::vector<unsigned long> indices1,indices2;
-  GetIndices(view1, indices1);
-  GetIndices(view2, indices2);
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    dist.push_back(frame->GetMinDistance(indices1,indices2));
-  }
-    return dist;
+  int n_frames=traj.GetFrameCount();
+  MinDistanceFunc func(StridedFrameCount(0, n_frames, stride));
+  GetIndices(view1, func.indices1);
+  GetIndices(view2, func.indices2);
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.dist;
 }
   
 std::vector<Real> AnalyzeMinDistanceBetwCenterOfMassAndView(const CoordGroupHandle& traj, const EntityView& view_cm,
-                                            const EntityView& view_atoms,unsigned int stride)
+                                            const EntityView& view_atoms,unsigned int stride,
+                                            int num_threads)
   // This function extracts the minimal distance between a set of atoms (view_atoms) and the center of mass
   // of a second set of atoms (view_cm) for each frame in a trajectory and returns it as a vector.
   {
@@ -189,20 +475,17 @@ std::vector<Real> AnalyzeMinDistanceBetwCenterOfMassAndView(const CoordGroupHand
   if (!view_atoms.HasAtoms()){
     throw Error("second EntityView is empty");
   } 
-  std::vector<Real> dist, masses_cm;
-  dist.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  std::vector<unsigned long> indices_cm,indices_atoms;
-  GetIndicesAndMasses(view_cm, indices_cm,masses_cm);
-  GetIndices(view_atoms, indices_atoms);
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    dist.push_back(frame->GetMinDistBetwCenterOfMassAndView(indices_cm, masses_cm, indices_atoms));
-  }
-  return dist;
+  int n_frames=traj.GetFrameCount();
+  MinDistBetwCenterOfMassAndViewFunc func(StridedFrameCount(0, n_frames, stride));
+  GetIndicesAndMasses(view_cm, func.indices_cm, func.masses_cm);
+  GetIndices(view_atoms, func.indices_atoms);
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.dist;
   }
 
 std::vector<Real> AnalyzeAromaticRingInteraction(const CoordGroupHandle& traj, const EntityView& view_ring1,
-                                                   const EntityView& view_ring2,unsigned int stride)
+                                                   const EntityView& view_ring2,unsigned int stride,
+                                                   int num_threads)
   // This function is a crude analysis of aromatic ring interactions. For each frame in a trajectory, it calculates
   // the minimal distance between the atoms in one view and the center of mass of the other
   // and vice versa, and returns the minimum between these two minimal distances.
@@ -216,23 +499,16 @@ std::vector<Real> AnalyzeAromaticRingInteraction(const CoordGroupHandle& traj, c
   if (!view_ring2.HasAtoms()){
     throw Error("second EntityView is empty");
   } 
-  std::vector<Real> dist, masses_ring1,masses_ring2;
-  dist.reserve(ceil(traj.GetFrameCount()/float(stride)));
-  std::vector<unsigned long> indices_ring1,indices_ring2;
-  Real d1,d2;
-  GetIndicesAndMasses(view_ring1, indices_ring1,masses_ring1);
-  GetIndicesAndMasses(view_ring2, indices_ring2,masses_ring2);
-  for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-    CoordFramePtr frame=traj.GetFrame(i);
-    d1=frame->GetMinDistBetwCenterOfMassAndView(indices_ring1, masses_ring1, indices_ring2);
-    d2=frame->GetMinDistBetwCenterOfMassAndView(indices_ring2, masses_ring2, indices_ring1);
-    dist.push_back(std::min(d1,d2));
-  }
-  return dist;  
+  int n_frames=traj.GetFrameCount();
+  AromaticRingInteractionFunc func(StridedFrameCount(0, n_frames, stride));
+  GetIndicesAndMasses(view_ring1, func.indices_ring1, func.masses_ring1);
+  GetIndicesAndMasses(view_ring2, func.indices_ring2, func.masses_ring2);
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  return func.dist;  
   }
 
   void AnalyzeAlphaHelixAxis(const CoordGroupHandle& traj, const EntityView& prot_seg, geom::Vec3List& directions,
-                             geom::Vec3List& centers, unsigned int stride)
+                             geom::Vec3List& centers, unsigned int stride, int num_threads)
   //This function calculates the best fitting cylinder to the C-alpha atoms of an EntityView and returns
   //the geometric center as well as the axis of that cylinder. We take care to have the axis point towards
   //the last residue of the selection, usually the direction of the alpha-helix
@@ -241,91 +517,69 @@ std::vector<Real> AnalyzeAromaticRingInteraction(const CoordGroupHandle& traj, c
     if (!prot_seg.HasAtoms()){
       throw Error("EntityView is empty");
     }
-    std::vector<unsigned long> indices_ca;
-    std::pair<geom::Line3, Real> cylinder;
-    geom::Line3 axis;
-    Real sign;
-    directions.reserve(ceil(traj.GetFrameCount()/float(stride)));
-    centers.reserve(ceil(traj.GetFrameCount()/float(stride)));
-    GetCaIndices(prot_seg, indices_ca);
-    unsigned int n_atoms=indices_ca.size();
-    for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-      CoordFramePtr frame=traj.GetFrame(i);
-      cylinder=frame->FitCylinder(indices_ca);
-      axis=cylinder.first;
-      sign=geom::Dot(axis.GetDirection(),(*frame)[indices_ca[n_atoms-1]]-axis.GetOrigin());
-      sign=sign/fabs(sign);
-      directions.push_back(sign*axis.GetDirection());
-      centers.push_back(axis.GetOrigin());
-    }
+    int n_frames=traj.GetFrameCount();
+    AlphaHelixAxisFunc func(StridedFrameCount(0, n_frames, stride));
+    GetCaIndices(prot_seg, func.indices_ca);
+    ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+    directions.insert(directions.end(), func.directions.begin(), 
+                      func.directions.end());
+    centers.insert(centers.end(), func.centers.begin(), func.centers.end());
     return;
   }
  
   //std::vector<geom::Line3> AnalyzeBestFitLine(const CoordGroupHandle& traj, const EntityView& prot_seg,
   //                                               unsigned int stride)
   void AnalyzeBestFitLine(const CoordGroupHandle& traj, const EntityView& prot_seg, geom::Vec3List& directions,
-                          geom::Vec3List& centers, unsigned int stride)
+                          geom::Vec3List& centers, unsigned int stride, int num_threads)
   {
     CheckHandleValidity(traj);
     if (!prot_seg.HasAtoms()){
       throw Error("EntityView is empty");
     }
-    std::vector<unsigned long> indices_ca;
-    geom::Line3 axis;
-    directions.reserve(ceil(traj.GetFrameCount()/float(stride)));
-    centers.reserve(ceil(traj.GetFrameCount()/float(stride)));
-    GetIndices(prot_seg, indices_ca);
-    for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-      CoordFramePtr frame=traj.GetFrame(i);
-      axis=frame->GetODRLine(indices_ca);
-      directions.push_back(axis.GetDirection());
-      centers.push_back(axis.GetOrigin());
-    }
+    int n_frames=traj.GetFrameCount();
+    BestFitLineFunc func(StridedFrameCount(0, n_frames, stride));
+    GetIndices(prot_seg, func.indices_ca);
+    ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+    directions.insert(directions.end(), func.directions.begin(), 
+                      func.directions.end());
+    centers.insert(centers.end(), func.centers.begin(), func.centers.end());
     return;
   }
   
   void AnalyzeBestFitPlane(const CoordGroupHandle& traj, const EntityView& prot_seg, geom::Vec3List& normals,
-                          geom::Vec3List& origins, unsigned int stride)
+                          geom::Vec3List& origins, unsigned int stride, int num_threads)
   {
     CheckHandleValidity(traj);
     if (!prot_seg.HasAtoms()){
       throw Error("EntityView is empty");
     }
-    std::vector<unsigned long> indices_ca;
-    geom::Plane best_plane;
-    normals.reserve(ceil(traj.GetFrameCount()/float(stride)));
-    origins.reserve(ceil(traj.GetFrameCount()/float(stride)));
-    GetIndices(prot_seg, indices_ca);
-    for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-      CoordFramePtr frame=traj.GetFrame(i);
-      best_plane=frame->GetODRPlane(indices_ca);
-      normals.push_back(best_plane.GetNormal());
-      origins.push_back(best_plane.GetOrigin());
-    }
+    int n_frames=traj.GetFrameCount();
+    BestFitPlaneFunc func(StridedFrameCount(0, n_frames, stride));
+    GetIndices(prot_seg, func.indices_ca);
+    ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+    normals.insert(normals.end(), func.normals.begin(), func.normals.end());
+    origins.insert(origins.end(), func.origins.begin(), func.origins.end());
     return;
   }
   
   std::vector<Real> AnalyzeHelicity(const CoordGroupHandle& traj, const EntityView& prot_seg,
-                                    unsigned int stride)
+                                    unsigned int stride, int num_threads)
   {
     CheckHandleValidity(traj);
     if (!prot_seg.HasAtoms()){
       throw Error("EntityView is empty");
     }
-    std::vector<unsigned long> indices_c,indices_o, indices_n, indices_ca;
-    std::vector<Real> helicity;
-    helicity.reserve(ceil(traj.GetFrameCount()/float(stride)));
-    GetCaCONIndices(prot_seg, indices_ca, indices_c, indices_o, indices_n);
-    for (size_t i=0; i<traj.GetFrameCount(); i+=stride) {
-      CoordFramePtr frame=traj.GetFrame(i);
-      helicity.push_back(frame->GetAlphaHelixContent(indices_ca,indices_c,indices_o,indices_n));
-    }
-    return helicity;
+    int n_frames=traj.GetFrameCount();
+    HelicityFunc func(StridedFrameCount(0, n_frames, stride));
+    GetCaCONIndices(prot_seg, func.indices_ca, func.indices_c, func.indices_o, 
+                    func.indices_n);
+    ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+    return func.helicity;
   }
 
   //This function constructs mean structures from a trajectory
   EntityHandle CreateMeanStructure(const CoordGroupHandle& traj, const EntityView& selection,
-                            int from, int to, unsigned int stride)
+                            int from, int to, unsigned int stride, int num_threads)
   {
     CheckHandleValidity(traj);
     if (to==-1)to=traj.GetFrameCount();
@@ -341,17 +595,13 @@ std::vector<Real> AnalyzeAromaticRingInteraction(const CoordGroupHandle& traj, c
       throw Error("number of frames is too small");
     }
     std::vector<unsigned long> indices;
-    std::vector<geom::Vec3> mean_positions;
     EntityHandle eh;
     eh=CreateEntityFromView(selection,1);
     GetIndices(selection,indices);
-    mean_positions.assign(n_atoms,geom::Vec3(0.0,0.0,0.0));
-    for (int i=from; i<to; i+=stride) {
-      CoordFramePtr frame=traj.GetFrame(i);
-      for (unsigned int j=0; j<n_atoms; ++j) {
-        mean_positions[j]+=(*frame)[indices[j]];
-      }
-    }
+    size_t chunk_size=ReductionChunkSize(n_frames);
+    PositionSumFunc func(indices, FrameChunkCount(n_frames, chunk_size));
+    ForEachFrame(traj, func, from, to, stride, num_threads, chunk_size);
+    geom::Vec3List mean_positions=func.Sum();
     mol::XCSEditor edi=eh.EditXCS(mol::BUFFERED_EDIT);
     AtomHandleList atoms=eh.GetAtomList();
     for (unsigned int j=0; j<n_atoms; ++j) {
@@ -360,7 +610,8 @@ std::vector<Real> AnalyzeAromaticRingInteraction(const CoordGroupHandle& traj, c
     return eh;
   }
 
-  Real AnalyzeRMSF(const CoordGroupHandle& traj, const EntityView& selection, int from, int to, unsigned int stride)
+  Real AnalyzeRMSF(const CoordGroupHandle& traj, const EntityView& selection, int from, int to, unsigned int stride,
+                   int num_threads)
   // This function extracts the rmsf between two entity views and assigns it 
   // The views don't have to be from the same entity
   // If you want to compare to frame i of the trajectory t, first use t.CopyFrame(i) for example:
@@ -379,26 +630,225 @@ std::vector<Real> AnalyzeAromaticRingInteraction(const CoordGroupHandle& traj, c
     if (n_frames<=1) {
       throw Error("number of frames is too small");
     }
-    Real rmsf=0.0;
-    geom::Vec3 v;
     std::vector<unsigned long> sele_indices;
-    std::vector<geom::Vec3> ref_pos(n_atoms,geom::Vec3(0.,0.,0.));
     GetIndices(selection, sele_indices);
+    size_t chunk_size=ReductionChunkSize(n_frames);
+    size_t n_chunks=FrameChunkCount(n_frames, chunk_size);
+    PositionSumFunc pos_func(sele_indices, n_chunks);
+    ForEachFrame(traj, pos_func, from, to, stride, num_threads, chunk_size);
+    geom::Vec3List ref_pos=pos_func.Sum();
     for (unsigned int j=0; j<n_atoms; ++j) {
-      for (int i=from; i<to; i+=stride) {
-        CoordFramePtr frame=traj.GetFrame(i);
-        ref_pos[j]+=frame->GetAtomPos(sele_indices[j]);
-      }
       ref_pos[j]/=n_frames;
     }
-    for (int i=from; i<to; i+=stride) {
-      CoordFramePtr frame=traj.GetFrame(i);
-      for (unsigned int j=0; j<n_atoms; ++j) {
-        v=frame->GetAtomPos(sele_indices[j])-ref_pos[j];
-        rmsf+=geom::Dot(v,v);
-      }
-    }
+    SquaredDeviationFunc dev_func(sele_indices, ref_pos, n_chunks);
+    ForEachFrame(traj, dev_func, from, to, stride, num_threads, chunk_size);
+    Real rmsf=dev_func.Sum();
     return sqrt(rmsf/float(n_atoms*n_frames));
   }
   
+TrajectoryPipeline::TrajectoryPipeline(): num_frames_(0) { }
+
+void TrajectoryPipeline::AddStage(const String& name, TrajectoryStagePtr stage)
+{
+  if (this->HasColumn(name)) {
+    throw Error("column '"+name+"' already exists");
+  }
+  names_.push_back(name);
+  stages_.push_back(stage);
+}
+
+void TrajectoryPipeline::AddAtomPos(const String& name, const AtomHandle& a1)
+{
+  this->AddStage(name, MakeStage(AtomPosFunc(a1.GetIndex(), 0), 
+                                 &AtomPosFunc::pos));
+}
+
+void TrajectoryPipeline::AddCenterOfMassPos(const String& name, 
+                                            const EntityView& sele)
+{
+  CenterOfMassPosFunc func(0);
+  GetIndicesAndMasses(sele, func.indices, func.masses);
+  this->AddStage(name, MakeStage(func, &CenterOfMassPosFunc::pos));
+}
+
+void TrajectoryPipeline::AddDistanceBetwAtoms(const String& name, 
+                                              const AtomHandle& a1,
+                                              const AtomHandle& a2)
+{
+  this->AddStage(name, MakeStage(DistanceFunc(a1.GetIndex(), a2.GetIndex(), 0),
+                                 &DistanceFunc::dist));
+}
+
+void TrajectoryPipeline::AddAngle(const String& name, const AtomHandle& a1, 
+                                  const AtomHandle& a2, const AtomHandle& a3)
+{
+  this->AddStage(name, MakeStage(AngleFunc(a1.GetIndex(), a2.GetIndex(), 
+                                           a3.GetIndex(), 0),
+                                 &AngleFunc::ang));
+}
+
+void TrajectoryPipeline::AddDihedralAngle(const String& name, 
+                                          const AtomHandle& a1,
+                                          const AtomHandle& a2,
+                                          const AtomHandle& a3,
+                                          const AtomHandle& a4)
+{
+  this->AddStage(name, MakeStage(DihedralAngleFunc(a1.GetIndex(), a2.GetIndex(),
+                                                   a3.GetIndex(), a4.GetIndex(),
+                                                   0),
+                                 &DihedralAngleFunc::ang));
+}
+
+void TrajectoryPipeline::AddDistanceBetwCenterOfMass(const String& name, 
+                                                     const EntityView& sele1,
+                                                     const EntityView& sele2)
+{
+  DistanceBetwCenterOfMassFunc func(0);
+  GetIndicesAndMasses(sele1, func.indices1, func.masses1);
+  GetIndicesAndMasses(sele2, func.indices2, func.masses2);
+  this->AddStage(name, MakeStage(func, &DistanceBetwCenterOfMassFunc::dist));
+}
+
+void TrajectoryPipeline::AddRMSD(const String& name, 
+                                 const EntityView& reference_view,
+                                 const EntityView& sele)
+{
+  if (reference_view.GetAtomCount()!=sele.GetAtomCount()) {
+    throw Error("atom counts of the two views are not equal");
+  }
+  RMSDFunc func(0);
+  GetIndices(sele, func.sele_indices);
+  GetPositions(reference_view, func.ref_pos);
+  this->AddStage(name, MakeStage(func, &RMSDFunc::rmsd));
+}
+
+void TrajectoryPipeline::AddRadiusOfGyration(const String& name, 
+                                             const EntityView& sele)
+{
+  if (!sele.HasAtoms()) {
+    throw Error("EntityView is empty");
+  }
+  RadiusOfGyrationFunc func(0);
+  GetIndicesAndMasses(sele, func.indices, func.masses);
+  // without masses, fall back to the unweighted radius of gyration instead of
+  // dividing by zero
+  if (sele.GetMass()<=0.0) {
+    func.masses.assign(func.indices.size(), Real(1.0)/func.indices.size());
+  }
+  this->AddStage(name, MakeStage(func, &RadiusOfGyrationFunc::rg));
+}
+
+void TrajectoryPipeline::AddMinDistance(const String& name, 
+                                        const EntityView& view1,
+                                        const EntityView& view2)
+{
+  if (!view1.HasAtoms()) {
+    throw Error("first EntityView is empty");
+  }
+  if (!view2.HasAtoms()) {
+    throw Error("second EntityView is empty");
+  }
+  MinDistanceFunc func(0);
+  GetIndices(view1, func.indices1);
+  GetIndices(view2, func.indices2);
+  this->AddStage(name, MakeStage(func, &MinDistanceFunc::dist));
+}
+
+void TrajectoryPipeline::AddMinDistanceBetwCenterOfMassAndView(const String& name,
+                                                               const EntityView& view_cm,
+                                                               const EntityView& view_atoms)
+{
+  if (!view_cm.HasAtoms()) {
+    throw Error("first EntityView is empty");
+  }
+  if (!view_atoms.HasAtoms()) {
+    throw Error("second EntityView is empty");
+  }
+  MinDistBetwCenterOfMassAndViewFunc func(0);
+  GetIndicesAndMasses(view_cm, func.indices_cm, func.masses_cm);
+  GetIndices(view_atoms, func.indices_atoms);
+  this->AddStage(name, MakeStage(func, 
+                                 &MinDistBetwCenterOfMassAndViewFunc::dist));
+}
+
+void TrajectoryPipeline::AddAromaticRingInteraction(const String& name,
+                                                    const EntityView& view_ring1,
+                                                    const EntityView& view_ring2)
+{
+  if (!view_ring1.HasAtoms()) {
+    throw Error("first EntityView is empty");
+  }
+  if (!view_ring2.HasAtoms()) {
+    throw Error("second EntityView is empty");
+  }
+  AromaticRingInteractionFunc func(0);
+  GetIndicesAndMasses(view_ring1, func.indices_ring1, func.masses_ring1);
+  GetIndicesAndMasses(view_ring2, func.indices_ring2, func.masses_ring2);
+  this->AddStage(name, MakeStage(func, &AromaticRingInteractionFunc::dist));
+}
+
+void TrajectoryPipeline::AddHelicity(const String& name, 
+                                     const EntityView& prot_seg)
+{
+  if (!prot_seg.HasAtoms()) {
+    throw Error("EntityView is empty");
+  }
+  HelicityFunc func(0);
+  GetCaCONIndices(prot_seg, func.indices_ca, func.indices_c, func.indices_o, 
+                  func.indices_n);
+  this->AddStage(name, MakeStage(func, &HelicityFunc::helicity));
+}
+
+void TrajectoryPipeline::Run(const CoordGroupHandle& traj, unsigned int stride,
+                             int num_threads)
+{
+  CheckHandleValidity(traj);
+  int n_frames=traj.GetFrameCount();
+  size_t n_visited=StridedFrameCount(0, n_frames, std::max(1u, stride));
+  columns_.clear();
+  vector_columns_.clear();
+  num_frames_=0;
+  for (size_t i=0; i<stages_.size(); ++i) {
+    stages_[i]->Prepare(n_visited);
+  }
+  PipelineFunc func(stages_);
+  ForEachFrame(traj, func, 0, n_frames, stride, num_threads);
+  for (size_t i=0; i<stages_.size(); ++i) {
+    stages_[i]->Store(names_[i], columns_, vector_columns_);
+  }
+  num_frames_=n_visited;
+}
+
+bool TrajectoryPipeline::HasColumn(const String& name) const
+{
+  return std::find(names_.begin(), names_.end(), name)!=names_.end();
+}
+
+bool TrajectoryPipeline::IsVectorColumn(const String& name) const
+{
+  if (!this->HasColumn(name)) {
+    throw Error("no column named '"+name+"'");
+  }
+  size_t index=std::find(names_.begin(), names_.end(), name)-names_.begin();
+  return stages_[index]->IsVector();
+}
+
+const std::vector<Real>& TrajectoryPipeline::GetColumn(const String& name) const
+{
+  std::map<String, std::vector<Real> >::const_iterator i=columns_.find(name);
+  if (i==columns_.end()) {
+    throw Error("no scalar column named '"+name+"', was the pipeline run?");
+  }
+  return i->second;
+}
+
+const geom::Vec3List& TrajectoryPipeline::GetVectorColumn(const String& name) const
+{
+  std::map<String, geom::Vec3List>::const_iterator i=vector_columns_.find(name);
+  if (i==vector_columns_.end()) {
+    throw Error("no vector column named '"+name+"', was the pipeline run?");
+  }
+  return i->second;
+}
+  
 }}} //ns
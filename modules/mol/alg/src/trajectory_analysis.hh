@@ -25,6 +25,8 @@
 
 #include <ost/mol/alg/module_config.hh>
 
+#include <map>
+#include <boost/shared_ptr.hpp>
 #include <ost/base.hh>
 #include <ost/geom/geom.hh>
 #include <ost/mol/entity_view.hh>
@@ -32,22 +34,79 @@
 
 
 namespace ost { namespace mol { namespace alg {
-  
-  geom::Vec3List DLLEXPORT_OST_MOL_ALG AnalyzeAtomPos(const CoordGroupHandle& traj, const AtomHandle& a1,unsigned int stride=1);
-  geom::Vec3List DLLEXPORT_OST_MOL_ALG AnalyzeCenterOfMassPos(const CoordGroupHandle& traj, const EntityView& sele,unsigned int stride=1);
-  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeDistanceBetwAtoms(const CoordGroupHandle& traj, const AtomHandle& a1, const AtomHandle& a2,unsigned int stride=1);
-  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeAngle(const CoordGroupHandle& traj, const AtomHandle& a1, const AtomHandle& a2, const AtomHandle& a3,unsigned int stride=1);
-  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeDistanceBetwCenterOfMass(const CoordGroupHandle& traj, const EntityView& sele1, const EntityView& sele2,unsigned int stride=1);
-  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeDihedralAngle(const CoordGroupHandle& traj, const AtomHandle& a1, const AtomHandle& a2, const AtomHandle& a3, const AtomHandle& a4,unsigned int stride=1);
-  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeRMSD(const CoordGroupHandle& traj, const EntityView& reference_view, const EntityView& sele,unsigned int stride=1);
-  Real DLLEXPORT_OST_MOL_ALG AnalyzeRMSF(const CoordGroupHandle& traj, const EntityView& selection,int from=0, int to=-1, unsigned int stride=1);
-  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeMinDistance(const CoordGroupHandle& traj, const EntityView& view1, const EntityView& view2,unsigned int stride=1);
-  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeMinDistanceBetwCenterOfMassAndView(const CoordGroupHandle& traj, const EntityView& view_cm, const EntityView& view_atoms,unsigned int stride=1);
-  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeAromaticRingInteraction(const CoordGroupHandle& traj, const EntityView& view_ring1, const EntityView& view_ring2,unsigned int stride=1);
-  void  DLLEXPORT_OST_MOL_ALG AnalyzeAlphaHelixAxis(const CoordGroupHandle& traj, const EntityView& prot_seg, geom::Vec3List& directions, geom::Vec3List& centers, unsigned int stride=1);
-  void  DLLEXPORT_OST_MOL_ALG AnalyzeBestFitLine(const CoordGroupHandle& traj, const EntityView& prot_seg, geom::Vec3List& directions, geom::Vec3List& centers, unsigned int stride=1);
-  void  DLLEXPORT_OST_MOL_ALG AnalyzeBestFitPlane(const CoordGroupHandle& traj, const EntityView& prot_seg, geom::Vec3List& normals, geom::Vec3List& origins, unsigned int stride=1);
-  EntityHandle  DLLEXPORT_OST_MOL_ALG CreateMeanStructure(const CoordGroupHandle& traj, const EntityView& selection, int from=0, int to=-1, unsigned int stride=1);
-  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeHelicity(const CoordGroupHandle& traj, const EntityView& prot_seg, unsigned int stride=1);
+
+  // All functions visit every stride-th frame. The frames are distributed over
+  // num_threads threads, 0 means one thread per core.
+  geom::Vec3List DLLEXPORT_OST_MOL_ALG AnalyzeAtomPos(const CoordGroupHandle& traj, const AtomHandle& a1,unsigned int stride=1, int num_threads=1);
+  geom::Vec3List DLLEXPORT_OST_MOL_ALG AnalyzeCenterOfMassPos(const CoordGroupHandle& traj, const EntityView& sele,unsigned int stride=1, int num_threads=1);
+  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeDistanceBetwAtoms(const CoordGroupHandle& traj, const AtomHandle& a1, const AtomHandle& a2,unsigned int stride=1, int num_threads=1);
+  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeAngle(const CoordGroupHandle& traj, const AtomHandle& a1, const AtomHandle& a2, const AtomHandle& a3,unsigned int stride=1, int num_threads=1);
+  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeDistanceBetwCenterOfMass(const CoordGroupHandle& traj, const EntityView& sele1, const EntityView& sele2,unsigned int stride=1, int num_threads=1);
+  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeDihedralAngle(const CoordGroupHandle& traj, const AtomHandle& a1, const AtomHandle& a2, const AtomHandle& a3, const AtomHandle& a4,unsigned int stride=1, int num_threads=1);
+  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeRMSD(const CoordGroupHandle& traj, const EntityView& reference_view, const EntityView& sele,unsigned int stride=1, int num_threads=1);
+  Real DLLEXPORT_OST_MOL_ALG AnalyzeRMSF(const CoordGroupHandle& traj, const EntityView& selection,int from=0, int to=-1, unsigned int stride=1, int num_threads=1);
+  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeMinDistance(const CoordGroupHandle& traj, const EntityView& view1, const EntityView& view2,unsigned int stride=1, int num_threads=1);
+  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeMinDistanceBetwCenterOfMassAndView(const CoordGroupHandle& traj, const EntityView& view_cm, const EntityView& view_atoms,unsigned int stride=1, int num_threads=1);
+  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeAromaticRingInteraction(const CoordGroupHandle& traj, const EntityView& view_ring1, const EntityView& view_ring2,unsigned int stride=1, int num_threads=1);
+  void  DLLEXPORT_OST_MOL_ALG AnalyzeAlphaHelixAxis(const CoordGroupHandle& traj, const EntityView& prot_seg, geom::Vec3List& directions, geom::Vec3List& centers, unsigned int stride=1, int num_threads=1);
+  void  DLLEXPORT_OST_MOL_ALG AnalyzeBestFitLine(const CoordGroupHandle& traj, const EntityView& prot_seg, geom::Vec3List& directions, geom::Vec3List& centers, unsigned int stride=1, int num_threads=1);
+  void  DLLEXPORT_OST_MOL_ALG AnalyzeBestFitPlane(const CoordGroupHandle& traj, const EntityView& prot_seg, geom::Vec3List& normals, geom::Vec3List& origins, unsigned int stride=1, int num_threads=1);
+  EntityHandle  DLLEXPORT_OST_MOL_ALG CreateMeanStructure(const CoordGroupHandle& traj, const EntityView& selection, int from=0, int to=-1, unsigned int stride=1, int num_threads=1);
+  std::vector<Real> DLLEXPORT_OST_MOL_ALG AnalyzeHelicity(const CoordGroupHandle& traj, const EntityView& prot_seg, unsigned int stride=1, int num_threads=1);
+
+  class TrajectoryStage;
+  typedef boost::shared_ptr<TrajectoryStage> TrajectoryStagePtr;
+
+  /// \brief evaluates several trajectory analyses in a single pass
+  ///
+  /// Every Add method registers one per-frame quantity under a column name.
+  /// Run then reads each visited frame once and evaluates all registered
+  /// quantities on it, which avoids reading (possibly lazily loaded) frames
+  /// once per analysis. Column i holds the value for the i-th visited frame.
+  class DLLEXPORT_OST_MOL_ALG TrajectoryPipeline {
+  public:
+    TrajectoryPipeline();
+
+    void AddAtomPos(const String& name, const AtomHandle& a1);
+    void AddCenterOfMassPos(const String& name, const EntityView& sele);
+    void AddDistanceBetwAtoms(const String& name, const AtomHandle& a1, const AtomHandle& a2);
+    void AddAngle(const String& name, const AtomHandle& a1, const AtomHandle& a2, const AtomHandle& a3);
+    void AddDihedralAngle(const String& name, const AtomHandle& a1, const AtomHandle& a2, const AtomHandle& a3, const AtomHandle& a4);
+    void AddDistanceBetwCenterOfMass(const String& name, const EntityView& sele1, const EntityView& sele2);
+    void AddRMSD(const String& name, const EntityView& reference_view, const EntityView& sele);
+    void AddRadiusOfGyration(const String& name, const EntityView& sele);
+    void AddMinDistance(const String& name, const EntityView& view1, const EntityView& view2);
+    void AddMinDistanceBetwCenterOfMassAndView(const String& name, const EntityView& view_cm, const EntityView& view_atoms);
+    void AddAromaticRingInteraction(const String& name, const EntityView& view_ring1, const EntityView& view_ring2);
+    void AddHelicity(const String& name, const EntityView& prot_seg);
+
+    /// \brief evaluate all registered quantities on every stride-th frame
+    ///
+    /// Results of a previous run are replaced.
+    void Run(const CoordGroupHandle& traj, unsigned int stride=1, int num_threads=1);
+
+    /// \brief number of frames visited by the last run
+    size_t GetFrameCount() const { return num_frames_; }
+
+    /// \brief names of all columns in the order they were added
+    const std::vector<String>& GetColumnNames() const { return names_; }
+
+    bool HasColumn(const String& name) const;
+    bool IsVectorColumn(const String& name) const;
+
+    /// \brief values of a column holding scalars, such as distances
+    const std::vector<Real>& GetColumn(const String& name) const;
+
+    /// \brief values of a column holding positions
+    const geom::Vec3List& GetVectorColumn(const String& name) const;
+  private:
+    void AddStage(const String& name, TrajectoryStagePtr stage);
+
+    std::vector<String>                    names_;
+    std::vector<TrajectoryStagePtr>        stages_;
+    std::map<String, std::vector<Real> >   columns_;
+    std::map<String, geom::Vec3List>       vector_columns_;
+    size_t                                 num_frames_;
+  };
 }}}//ns
 #endif
@@ -108,6 +108,22 @@ class TestAccessibility(unittest.TestCase):
     except:
       print("Could not find NACCESS, could not compare Accessiblity function...")
 
+  def testAccThreads(self):
+
+    # the result must not depend on the number of threads
+    ent = io.LoadPDB(os.path.join("testfiles", "1a0s.pdb"))
+    ent = ent.Select("peptide=true")
+    for algorithm in [mol.alg.AccessibilityAlgorithm.NACCESS,
+                      mol.alg.AccessibilityAlgorithm.DSSP]:
+      mol.alg.Accessibility(ent, oligo_mode=True, algorithm=algorithm)
+      mol.alg.Accessibility(ent, oligo_mode=True, algorithm=algorithm,
+                            asa_atom="asaThreads", num_threads=4)
+      for a in ent.atoms:
+        self.assertEqual(a.GetFloatProp("asaAtom"),
+                         a.GetFloatProp("asaThreads"))
+        self.assertEqual(a.GetFloatProp("asaAtom_single_chain"),
+                         a.GetFloatProp("asaThreads_single_chain"))
+
 
   def testAccDSSP(self):
 
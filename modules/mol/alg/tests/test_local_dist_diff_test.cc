@@ -0,0 +1,255 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <ost/mol/mol.hh>
+#include <ost/mol/alg/local_dist_diff_test.hh>
+
+using namespace ost;
+using namespace ost::mol;
+using namespace ost::mol::alg;
+
+namespace {
+
+const char* RNAMES[]={ "GLU", "ALA", "VAL", "ASP", "LEU", "GLU", "SER", "PHE" };
+
+// builds a small helical peptide. Positions are perturbed by noise, scaled 
+// by the given amount.
+EntityHandle make_peptide(Real noise, bool swap_glu=false, 
+                          int skip_residue=-1)
+{
+  EntityHandle ent=CreateEntity();
+  XCSEditor edi=ent.EditXCS();
+  ChainHandle chain=edi.InsertChain("A");
+  const char* anames[]={ "N", "CA", "C", "O", "CB", "CG", "CD", "OE1", "OE2" };
+  for (int i=0; i<8; ++i) {
+    if (i==skip_residue) {
+      continue;
+    }
+    ResidueHandle res=edi.AppendResidue(chain, RNAMES[i], ResNum(i+1));
+    int num_atoms=String(RNAMES[i])=="GLU" ? 9 : 5;
+    for (int j=0; j<num_atoms; ++j) {
+      Real t=i*1.7+j*0.35;
+      geom::Vec3 pos(2.3*cos(t)+0.4*j, 2.3*sin(t), 1.5*i+0.2*j);
+      pos+=geom::Vec3(sin(7.0*t+j), cos(5.0*t-i), sin(3.0*t*j))*noise;
+      String aname=anames[j];
+      if (swap_glu && aname.substr(0, 2)=="OE") {
+        aname=aname=="OE1" ? "OE2" : "OE1";
+      }
+      edi.InsertAtom(res, aname, pos, aname.substr(0, 1));
+    }
+  }
+  return ent;
+}
+
+std::vector<Real> ldt_cutoffs()
+{
+  std::vector<Real> cutoffs;
+  cutoffs.push_back(0.5);
+  cutoffs.push_back(1.0);
+  cutoffs.push_back(2.0);
+  cutoffs.push_back(4.0);
+  return cutoffs;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( mol_alg );
+
+BOOST_AUTO_TEST_CASE(lddt_distance_table) 
+{
+  EntityView ref=make_peptide(0.0).CreateFullView();
+  std::vector<Real> cutoffs=ldt_cutoffs();
+  for (int sep=0; sep<2; ++sep) {
+    GlobalRDMap glob_dist_list=CreateDistanceList(ref, 8.0);
+    lDDTDistanceTable table(glob_dist_list, sep);
+    BOOST_CHECK_EQUAL(table.GetResidueCount(), glob_dist_list.size());
+    for (int k=0; k<4; ++k) {
+      bool swap_glu=k%2==1;
+      int skip=k>=2 ? 3 : -1;
+      // the table does not modify the model, so it can be scored first
+      EntityView mdl=make_peptide(0.6, swap_glu, skip).CreateFullView();
+      lDDTModelScore score=table.Score(mdl, cutoffs);
+      std::pair<long int, long int> ov=LocalDistDiffTest(mdl, glob_dist_list,
+                                                         cutoffs, sep, 
+                                                         "lddt");
+      BOOST_CHECK_EQUAL(score.conserved_dist, ov.first);
+      BOOST_CHECK_EQUAL(score.total_dist, ov.second);
+      BOOST_CHECK_CLOSE(score.global_score, 
+                        Real(ov.first)/(ov.second ? ov.second : 1), 1e-4);
+      std::vector<lDDTLocalScore> local=GetlDDTPerResidueStats(mdl, 
+                                                               glob_dist_list,
+                                                               false, "lddt");
+      BOOST_REQUIRE_EQUAL(score.local_scores.size(), local.size());
+      for (size_t i=0; i<local.size(); ++i) {
+        BOOST_CHECK_EQUAL(score.local_scores[i].ToString(false), 
+                          local[i].ToString(false));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(lddt_distance_table_parallel) 
+{
+  EntityView ref=make_peptide(0.0).CreateFullView();
+  std::vector<Real> cutoffs=ldt_cutoffs();
+  lDDTDistanceTable table(CreateDistanceList(ref, 10.0));
+  std::vector<EntityView> models;
+  for (int i=0; i<16; ++i) {
+    models.push_back(make_peptide(0.1*i, i%3==0, i%5-1).CreateFullView());
+  }
+  std::vector<lDDTModelScore> scores=LocalDistDiffTest(models, table, cutoffs,
+                                                       4);
+  BOOST_REQUIRE_EQUAL(scores.size(), models.size());
+  for (size_t i=0; i<models.size(); ++i) {
+    lDDTModelScore score=table.Score(models[i], cutoffs);
+    BOOST_CHECK_EQUAL(scores[i].conserved_dist, score.conserved_dist);
+    BOOST_CHECK_EQUAL(scores[i].total_dist, score.total_dist);
+    BOOST_CHECK_EQUAL(scores[i].local_scores.size(), 
+                      score.local_scores.size());
+  }
+  BOOST_CHECK_EQUAL(scores[0].conserved_dist, scores[0].total_dist);
+  BOOST_CHECK(LocalDistDiffTest(std::vector<EntityView>(), table, 
+                                cutoffs).empty());
+}
+
+BOOST_AUTO_TEST_CASE(lddt_distance_table_from_entity) 
+{
+  EntityView ref=make_peptide(0.0).CreateFullView();
+  std::vector<Real> cutoffs=ldt_cutoffs();
+  for (int sep=0; sep<3; ++sep) {
+    lDDTDistanceTable from_map(CreateDistanceList(ref, 8.0), sep);
+    lDDTDistanceTable from_ent(ref, 8.0, sep);
+    BOOST_CHECK_EQUAL(from_ent.GetResidueCount(), from_map.GetResidueCount());
+    BOOST_CHECK_EQUAL(from_ent.GetDistanceCount(), 
+                      from_map.GetDistanceCount());
+    for (int k=0; k<4; ++k) {
+      EntityView mdl=make_peptide(0.5, k%2==1, k>=2 ? 4 : -1).CreateFullView();
+      lDDTModelScore s1=from_map.Score(mdl, cutoffs);
+      lDDTModelScore s2=from_ent.Score(mdl, cutoffs);
+      BOOST_CHECK_EQUAL(s1.conserved_dist, s2.conserved_dist);
+      BOOST_CHECK_EQUAL(s1.total_dist, s2.total_dist);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(lddt_distance_table_io) 
+{
+  EntityView ref=make_peptide(0.0).CreateFullView();
+  std::vector<Real> cutoffs=ldt_cutoffs();
+  lDDTDistanceTable table(ref, 10.0, 1);
+  table.Save("testfiles/lddt_table-out.dat");
+  lDDTDistanceTable loaded=lDDTDistanceTable::Load("testfiles/lddt_table-out.dat");
+  BOOST_CHECK_EQUAL(loaded.GetResidueCount(), table.GetResidueCount());
+  BOOST_CHECK_EQUAL(loaded.GetDistanceCount(), table.GetDistanceCount());
+  BOOST_CHECK_EQUAL(loaded.GetSequenceSeparation(), 1);
+  EntityView mdl=make_peptide(0.7, true).CreateFullView();
+  lDDTModelScore s1=table.Score(mdl, cutoffs);
+  lDDTModelScore s2=loaded.Score(mdl, cutoffs);
+  BOOST_CHECK_EQUAL(s1.conserved_dist, s2.conserved_dist);
+  BOOST_CHECK_EQUAL(s1.total_dist, s2.total_dist);
+  BOOST_CHECK_THROW(lDDTDistanceTable::Load("testfiles/does-not-exist.dat"),
+                    ost::Error);
+  BOOST_CHECK_THROW(lDDTDistanceTable::Load("testfiles/1a0s.pdb"),
+                    ost::Error);
+}
+
+namespace {
+
+// writes a table with two residues, one atom name, no atoms and no distances
+// to filename. The magic number and version are taken from a saved table.
+void write_small_table(const String& filename, const String& header,
+                       int first_res, int second_res, 
+                       const std::vector<uint32_t>& offsets)
+{
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  out.write(header.data(), header.size());
+  int32_t seq_sep=1;
+  out.write(reinterpret_cast<const char*>(&seq_sep), sizeof(int32_t));
+  uint32_t num_residues=2;
+  out.write(reinterpret_cast<const char*>(&num_residues), sizeof(uint32_t));
+  int32_t nums[]={first_res, second_res};
+  for (int i=0; i<2; ++i) {
+    out.write(reinterpret_cast<const char*>(&nums[i]), sizeof(int32_t));
+    out.put('\0');
+  }
+  uint32_t num_names=1;
+  out.write(reinterpret_cast<const char*>(&num_names), sizeof(uint32_t));
+  out.put(char(2));
+  out.write("CA", 2);
+  uint32_t zero=0;
+  out.write(reinterpret_cast<const char*>(&zero), sizeof(uint32_t));
+  uint32_t num_offsets=offsets.size();
+  out.write(reinterpret_cast<const char*>(&num_offsets), sizeof(uint32_t));
+  out.write(reinterpret_cast<const char*>(&offsets.front()),
+            sizeof(uint32_t)*offsets.size());
+  out.write(reinterpret_cast<const char*>(&zero), sizeof(uint32_t));
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(lddt_distance_table_io_corrupt) 
+{
+  EntityView ref=make_peptide(0.0).CreateFullView();
+  lDDTDistanceTable table(ref, 10.0, 1);
+  table.Save("testfiles/lddt_table-out.dat");
+  std::ifstream in("testfiles/lddt_table-out.dat", std::ios::binary);
+  String header(5, '\0');
+  in.read(&header[0], header.size());
+  std::vector<uint32_t> offsets(3, 0);
+  write_small_table("testfiles/lddt_table-out.dat", header, 1, 2, offsets);
+  lDDTDistanceTable loaded=lDDTDistanceTable::Load("testfiles/lddt_table-out.dat");
+  BOOST_CHECK_EQUAL(loaded.GetResidueCount(), size_t(2));
+  BOOST_CHECK_EQUAL(loaded.GetDistanceCount(), size_t(0));
+  // offsets must not decrease
+  offsets[1]=1;
+  write_small_table("testfiles/lddt_table-out.dat", header, 1, 2, offsets);
+  BOOST_CHECK_THROW(lDDTDistanceTable::Load("testfiles/lddt_table-out.dat"),
+                    ost::Error);
+}
+
+BOOST_AUTO_TEST_CASE(lddt_distance_table_io_nonstandard) 
+{
+  // MSE is not assessed, so it is stored after the assessed residues, out of
+  // residue number order.
+  EntityHandle ent=make_peptide(0.0);
+  XCSEditor edi=ent.EditXCS();
+  edi.RenameResidue(ent.FindResidue("A", ResNum(4)), "MSE");
+  std::vector<Real> cutoffs=ldt_cutoffs();
+  lDDTDistanceTable table(ent.CreateFullView(), 10.0, 1);
+  BOOST_CHECK_EQUAL(table.GetResidueCount(), size_t(7));
+  table.Save("testfiles/lddt_table-out.dat");
+  lDDTDistanceTable loaded=lDDTDistanceTable::Load("testfiles/lddt_table-out.dat");
+  BOOST_CHECK_EQUAL(loaded.GetResidueCount(), table.GetResidueCount());
+  BOOST_CHECK_EQUAL(loaded.GetDistanceCount(), table.GetDistanceCount());
+  EntityHandle mdl=make_peptide(0.7, true);
+  edi=mdl.EditXCS();
+  edi.RenameResidue(mdl.FindResidue("A", ResNum(4)), "MSE");
+  lDDTModelScore s1=table.Score(mdl.CreateFullView(), cutoffs);
+  lDDTModelScore s2=loaded.Score(mdl.CreateFullView(), cutoffs);
+  BOOST_CHECK(s1.total_dist>0);
+  BOOST_CHECK_EQUAL(s1.conserved_dist, s2.conserved_dist);
+  BOOST_CHECK_EQUAL(s1.total_dist, s2.total_dist);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -21,6 +21,7 @@
  * Author Juergen Haas
  */
 #include <ost/mol/alg/svd_superpose.hh>
+#include <ost/mol/alg/superpose_frames.hh>
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
 #include <ost/mol/mol.hh>
@@ -118,7 +119,55 @@ BOOST_AUTO_TEST_CASE(iterative_superposition_svd)
   BOOST_CHECK_THROW(IterativeSuperposeSVD(ev1, ev2, 5, 5.0, false), Error);
 }
 
-
-
+BOOST_AUTO_TEST_CASE(superpose_frames)
+{
+  Fixture f;
+  AtomHandleList atoms=f.e.GetAtomList();
+  CoordGroupHandle cg=CreateCoordGroup(atoms);
+  for (int i=0; i<10; ++i) {
+    geom::Mat4 tf=geom::Mat4(geom::EulerTransformation(0.3*i, 0.1*i, -0.2*i));
+    tf.PasteTranslation(geom::Vec3(i, -2*i, 0.5*i));
+    geom::Vec3List pos;
+    for (AtomHandleList::const_iterator a=atoms.begin(), 
+         e=atoms.end(); a!=e; ++a) {
+      pos.push_back(geom::Vec3(tf*geom::Vec4(a->GetPos())));
+    }
+    cg.AddFrame(pos);
+  }
+  EntityView sel=f.e.Select("aname=A,B,C,E");
+  EntityView ref_view=f.e.CreateFullView();
+  CoordGroupHandle superposed=SuperposeFrames(cg, sel, 0, -1, 3);
+  CoordGroupHandle lazy=SuperposeFramesLazy(cg, sel, 2, 8, 3, 2);
+  CoordGroupHandle on_view=SuperposeFrames(cg, ref_view, ref_view, 0, -1, 2);
+  BOOST_CHECK_EQUAL(superposed.GetFrameCount(), uint(10));
+  BOOST_CHECK_EQUAL(lazy.GetFrameCount(), uint(6));
+  geom::Vec3List ref_pos=cg.GetFramePositions(3);
+  for (uint i=0; i<superposed.GetFrameCount(); ++i) {
+    geom::Vec3List pos=superposed.GetFramePositions(i);
+    geom::Vec3List view_pos=on_view.GetFramePositions(i);
+    for (size_t j=0; j<pos.size(); ++j) {
+      BOOST_CHECK(geom::Distance(pos[j], ref_pos[j])<1e-4);
+      BOOST_CHECK(geom::Distance(view_pos[j], atoms[j].GetPos())<1e-4);
+    }
+  }
+  for (uint i=0; i<lazy.GetFrameCount(); ++i) {
+    geom::Vec3List pos=lazy.GetFramePositions(i);
+    geom::Vec3List pos2=superposed.GetFramePositions(i+2);
+    for (size_t j=0; j<pos.size(); ++j) {
+      BOOST_CHECK(geom::Distance(pos[j], pos2[j])<1e-5);
+    }
+  }
+  // superposing every frame on the previous one gives the first frame
+  SuperposeFramesInPlace(cg, sel, 0, -1, -1, 2);
+  ref_pos=cg.GetFramePositions(0);
+  for (uint i=1; i<cg.GetFrameCount(); ++i) {
+    geom::Vec3List pos=cg.GetFramePositions(i);
+    for (size_t j=0; j<pos.size(); ++j) {
+      BOOST_CHECK(geom::Distance(pos[j], ref_pos[j])<1e-4);
+    }
+  }
+  EntityView empty=f.e.Select("aname=X");
+  BOOST_CHECK_THROW(SuperposeFrames(cg, empty, 0, -1, 0), Error);
+}
 
 BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,189 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+
+#include <ost/mol/alg/trajectory_analysis.hh>
+#include <ost/mol/alg/parallel_frames.hh>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <ost/mol/mol.hh>
+#include <ost/mol/builder.hh>
+#include <ost/mol/coord_group.hh>
+#include <ost/message.hh>
+
+using namespace ost;
+using namespace ost::mol;
+using namespace ost::mol::alg;
+
+namespace {
+
+struct Fixture {
+  Fixture() {
+    e = Builder()
+           .Chain("A")
+              .Residue("DUM")
+                .Atom("A",geom::Vec3(-5,-5,-5))
+                .Atom("B",geom::Vec3(-5, 5,-5))
+                .Atom("C",geom::Vec3(-5, 5, 5))
+                .Atom("D",geom::Vec3(-5,-5, 5))
+                .Atom("E",geom::Vec3(5,-5, 5))
+                .Atom("F",geom::Vec3(5,-5,-5))
+                .Atom("G",geom::Vec3(5, 5,-5))
+                .Atom("H",geom::Vec3(5, 5, 5));
+    atoms = e.GetAtomList();
+    traj = CreateCoordGroup(atoms);
+    // deterministic wobble, so every frame differs from the others
+    for (int f=0; f<101; ++f) {
+      geom::Vec3List pos;
+      for (size_t i=0; i<atoms.size(); ++i) {
+        Real d=Real(0.01)*((f*7+i*13)%17);
+        pos.push_back(atoms[i].GetPos()+geom::Vec3(d, -d, Real(0.5)*d));
+      }
+      traj.AddFrame(pos);
+    }
+  }
+  EntityHandle e;
+  AtomHandleList atoms;
+  CoordGroupHandle traj;
+};
+
+struct CountFrames {
+  CountFrames(size_t n): visited(n, 0) { }
+  void operator()(size_t chunk, size_t k, const CoordFrame& frame) {
+    visited[k]+=1;
+  }
+  std::vector<int> visited;
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE( mol_alg );
+
+BOOST_AUTO_TEST_CASE(for_each_frame)
+{
+  Fixture f;
+  BOOST_CHECK_EQUAL(StridedFrameCount(0, 101, 1), size_t(101));
+  BOOST_CHECK_EQUAL(StridedFrameCount(1, 101, 3), size_t(34));
+  BOOST_CHECK_EQUAL(StridedFrameCount(5, 5, 3), size_t(0));
+  for (int num_threads=1; num_threads<=4; ++num_threads) {
+    CountFrames func(StridedFrameCount(1, 101, 3));
+    ForEachFrame(f.traj, func, 1, 101, 3, num_threads, 5);
+    for (size_t k=0; k<func.visited.size(); ++k) {
+      BOOST_CHECK_EQUAL(func.visited[k], 1);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(trajectory_analysis_threads)
+{
+  Fixture f;
+  EntityView full=f.e.CreateFullView();
+  EntityView half=f.e.Select("aname=A,B,C,D");
+  std::vector<Real> dist=AnalyzeDistanceBetwAtoms(f.traj, f.atoms[0],
+                                                   f.atoms[7], 2, 1);
+  std::vector<Real> rmsd=AnalyzeRMSD(f.traj, full, full, 1, 1);
+  Real rmsf=AnalyzeRMSF(f.traj, half, 0, -1, 1, 1);
+  EntityHandle mean=CreateMeanStructure(f.traj, full, 0, -1, 1, 1);
+  BOOST_CHECK_EQUAL(dist.size(), size_t(51));
+  BOOST_CHECK_EQUAL(rmsd.size(), size_t(101));
+  BOOST_CHECK(rmsf>0.0);
+  for (int num_threads=0; num_threads<=4; num_threads+=2) {
+    std::vector<Real> dist2=AnalyzeDistanceBetwAtoms(f.traj, f.atoms[0],
+                                                      f.atoms[7], 2,
+                                                      num_threads);
+    std::vector<Real> rmsd2=AnalyzeRMSD(f.traj, full, full, 1, num_threads);
+    BOOST_CHECK(dist==dist2);
+    BOOST_CHECK(rmsd==rmsd2);
+    // the partial sums don't depend on the number of threads, so neither
+    // does the result
+    BOOST_CHECK_EQUAL(AnalyzeRMSF(f.traj, half, 0, -1, 1, num_threads), rmsf);
+    EntityHandle mean2=CreateMeanStructure(f.traj, full, 0, -1, 1,
+                                           num_threads);
+    AtomHandleList a1=mean.GetAtomList(), a2=mean2.GetAtomList();
+    BOOST_CHECK_EQUAL(a1.size(), a2.size());
+    for (size_t i=0; i<a1.size(); ++i) {
+      BOOST_CHECK(a1[i].GetPos()==a2[i].GetPos());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(trajectory_pipeline)
+{
+  Fixture f;
+  for (size_t i=0; i<f.atoms.size(); ++i) {
+    f.atoms[i].SetMass(1.0);
+  }
+  EntityView full=f.e.CreateFullView();
+  EntityView half=f.e.Select("aname=A,B,C,D");
+  TrajectoryPipeline pipeline;
+  pipeline.AddDistanceBetwAtoms("dist", f.atoms[0], f.atoms[7]);
+  pipeline.AddRMSD("rmsd", full, full);
+  pipeline.AddCenterOfMassPos("com", half);
+  pipeline.AddRadiusOfGyration("rg", full);
+  BOOST_CHECK_THROW(pipeline.AddRMSD("rmsd", full, full), Error);
+  BOOST_CHECK_THROW(pipeline.AddRMSD("bad", full, half), Error);
+  BOOST_CHECK_THROW(pipeline.GetColumn("dist"), Error);
+  BOOST_CHECK_EQUAL(pipeline.GetColumnNames().size(), size_t(4));
+  BOOST_CHECK(pipeline.IsVectorColumn("com"));
+  BOOST_CHECK(!pipeline.IsVectorColumn("rg"));
+
+  pipeline.Run(f.traj, 3, 2);
+  BOOST_CHECK_EQUAL(pipeline.GetFrameCount(), size_t(34));
+  BOOST_CHECK(pipeline.GetColumn("dist")==
+              AnalyzeDistanceBetwAtoms(f.traj, f.atoms[0], f.atoms[7], 3));
+  BOOST_CHECK(pipeline.GetColumn("rmsd")==AnalyzeRMSD(f.traj, full, full, 3));
+  geom::Vec3List com=AnalyzeCenterOfMassPos(f.traj, half, 3);
+  const geom::Vec3List& com2=pipeline.GetVectorColumn("com");
+  BOOST_CHECK_EQUAL(com2.size(), com.size());
+  for (size_t i=0; i<com.size(); ++i) {
+    BOOST_CHECK(com[i]==com2[i]);
+  }
+  BOOST_CHECK_THROW(pipeline.GetVectorColumn("rg"), Error);
+  // all atoms have the same mass
+  const std::vector<Real>& rg=pipeline.GetColumn("rg");
+  BOOST_CHECK_EQUAL(rg.size(), size_t(34));
+  geom::Vec3List pos=f.traj.GetFramePositions(3);
+  geom::Vec3 center=pos.GetCenter();
+  Real sum=0.0;
+  for (size_t i=0; i<pos.size(); ++i) {
+    sum+=geom::Length2(pos[i]-center);
+  }
+  BOOST_CHECK_CLOSE(rg[1], Real(sqrt(sum/pos.size())), Real(1e-3));
+}
+
+BOOST_AUTO_TEST_CASE(trajectory_pipeline_massless)
+{
+  Fixture f;
+  for (size_t i=0; i<f.atoms.size(); ++i) {
+    f.atoms[i].SetMass(0.0);
+  }
+  TrajectoryPipeline pipeline;
+  pipeline.AddRadiusOfGyration("rg", f.e.CreateFullView());
+  pipeline.Run(f.traj, 3, 2);
+  // without masses, all atoms are weighted equally
+  const std::vector<Real>& rg=pipeline.GetColumn("rg");
+  geom::Vec3List pos=f.traj.GetFramePositions(3);
+  geom::Vec3 center=pos.GetCenter();
+  Real sum=0.0;
+  for (size_t i=0; i<pos.size(); ++i) {
+    sum+=geom::Length2(pos[i]-center);
+  }
+  BOOST_CHECK_CLOSE(rg[1], Real(sqrt(sum/pos.size())), Real(1e-3));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
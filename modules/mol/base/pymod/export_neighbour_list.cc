@@ -0,0 +1,81 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#include <boost/python.hpp>
+#include <boost/python/suite/indexing/vector_indexing_suite.hpp>
+using namespace boost::python;
+
+#include <ost/mol/entity_view.hh>
+#include <ost/mol/neighbour_list.hh>
+using namespace ost;
+using namespace ost::mol;
+
+namespace {
+
+IndexPairList find_pairs_a(const geom::Vec3List& pos_a,
+                           const geom::Vec3List& pos_b, Real cutoff)
+{
+  IndexPairList pairs;
+  FindAllPairsWithin(pos_a, pos_b, cutoff, pairs);
+  return pairs;
+}
+
+IndexPairList find_pairs_b(const geom::Vec3List& pos, Real cutoff)
+{
+  IndexPairList pairs;
+  FindAllPairsWithin(pos, cutoff, pairs);
+  return pairs;
+}
+
+IndexPairList find_pairs_c(const EntityView& view_a, const EntityView& view_b,
+                           Real cutoff)
+{
+  IndexPairList pairs;
+  FindAllPairsWithin(view_a, view_b, cutoff, pairs);
+  return pairs;
+}
+
+IndexPairList find_pairs_d(const EntityView& view, Real cutoff)
+{
+  IndexPairList pairs;
+  FindAllPairsWithin(view, cutoff, pairs);
+  return pairs;
+}
+
+}
+
+void export_NeighbourList()
+{
+  class_<IndexPair>("IndexPair", init<>())
+    .def(init<uint32_t, uint32_t, Real>())
+    .def_readwrite("first", &IndexPair::first)
+    .def_readwrite("second", &IndexPair::second)
+    .def_readwrite("dist2", &IndexPair::dist2)
+    .def(self==self)
+    .def(self!=self)
+  ;
+  class_<IndexPairList>("IndexPairList", init<>())
+    .def(vector_indexing_suite<IndexPairList>())
+  ;
+  def("FindAllPairsWithin", &find_pairs_a, 
+      (arg("pos_a"), arg("pos_b"), arg("cutoff")));
+  def("FindAllPairsWithin", &find_pairs_b, (arg("pos"), arg("cutoff")));
+  def("FindAllPairsWithin", &find_pairs_c, 
+      (arg("view_a"), arg("view_b"), arg("cutoff")));
+  def("FindAllPairsWithin", &find_pairs_d, (arg("view"), arg("cutoff")));
+}
@@ -42,6 +42,7 @@ void export_PropertyID();
 void export_BoundingBox();
 void export_QueryViewWrapper();
 void export_EntityPropertyMapper();
+void export_NeighbourList();
 
 BOOST_PYTHON_MODULE(_ost_mol)
 {
@@ -70,4 +71,5 @@ BOOST_PYTHON_MODULE(_ost_mol)
   export_BoundingBox();
   export_QueryViewWrapper();
   export_EntityPropertyMapper();
+  export_NeighbourList();
 }
@@ -0,0 +1,346 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <ost/message.hh>
+#include "bulk_builder.hh"
+#include "xcs_editor.hh"
+#include "entity_handle.hh"
+#include "chain_handle.hh"
+#include "residue_handle.hh"
+#include "atom_handle.hh"
+#include "impl/entity_impl.hh"
+#include "impl/chain_impl.hh"
+#include "impl/residue_impl.hh"
+#include "impl/atom_impl.hh"
+
+namespace ost { namespace mol {
+
+void BulkBuilder::Reserve(size_t num_chains, size_t num_residues,
+                          size_t num_atoms)
+{
+  chain_names_.reserve(num_chains);
+  chain_residues_.reserve(num_chains);
+  chain_in_sequence_.reserve(num_chains);
+  res_keys_.reserve(num_residues);
+  res_nums_.reserve(num_residues);
+  res_first_atom_.reserve(num_residues);
+  res_last_atom_.reserve(num_residues);
+  atom_names_.reserve(num_atoms);
+  atom_elements_.reserve(num_atoms);
+  atom_pos_.reserve(num_atoms);
+  atom_occupancies_.reserve(num_atoms);
+  atom_b_factors_.reserve(num_atoms);
+  atom_is_hetatm_.reserve(num_atoms);
+  atom_alt_groups_.reserve(num_atoms);
+  atom_next_.reserve(num_atoms);
+}
+
+void BulkBuilder::AddChain(const String& name)
+{
+  curr_res_=-1;
+  std::map<String, size_t>::const_iterator i=chain_index_.find(name);
+  if (i!=chain_index_.end()) {
+    curr_chain_=i->second;
+    return;
+  }
+  curr_chain_=chain_names_.size();
+  chain_index_[name]=curr_chain_;
+  chain_names_.push_back(name);
+  chain_residues_.push_back(std::vector<size_t>());
+  chain_in_sequence_.push_back(true);
+}
+
+bool BulkBuilder::HasChain(const String& name) const
+{
+  return chain_index_.find(name)!=chain_index_.end();
+}
+
+void BulkBuilder::AddResidue(const ResidueKey& key, const ResNum& num)
+{
+  if (curr_chain_<0) {
+    throw Error("Can't add residue: no chain has been added yet");
+  }
+  std::vector<size_t>& residues=chain_residues_[curr_chain_];
+  if (!residues.empty() && res_nums_[residues.back()]>=num) {
+    chain_in_sequence_[curr_chain_]=false;
+  }
+  curr_res_=res_keys_.size();
+  residues.push_back(curr_res_);
+  res_keys_.push_back(key);
+  res_nums_.push_back(num);
+  res_first_atom_.push_back(-1);
+  res_last_atom_.push_back(-1);
+}
+
+void BulkBuilder::AddResidue(const ResidueKey& key)
+{
+  if (curr_chain_<0) {
+    throw Error("Can't add residue: no chain has been added yet");
+  }
+  const std::vector<size_t>& residues=chain_residues_[curr_chain_];
+  this->AddResidue(key, residues.empty() ? ResNum(1) :
+                                           res_nums_[residues.back()]+1);
+}
+
+void BulkBuilder::InsertResidue(const ResidueKey& key, const ResNum& num)
+{
+  if (curr_chain_<0) {
+    throw Error("Can't add residue: no chain has been added yet");
+  }
+  std::vector<size_t>& residues=chain_residues_[curr_chain_];
+  int loc=static_cast<int>(residues.size())-1;
+  for (; loc>=0; --loc) {
+    if (res_nums_[residues[loc]]<num) {
+      break;
+    }
+  }
+  if (loc==static_cast<int>(residues.size())-1) {
+    this->AddResidue(key, num);
+    return;
+  }
+  // the residue after the insertion point doesn't have a larger number, if
+  // the chain wasn't sorted before
+  if (res_nums_[residues[loc+1]]<=num) {
+    chain_in_sequence_[curr_chain_]=false;
+  }
+  curr_res_=res_keys_.size();
+  residues.insert(residues.begin()+loc+1, curr_res_);
+  res_keys_.push_back(key);
+  res_nums_.push_back(num);
+  res_first_atom_.push_back(-1);
+  res_last_atom_.push_back(-1);
+}
+
+namespace {
+
+struct ResNumLess {
+  ResNumLess(const std::vector<ResNum>& nums): nums_(nums) { }
+
+  bool operator()(size_t res, const ResNum& num) const
+  {
+    return nums_[res]<num;
+  }
+
+  const std::vector<ResNum>& nums_;
+};
+
+}
+
+bool BulkBuilder::SelectResidue(const ResNum& num)
+{
+  if (curr_chain_<0) {
+    return false;
+  }
+  const std::vector<size_t>& residues=chain_residues_[curr_chain_];
+  std::vector<size_t>::const_iterator i;
+  if (chain_in_sequence_[curr_chain_]) {
+    i=std::lower_bound(residues.begin(), residues.end(), num,
+                       ResNumLess(res_nums_));
+  } else {
+    for (i=residues.begin(); i!=residues.end(); ++i) {
+      if (res_nums_[*i]==num) {
+        break;
+      }
+    }
+  }
+  if (i==residues.end() || res_nums_[*i]!=num) {
+    return false;
+  }
+  curr_res_=*i;
+  return true;
+}
+
+void BulkBuilder::CheckResidue(const char* what) const
+{
+  if (curr_res_<0) {
+    throw Error(String("Can't ")+what+": there is no current residue");
+  }
+}
+
+size_t BulkBuilder::AddAtom(const String& name, const geom::Vec3& pos,
+                            const String& ele, Real occupancy, Real b_factor,
+                            bool is_hetatm)
+{
+  this->CheckResidue("add atom");
+  int index=atom_names_.size();
+  atom_names_.push_back(name);
+  atom_elements_.push_back(ele);
+  atom_pos_.push_back(pos);
+  atom_occupancies_.push_back(occupancy);
+  atom_b_factors_.push_back(b_factor);
+  atom_is_hetatm_.push_back(is_hetatm);
+  atom_alt_groups_.push_back(String());
+  atom_next_.push_back(-1);
+  if (res_last_atom_[curr_res_]<0) {
+    res_first_atom_[curr_res_]=index;
+  } else {
+    atom_next_[res_last_atom_[curr_res_]]=index;
+  }
+  res_last_atom_[curr_res_]=index;
+  return index;
+}
+
+size_t BulkBuilder::AddAltAtom(const String& name, const String& alt_group,
+                               const geom::Vec3& pos, const String& ele,
+                               Real occupancy, Real b_factor, bool is_hetatm)
+{
+  if (alt_group.empty()) {
+    throw Error("alt atom group name can't be empty String");
+  }
+  size_t index=this->AddAtom(name, pos, ele, occupancy, b_factor, is_hetatm);
+  atom_alt_groups_[index]=alt_group;
+  return index;
+}
+
+void BulkBuilder::AddAltAtomPos(size_t atom, const String& alt_group,
+                                const geom::Vec3& pos, Real occupancy,
+                                Real b_factor)
+{
+  if (atom>=atom_names_.size() || atom_alt_groups_[atom].empty()) {
+    throw Error("Definition of alternative position without prior call to "
+                "InsertAltAtom is not allowed");
+  }
+  if (alt_group.empty()) {
+    throw Error("alt atom group name can't be empty String");
+  }
+  alt_atoms_.push_back(atom);
+  alt_groups_.push_back(alt_group);
+  alt_pos_.push_back(pos);
+  alt_occupancies_.push_back(occupancy);
+  alt_b_factors_.push_back(b_factor);
+}
+
+int BulkBuilder::FindAtom(const String& name) const
+{
+  if (curr_res_<0) {
+    return -1;
+  }
+  for (int a=res_first_atom_[curr_res_]; a>=0; a=atom_next_[a]) {
+    if (atom_names_[a]==name) {
+      return a;
+    }
+  }
+  return -1;
+}
+
+const String& BulkBuilder::GetChainName() const
+{
+  if (curr_chain_<0) {
+    throw Error("There is no current chain");
+  }
+  return chain_names_[curr_chain_];
+}
+
+const ResidueKey& BulkBuilder::GetResidueKey() const
+{
+  this->CheckResidue("get residue name");
+  return res_keys_[curr_res_];
+}
+
+const ResNum& BulkBuilder::GetResidueNumber() const
+{
+  this->CheckResidue("get residue number");
+  return res_nums_[curr_res_];
+}
+
+String BulkBuilder::GetResidueQualifiedName() const
+{
+  const String& chain_name=this->GetChainName();
+  return ((chain_name==" " || chain_name=="") ? "" :  chain_name+".")+
+         this->GetResidueKey()+this->GetResidueNumber().AsString();
+}
+
+void BulkBuilder::Clear()
+{
+  chain_names_.clear();
+  chain_index_.clear();
+  chain_residues_.clear();
+  chain_in_sequence_.clear();
+  res_keys_.clear();
+  res_nums_.clear();
+  res_first_atom_.clear();
+  res_last_atom_.clear();
+  atom_names_.clear();
+  atom_elements_.clear();
+  atom_pos_.clear();
+  atom_occupancies_.clear();
+  atom_b_factors_.clear();
+  atom_is_hetatm_.clear();
+  atom_alt_groups_.clear();
+  atom_next_.clear();
+  alt_atoms_.clear();
+  alt_groups_.clear();
+  alt_pos_.clear();
+  alt_occupancies_.clear();
+  alt_b_factors_.clear();
+  curr_chain_=-1;
+  curr_res_=-1;
+}
+
+AtomHandleList BulkBuilder::Build(XCSEditor& editor) const
+{
+  impl::EntityImplPtr ent=editor.GetEntity().Impl();
+  ent->MarkTraceDirty();
+  ent->ReserveAtoms(atom_names_.size());
+  impl::AtomImplList atoms(atom_names_.size());
+  for (size_t c=0; c<chain_names_.size(); ++c) {
+    ChainHandle existing=editor.GetEntity().FindChain(chain_names_[c]);
+    impl::ChainImplPtr chain=existing.IsValid() ? existing.Impl() :
+                             ent->InsertChain(chain_names_[c]);
+    const std::vector<size_t>& chain_residues=chain_residues_[c];
+    impl::ResidueImplList& residues=chain->GetResidueList();
+    residues.reserve(residues.size()+chain_residues.size());
+    for (size_t i=0; i<chain_residues.size(); ++i) {
+      size_t r=chain_residues[i];
+      impl::ResidueImplPtr res=chain->AppendResidue(res_keys_[r],
+                                                    res_nums_[r]);
+      size_t num_atoms=0;
+      for (int a=res_first_atom_[r]; a>=0; a=atom_next_[a]) {
+        ++num_atoms;
+      }
+      impl::AtomImplList& res_atoms=res->GetAtomList();
+      res_atoms.reserve(num_atoms);
+      for (int a=res_first_atom_[r]; a>=0; a=atom_next_[a]) {
+        impl::AtomImplPtr atom;
+        if (atom_alt_groups_[a].empty()) {
+          atom=ent->CreateAtom(res, atom_names_[a], atom_pos_[a],
+                               atom_elements_[a]);
+          res_atoms.push_back(atom);
+        } else {
+          atom=res->InsertAltAtom(atom_names_[a], atom_alt_groups_[a],
+                                  atom_pos_[a], atom_elements_[a],
+                                  atom_occupancies_[a], atom_b_factors_[a]);
+        }
+        atom->SetOccupancy(atom_occupancies_[a]);
+        atom->SetBFactor(atom_b_factors_[a]);
+        atom->SetHetAtom(atom_is_hetatm_[a]);
+        atoms[a]=atom;
+      }
+    }
+  }
+  for (size_t i=0; i<alt_atoms_.size(); ++i) {
+    const impl::AtomImplPtr& atom=atoms[alt_atoms_[i]];
+    atom->GetResidue()->AddAltAtomPos(alt_groups_[i], atom, alt_pos_[i],
+                                      alt_occupancies_[i], alt_b_factors_[i]);
+  }
+  return AtomHandleList(atoms.begin(), atoms.end());
+}
+
+}}
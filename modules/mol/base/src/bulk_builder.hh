@@ -0,0 +1,187 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_MOL_BASE_BULK_BUILDER_HH
+#define OST_MOL_BASE_BULK_BUILDER_HH
+
+#include <vector>
+#include <map>
+#include <ost/geom/vec3.hh>
+#include <ost/mol/module_config.hh>
+#include <ost/mol/residue_prop.hh>
+#include <ost/mol/handle_type_fw.hh>
+
+namespace ost { namespace mol {
+
+class XCSEditor;
+
+/// \brief collects chains, residues and atoms in columns and adds them to an
+///     entity in one go
+///
+/// Loaders that know the whole structure up front don't need to go through
+/// the editor for every single atom. Storage for the residues, atoms and the
+/// spatial organizer is reserved once and the per-atom bookkeeping of the
+/// editor is skipped.
+///
+/// The builder keeps track of a current chain and residue. Residues are added
+/// to the current chain, atoms to the current residue. Going back to a chain
+/// or residue that was added before is possible with AddChain() and
+/// SelectResidue(), which is what file readers need to join records that are
+/// spread over the file.
+///
+/// \code
+/// BulkBuilder builder;
+/// builder.AddChain("A");
+/// builder.AddResidue("GLY", ResNum(1));
+/// builder.AddAtom("N", geom::Vec3(0, 0, 0), "N");
+/// builder.AddAtom("CA", geom::Vec3(1.5, 0, 0), "C");
+/// AtomHandleList atoms=builder.Build(editor);
+/// \endcode
+class DLLEXPORT_OST_MOL BulkBuilder {
+public:
+  BulkBuilder(): curr_chain_(-1), curr_res_(-1) { }
+
+  /// \brief reserve storage for the given number of chains, residues and atoms
+  void Reserve(size_t num_chains, size_t num_residues, size_t num_atoms);
+
+  /// \brief make the chain with the given name the current one
+  ///
+  /// The chain is added, if the builder doesn't know it yet. If the entity
+  /// already contains a chain of that name when calling Build(), the residues
+  /// are appended to that chain. There is no current residue afterwards.
+  void AddChain(const String& name);
+
+  /// \brief whether a chain of that name has been added
+  bool HasChain(const String& name) const;
+
+  /// \brief append a residue to the current chain and make it the current one
+  void AddResidue(const ResidueKey& key, const ResNum& num);
+
+  /// \brief append a residue numbered one after the last residue of the
+  ///     current chain, or 1 if the chain is empty
+  void AddResidue(const ResidueKey& key);
+
+  /// \brief insert a residue into the current chain after the last residue
+  ///     with a smaller number and make it the current one
+  ///
+  /// For chains sorted by residue number, the chain stays sorted.
+  void InsertResidue(const ResidueKey& key, const ResNum& num);
+
+  /// \brief make the residue with the given number in the current chain the
+  ///     current one
+  ///
+  /// \return false, if the current chain has no such residue. The current
+  ///     residue doesn't change in that case.
+  bool SelectResidue(const ResNum& num);
+
+  /// \brief add an atom to the current residue
+  ///
+  /// The arguments have the same meaning as for EditorBase::InsertAtom().
+  ///
+  /// \return the index of the atom, see Build()
+  size_t AddAtom(const String& name, const geom::Vec3& pos,
+                 const String& ele="", Real occupancy=1.0, Real b_factor=0.0,
+                 bool is_hetatm=false);
+
+  /// \brief add an atom with an alternative location to the current residue
+  ///
+  /// The arguments have the same meaning as for EditorBase::InsertAltAtom().
+  ///
+  /// \return the index of the atom, see Build()
+  size_t AddAltAtom(const String& name, const String& alt_group,
+                    const geom::Vec3& pos, const String& ele="",
+                    Real occupancy=1.0, Real b_factor=0.0,
+                    bool is_hetatm=false);
+
+  /// \brief add another location to an atom added with AddAltAtom()
+  ///
+  /// Throws an Error, if the atom has been added without an alternative
+  /// location, just like EditorBase::AddAltAtomPos().
+  void AddAltAtomPos(size_t atom, const String& alt_group,
+                     const geom::Vec3& pos, Real occupancy=1.0,
+                     Real b_factor=0.0);
+
+  /// \brief index of the atom with the given name in the current residue
+  ///
+  /// \return the index of the first atom of that name, or -1 if there is none
+  int FindAtom(const String& name) const;
+
+  /// \name current chain and residue
+  ///
+  /// Throw an Error, if there is no current chain or residue.
+  //@{
+  const String& GetChainName() const;
+
+  const ResidueKey& GetResidueKey() const;
+
+  const ResNum& GetResidueNumber() const;
+
+  /// \brief the name ResidueHandle::GetQualifiedName() will return for the
+  ///     current residue
+  String GetResidueQualifiedName() const;
+  //@}
+
+  size_t GetChainCount() const { return chain_names_.size(); }
+
+  size_t GetResidueCount() const { return res_keys_.size(); }
+
+  size_t GetAtomCount() const { return atom_names_.size(); }
+
+  /// \brief remove all chains, residues and atoms
+  void Clear();
+
+  /// \brief add all chains, residues and atoms to the entity of editor
+  ///
+  /// Chains are added in the order they were first added to the builder,
+  /// residues in the order they have within their chain. The builder is left
+  /// untouched, so the same structure can be added to several entities.
+  ///
+  /// \return the created atoms, indexed by the return values of AddAtom() and
+  ///     AddAltAtom()
+  AtomHandleList Build(XCSEditor& editor) const;
+private:
+  void CheckResidue(const char* what) const;
+
+  std::vector<String>              chain_names_;
+  std::map<String, size_t>         chain_index_;
+  std::vector<std::vector<size_t> > chain_residues_; ///< in chain order
+  std::vector<bool>                chain_in_sequence_;
+  std::vector<ResidueKey>          res_keys_;
+  std::vector<ResNum>              res_nums_;
+  std::vector<int>                 res_first_atom_;
+  std::vector<int>                 res_last_atom_;
+  std::vector<String>              atom_names_;
+  std::vector<String>              atom_elements_;
+  geom::Vec3List                   atom_pos_;
+  std::vector<Real>                atom_occupancies_;
+  std::vector<Real>                atom_b_factors_;
+  std::vector<bool>                atom_is_hetatm_;
+  std::vector<String>              atom_alt_groups_; ///< empty if none
+  std::vector<int>                 atom_next_;       ///< in the same residue
+  std::vector<size_t>              alt_atoms_;
+  std::vector<String>              alt_groups_;
+  geom::Vec3List                   alt_pos_;
+  std::vector<Real>                alt_occupancies_;
+  std::vector<Real>                alt_b_factors_;
+  int                              curr_chain_;
+  int                              curr_res_;
+};
+
+}}
+
+#endif
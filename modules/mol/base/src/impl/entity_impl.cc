@@ -318,6 +318,11 @@ AtomImplPtr EntityImpl::CreateAtom(const ResidueImplPtr& rp,
   return ap;
 }
 
+void EntityImpl::ReserveAtoms(size_t n)
+{
+  atom_organizer_.Reserve(atom_organizer_.GetSize()+n);
+}
+
 void EntityImpl::DeleteAtom(const AtomImplPtr& atom) {
   atom_map_.erase(atom.get());
   atom_organizer_.Remove(atom);
@@ -1049,10 +1054,12 @@ void EntityImpl::DeleteChain(const ChainImplPtr& chain) {
 void EntityImpl::UpdateOrganizer()
 {
   atom_organizer_.Clear();
+  atom_organizer_.Reserve(atom_map_.size());
   for (AtomImplMap::const_iterator i=atom_map_.begin(), 
        e=atom_map_.end(); i!=e; ++i) {
     atom_organizer_.Add(i->second, i->second->TransformedPos());
   }
+  atom_organizer_.Build();
   dirty_flags_&=~DirtyOrganizer;
 }
 
@@ -65,7 +65,9 @@ typedef std::vector<FragmentImplP> FragmentImplList;
 /// \internal
 typedef std::map<EntityObserver*,EntityObserverPtr> EntityObserverMap;
 /// \internal
-typedef SpatialOrganizer<AtomImplPtr> SpatialAtomOrganizer;
+/// backend used for spatial queries on atoms, e.g. EntityHandle::FindWithin.
+/// Switch to SpatialOrganizer<AtomImplPtr> for the map based implementation.
+typedef CellListOrganizer<AtomImplPtr> SpatialAtomOrganizer;
 
 /// \internal
 typedef enum {
@@ -101,6 +103,9 @@ public:
   AtomImplPtr CreateAtom(const ResidueImplPtr& rp, const String& name,
                          const geom::Vec3& pos, const String& ele);
 
+  /// \brief make room for n more atoms in the spatial organizer
+  void ReserveAtoms(size_t n);
+
   ResidueImplPtr CreateResidue(const ChainImplPtr& cp,
                                const ResNum& n,
                                const ResidueKey& k);
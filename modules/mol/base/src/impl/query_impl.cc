@@ -357,6 +357,7 @@ QueryImpl::QueryImpl(Node* ast)
                       sel_stacks_[(int)Prop::ATOM]);        
   delete ast;
   empty_optimize_=false;
+  this->Compile();
 }
 
 void QueryImpl::ASTToSelStack(const Node* src_ast,
@@ -415,6 +416,7 @@ QueryImpl::QueryImpl(const String& query_string)
       delete ast_root;
       empty_optimize_=false;
       has_error_=false;
+      this->Compile();
     } else {
       has_error_=true;
     }  
@@ -424,6 +426,118 @@ QueryImpl::QueryImpl(const String& query_string)
 }
 
 
+namespace {
+
+bool is_constant(const SelProgram& prog, boost::logic::tribool value)
+{
+  if (prog.size()!=1 || prog[0].type!=SEL_CONST) {
+    return false;
+  }
+  if (indeterminate(value)) {
+    return indeterminate(prog[0].constant);
+  }
+  return bool(prog[0].constant==value);
+}
+
+}
+
+void QueryImpl::Compile()
+{
+  level_stmts_.assign(3, std::vector<size_t>());
+  sel_info_.assign(sel_values_.size(), SelStmtInfo());
+  for (int level=0; level<3; ++level) {
+    for (std::set<size_t>::const_iterator i=indices_[level].begin(),
+         e=indices_[level].end(); i!=e; ++i) {
+      level_stmts_[level].push_back(*i);
+      sel_info_[*i].level=(Prop::Level)level;
+    }
+  }
+  for (size_t i=1; i<sel_values_.size(); ++i) {
+    const SelStmt& ss=sel_values_[i];
+    SelStmtInfo& info=sel_info_[i];
+    if (const int* int_value=boost::get<int>(&ss.param)) {
+      info.int_param=*int_value;
+    } else if (const Real* float_value=boost::get<Real>(&ss.param)) {
+      info.float_param=*float_value;
+    }
+    if (ss.sel_id==Prop::RTYPE) {
+      const String& p=boost::get<StringOrRegexParam>(ss.param).str();
+      if (p.length()>1) {
+        if (p=="helix") {
+          info.rtype=SelStmtInfo::RTYPE_HELIX;
+        } else if (p=="ext" || p=="strand") {
+          info.rtype=SelStmtInfo::RTYPE_EXTENDED;
+        } else if (p=="coil") {
+          info.rtype=SelStmtInfo::RTYPE_COIL;
+        } else {
+          info.rtype=SelStmtInfo::RTYPE_NONE;
+        }
+      }
+    }
+  }
+  sel_programs_.resize(3);
+  for (int level=0; level<3; ++level) {
+    size_t pos=0;
+    sel_programs_[level]=this->CompileStack(sel_stacks_[level], pos);
+    assert(pos==sel_stacks_[level].size());
+  }
+}
+
+SelProgram QueryImpl::CompileValue(size_t index) const
+{
+  SelProgram prog;
+  // index 0 is the UNDEF statement used for subtrees that can not be 
+  // evaluated at this level.
+  if (index==0) {
+    prog.push_back(SelOp(SEL_CONST, 0, 1, boost::logic::indeterminate));
+    return prog;
+  }
+  const SelStmt& ss=sel_values_[index];
+  if (ss.sel_id==Prop::RTYPE && 
+      boost::get<StringOrRegexParam>(ss.param).str()=="*") {
+    prog.push_back(SelOp(SEL_CONST, 0, 1, ss.comp_op==COP_EQ));
+    return prog;
+  }
+  prog.push_back(SelOp(SEL_STMT, index, 1));
+  return prog;
+}
+
+SelProgram QueryImpl::CompileStack(const SelStack& stack, size_t& pos) const
+{
+  const SelItem& item=stack[pos++];
+  if (item.type==VALUE) {
+    return this->CompileValue(item.value);
+  }
+  SelProgram lhs=this->CompileStack(stack, pos);
+  SelProgram rhs=this->CompileStack(stack, pos);
+  bool is_and=(LogicOP)item.value==LOP_AND;
+  // constant folding. false is absorbing for and, true is absorbing for or.
+  // The neutral element of the operation is dropped.
+  boost::logic::tribool absorbing(!is_and);
+  if (is_constant(lhs, absorbing)) {
+    return lhs;
+  }
+  if (is_constant(rhs, absorbing)) {
+    return rhs;
+  }
+  if (is_constant(lhs, is_and)) {
+    return rhs;
+  }
+  if (is_constant(rhs, is_and)) {
+    return lhs;
+  }
+  if (is_constant(lhs, boost::logic::indeterminate) && 
+      is_constant(rhs, boost::logic::indeterminate)) {
+    return lhs;
+  }
+  SelProgram prog;
+  prog.reserve(1+lhs.size()+rhs.size());
+  prog.push_back(SelOp(is_and ? SEL_AND : SEL_OR, 0, 1+lhs.size()+rhs.size()));
+  prog.insert(prog.end(), lhs.begin(), lhs.end());
+  prog.insert(prog.end(), rhs.begin(), rhs.end());
+  return prog;
+}
+
 const QueryErrorDesc& QueryImpl::GetErrorDescription() const {
   return error_desc_;
 }
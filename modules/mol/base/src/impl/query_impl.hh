@@ -158,6 +158,50 @@ typedef std::vector<SelItem> SelStack;
 
 /// \internal
 typedef std::vector<SelStmt> SelStmts;
+
+/// \internal
+typedef enum {
+  SEL_CONST, SEL_STMT, SEL_AND, SEL_OR
+} SelOpType;
+
+/// \brief operation of a compiled selection program
+/// \internal
+///
+/// Operations are stored in prefix order. The left-hand side operand of a 
+/// logic operation directly follows the operation, the right-hand side 
+/// follows the left-hand side. size is the number of operations in the 
+/// subtree, including the operation itself, which allows to skip the 
+/// right-hand side when the result is already determined by the left-hand 
+/// side.
+struct SelOp {
+  SelOp(SelOpType t, size_t v, size_t s, 
+        boost::logic::tribool c=boost::logic::indeterminate)
+    : type(t), value(v), size(s), constant(c) { }
+  SelOpType             type;
+  /// index into the selection statements for SEL_STMT
+  size_t                value;
+  size_t                size;
+  /// value of SEL_CONST operations
+  boost::logic::tribool constant;
+};
+
+/// \internal
+typedef std::vector<SelOp> SelProgram;
+
+/// \brief selection statement information resolved at compile time
+/// \internal
+struct SelStmtInfo {
+  SelStmtInfo(): level(Prop::UNSPECIFIED), int_param(0), float_param(0.0),
+                 rtype(RTYPE_STRING) { }
+  /// \brief how to evaluate rtype statements
+  typedef enum {
+    RTYPE_STRING, RTYPE_HELIX, RTYPE_EXTENDED, RTYPE_COIL, RTYPE_NONE
+  } RTypeClass;
+  Prop::Level level;
+  int         int_param;
+  Real        float_param;
+  RTypeClass  rtype;
+};
   
 /// \brief query statement implementation 
 /// \internal
@@ -263,6 +307,16 @@ private:
                           QueryLexer& lexer);
   /// Concatenate two nodes together using LogicOP
   Node* Concatenate(Node* lhs, Node* rhs, LogicOP logical_op);
+
+  /// Lower the selection stacks into flat selection programs with constant
+  /// folding and resolve the parameters of the selection statements.
+  void Compile();
+
+  /// Compile the subtree of the selection stack starting at pos. On exit, pos
+  /// points to the first item after the subtree.
+  SelProgram CompileStack(const SelStack& stack, size_t& pos) const;
+
+  SelProgram CompileValue(size_t index) const;
   
   String                            query_string_;
   bool                              has_error_;
@@ -276,6 +330,9 @@ protected:
   std::vector<std::set<size_t> >    indices_;
   std::vector<bool>                 inversion_stack_;
   std::vector<QueryImplP>           bracketed_expr_;
+  std::vector<SelProgram>           sel_programs_;
+  std::vector<SelStmtInfo>          sel_info_;
+  std::vector<std::vector<size_t> > level_stmts_;
 };
  
 }}} // ns
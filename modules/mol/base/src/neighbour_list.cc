@@ -0,0 +1,130 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#include <algorithm>
+
+#include <ost/invalid_handle.hh>
+
+#include "neighbour_list.hh"
+#include "spatial_organizer.hh"
+#include "entity_view.hh"
+#include "atom_view.hh"
+
+namespace ost { namespace mol {
+
+namespace {
+
+// cell lists with tiny cells are slower to build than to scan, so the cell
+// size never drops below this value
+const Real MIN_CELL_SIZE=1.0;
+
+class PairCollector {
+public:
+  PairCollector(IndexPairList& pairs, bool symmetric): 
+    pairs_(pairs), symmetric_(symmetric), current_(0)
+  { }
+
+  void SetCurrent(uint32_t index) { current_=index; }
+
+  void operator()(uint32_t other, Real dist2)
+  {
+    if (symmetric_ && other<=current_) {
+      return;
+    }
+    pairs_.push_back(IndexPair(current_, other, dist2));
+  }
+private:
+  IndexPairList& pairs_;
+  bool           symmetric_;
+  uint32_t       current_;
+};
+
+struct SecondLess {
+  bool operator()(const IndexPair& lhs, const IndexPair& rhs) const
+  {
+    return lhs.second<rhs.second;
+  }
+};
+
+void find_pairs(const geom::Vec3List& pos_a, const geom::Vec3List& pos_b,
+                Real cutoff, bool symmetric, IndexPairList& pairs)
+{
+  pairs.clear();
+  if (pos_a.empty() || pos_b.empty() || cutoff<0.0) {
+    return;
+  }
+  CellListOrganizer<uint32_t> cells(std::max(cutoff, MIN_CELL_SIZE));
+  cells.Reserve(pos_b.size());
+  for (size_t i=0; i<pos_b.size(); ++i) {
+    cells.Add(static_cast<uint32_t>(i), pos_b[i]);
+  }
+  cells.Build();
+  PairCollector collector(pairs, symmetric);
+  for (size_t i=0; i<pos_a.size(); ++i) {
+    size_t first_pair=pairs.size();
+    collector.SetCurrent(static_cast<uint32_t>(i));
+    cells.VisitWithin(pos_a[i], cutoff, collector);
+    // the cell list returns neighbours in cell order
+    std::sort(pairs.begin()+first_pair, pairs.end(), SecondLess());
+  }
+}
+
+geom::Vec3List atom_positions(const EntityView& view)
+{
+  geom::Vec3List positions;
+  positions.reserve(view.GetAtomCount());
+  AtomViewList atoms=view.GetAtomList();
+  for (AtomViewList::const_iterator i=atoms.begin(), e=atoms.end(); i!=e; ++i) {
+    positions.push_back(i->GetPos());
+  }
+  return positions;
+}
+
+}
+
+void FindAllPairsWithin(const geom::Vec3List& pos_a, 
+                        const geom::Vec3List& pos_b,
+                        Real cutoff, IndexPairList& pairs)
+{
+  find_pairs(pos_a, pos_b, cutoff, false, pairs);
+}
+
+void FindAllPairsWithin(const geom::Vec3List& pos, Real cutoff, 
+                        IndexPairList& pairs)
+{
+  find_pairs(pos, pos, cutoff, true, pairs);
+}
+
+void FindAllPairsWithin(const EntityView& view_a, const EntityView& view_b,
+                        Real cutoff, IndexPairList& pairs)
+{
+  CheckHandleValidity(view_a);
+  CheckHandleValidity(view_b);
+  find_pairs(atom_positions(view_a), atom_positions(view_b), cutoff, false,
+             pairs);
+}
+
+void FindAllPairsWithin(const EntityView& view, Real cutoff, 
+                        IndexPairList& pairs)
+{
+  CheckHandleValidity(view);
+  geom::Vec3List positions=atom_positions(view);
+  find_pairs(positions, positions, cutoff, true, pairs);
+}
+
+}} // ns
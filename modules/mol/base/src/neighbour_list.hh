@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_MOL_NEIGHBOUR_LIST_HH
+#define OST_MOL_NEIGHBOUR_LIST_HH
+
+#include <vector>
+
+#include <ost/stdint.hh>
+#include <ost/geom/geom.hh>
+#include <ost/mol/module_config.hh>
+
+namespace ost { namespace mol {
+
+class EntityView;
+
+/// \brief pair of points closer than a distance cutoff
+///
+/// \c first and \c second are indices into the first and second set of points
+/// passed to FindAllPairsWithin. For entity views, these are the indices into
+/// the atom lists as returned by EntityView::GetAtomList().
+struct DLLEXPORT_OST_MOL IndexPair {
+  IndexPair(): first(0), second(0), dist2(0.0) { }
+  IndexPair(uint32_t f, uint32_t s, Real d2): first(f), second(s), dist2(d2) { }
+
+  uint32_t first;
+  uint32_t second;
+  /// \brief squared distance between the two points
+  Real     dist2;
+
+  bool operator==(const IndexPair& rhs) const {
+    return first==rhs.first && second==rhs.second && dist2==rhs.dist2;
+  }
+
+  bool operator!=(const IndexPair& rhs) const {
+    return !this->operator==(rhs);
+  }
+};
+
+typedef std::vector<IndexPair> IndexPairList;
+
+/// \name all-pairs neighbour search
+///
+/// The points of the second set are binned into a cell list once, and all
+/// pairs with a distance <= cutoff are written to \p pairs. The list is
+/// cleared before it is filled, but keeps its capacity, so the same buffer
+/// may be reused for many searches to avoid reallocation. Pairs are sorted
+/// by the index of the first point.
+//@{
+/// \brief find all pairs (i, j) with point i from \p pos_a and point j from
+///     \p pos_b within \p cutoff
+void DLLEXPORT_OST_MOL FindAllPairsWithin(const geom::Vec3List& pos_a,
+                                          const geom::Vec3List& pos_b,
+                                          Real cutoff, IndexPairList& pairs);
+
+/// \brief find all pairs (i, j) with i < j of points in \p pos within
+///     \p cutoff
+void DLLEXPORT_OST_MOL FindAllPairsWithin(const geom::Vec3List& pos,
+                                          Real cutoff, IndexPairList& pairs);
+
+/// \brief find all pairs of atoms between two views within \p cutoff
+void DLLEXPORT_OST_MOL FindAllPairsWithin(const EntityView& view_a,
+                                          const EntityView& view_b,
+                                          Real cutoff, IndexPairList& pairs);
+
+/// \brief find all pairs of distinct atoms in a view within \p cutoff
+///
+/// Every pair is only reported once, with first < second.
+void DLLEXPORT_OST_MOL FindAllPairsWithin(const EntityView& view,
+                                          Real cutoff, IndexPairList& pairs);
+//@}
+
+}} // ns
+
+#endif
@@ -22,6 +22,9 @@
 
 #include <vector>
 #include <algorithm>
+#include <map>
+#include <list>
+#include <mutex>
 
 #include <boost/logic/tribool.hpp>
 
@@ -37,8 +40,46 @@
 
 namespace ost { namespace mol {
 
+namespace {
+
+// Compiled queries are immutable, so they can be shared between all Query
+// instances constructed from the same string. Pipelines tend to issue the 
+// same few selection strings over and over again, which makes parsing and 
+// compiling the query a noticeable fraction of the selection time for small 
+// entities. Once the cache is full, the least recently used query is dropped.
+const size_t MAX_CACHED_QUERIES=512;
+
+// most recently used query first
+typedef std::list<std::pair<String, impl::QueryImplP> > QueryCacheList;
+
+std::mutex query_cache_mutex;
+QueryCacheList query_cache_list;
+std::map<String, QueryCacheList::iterator> query_cache;
+
+impl::QueryImplP get_compiled_query(const String& query_string)
+{
+  std::lock_guard<std::mutex> lock(query_cache_mutex);
+  std::map<String, QueryCacheList::iterator>::iterator 
+    i=query_cache.find(query_string);
+  if (i!=query_cache.end()) {
+    query_cache_list.splice(query_cache_list.begin(), query_cache_list, 
+                            i->second);
+    return i->second->second;
+  }
+  impl::QueryImplP q(new impl::QueryImpl(query_string));
+  query_cache_list.push_front(std::make_pair(query_string, q));
+  query_cache[query_string]=query_cache_list.begin();
+  if (query_cache_list.size()>MAX_CACHED_QUERIES) {
+    query_cache.erase(query_cache_list.back().first);
+    query_cache_list.pop_back();
+  }
+  return q;
+}
+
+}
+
 Query::Query(const String& query_string):
-  impl_(impl::QueryImplP(new impl::QueryImpl(query_string))) {
+  impl_(get_compiled_query(query_string)) {
 }
 
 Query::Query(const impl::QueryImplP& impl):
@@ -110,8 +110,9 @@ QueryState::~QueryState()
 }
 
 QueryState::QueryState(const QueryImpl& query, const EntityHandle& ref)
-  : q_(query) {
+  : q_(query), chain_(NULL), residue_(NULL), atom_(NULL) {
   s_.resize(query.sel_values_.size(),boost::logic::indeterminate);
+  known_.resize(query.sel_values_.size(), 0);
   if (! query.bracketed_expr_.empty()) {
     r_.reset(new LazilyBoundData);
     r_->refs.resize(query.bracketed_expr_.size());
@@ -129,8 +130,9 @@ LazilyBoundRef& LazilyBoundRef::operator=(const LazilyBoundRef& rhs) {
 }
 
 QueryState::QueryState(const QueryImpl& query, const EntityView& ref)
-  : q_(query) {
+  : q_(query), chain_(NULL), residue_(NULL), atom_(NULL) {
   s_.resize(query.sel_values_.size(),boost::logic::indeterminate);
+  known_.resize(query.sel_values_.size(), 0);
   if (! query.bracketed_expr_.empty()) {
     r_.reset(new LazilyBoundData);
     r_->refs.resize(query.bracketed_expr_.size());
@@ -148,157 +150,183 @@ const LazilyBoundRef& QueryState::GetBoundObject(int i) const {
 
 
 
-boost::logic::tribool QueryState::EvalChain(const ChainImplPtr& c) {
-  if (q_.empty_optimize_)
-    return true;
-  const std::set<size_t>& indices = q_.indices_[(int)Prop::CHAIN];
-  std::set<size_t>::const_iterator i = indices.begin();
-  for (; i != indices.end(); ++i) {
-    const SelStmt& ss = q_.sel_values_[*i];
-    String value;
-    float float_value;
-    switch (ss.sel_id) {
-      case Prop::CNAME:
-        s_[*i] = cmp_string(ss.comp_op, c->GetName(),
+bool QueryState::eval_chain_stmt(size_t index, const ChainImplPtr& c)
+{
+  const SelStmt& ss=q_.sel_values_[index];
+  switch (ss.sel_id) {
+    case Prop::CNAME:
+      return cmp_string(ss.comp_op, c->GetName(),
+                        boost::get<StringOrRegexParam>(ss.param));
+    default:
+      if (ss.sel_id>=Prop::CUSTOM) {
+        const GenProp& gen_prop=q_.gen_prop_list_[ss.sel_id-Prop::CUSTOM];
+        Real float_value;
+        if (gen_prop.has_default) {
+          float_value=gen_prop.mapper.Get(c, gen_prop.default_val);
+        } else {
+          float_value=gen_prop.mapper.Get(c);
+        }
+        return cmp_num<Real>(ss.comp_op, float_value, 
+                             q_.sel_info_[index].float_param);
+      }
+      assert(0 && "not implemented" );
+  }
+  return false;
+}
+
+bool QueryState::eval_residue_stmt(size_t index, const ResidueImplPtr& r)
+{
+  const SelStmt& ss=q_.sel_values_[index];
+  const SelStmtInfo& info=q_.sel_info_[index];
+  bool b=false;
+  switch (ss.sel_id) {
+    case Prop::RNAME:
+      return cmp_string(ss.comp_op,r->GetName(),
+                        boost::get<StringOrRegexParam>(ss.param));
+    case Prop::RNUM:
+      return cmp_num<int>(ss.comp_op, r->GetNumber().GetNum(), 
+                          info.int_param);
+    case Prop::PEPTIDE:
+      return cmp_num<int>(ss.comp_op, r->GetChemClass().IsPeptideLinking(), 
+                          info.int_param);
+    case Prop::RBFAC:
+      // This is ugly! Outcome is the same for a prefiltered view as it is for
+      // as for the full entity, even though the residue view might not have
+      // all the atoms included.
+      return cmp_num<Real>(ss.comp_op, r->GetAverageBFactor(),
+                           info.float_param);
+    case Prop::PROTEIN:
+      return cmp_num<int>(ss.comp_op, r->IsProtein(), info.int_param);
+    case Prop::WATER:
+      return cmp_num<int>(ss.comp_op, r->GetChemClass().IsWater(), 
+                          info.int_param);
+    case Prop::LIGAND:
+      return cmp_num<int>(ss.comp_op, r->IsLigand(), info.int_param);
+    case Prop::RTYPE:
+      switch (info.rtype) {
+        case SelStmtInfo::RTYPE_STRING:
+          return cmp_string(ss.comp_op, String(1, (char)r->GetSecStructure()),
                             boost::get<StringOrRegexParam>(ss.param));
-        continue;
-      default:
-        if (ss.sel_id>=Prop::CUSTOM) {
-          int index=ss.sel_id-Prop::CUSTOM;
-          GenProp gen_prop=q_.gen_prop_list_[index];
-          if (gen_prop.has_default) {
-            float_value=gen_prop.mapper.Get(c, gen_prop.default_val);
-          } else {
-            float_value=gen_prop.mapper.Get(c);
-          }
-          s_[*i]=cmp_num<Real>(ss.comp_op, float_value,
-                               boost::get<float>(ss.param));
+        case SelStmtInfo::RTYPE_HELIX:
+          b=r->GetSecStructure().IsHelical();
+          break;
+        case SelStmtInfo::RTYPE_EXTENDED:
+          b=r->GetSecStructure().IsExtended();
+          break;
+        case SelStmtInfo::RTYPE_COIL:
+          b=r->GetSecStructure().IsCoil();
+          break;
+        case SelStmtInfo::RTYPE_NONE:
+          b=false;
+          break;
+      }
+      return ss.comp_op==COP_EQ ? b : !b;
+    case Prop::RINDEX:
+      return cmp_num<int>(ss.comp_op, r->GetIndex(), info.int_param);
+    default:
+      if (ss.sel_id>=Prop::CUSTOM) {
+        const GenProp& gen_prop=q_.gen_prop_list_[ss.sel_id-Prop::CUSTOM];
+        Real float_value;
+        if (gen_prop.has_default) {
+          float_value=gen_prop.mapper.Get(r, gen_prop.default_val);
         } else {
-          assert(0 && "not implemented" );
+          float_value=gen_prop.mapper.Get(r);
         }
-    }
-  }  
-  return this->EvalStack(Prop::CHAIN);
+        return cmp_num<Real>(ss.comp_op, float_value, info.float_param);
+      }
+      assert(0 && "not implemented" );
+  }
+  return false;
+}
+
+boost::logic::tribool QueryState::EvalChain(const ChainImplPtr& c) {
+  if (q_.empty_optimize_)
+    return true;
+  chain_=&c;
+  this->forget(Prop::CHAIN);
+  size_t pc=0;
+  return this->eval_program(Prop::CHAIN, pc);
 }
 
 boost::logic::tribool QueryState::EvalResidue(const ResidueImplPtr& r) {
   if (q_.empty_optimize_)
     return true;
-  const std::set<size_t>& indices = q_.indices_[(int)Prop::RESIDUE];
-  std::set<size_t>::const_iterator i = indices.begin();
-  String str_value;
-  int int_value;
-  String p;  
-  for (; i != indices.end(); ++i) {
-    const SelStmt& ss = q_.sel_values_[*i];
-    Real float_value;
-    switch (ss.sel_id) {
-      case Prop::RNAME:
-        s_[*i] = cmp_string(ss.comp_op,r->GetName(),
-                            boost::get<StringOrRegexParam>(ss.param));
-        continue;
-      case Prop::RNUM:
-        int_value=r->GetNumber().GetNum();
-        s_[*i]=cmp_num<int>(ss.comp_op,int_value,boost::get<int>(ss.param));        
-        break;
-      case Prop::PEPTIDE:
-        int_value=r->GetChemClass().IsPeptideLinking();
-        s_[*i] = cmp_num<int>(ss.comp_op,int_value,boost::get<int>(ss.param));        
-        break;        
-      case Prop::RBFAC:
-        // This is ugly! Outcome is the same for a prefiltered view as it is for
-        // as for the full entity, even though the residue view might not have
-        // all the atoms included.
-        float_value=r->GetAverageBFactor();
-        s_[*i] = cmp_num<Real>(ss.comp_op, float_value,
-                                 boost::get<float>(ss.param));        
-        break;
-      case Prop::PROTEIN:
-        int_value=r->IsProtein();
-        s_[*i]=cmp_num<int>(ss.comp_op,int_value,boost::get<int>(ss.param));
-        break;
-      case Prop::WATER:
-        int_value=r->GetChemClass().IsWater();
-        s_[*i]=cmp_num<int>(ss.comp_op,int_value,boost::get<int>(ss.param));
-        break;
-      case Prop::LIGAND:
-        int_value=r->IsLigand();
-        s_[*i]=cmp_num<int>(ss.comp_op,int_value,boost::get<int>(ss.param));
-        break;        
-      case Prop::RTYPE:
-        p=boost::get<StringOrRegexParam>(ss.param).str();
-        if (p.length()>1) {
-          bool b=false;
-          if (p=="helix") {
-            b=r->GetSecStructure().IsHelical();
-          } else if (p=="ext" || p=="strand") {
-            b=r->GetSecStructure().IsExtended();
-          } else if (p=="coil") {
-            b=r->GetSecStructure().IsCoil();
-          } else if (p=="*") {
-            b=true;
-          }
-          s_[*i]=ss.comp_op==COP_EQ ? b : !b;          
-        } else {
-          str_value = String(1, (char)r->GetSecStructure());
-          s_[*i]=cmp_string(ss.comp_op,str_value,
-                            boost::get<StringOrRegexParam>(ss.param));          
-        }
-        break;
-      case Prop::RINDEX:
-        int_value=r->GetIndex();
-        s_[*i]=cmp_num<int>(ss.comp_op,int_value,boost::get<int>(ss.param));
-        break;
-      default:
-        if (ss.sel_id>=Prop::CUSTOM) {
-          int index=ss.sel_id-Prop::CUSTOM;
-          GenProp gen_prop=q_.gen_prop_list_[index];
-          if (gen_prop.has_default) {
-            float_value=gen_prop.mapper.Get(r, gen_prop.default_val);
-          } else {
-            float_value=gen_prop.mapper.Get(r);
-          }
-          s_[*i]=cmp_num<Real>(ss.comp_op, float_value,
-                               boost::get<float>(ss.param));
-        } else {
-          assert(0 && "not implemented" );
-        }
-    }
+  residue_=&r;
+  this->forget(Prop::RESIDUE);
+  size_t pc=0;
+  return this->eval_program(Prop::RESIDUE, pc);
+}
+
+boost::logic::tribool QueryState::eval_program(Prop::Level level, size_t& pc)
+{
+  const SelOp& op=q_.sel_programs_[(int)level][pc];
+  switch (op.type) {
+    case SEL_CONST:
+      ++pc;
+      return op.constant;
+    case SEL_STMT:
+      ++pc;
+      return this->stmt_value(op.value, level);
+    default:
+      break;
+  }
+  size_t end=pc+op.size;
+  ++pc;
+  boost::logic::tribool lhs=this->eval_program(level, pc);
+  // short-circuit evaluation: the right-hand side does not change the result
+  // if lhs is false for and, or true for or.
+  if (op.type==SEL_AND ? lhs==false : lhs==true) {
+    pc=end;
+    return lhs;
   }
-  return this->EvalStack(Prop::RESIDUE);  
+  boost::logic::tribool rhs=this->eval_program(level, pc);
+  return op.type==SEL_AND ? lhs && rhs : lhs || rhs;
 }
 
-boost::logic::tribool QueryState::EvalStack(Prop::Level level) {
-  const SelStack& stack = q_.sel_stacks_[(int)level];
-  SelStack::const_reverse_iterator i = stack.rbegin();
-  value_stack_.clear();
-  while (i!=stack.rend()) {
-    const SelItem& si = *i;
-    if (si.type==VALUE) {
-      value_stack_.push_back(s_[si.value]);
-      ++i;
-      continue;
-    } else {
-      boost::logic::tribool lhs = value_stack_.back();
-      value_stack_.pop_back();
-      boost::logic::tribool rhs = value_stack_.back();
-      value_stack_.pop_back();      
-      LogicOP lop = (LogicOP)si.value;
-      boost::logic::tribool result;
-      switch(lop) {
-        case LOP_AND:
-          result = lhs && rhs;
-          break;
-        case LOP_OR:
-          result = lhs || rhs;
-          break;              
-      }      
-      value_stack_.push_back(result);
-      ++i;
-    }
+boost::logic::tribool QueryState::stmt_value(size_t index, Prop::Level level)
+{
+  Prop::Level stmt_level=q_.sel_info_[index].level;
+  if (stmt_level!=level && known_[index]) {
+    return s_[index];
+  }
+  bool value=false;
+  switch (level) {
+    case Prop::CHAIN:
+      value=this->eval_chain_stmt(index, *chain_);
+      break;
+    case Prop::RESIDUE:
+      if (stmt_level==Prop::RESIDUE) {
+        value=this->eval_residue_stmt(index, *residue_);
+      } else {
+        // skipped during chain evaluation
+        value=this->eval_chain_stmt(index, (*residue_)->GetChain());
+      }
+      break;
+    case Prop::ATOM:
+      if (stmt_level==Prop::ATOM) {
+        value=this->eval_atom_stmt(index, *atom_);
+      } else if (stmt_level==Prop::RESIDUE) {
+        value=this->eval_residue_stmt(index, (*atom_)->GetResidue());
+      } else {
+        value=this->eval_chain_stmt(index, 
+                                    (*atom_)->GetResidue()->GetChain());
+      }
+      break;
+    default:
+      assert(0 && "invalid level");
+  }
+  s_[index]=value;
+  known_[index]=1;
+  return value;
+}
+
+void QueryState::forget(Prop::Level level)
+{
+  const std::vector<size_t>& indices=q_.level_stmts_[(int)level];
+  for (std::vector<size_t>::const_iterator 
+       i=indices.begin(), e=indices.end(); i!=e; ++i) {
+    known_[*i]=0;
   }
-  assert(value_stack_.size()==1);
-  return value_stack_.back();
 }
 
 namespace {
@@ -306,98 +334,75 @@ namespace {
 QueryImpl dummy_query_impl;
 }
 QueryState::QueryState()
-  : s_(), q_(dummy_query_impl) {
- value_stack_.reserve(20);
+  : s_(), q_(dummy_query_impl), chain_(NULL), residue_(NULL), atom_(NULL) {
 }
 
-boost::logic::tribool QueryState::EvalAtom(const AtomImplPtr& a) {
-  if (q_.empty_optimize_)
-    return true;  
-  const std::set<size_t>& indices = q_.indices_[(int)Prop::ATOM];
-  std::set<size_t>::const_iterator i = indices.begin();
-  for (; i != indices.end(); ++i) {
-    const SelStmt& ss = q_.sel_values_[*i];
-    String str_value;
-    Real float_value;
-    int int_value;
-    switch (ss.sel_id) {
-      case Prop::ANAME:
-        s_[*i] = cmp_string(ss.comp_op,a->GetName(),
-                            boost::get<StringOrRegexParam>(ss.param));
-        break;
-      case Prop::AINDEX:
-        int_value=(a->GetIndex());
-        s_[*i]=cmp_num<int>(ss.comp_op, int_value,boost::get<int>(ss.param));
-        break;
-      case Prop::AX:
-        float_value=(a->TransformedPos())[0];
-        s_[*i]=cmp_num<Real>(ss.comp_op, float_value, 
-        boost::get<float>(ss.param));
-        break;
-      case Prop::AY:
-        float_value=(a->TransformedPos())[1];
-        s_[*i]=cmp_num<Real>(ss.comp_op, float_value, 
-                             boost::get<float>(ss.param));
-        break;
-      case Prop::AZ:
-        float_value=(a->TransformedPos())[2];
-        s_[*i]=cmp_num<Real>(ss.comp_op, float_value, 
-                             boost::get<float>(ss.param));
-        break;                
-      case Prop::OCC:
-        float_value=a->GetOccupancy();
-        s_[*i]=cmp_num<Real>(ss.comp_op, float_value, 
-                             boost::get<float>(ss.param));
-        break;                        
-      case Prop::ELE:
-        s_[*i] = cmp_string(ss.comp_op,a->GetElement(),
-                            boost::get<StringOrRegexParam>(ss.param));                          
-        break;
-      case Prop::ABFAC:
-        float_value=a->GetBFactor();
-        s_[*i]=cmp_num<Real>(ss.comp_op, float_value, 
-                              boost::get<float>(ss.param));
-        break;
-      case Prop::WITHIN:
-        s_[*i]= this->do_within(a->TransformedPos(), 
-                                boost::get<WithinParam>(ss.param),
-                                ss.comp_op);
-        break;
-      case Prop::ISHETATM:
-        int_value = a->IsHetAtom();
-        s_[*i] = cmp_num<int>(ss.comp_op,int_value,boost::get<int>(ss.param));
-        break;
-      case Prop::ACHARGE:
-        float_value=a->GetCharge();
-        s_[*i]=cmp_num<Real>(ss.comp_op, float_value, 
-                              boost::get<float>(ss.param));
-        break;
-      default:
-        if (ss.sel_id>=Prop::CUSTOM) {
-          int index=ss.sel_id-Prop::CUSTOM;
-          GenProp gen_prop=q_.gen_prop_list_[index];
-          if (gen_prop.has_default) {
-            float_value=gen_prop.mapper.Get(a, gen_prop.default_val);
-          } else {
-            float_value=gen_prop.mapper.Get(a);
-          }
-          s_[*i]=cmp_num<Real>(ss.comp_op, float_value,
-                               boost::get<float>(ss.param));
+bool QueryState::eval_atom_stmt(size_t index, const AtomImplPtr& a)
+{
+  const SelStmt& ss=q_.sel_values_[index];
+  const SelStmtInfo& info=q_.sel_info_[index];
+  switch (ss.sel_id) {
+    case Prop::ANAME:
+      return cmp_string(ss.comp_op,a->GetName(),
+                        boost::get<StringOrRegexParam>(ss.param));
+    case Prop::AINDEX:
+      return cmp_num<int>(ss.comp_op, a->GetIndex(), info.int_param);
+    case Prop::AX:
+      return cmp_num<Real>(ss.comp_op, a->TransformedPos()[0], 
+                           info.float_param);
+    case Prop::AY:
+      return cmp_num<Real>(ss.comp_op, a->TransformedPos()[1], 
+                           info.float_param);
+    case Prop::AZ:
+      return cmp_num<Real>(ss.comp_op, a->TransformedPos()[2], 
+                           info.float_param);
+    case Prop::OCC:
+      return cmp_num<Real>(ss.comp_op, a->GetOccupancy(), info.float_param);
+    case Prop::ELE:
+      return cmp_string(ss.comp_op,a->GetElement(),
+                        boost::get<StringOrRegexParam>(ss.param));
+    case Prop::ABFAC:
+      return cmp_num<Real>(ss.comp_op, a->GetBFactor(), info.float_param);
+    case Prop::WITHIN:
+      return this->do_within(a->TransformedPos(), 
+                             boost::get<WithinParam>(ss.param), ss.comp_op);
+    case Prop::ISHETATM:
+      return cmp_num<int>(ss.comp_op, a->IsHetAtom(), info.int_param);
+    case Prop::ACHARGE:
+      return cmp_num<Real>(ss.comp_op, a->GetCharge(), info.float_param);
+    default:
+      if (ss.sel_id>=Prop::CUSTOM) {
+        const GenProp& gen_prop=q_.gen_prop_list_[ss.sel_id-Prop::CUSTOM];
+        Real float_value;
+        if (gen_prop.has_default) {
+          float_value=gen_prop.mapper.Get(a, gen_prop.default_val);
         } else {
-          assert(0 && "not implemented" );
+          float_value=gen_prop.mapper.Get(a);
         }
-    }    
+        return cmp_num<Real>(ss.comp_op, float_value, info.float_param);
+      }
+      assert(0 && "not implemented" );
   }
-  return this->EvalStack(Prop::ATOM);
+  return false;
+}
+
+boost::logic::tribool QueryState::EvalAtom(const AtomImplPtr& a) {
+  if (q_.empty_optimize_)
+    return true;  
+  atom_=&a;
+  this->forget(Prop::ATOM);
+  size_t pc=0;
+  return this->eval_program(Prop::ATOM, pc);
 }
 
 void QueryState::Reset(Prop::Level level) {
   if (q_.empty_optimize_)
     return;
-  const std::set<size_t>& indices = q_.indices_[(int)level];
-  std::set<size_t>::const_iterator i = indices.begin();
-  for (; i != indices.end(); ++i) {
-    s_[*i] = boost::logic::indeterminate;
+  const std::vector<size_t>& indices=q_.level_stmts_[(int)level];
+  for (std::vector<size_t>::const_iterator 
+       i=indices.begin(), e=indices.end(); i!=e; ++i) {
+    s_[*i]=boost::logic::indeterminate;
+    known_[*i]=0;
   }
 }
 
@@ -75,16 +75,36 @@ protected:
   QueryState();  
 
   const LazilyBoundRef& GetBoundObject(int i) const;  
-  /// Evaluate stack.
-  boost::logic::tribool EvalStack(Prop::Level level);
 
 private:
   bool do_within(const geom::Vec3& pos, const impl::WithinParam& p, 
                  impl::CompOP op);
+  
+  /// evaluate compiled selection program of level, starting at pc. On exit, 
+  /// pc points to the first operation after the evaluated subtree.
+  boost::logic::tribool eval_program(Prop::Level level, size_t& pc);
+  
+  /// value of selection statement at index, evaluated for the element 
+  /// currently being looked at on the given level. Statements of enclosing 
+  /// levels are looked up, or evaluated on demand if they were skipped.
+  boost::logic::tribool stmt_value(size_t index, Prop::Level level);
+  
+  bool eval_chain_stmt(size_t index, const impl::ChainImplPtr& c);
+  bool eval_residue_stmt(size_t index, const impl::ResidueImplPtr& r);
+  bool eval_atom_stmt(size_t index, const impl::AtomImplPtr& a);
+  
+  void forget(Prop::Level level);
+  
   std::vector<boost::logic::tribool>   s_;
-  std::vector<boost::logic::tribool>   value_stack_;
+  // whether s_ holds the value of the statement for the current element
+  std::vector<char>                    known_;
   boost::shared_ptr<LazilyBoundData>   r_;
   const impl::QueryImpl&               q_;
+  // elements under evaluation. Only valid during calls to EvalChain, 
+  // EvalResidue and EvalAtom
+  const impl::ChainImplPtr*            chain_;
+  const impl::ResidueImplPtr*          residue_;
+  const impl::AtomImplPtr*             atom_;
 };
 
 }} //ns
@@ -23,7 +23,11 @@
 #include <map>
 #include <cmath>
 #include <limits>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
+#include <ost/stdint.hh>
 #include <ost/geom/geom.hh>
 
 namespace ost { namespace mol {
@@ -230,6 +234,388 @@ private:
 
 };
 
+//! flat cell-list spatial organizer
+/*
+  drop-in replacement for SpatialOrganizer using the same binning (cells of
+  size delta, centered at integer multiples of delta). Instead of a tree of
+  heap allocated buckets, items and positions are kept in contiguous
+  structure-of-arrays storage which is sorted by cell on demand. Cells are
+  addressed with CSR-style offsets on a dense grid covering the bounding box
+  of all items or, if that grid would be sparse, by binary search in the
+  sorted cell keys. Within a cell, items keep their insertion order, so
+  queries return items in the same order as SpatialOrganizer does.
+
+  The sorted layout is rebuilt lazily on the first query after a
+  modification, or explicitly by calling Build(). The rebuild is guarded by a
+  mutex, so const queries may run concurrently. Modifications must not
+  overlap with queries.
+*/
+template <class ITEM, class VEC=geom::Vec3>
+class DLLEXPORT_OST_MOL CellListOrganizer {
+public:
+  typedef std::vector<ITEM> ItemList;
+
+  CellListOrganizer(Real delta): delta_(delta), dense_(true),
+    umin_(0), vmin_(0), wmin_(0), nu_(0), nv_(0), nw_(0) {
+    if(delta==0.0) {
+      throw "delta cannot be zero";
+    }
+  }
+
+  void Add(const ITEM& item, const VEC& pos) {
+    items_.push_back(item);
+    x_.push_back(pos[0]);
+    y_.push_back(pos[1]);
+    z_.push_back(pos[2]);
+    dirty_.flag=true;
+  }
+
+  void Remove(const ITEM& item) {
+    for (size_t i=0; i<items_.size(); ++i) {
+      if (items_[i]==item) {
+        items_.erase(items_.begin()+i);
+        x_.erase(x_.begin()+i);
+        y_.erase(y_.begin()+i);
+        z_.erase(z_.begin()+i);
+        dirty_.flag=true;
+        return;
+      }
+    }
+  }
+
+  void Reserve(size_t n) {
+    items_.reserve(n);
+    x_.reserve(n);
+    y_.reserve(n);
+    z_.reserve(n);
+  }
+
+  size_t GetSize() const { return items_.size(); }
+
+  bool HasWithin(const VEC& pos, Real dist) const {
+    this->Build();
+    Real dist2=dist*dist;
+    int ulo, uhi, vlo, vhi, wlo, whi;
+    if (!this->clamp_range(pos, dist, ulo, uhi, vlo, vhi, wlo, whi)) {
+      return false;
+    }
+    if (this->prefer_full_scan(vhi-vlo+1, whi-wlo+1)) {
+      return this->first_within(0, items_.size(), pos, dist2)<items_.size();
+    }
+    for (int wc=wlo; wc<=whi; ++wc) {
+      for (int vc=vlo; vc<=vhi; ++vc) {
+        size_t b, e;
+        this->row_range(ulo, uhi, vc, wc, b, e);
+        if (this->first_within(b, e, pos, dist2)<e) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  ItemList FindWithin(const VEC& pos, Real dist) const {
+    ItemList item_list;
+    this->FindWithin(pos, dist, item_list);
+    return item_list;
+  }
+
+  /// \brief append all items within dist of pos to item_list
+  ///
+  /// Allows to reuse the same list for many queries to avoid reallocation.
+  void FindWithin(const VEC& pos, Real dist, ItemList& item_list) const {
+    this->Build();
+    Real dist2=dist*dist;
+    int ulo, uhi, vlo, vhi, wlo, whi;
+    if (!this->clamp_range(pos, dist, ulo, uhi, vlo, vhi, wlo, whi)) {
+      return;
+    }
+    if (this->prefer_full_scan(vhi-vlo+1, whi-wlo+1)) {
+      this->collect_within(0, items_.size(), pos, dist2, item_list);
+      return;
+    }
+    for (int wc=wlo; wc<=whi; ++wc) {
+      for (int vc=vlo; vc<=vhi; ++vc) {
+        size_t b, e;
+        this->row_range(ulo, uhi, vc, wc, b, e);
+        this->collect_within(b, e, pos, dist2, item_list);
+      }
+    }
+  }
+
+  /// \brief call visitor(item, squared_distance) for all items within dist
+  ///     of pos
+  ///
+  /// Items are visited in the same order as they are returned by FindWithin.
+  template <typename VISITOR>
+  void VisitWithin(const VEC& pos, Real dist, VISITOR& visitor) const {
+    this->Build();
+    Real dist2=dist*dist;
+    int ulo, uhi, vlo, vhi, wlo, whi;
+    if (!this->clamp_range(pos, dist, ulo, uhi, vlo, vhi, wlo, whi)) {
+      return;
+    }
+    if (this->prefer_full_scan(vhi-vlo+1, whi-wlo+1)) {
+      this->visit_within(0, items_.size(), pos, dist2, visitor);
+      return;
+    }
+    for (int wc=wlo; wc<=whi; ++wc) {
+      for (int vc=vlo; vc<=vhi; ++vc) {
+        size_t b, e;
+        this->row_range(ulo, uhi, vc, wc, b, e);
+        this->visit_within(b, e, pos, dist2, visitor);
+      }
+    }
+  }
+
+  void Clear()
+  {
+    items_.clear();
+    x_.clear();
+    y_.clear();
+    z_.clear();
+    offsets_.clear();
+    keys_.clear();
+    dirty_.flag=false;
+    nu_=nv_=nw_=0;
+  }
+
+  void Swap(CellListOrganizer& o) {
+    items_.swap(o.items_);
+    x_.swap(o.x_);
+    y_.swap(o.y_);
+    z_.swap(o.z_);
+    offsets_.swap(o.offsets_);
+    keys_.swap(o.keys_);
+    std::swap(delta_, o.delta_);
+    bool dirty=dirty_.flag;
+    dirty_.flag=o.dirty_.flag.load();
+    o.dirty_.flag=dirty;
+    std::swap(dense_, o.dense_);
+    std::swap(umin_, o.umin_);
+    std::swap(vmin_, o.vmin_);
+    std::swap(wmin_, o.wmin_);
+    std::swap(nu_, o.nu_);
+    std::swap(nv_, o.nv_);
+    std::swap(nw_, o.nw_);
+  }
+
+  /// \brief sort items by cell, if they have been modified since last build
+  void Build() const {
+    if (!dirty_.flag.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(dirty_.mutex);
+    if (!dirty_.flag.load(std::memory_order_relaxed)) {
+      return;
+    }
+    this->rebuild();
+    dirty_.flag.store(false, std::memory_order_release);
+  }
+
+private:
+  // number of cells per item up to which a dense offset table is used
+  static const size_t DENSE_CELLS_PER_ITEM=4;
+
+  // set by modifications, cleared by Build(). Copies get their own mutex.
+  struct DirtyFlag {
+    DirtyFlag(): flag(false) {}
+    DirtyFlag(const DirtyFlag& rhs): flag(rhs.flag.load()) {}
+    DirtyFlag& operator=(const DirtyFlag& rhs) {
+      flag=rhs.flag.load();
+      return *this;
+    }
+    std::atomic<bool> flag;
+    std::mutex mutex;
+  };
+
+  void rebuild() const {
+    offsets_.clear();
+    keys_.clear();
+    size_t n=items_.size();
+    if (n==0) {
+      nu_=nv_=nw_=0;
+      return;
+    }
+    std::vector<int> cu(n), cv(n), cw(n);
+    int umax=0, vmax=0, wmax=0;
+    for (size_t i=0; i<n; ++i) {
+      cu[i]=gen_index(x_[i]);
+      cv[i]=gen_index(y_[i]);
+      cw[i]=gen_index(z_[i]);
+      if (i==0) {
+        umin_=umax=cu[i];
+        vmin_=vmax=cv[i];
+        wmin_=wmax=cw[i];
+        continue;
+      }
+      umin_=std::min(umin_, cu[i]); umax=std::max(umax, cu[i]);
+      vmin_=std::min(vmin_, cv[i]); vmax=std::max(vmax, cv[i]);
+      wmin_=std::min(wmin_, cw[i]); wmax=std::max(wmax, cw[i]);
+    }
+    nu_=uint64_t(umax-umin_)+1;
+    nv_=uint64_t(vmax-vmin_)+1;
+    nw_=uint64_t(wmax-wmin_)+1;
+    double num_cells=double(nu_)*double(nv_)*double(nw_);
+    dense_=num_cells<=double(DENSE_CELLS_PER_ITEM*n+4096);
+    std::vector<uint64_t> cell_keys(n);
+    for (size_t i=0; i<n; ++i) {
+      cell_keys[i]=this->key(cu[i], cv[i], cw[i]);
+    }
+    // stable ordering by cell key, which preserves insertion order inside
+    // each cell
+    std::vector<size_t> perm(n);
+    if (dense_) {
+      offsets_.assign(nu_*nv_*nw_+1, 0);
+      for (size_t i=0; i<n; ++i) {
+        ++offsets_[cell_keys[i]+1];
+      }
+      for (size_t i=1; i<offsets_.size(); ++i) {
+        offsets_[i]+=offsets_[i-1];
+      }
+      std::vector<size_t> fill(offsets_.begin(), offsets_.end()-1);
+      for (size_t i=0; i<n; ++i) {
+        perm[fill[cell_keys[i]]++]=i;
+      }
+    } else {
+      for (size_t i=0; i<n; ++i) {
+        perm[i]=i;
+      }
+      std::stable_sort(perm.begin(), perm.end(), KeyCmp(cell_keys));
+      keys_.resize(n);
+      for (size_t i=0; i<n; ++i) {
+        keys_[i]=cell_keys[perm[i]];
+      }
+    }
+    this->apply_permutation(perm, items_);
+    this->apply_permutation(perm, x_);
+    this->apply_permutation(perm, y_);
+    this->apply_permutation(perm, z_);
+  }
+
+  struct KeyCmp {
+    KeyCmp(const std::vector<uint64_t>& k): keys(k) {}
+    bool operator()(size_t a, size_t b) const { return keys[a]<keys[b]; }
+    const std::vector<uint64_t>& keys;
+  };
+
+  template <typename T>
+  static void apply_permutation(const std::vector<size_t>& perm,
+                                std::vector<T>& values) {
+    std::vector<T> sorted;
+    sorted.reserve(values.size());
+    for (size_t i=0; i<perm.size(); ++i) {
+      sorted.push_back(values[perm[i]]);
+    }
+    values.swap(sorted);
+  }
+
+  uint64_t key(int u, int v, int w) const {
+    return (uint64_t(w-wmin_)*nv_+uint64_t(v-vmin_))*nu_+uint64_t(u-umin_);
+  }
+
+  // restrict cell range of a query to the occupied grid. returns false if
+  // the query does not overlap with the grid at all.
+  bool clamp_range(const VEC& pos, Real dist, int& ulo, int& uhi,
+                   int& vlo, int& vhi, int& wlo, int& whi) const {
+    if (items_.empty()) {
+      return false;
+    }
+    ulo=std::max(gen_index(pos[0]-dist), umin_);
+    vlo=std::max(gen_index(pos[1]-dist), vmin_);
+    wlo=std::max(gen_index(pos[2]-dist), wmin_);
+    uhi=std::min(gen_index(pos[0]+dist), umin_+int(nu_)-1);
+    vhi=std::min(gen_index(pos[1]+dist), vmin_+int(nv_)-1);
+    whi=std::min(gen_index(pos[2]+dist), wmin_+int(nw_)-1);
+    return ulo<=uhi && vlo<=vhi && wlo<=whi;
+  }
+
+  // for very large query radii, scanning all positions in one go is cheaper
+  // than looking up every row of cells
+  bool prefer_full_scan(int num_v, int num_w) const {
+    return !dense_ && double(num_v)*double(num_w)>double(items_.size());
+  }
+
+  // range of item indices in cells [ulo, uhi] of row (v, w). Since cells are
+  // sorted by w, v and then u, this is always one contiguous block.
+  void row_range(int ulo, int uhi, int v, int w, size_t& b, size_t& e) const {
+    uint64_t kb=this->key(ulo, v, w);
+    uint64_t ke=this->key(uhi, v, w);
+    if (dense_) {
+      b=offsets_[kb];
+      e=offsets_[ke+1];
+      return;
+    }
+    b=std::lower_bound(keys_.begin(), keys_.end(), kb)-keys_.begin();
+    e=std::upper_bound(keys_.begin()+b, keys_.end(), ke)-keys_.begin();
+  }
+
+  size_t first_within(size_t b, size_t e, const VEC& pos, Real dist2) const {
+    Real px=pos[0], py=pos[1], pz=pos[2];
+    for (size_t i=b; i<e; ++i) {
+      Real delta_x=x_[i]-px;
+      Real delta_y=y_[i]-py;
+      Real delta_z=z_[i]-pz;
+      if (delta_x*delta_x+delta_y*delta_y+delta_z*delta_z<=dist2) {
+        return i;
+      }
+    }
+    return e;
+  }
+
+  void collect_within(size_t b, size_t e, const VEC& pos, Real dist2,
+                      ItemList& item_list) const {
+    Real px=pos[0], py=pos[1], pz=pos[2];
+    for (size_t i=b; i<e; ++i) {
+      Real delta_x=x_[i]-px;
+      Real delta_y=y_[i]-py;
+      Real delta_z=z_[i]-pz;
+      if (delta_x*delta_x+delta_y*delta_y+delta_z*delta_z<=dist2) {
+        item_list.push_back(items_[i]);
+      }
+    }
+  }
+
+  template <typename VISITOR>
+  void visit_within(size_t b, size_t e, const VEC& pos, Real dist2,
+                    VISITOR& visitor) const {
+    Real px=pos[0], py=pos[1], pz=pos[2];
+    for (size_t i=b; i<e; ++i) {
+      Real delta_x=x_[i]-px;
+      Real delta_y=y_[i]-py;
+      Real delta_z=z_[i]-pz;
+      Real d2=delta_x*delta_x+delta_y*delta_y+delta_z*delta_z;
+      if (d2<=dist2) {
+        visitor(items_[i], d2);
+      }
+    }
+  }
+
+  int gen_index(Real coord) const {
+    return static_cast<int>(round(coord/delta_));
+  }
+
+  // the sorted layout is built lazily from const queries, hence everything
+  // touched by rebuild() is mutable
+  mutable ItemList items_;
+  mutable std::vector<Real> x_;
+  mutable std::vector<Real> y_;
+  mutable std::vector<Real> z_;
+  // dense mode: start of each cell in the sorted arrays (one extra element)
+  mutable std::vector<size_t> offsets_;
+  // sparse mode: cell key of each item in the sorted arrays
+  mutable std::vector<uint64_t> keys_;
+  Real delta_;
+  mutable DirtyFlag dirty_;
+  mutable bool dense_;
+  mutable int umin_;
+  mutable int vmin_;
+  mutable int wmin_;
+  mutable uint64_t nu_;
+  mutable uint64_t nv_;
+  mutable uint64_t nw_;
+};
+
 }} // ns
 
 #endif
@@ -0,0 +1,142 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+
+#include <ost/mol/bulk_builder.hh>
+#include <ost/mol/mol.hh>
+#include <ost/message.hh>
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace ost;
+using namespace ost::mol;
+
+BOOST_AUTO_TEST_SUITE( mol_base_bulk_builder );
+
+BOOST_AUTO_TEST_CASE(bulk_builder_builds_hierarchy)
+{
+  BulkBuilder builder;
+  builder.Reserve(2, 3, 5);
+  BOOST_CHECK_THROW(builder.AddResidue("GLY", ResNum(1)), Error);
+  builder.AddChain("A");
+  BOOST_CHECK_THROW(builder.AddAtom("N", geom::Vec3()), Error);
+  builder.AddResidue("GLY", ResNum(1));
+  builder.AddAtom("N", geom::Vec3(1, 0, 0), "N", 0.5, 10.0);
+  builder.AddAtom("CA", geom::Vec3(2, 0, 0), "C");
+  builder.AddResidue("ALA", ResNum(3, 'B'));
+  builder.AddAtom("N", geom::Vec3(3, 0, 0), "N");
+  builder.AddChain("B");
+  BOOST_CHECK_THROW(builder.AddAtom("O", geom::Vec3()), Error);
+  builder.AddResidue("HOH", ResNum(1));
+  builder.AddAtom("O", geom::Vec3(0, 5, 0), "O", 1.0, 20.0, true);
+  BOOST_CHECK_EQUAL(builder.GetChainCount(), size_t(2));
+  BOOST_CHECK_EQUAL(builder.GetResidueCount(), size_t(3));
+  BOOST_CHECK_EQUAL(builder.GetAtomCount(), size_t(4));
+
+  EntityHandle ent=CreateEntity();
+  XCSEditor ed=ent.EditXCS();
+  AtomHandleList atoms=builder.Build(ed);
+  BOOST_CHECK_EQUAL(atoms.size(), size_t(4));
+  BOOST_CHECK_EQUAL(ent.GetChainCount(), 2);
+  BOOST_CHECK_EQUAL(ent.GetResidueCount(), 3);
+  BOOST_CHECK_EQUAL(ent.GetAtomCount(), 4);
+  AtomHandle n=ent.FindAtom("A", 1, "N");
+  BOOST_CHECK(n==atoms[0]);
+  BOOST_CHECK_EQUAL(n.GetElement(), "N");
+  BOOST_CHECK_CLOSE(n.GetOccupancy(), Real(0.5), Real(1e-6));
+  BOOST_CHECK_CLOSE(n.GetBFactor(), Real(10.0), Real(1e-6));
+  BOOST_CHECK(!n.IsHetAtom());
+  BOOST_CHECK(ent.FindResidue("A", ResNum(3, 'B')).IsValid());
+  BOOST_CHECK(ent.FindAtom("B", 1, "O").IsHetAtom());
+  BOOST_CHECK_EQUAL(ent.FindResidue("A", 1).GetAtomCount(), 2);
+
+  // atoms are known to the spatial organizer and the atom map
+  AtomHandleList close=ent.FindWithin(geom::Vec3(0, 5, 0), 1.0);
+  BOOST_CHECK_EQUAL(close.size(), size_t(1));
+  BOOST_CHECK(close[0]==atoms[3]);
+  ed.DeleteAtom(atoms[1]);
+  BOOST_CHECK_EQUAL(ent.GetAtomCount(), 3);
+  BOOST_CHECK_EQUAL(ent.FindWithin(geom::Vec3(2, 0, 0), 0.5).size(), 
+                    size_t(0));
+
+  // adding to existing chains appends residues
+  builder.Clear();
+  builder.AddChain("B");
+  builder.AddResidue("HOH", ResNum(2));
+  builder.AddAtom("O", geom::Vec3(0, 7, 0), "O");
+  builder.Build(ed);
+  BOOST_CHECK_EQUAL(ent.GetChainCount(), 2);
+  BOOST_CHECK_EQUAL(ent.FindChain("B").GetResidueCount(), 2);
+  BOOST_CHECK_EQUAL(ent.GetAtomCount(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(bulk_builder_joins_records)
+{
+  BulkBuilder builder;
+  builder.AddChain("A");
+  builder.AddResidue("GLY", ResNum(1));
+  BOOST_CHECK_EQUAL(builder.AddAtom("N", geom::Vec3(1, 0, 0), "N"), size_t(0));
+  builder.AddResidue("ALA", ResNum(4));
+  builder.AddAtom("N", geom::Vec3(4, 0, 0), "N");
+  builder.AddChain("B");
+  BOOST_CHECK(builder.HasChain("B"));
+  BOOST_CHECK(!builder.HasChain("C"));
+  builder.AddResidue("HOH");
+  builder.AddResidue("HOH");
+  BOOST_CHECK_EQUAL(builder.GetResidueNumber(), ResNum(2));
+  builder.AddAtom("O", geom::Vec3(0, 5, 0), "O");
+  // going back to chain A and its first residue
+  builder.AddChain("A");
+  BOOST_CHECK_THROW(builder.GetResidueKey(), Error);
+  BOOST_CHECK_EQUAL(builder.GetChainCount(), size_t(2));
+  BOOST_CHECK(!builder.SelectResidue(ResNum(2)));
+  BOOST_CHECK(builder.SelectResidue(ResNum(1)));
+  BOOST_CHECK_EQUAL(builder.GetResidueKey(), "GLY");
+  BOOST_CHECK_EQUAL(builder.GetResidueQualifiedName(), "A.GLY1");
+  BOOST_CHECK_EQUAL(builder.FindAtom("N"), 0);
+  BOOST_CHECK_EQUAL(builder.FindAtom("CA"), -1);
+  size_t ca=builder.AddAltAtom("CA", "A", geom::Vec3(2, 0, 0), "C", 0.6);
+  BOOST_CHECK_EQUAL(builder.FindAtom("CA"), int(ca));
+  builder.AddAltAtomPos(ca, "B", geom::Vec3(2, 1, 0), 0.4);
+  BOOST_CHECK_THROW(builder.AddAltAtomPos(0, "B", geom::Vec3()), Error);
+  builder.InsertResidue("SER", ResNum(2, 'A'));
+  builder.AddAtom("OG", geom::Vec3(3, 0, 0), "O");
+  BOOST_CHECK(builder.SelectResidue(ResNum(2, 'A')));
+  BOOST_CHECK(builder.SelectResidue(ResNum(4)));
+
+  EntityHandle ent=CreateEntity();
+  XCSEditor ed=ent.EditXCS();
+  AtomHandleList atoms=builder.Build(ed);
+  BOOST_REQUIRE_EQUAL(atoms.size(), size_t(5));
+  BOOST_CHECK_EQUAL(atoms[ca].GetQualifiedName(), "A.GLY1.CA");
+  BOOST_CHECK_EQUAL(atoms[4].GetQualifiedName(), "A.SER2A.OG");
+  ResidueHandleList residues=ent.FindChain("A").GetResidueList();
+  BOOST_REQUIRE_EQUAL(residues.size(), size_t(3));
+  BOOST_CHECK_EQUAL(residues[1].GetName(), "SER");
+  BOOST_CHECK(ent.FindChain("A").InSequence());
+  BOOST_CHECK_EQUAL(residues[0].GetAtomCount(), 2);
+  BOOST_CHECK(residues[0].HasAltAtomGroup("B"));
+  BOOST_CHECK_CLOSE(atoms[ca].GetOccupancy(), Real(0.6), Real(1e-6));
+  BOOST_CHECK(geom::Distance(residues[0].GetAltAtomPos(atoms[ca], "B"),
+                             geom::Vec3(2, 1, 0))<1e-6);
+  BOOST_CHECK_EQUAL(ent.FindChain("B").GetResidueList()[1].GetNumber(),
+                    ResNum(2));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
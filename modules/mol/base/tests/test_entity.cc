@@ -26,6 +26,7 @@
 #include <ost/mol/chem_class.hh>
 #include <ost/mol/mol.hh>
 #include <ost/mol/property_id.hh>
+#include <ost/mol/spatial_organizer.hh>
 #include <cmath>
 
 #define CHECK_TRANSFORMED_ATOM_POSITION(ATOM,TARGET) \
@@ -178,6 +179,46 @@ BOOST_AUTO_TEST_CASE(spatial_organizer)
   BOOST_CHECK_EQUAL(std::count(ahv.begin(), ahv.end(), a5), 1);
 }
 
+BOOST_AUTO_TEST_CASE(cell_list_organizer)
+{
+  // compare against the map based organizer, once with a compact cloud of
+  // points (dense cell grid) and once with a far away outlier (sparse grid)
+  for (int sparse=0; sparse<2; ++sparse) {
+    SpatialOrganizer<int> map_org(5.0);
+    CellListOrganizer<int> cell_org(5.0);
+    int n=0;
+    for (int i=0; i<10; ++i) {
+      for (int j=0; j<10; ++j) {
+        for (int k=0; k<10; ++k, ++n) {
+          geom::Vec3 pos(i*1.7-3.1, j*2.3+0.4, k*1.1-7.5);
+          map_org.Add(n, pos);
+          cell_org.Add(n, pos);
+        }
+      }
+    }
+    if (sparse) {
+      map_org.Add(n, geom::Vec3(2000.0, -3000.0, 5000.0));
+      cell_org.Add(n, geom::Vec3(2000.0, -3000.0, 5000.0));
+    }
+    cell_org.Remove(17);
+    map_org.Remove(17);
+    for (int i=0; i<5; ++i) {
+      geom::Vec3 pos(i*2.1, i*3.3, i*-1.9);
+      for (Real dist=0.5; dist<12.0; dist+=2.5) {
+        std::vector<int> expected=map_org.FindWithin(pos, dist);
+        std::vector<int> found=cell_org.FindWithin(pos, dist);
+        BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(),
+                                      expected.begin(), expected.end());
+        BOOST_CHECK_EQUAL(cell_org.HasWithin(pos, dist),
+                          map_org.HasWithin(pos, dist));
+      }
+    }
+    BOOST_CHECK(cell_org.FindWithin(geom::Vec3(2000.0, -3000.0, 5000.0),
+                                    1.0).size()==size_t(sparse));
+    BOOST_CHECK(!cell_org.HasWithin(geom::Vec3(-500.0, 0.0, 0.0), 10.0));
+  }
+}
+
 BOOST_AUTO_TEST_CASE(transformation) 
 {
   EntityHandle eh = CreateEntity();
@@ -0,0 +1,111 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <ost/mol/mol.hh>
+#include <ost/mol/neighbour_list.hh>
+
+using namespace ost;
+using namespace ost::mol;
+
+namespace {
+
+geom::Vec3List make_points(int n, Real offset)
+{
+  geom::Vec3List points;
+  for (int i=0; i<n; ++i) {
+    points.push_back(geom::Vec3(offset+(i%7)*1.3, (i%11)*0.9-2.0, 
+                                (i%5)*1.7+offset*0.5));
+  }
+  return points;
+}
+
+IndexPairList brute_force(const geom::Vec3List& a, const geom::Vec3List& b,
+                          Real cutoff, bool symmetric)
+{
+  IndexPairList pairs;
+  for (size_t i=0; i<a.size(); ++i) {
+    for (size_t j=symmetric ? i+1 : 0; j<b.size(); ++j) {
+      Real d2=geom::Length2(a[i]-b[j]);
+      if (d2<=cutoff*cutoff) {
+        pairs.push_back(IndexPair(i, j, d2));
+      }
+    }
+  }
+  return pairs;
+}
+
+void check_pairs(const IndexPairList& found, const IndexPairList& expected)
+{
+  BOOST_REQUIRE_EQUAL(found.size(), expected.size());
+  for (size_t i=0; i<found.size(); ++i) {
+    BOOST_CHECK_EQUAL(found[i].first, expected[i].first);
+    BOOST_CHECK_EQUAL(found[i].second, expected[i].second);
+    BOOST_CHECK_CLOSE(found[i].dist2, expected[i].dist2, Real(1e-3));
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( mol_base );
+
+BOOST_AUTO_TEST_CASE(all_pairs_within_points)
+{
+  geom::Vec3List a=make_points(150, 0.0);
+  geom::Vec3List b=make_points(90, 3.5);
+  IndexPairList pairs;
+  for (Real cutoff=0.5; cutoff<10.0; cutoff+=3.0) {
+    FindAllPairsWithin(a, b, cutoff, pairs);
+    check_pairs(pairs, brute_force(a, b, cutoff, false));
+    FindAllPairsWithin(a, cutoff, pairs);
+    check_pairs(pairs, brute_force(a, a, cutoff, true));
+  }
+  FindAllPairsWithin(a, geom::Vec3List(), 5.0, pairs);
+  BOOST_CHECK(pairs.empty());
+}
+
+BOOST_AUTO_TEST_CASE(all_pairs_within_views)
+{
+  EntityHandle ent=CreateEntity();
+  XCSEditor edi=ent.EditXCS();
+  ChainHandle chain=edi.InsertChain("A");
+  ResidueHandle res=edi.AppendResidue(chain, "X");
+  edi.InsertAtom(res, "A1", geom::Vec3(0.0, 0.0, 0.0));
+  edi.InsertAtom(res, "A2", geom::Vec3(1.0, 0.0, 0.0));
+  edi.InsertAtom(res, "B1", geom::Vec3(0.0, 2.5, 0.0));
+  edi.InsertAtom(res, "B2", geom::Vec3(20.0, 0.0, 0.0));
+
+  IndexPairList pairs;
+  FindAllPairsWithin(ent.CreateFullView(), 3.0, pairs);
+  BOOST_REQUIRE_EQUAL(pairs.size(), size_t(3));
+  BOOST_CHECK(pairs[0].first==0 && pairs[0].second==1);
+  BOOST_CHECK(pairs[1].first==0 && pairs[1].second==2);
+  BOOST_CHECK(pairs[2].first==1 && pairs[2].second==2);
+  BOOST_CHECK_CLOSE(pairs[1].dist2, Real(6.25), Real(1e-4));
+
+  EntityView view_a=ent.Select("aname=A1,A2");
+  EntityView view_b=ent.Select("aname=B1,B2");
+  FindAllPairsWithin(view_a, view_b, 2.6, pairs);
+  BOOST_REQUIRE_EQUAL(pairs.size(), size_t(1));
+  BOOST_CHECK(pairs[0].first==0 && pairs[0].second==0);
+  FindAllPairsWithin(view_a, view_b, 2.8, pairs);
+  BOOST_CHECK_EQUAL(pairs.size(), size_t(2));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -266,6 +266,39 @@ BOOST_AUTO_TEST_CASE(test_query_eval_on_view)
   ensure_counts_v(v, "gctestprop_c:2.0=2", 0, 0, 0);
 }
 
+BOOST_AUTO_TEST_CASE(test_query_eval_short_circuit)
+{
+  EntityHandle e=make_query_test_entity();
+  // statements of enclosing levels that were skipped during chain or residue 
+  // evaluation must be evaluated on demand on the lower levels.
+  ensure_counts(e, "cname=A or rname=GLY", 1, 3, 27);
+  ensure_counts(e, "rname=GLY or cname=A", 1, 3, 27);
+  ensure_counts(e, "cname=B and rname=MET", 0, 0, 0);
+  ensure_counts(e, "rname=MET and cname=A", 1, 1, 8);
+  ensure_counts(e, "aname=CA or cname=B", 1, 3, 3);
+  ensure_counts(e, "aname=CA and rname=MET or rnum=3", 1, 2, 9);
+  ensure_counts(e, "rnum=2 or aname=CA and cname=A", 1, 3, 13);
+  ensure_counts(e, "aname=CA and not cname=B", 1, 3, 3);
+  // constant folding of rtype=*
+  ensure_counts(e, "rtype=* and aname=CA", 1, 3, 3);
+  ensure_counts(e, "rtype=* or aname=CA", 1, 3, 27);
+  ensure_counts(e, "rtype!=* or aname=CA", 1, 3, 3);
+  ensure_counts(e, "rtype!=* and aname=CA", 0, 0, 0);
+  ensure_counts(e, "aname=CA or rtype=*", 1, 3, 27);
+}
+
+BOOST_AUTO_TEST_CASE(test_query_compile_cache)
+{
+  Query q1("aname=CA and rnum=1:2");
+  Query q2("aname=CA and rnum=1:2");
+  BOOST_CHECK(q1.Impl()==q2.Impl());
+  Query q3("aname=CB and rnum=1:2");
+  BOOST_CHECK(q1.Impl()!=q3.Impl());
+  EntityHandle e=make_query_test_entity();
+  BOOST_CHECK_EQUAL(e.Select(q1).GetAtomCount(), 2);
+  BOOST_CHECK_EQUAL(e.Select(q2).GetAtomCount(), 2);
+}
+
 BOOST_AUTO_TEST_CASE(test_query_throw) 
 {
   EntityHandle e=make_query_test_entity();
@@ -28,6 +28,7 @@
 #include <ost/seq/alg/local_align.hh>
 #include <ost/seq/alg/global_align.hh>
 #include <ost/seq/alg/semiglobal_align.hh>
+#include <ost/seq/alg/batch_align.hh>
 #include <ost/seq/alg/entropy.hh>
 #include <ost/seq/alg/pair_subst_weight_matrix.hh>
 #include <ost/seq/alg/contact_weight_matrix.hh>
@@ -37,6 +38,7 @@
 #include <ost/seq/alg/variance_map.hh>
 #include <ost/seq/alg/hmm_pseudo_counts.hh>
 #include <ost/seq/alg/hmm_score.hh>
+#include <ost/seq/alg/hmm_align.hh>
 
 #include <algorithm>
 
@@ -170,9 +172,47 @@ void export_aln_alg()
   def("LocalAlign", &LocalAlign, (arg("seq1"), arg("seq2"),arg("subst_weight"), 
       arg("gap_open")=-5, arg("gap_ext")=-2));
   def("GlobalAlign", &GlobalAlign,(arg("seq1"),arg("seq2"),arg("subst_weight"), 
-      arg("gap_open")=-5, arg("gap_ext")=-2));
+      arg("gap_open")=-5, arg("gap_ext")=-2, arg("low_memory")=false));
   def("SemiGlobalAlign", &SemiGlobalAlign,(arg("seq1"),arg("seq2"),arg("subst_weight"), 
-      arg("gap_open")=-5, arg("gap_ext")=-2));
+      arg("gap_open")=-5, arg("gap_ext")=-2, arg("low_memory")=false));
+  def("LocalAlignScore", &LocalAlignScore, (arg("seq1"), arg("seq2"),
+      arg("subst_weight"), arg("gap_open")=-5, arg("gap_ext")=-2));
+  def("GlobalAlignScore", &GlobalAlignScore, (arg("seq1"), arg("seq2"),
+      arg("subst_weight"), arg("gap_open")=-5, arg("gap_ext")=-2));
+  def("SemiGlobalAlignScore", &SemiGlobalAlignScore, (arg("seq1"), arg("seq2"),
+      arg("subst_weight"), arg("gap_open")=-5, arg("gap_ext")=-2));
+
+  enum_<AlignMode::Type>("AlignMode")
+    .value("LOCAL", AlignMode::LOCAL)
+    .value("GLOBAL", AlignMode::GLOBAL)
+    .value("SEMIGLOBAL", AlignMode::SEMIGLOBAL)
+  ;
+
+  class_<BatchAlignResult>("BatchAlignResult", init<>())
+    .def_readonly("query_index", &BatchAlignResult::query_index)
+    .def_readonly("target_index", &BatchAlignResult::target_index)
+    .def_readonly("score", &BatchAlignResult::score)
+    .def_readonly("identity", &BatchAlignResult::identity)
+    .def_readonly("query_begin", &BatchAlignResult::query_begin)
+    .def_readonly("query_end", &BatchAlignResult::query_end)
+    .def_readonly("target_begin", &BatchAlignResult::target_begin)
+    .def_readonly("target_end", &BatchAlignResult::target_end)
+    .def_readonly("cigar", &BatchAlignResult::cigar)
+    .def("GetLength", &BatchAlignResult::GetLength)
+    .def("ToAlignment", &BatchAlignResult::ToAlignment,
+         (arg("query"), arg("target")))
+  ;
+
+  class_<BatchAlignResultList>("BatchAlignResultList", init<>())
+    .def(vector_indexing_suite<BatchAlignResultList>())
+  ;
+
+  def("BatchAlign", &BatchAlign, (arg("query"), arg("targets"),
+      arg("subst_weight"), arg("gap_open")=-5, arg("gap_ext")=-2,
+      arg("mode")=AlignMode::LOCAL, arg("num_threads")=0));
+  def("AllVsAllAlign", &AllVsAllAlign, (arg("seqs"), arg("subst_weight"),
+      arg("gap_open")=-5, arg("gap_ext")=-2, arg("mode")=AlignMode::LOCAL,
+      arg("num_threads")=0));
   def("ShannonEntropy", &ShannonEntropy, (arg("aln"), arg("ignore_gaps")=true));
 }
 
@@ -343,6 +383,37 @@ void export_hmm_algorithms() {
                               arg("del_extend_penalty_factor")=0.6,
                               arg("ins_start_penalty_factor")=0.6,
                               arg("ins_extend_penalty_factor")=0.6));
+
+  class_<HMMAlignResult>("HMMAlignResult", init<>())
+    .def_readonly("name", &HMMAlignResult::name)
+    .def_readonly("score", &HMMAlignResult::score)
+    .def_readonly("query_begin", &HMMAlignResult::query_begin)
+    .def_readonly("query_end", &HMMAlignResult::query_end)
+    .def_readonly("target_begin", &HMMAlignResult::target_begin)
+    .def_readonly("target_end", &HMMAlignResult::target_end)
+    .def_readonly("cigar", &HMMAlignResult::cigar)
+    .def("GetLength", &HMMAlignResult::GetLength)
+    .def("ToAlignment", &HMMAlignResult::ToAlignment,
+         (arg("query"), arg("target")))
+  ;
+
+  class_<HMMAlignResultList>("HMMAlignResultList", init<>())
+    .def(vector_indexing_suite<HMMAlignResultList>())
+  ;
+
+  def("HMMAlign", &HMMAlign, (arg("query"), arg("target"),
+                              arg("match_score_offset")=-0.03,
+                              arg("del_start_penalty_factor")=0.6,
+                              arg("del_extend_penalty_factor")=0.6,
+                              arg("ins_start_penalty_factor")=0.6,
+                              arg("ins_extend_penalty_factor")=0.6));
+  def("HMMSearch", &HMMSearch, (arg("query"), arg("db"),
+                                arg("match_score_offset")=-0.03,
+                                arg("del_start_penalty_factor")=0.6,
+                                arg("del_extend_penalty_factor")=0.6,
+                                arg("ins_start_penalty_factor")=0.6,
+                                arg("ins_extend_penalty_factor")=0.6,
+                                arg("num_threads")=0));
 }
 
 BOOST_PYTHON_MODULE(_ost_seq_alg)
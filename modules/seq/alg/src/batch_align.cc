@@ -0,0 +1,251 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#include <cassert>
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+#include <ost/parallel_for.hh>
+#include "impl/align_fill.hh"
+#include "batch_align.hh"
+
+namespace ost { namespace seq { namespace alg {
+
+namespace {
+
+// number of targets aligned against the same query in one go by a thread
+const size_t TARGETS_PER_TASK=16;
+
+typedef boost::shared_ptr<impl::SubstProfile> SubstProfilePtr;
+
+struct BatchTask {
+  BatchTask(): query(0), target_begin(0), target_end(0), first_result(0) { }
+
+  int    query;
+  int    target_begin;
+  int    target_end;
+  size_t first_result;
+};
+
+// aligns a list of queries against a list of targets, or every sequence
+// against the following ones if the two lists are the same
+class BatchAlignJob {
+public:
+  BatchAlignJob(const std::vector<String>& queries,
+                const std::vector<String>& targets, bool all_vs_all,
+                const SubstWeightMatrixPtr& subst, int gap_open, int gap_ext,
+                AlignMode::Type mode):
+    queries_(queries), targets_(targets), all_vs_all_(all_vs_all),
+    subst_(subst), gap_open_(gap_open), gap_ext_(gap_ext), mode_(mode)
+  {
+    size_t count=0;
+    for (size_t i=0; i<queries_.size(); ++i) {
+      size_t first=all_vs_all_ ? std::min(i+1, targets_.size()) : 0;
+      for (size_t j=first; j<targets_.size(); j+=TARGETS_PER_TASK) {
+        BatchTask task;
+        task.query=i;
+        task.target_begin=j;
+        task.target_end=std::min(j+TARGETS_PER_TASK, targets_.size());
+        task.first_result=count;
+        count+=task.target_end-task.target_begin;
+        tasks_.push_back(task);
+      }
+    }
+    results_.resize(count);
+  }
+
+  void Run(int num_threads)
+  {
+    ParallelForChunks(tasks_.size(), 1, num_threads, Worker(*this));
+  }
+
+  BatchAlignResultList& GetResults() { return results_; }
+
+private:
+  // every thread keeps the profile of the query it aligns. The tasks of a
+  // query are consecutive, so the profile rarely needs to be rebuilt.
+  class Worker {
+  public:
+    Worker(BatchAlignJob& job): job_(job), query_(-1) { }
+
+    void operator()(size_t begin, size_t end)
+    {
+      for (size_t i=begin; i<end; ++i) {
+        const BatchTask& task=job_.tasks_[i];
+        if (task.query!=query_) {
+          prof_.reset(new impl::SubstProfile(job_.queries_[task.query],
+                                             *job_.subst_));
+          query_=task.query;
+        }
+        job_.AlignTask(task, *prof_);
+      }
+    }
+  private:
+    BatchAlignJob&  job_;
+    int             query_;
+    SubstProfilePtr prof_;
+  };
+
+  void AlignTask(const BatchTask& task, const impl::SubstProfile& prof)
+  {
+    for (int t=task.target_begin; t<task.target_end; ++t) {
+      BatchAlignResult& result=results_[task.first_result+t-task.target_begin];
+      result.query_index=task.query;
+      result.target_index=t;
+      this->Align(prof, queries_[task.query], targets_[t], result);
+    }
+  }
+
+  void Align(const impl::SubstProfile& prof, const String& s1,
+             const String& s2, BatchAlignResult& result) const;
+
+  const std::vector<String>& queries_;
+  const std::vector<String>& targets_;
+  bool                       all_vs_all_;
+  SubstWeightMatrixPtr       subst_;
+  int                        gap_open_;
+  int                        gap_ext_;
+  AlignMode::Type            mode_;
+  std::vector<BatchTask>     tasks_;
+  BatchAlignResultList       results_;
+};
+
+void BatchAlignJob::Align(const impl::SubstProfile& prof, const String& s1,
+                          const String& s2, BatchAlignResult& result) const
+{
+  impl::AlnMode aln_mode=impl::LOCAL_ALN;
+  if (mode_==AlignMode::GLOBAL) {
+    aln_mode=impl::GLOBAL_ALN;
+  } else if (mode_==AlignMode::SEMIGLOBAL) {
+    aln_mode=impl::SEMIGLOBAL_ALN;
+  }
+  impl::AlnMat mat(s1.size()+1, s2.size()+1);
+  impl::FillAlnMat(prof, s2, gap_open_, gap_ext_, aln_mode, mat);
+  int i=mat.GetWidth()-1;
+  int j=mat.GetHeight()-1;
+  if (aln_mode==impl::LOCAL_ALN) {
+    // the same cell LocalAlign() starts its first alignment from
+    int max_score=0;
+    for (int x=0; x<mat.GetWidth(); ++x) {
+      for (int y=0; y<mat.GetHeight(); ++y) {
+        if (mat(x, y).score>=max_score) {
+          i=x;
+          j=y;
+          max_score=mat(x, y).score;
+        }
+      }
+    }
+  }
+  result.score=mat(i, j).score;
+  result.query_end=i;
+  result.target_end=j;
+  String path;
+  int aligned=0, identical=0;
+  while (aln_mode==impl::LOCAL_ALN ? (i>0 && j>0 && mat(i, j).score>0) :
+                                     (i>0 || j>0)) {
+    switch (mat(i, j).from) {
+      case impl::DIAG:
+        --i;
+        --j;
+        path.push_back('M');
+        if (s1[i]!='-' && s2[j]!='-') {
+          ++aligned;
+        }
+        if (s1[i]!='-' && s1[i]==s2[j]) {
+          ++identical;
+        }
+        break;
+      case impl::INS1:
+        --j;
+        path.push_back('I');
+        break;
+      case impl::INS2:
+        --i;
+        path.push_back('D');
+        break;
+      default:
+        assert(0 && "should never get here");
+        return;
+    }
+  }
+  if (aln_mode==impl::LOCAL_ALN && path.size()<2) {
+    // LocalAlign() drops such alignments as well
+    result.query_end=result.target_end=0;
+    return;
+  }
+  result.query_begin=i;
+  result.target_begin=j;
+  result.identity=aligned>0 ? 100*static_cast<Real>(identical)/aligned : 0;
+  result.cigar=impl::PathToCigar(path);
+}
+
+std::vector<String> GetStrings(const ConstSequenceList& seqs)
+{
+  std::vector<String> strings;
+  strings.reserve(seqs.GetCount());
+  for (int i=0; i<seqs.GetCount(); ++i) {
+    strings.push_back(seqs[i].GetString());
+  }
+  return strings;
+}
+
+}
+
+int BatchAlignResult::GetLength() const
+{
+  return impl::CigarLength(cigar);
+}
+
+AlignmentHandle BatchAlignResult::ToAlignment(const ConstSequenceHandle& query,
+                                              const ConstSequenceHandle& target) const
+{
+  if (cigar.empty()) {
+    return AlignmentHandle();
+  }
+  return impl::CigarToAln(cigar, query, target, query_begin, target_begin);
+}
+
+BatchAlignResultList BatchAlign(const ConstSequenceHandle& query,
+                                const ConstSequenceList& targets,
+                                const SubstWeightMatrixPtr& subst,
+                                int gap_open, int gap_ext,
+                                AlignMode::Type mode, int num_threads)
+{
+  std::vector<String> queries(1, query.GetString());
+  std::vector<String> target_strings=GetStrings(targets);
+  BatchAlignJob job(queries, target_strings, false, subst, gap_open, gap_ext,
+                    mode);
+  job.Run(num_threads);
+  BatchAlignResultList results;
+  results.swap(job.GetResults());
+  return results;
+}
+
+BatchAlignResultList AllVsAllAlign(const ConstSequenceList& seqs,
+                                   const SubstWeightMatrixPtr& subst,
+                                   int gap_open, int gap_ext,
+                                   AlignMode::Type mode, int num_threads)
+{
+  std::vector<String> strings=GetStrings(seqs);
+  BatchAlignJob job(strings, strings, true, subst, gap_open, gap_ext, mode);
+  job.Run(num_threads);
+  BatchAlignResultList results;
+  results.swap(job.GetResults());
+  return results;
+}
+
+}}}
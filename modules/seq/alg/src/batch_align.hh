@@ -0,0 +1,121 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_SEQ_ALG_BATCH_ALIGN_HH
+#define OST_SEQ_ALG_BATCH_ALIGN_HH
+
+#include <vector>
+#include <ost/seq/alignment_handle.hh>
+#include <ost/seq/sequence_list.hh>
+#include <ost/seq/alg/module_config.hh>
+#include <ost/seq/alg/subst_weight_matrix.hh>
+
+namespace ost { namespace seq { namespace alg {
+
+struct AlignMode {
+  enum Type {
+    LOCAL=0,
+    GLOBAL,
+    SEMIGLOBAL
+  };
+};
+
+/// \brief outcome of aligning two sequences with BatchAlign() or
+///        AllVsAllAlign()
+///
+/// Only the score and the path through the alignment matrix are stored. The
+/// alignment is built on demand with ToAlignment().
+struct DLLEXPORT_OST_SEQ_ALG BatchAlignResult {
+  BatchAlignResult(): query_index(0), target_index(0), score(0), identity(0),
+    query_begin(0), query_end(0), target_begin(0), target_end(0) { }
+
+  /// \brief index of the query, always 0 for BatchAlign()
+  int    query_index;
+  /// \brief index of the target in the list of targets or sequences
+  int    target_index;
+  int    score;
+  /// \brief sequence identity in the range 0 to 100 as returned by
+  ///        SequenceIdentity() with RefMode::ALIGNMENT
+  Real   identity;
+  /// \brief first aligned residue of the query
+  int    query_begin;
+  /// \brief one past the last aligned residue of the query
+  int    query_end;
+  int    target_begin;
+  int    target_end;
+  /// \brief path of the alignment as run lengths of the operations M (query
+  ///        and target residue aligned), D (query residue against a gap) and
+  ///        I (target residue against a gap), e.g. "5M2I10M". Empty if no
+  ///        local alignment was found.
+  String cigar;
+
+  /// \brief number of alignment columns
+  int GetLength() const;
+
+  /// \brief the alignment the result describes
+  ///
+  /// The alignment is the same as the one LocalAlign(), GlobalAlign() or
+  /// SemiGlobalAlign() return for the two sequences, the first one for
+  /// LocalAlign(). query and target have to be the sequences the result was
+  /// calculated for. An invalid handle is returned if there is no alignment.
+  AlignmentHandle ToAlignment(const ConstSequenceHandle& query,
+                              const ConstSequenceHandle& target) const;
+
+  bool operator==(const BatchAlignResult& rhs) const
+  {
+    return query_index==rhs.query_index && target_index==rhs.target_index &&
+           score==rhs.score && identity==rhs.identity &&
+           query_begin==rhs.query_begin && query_end==rhs.query_end &&
+           target_begin==rhs.target_begin && target_end==rhs.target_end &&
+           cigar==rhs.cigar;
+  }
+
+  bool operator!=(const BatchAlignResult& rhs) const
+  {
+    return !this->operator==(rhs);
+  }
+};
+
+typedef std::vector<BatchAlignResult> BatchAlignResultList;
+
+/// \brief aligns query against all targets on several threads
+///
+/// The substitution weights of the query are looked up once and shared by all
+/// threads. Results are returned in the order of the targets.
+///
+/// \param num_threads number of worker threads, one per core if 0
+BatchAlignResultList DLLEXPORT_OST_SEQ_ALG
+BatchAlign(const ConstSequenceHandle& query, const ConstSequenceList& targets,
+           const SubstWeightMatrixPtr& subst, int gap_open=-5, int gap_ext=-2,
+           AlignMode::Type mode=AlignMode::LOCAL, int num_threads=0);
+
+/// \brief aligns every sequence against all sequences following it in the
+///        list on several threads
+///
+/// Sequence i is used as query and aligned against sequences i+1 to n-1. The
+/// results are ordered by query index first and target index second.
+///
+/// \param num_threads number of worker threads, one per core if 0
+BatchAlignResultList DLLEXPORT_OST_SEQ_ALG
+AllVsAllAlign(const ConstSequenceList& seqs, const SubstWeightMatrixPtr& subst,
+              int gap_open=-5, int gap_ext=-2,
+              AlignMode::Type mode=AlignMode::LOCAL, int num_threads=0);
+
+}}}
+
+#endif
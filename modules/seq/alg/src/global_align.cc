@@ -18,6 +18,7 @@
 //------------------------------------------------------------------------------
 #include <ost/log.hh>
 #include "impl/align_impl.hh"
+#include "impl/align_fill.hh"
 #include "global_align.hh"
 
 namespace ost { namespace seq { namespace alg {
@@ -40,58 +41,36 @@ void Traceback(impl::AlnMat& mat, int max_i, int max_j,
 AlignmentList GlobalAlign(const ConstSequenceHandle& s1, 
                           const ConstSequenceHandle& s2,
                           alg::SubstWeightMatrixPtr& subst,
-                          int gap_open,int gap_ext)
+                          int gap_open,int gap_ext, bool low_memory)
 {
-  impl::AlnMat mat(s1.GetLength()+1, s2.GetLength()+1);
-  // init first column of matrix
-  if (mat.GetHeight() > 1) {
-    mat(0, 1).score = mat(0, 0).score + gap_open;
-    mat(0, 1).from = impl::INS1;
-  }
-  for (int j = 2; j < mat.GetHeight(); ++j) {
-    mat(0, j).score = mat(0, j-1).score + gap_ext;
-    mat(0, j).from = impl::INS1;
-  }
-  // fill the alignment matrix
-  for (int i = 0; i < mat.GetWidth()-1; ++i) {
-    mat(i+1, 0).score = mat(i, 0).score
-                      + (mat(i, 0).from==impl::INS2 ? gap_ext : gap_open);
-    mat(i+1,0).from = impl::INS2;
-    for (int j = 0; j < mat.GetHeight()-1; ++j) {
-      char c1=s1[i];
-      char c2=s2[j];
-      short weight=subst->GetWeight(c1, c2);
-      int diag=weight+mat(i, j).score;
-      int ins1=mat(i+1, j).score
-              +(mat(i+1, j).from==impl::INS1 ? gap_ext : gap_open);
-      int ins2=mat(i, j+1).score
-              +(mat(i, j+1).from==impl::INS2 ? gap_ext : gap_open);
-      if (diag>=ins1) {
-        if (diag>=ins2) {
-          mat(i+1, j+1).score=diag;
-          mat(i+1, j+1).from=impl::DIAG;
-        } else {
-          mat(i+1, j+1).score=ins2;
-          mat(i+1, j+1).from=impl::INS2;
-        }
-      } else if (ins1>ins2) {
-        mat(i+1, j+1).score=ins1;
-        mat(i+1, j+1).from=impl::INS1;
-      } else {
-        mat(i+1, j+1).score=ins2;
-        mat(i+1, j+1).from=impl::INS2;
-      }
-    }
-  }
-  // write traceback matrix in debug mode
+  impl::SubstProfile prof(s1.GetString(), *subst);
+  AlignmentList alignments;
+  if (low_memory) {
+    impl::LowMemoryAlign(prof, s1, s2, gap_open, gap_ext, impl::GLOBAL_ALN,
+                         alignments);
+  } else {
+    impl::AlnMat mat(s1.GetLength()+1, s2.GetLength()+1);
+    impl::FillAlnMat(prof, s2.GetString(), gap_open, gap_ext, impl::GLOBAL_ALN,
+                     mat);
+    // write traceback matrix in debug mode
 #if !defined(NDEBUG)
-  DbgWriteAlnMatrix(mat,s1, s2);
+    DbgWriteAlnMatrix(mat,s1, s2);
 #endif
-  AlignmentList alignments;
-  Traceback(mat, mat.GetWidth(), mat.GetHeight(), s1, s2, alignments);
+    Traceback(mat, mat.GetWidth(), mat.GetHeight(), s1, s2, alignments);
+  }
   LOG_DEBUG(alignments.back().ToString(80));
 
   return alignments;
 }
 
+int GlobalAlignScore(const ConstSequenceHandle& s1,
+                     const ConstSequenceHandle& s2,
+                     alg::SubstWeightMatrixPtr& subst,
+                     int gap_open, int gap_ext)
+{
+  impl::SubstProfile prof(s1.GetString(), *subst);
+  return impl::AlnScore(prof, s2.GetString(), gap_open, gap_ext,
+                        impl::GLOBAL_ALN);
+}
+
 }}}
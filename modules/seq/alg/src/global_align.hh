@@ -29,7 +29,16 @@ namespace ost { namespace seq { namespace alg {
 AlignmentList DLLEXPORT_OST_SEQ_ALG GlobalAlign(const ConstSequenceHandle& s1,
                                                 const ConstSequenceHandle& s2,
                                                 SubstWeightMatrixPtr& subst,
-                                                int gap_open=-5,int gap_ext=-2);
+                                                int gap_open=-5,int gap_ext=-2,
+                                                bool low_memory=false);
+
+/// \brief score of the alignment GlobalAlign() would return
+///
+/// Only one column of the alignment matrix is kept in memory.
+int DLLEXPORT_OST_SEQ_ALG GlobalAlignScore(const ConstSequenceHandle& s1,
+                                           const ConstSequenceHandle& s2,
+                                           SubstWeightMatrixPtr& subst,
+                                           int gap_open=-5, int gap_ext=-2);
 }}}
 
 #endif
@@ -0,0 +1,372 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <ost/message.hh>
+#include <ost/parallel_for.hh>
+#include "impl/align_impl.hh"
+#include "hmm_align.hh"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OST_HMM_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OST_HMM_SSE
+#endif
+
+namespace ost { namespace seq { namespace alg {
+
+namespace {
+
+// the rows of the target frequencies are padded to a multiple of this
+const int ROW_ALIGN=8;
+
+const float NEG_INF=-std::numeric_limits<float>::infinity();
+
+// where the best path into a cell comes from, the lower three bits are used
+// for the match state, the upper bits for the gap states
+enum {
+  FROM_START=0, FROM_M=1, FROM_A1=2, FROM_A2=3, FROM_B1=4, FROM_B2=5,
+  M_MASK=7, A1_EXT=8, A2_EXT=16, B1_EXT=32, B2_EXT=64
+};
+
+// log2 of the transition probabilities of a profile with the penalty factors
+// of HMMScore() applied
+struct Transitions {
+  Transitions(const ProfileHandle& prof, Real del_start, Real del_ext,
+              Real ins_start, Real ins_ext);
+
+  std::vector<float> m2m, m2i, m2d, i2m, i2i, d2m, d2d;
+};
+
+Transitions::Transitions(const ProfileHandle& prof, Real del_start,
+                         Real del_ext, Real ins_start, Real ins_ext):
+  m2m(prof.size()), m2i(prof.size()), m2d(prof.size()), i2m(prof.size()),
+  i2i(prof.size()), d2m(prof.size()), d2d(prof.size())
+{
+  for (size_t i=0; i<prof.size(); ++i) {
+    const ProfileColumn& col=prof[i];
+    m2m[i]=std::log2(col.GetTransProb(HMM_M2M));
+    m2i[i]=std::log2(col.GetTransProb(HMM_M2I))*ins_start;
+    i2m[i]=std::log2(col.GetTransProb(HMM_I2M));
+    i2i[i]=std::log2(col.GetTransProb(HMM_I2I))*ins_ext;
+    m2d[i]=std::log2(col.GetTransProb(HMM_M2D))*del_start;
+    d2m[i]=std::log2(col.GetTransProb(HMM_D2M));
+    d2d[i]=std::log2(col.GetTransProb(HMM_D2D))*del_ext;
+  }
+}
+
+// out[j]=sum over a of q[a]*t[a*stride+j] for all j<stride. stride is a
+// multiple of ROW_ALIGN.
+void DotRow(const float* q, const float* t, int stride, float* out)
+{
+#if defined(OST_HMM_AVX2)
+  for (int j=0; j<stride; j+=8) {
+    __m256 sum=_mm256_setzero_ps();
+    for (int a=0; a<20; ++a) {
+      sum=_mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(q[a]),
+                                           _mm256_loadu_ps(t+a*stride+j)));
+    }
+    _mm256_storeu_ps(out+j, sum);
+  }
+#elif defined(OST_HMM_SSE)
+  for (int j=0; j<stride; j+=4) {
+    __m128 sum=_mm_setzero_ps();
+    for (int a=0; a<20; ++a) {
+      sum=_mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(q[a]),
+                                     _mm_loadu_ps(t+a*stride+j)));
+    }
+    _mm_storeu_ps(out+j, sum);
+  }
+#else
+  for (int j=0; j<stride; ++j) {
+    float sum=0;
+    for (int a=0; a<20; ++a) {
+      sum+=q[a]*t[a*stride+j];
+    }
+    out[j]=sum;
+  }
+#endif
+}
+
+// everything about the query needed to align it, shared by all threads
+class HMMAligner {
+public:
+  HMMAligner(const ProfileHandle& query, Real match_score_offset,
+             Real del_start, Real del_ext, Real ins_start, Real ins_ext):
+    query_(query), trans_(query, del_start, del_ext, ins_start, ins_ext),
+    freqs_(20*query.size()), offset_(match_score_offset),
+    del_start_(del_start), del_ext_(del_ext), ins_start_(ins_start),
+    ins_ext_(ins_ext)
+  {
+    for (size_t i=0; i<query.size(); ++i) {
+      std::copy(query[i].freqs_begin(), query[i].freqs_end(), &freqs_[20*i]);
+    }
+  }
+
+  HMMAlignResult Align(const ProfileHandle& target) const;
+
+private:
+  const ProfileHandle& query_;
+  Transitions          trans_;
+  std::vector<float>   freqs_;
+  float                offset_;
+  Real                 del_start_;
+  Real                 del_ext_;
+  Real                 ins_start_;
+  Real                 ins_ext_;
+};
+
+HMMAlignResult HMMAligner::Align(const ProfileHandle& target) const
+{
+  HMMAlignResult result;
+  const int n0=query_.size();
+  const int n1=target.size();
+  if (n0==0 || n1==0) {
+    return result;
+  }
+  Transitions tt(target, del_start_, del_ext_, ins_start_, ins_ext_);
+  const Transitions& tq=trans_;
+  // target frequencies divided by the average background frequencies, one row
+  // per amino acid, so the column scores of a query column against all target
+  // columns are calculated as one vectorized dot product
+  const int stride=(n1+ROW_ALIGN-1)/ROW_ALIGN*ROW_ALIGN;
+  std::vector<float> t_freqs(20*stride, 0.0f);
+  const Real* q_null=query_.GetNullModel().freqs_begin();
+  const Real* t_null=target.GetNullModel().freqs_begin();
+  for (int a=0; a<20; ++a) {
+    float null_freq=(q_null[a]+t_null[a])/2;
+    for (int j=0; j<n1; ++j) {
+      t_freqs[a*stride+j]=target[j].freqs_begin()[a]/null_freq;
+    }
+  }
+  // the states are
+  //  M:  query column i and target column j are aligned
+  //  A1: target column j is aligned to a gap after query column i, which is in
+  //      its insert state
+  //  A2: same as A1, but the target is in its delete state
+  //  B1: query column i is aligned to a gap after target column j, which is
+  //      in its insert state
+  //  B2: same as B1, but the query is in its delete state
+  std::vector<float> m(n1), a1(n1), a2(n1), b1(n1), b2(n1);
+  std::vector<float> pm(n1, NEG_INF), pb1(n1, NEG_INF), pb2(n1, NEG_INF);
+  std::vector<float> pa1(n1, NEG_INF), pa2(n1, NEG_INF);
+  std::vector<float> col_score(stride);
+  std::vector<unsigned char> from(n0*n1);
+  float best=0;
+  int best_i=-1, best_j=-1;
+  for (int i=0; i<n0; ++i) {
+    DotRow(&freqs_[20*i], &t_freqs[0], stride, &col_score[0]);
+    unsigned char* from_row=&from[size_t(i)*n1];
+    for (int j=0; j<n1; ++j) {
+      unsigned char f=FROM_START;
+      float prev=0;
+      if (i>0 && j>0) {
+        float c=pm[j-1]+tq.m2m[i-1]+tt.m2m[j-1];
+        if (c>prev) { prev=c; f=FROM_M; }
+        c=pa1[j-1]+tq.i2m[i-1]+tt.m2m[j-1];
+        if (c>prev) { prev=c; f=FROM_A1; }
+        c=pa2[j-1]+tt.d2m[j-1]+tq.m2m[i-1];
+        if (c>prev) { prev=c; f=FROM_A2; }
+        c=pb1[j-1]+tt.i2m[j-1]+tq.m2m[i-1];
+        if (c>prev) { prev=c; f=FROM_B1; }
+        c=pb2[j-1]+tq.d2m[i-1]+tt.m2m[j-1];
+        if (c>prev) { prev=c; f=FROM_B2; }
+      }
+      m[j]=std::log2(col_score[j])+offset_+prev;
+      if (m[j]>best) {
+        best=m[j];
+        best_i=i;
+        best_j=j;
+      }
+      if (j>0) {
+        float open=m[j-1]+tq.m2i[i]+tt.m2m[j-1];
+        float ext=a1[j-1]+tq.i2i[i]+tt.m2m[j-1];
+        a1[j]=std::max(open, ext);
+        f|=(ext>open ? A1_EXT : 0);
+        open=m[j-1]+tt.m2d[j-1];
+        ext=a2[j-1]+tt.d2d[j-1];
+        a2[j]=std::max(open, ext);
+        f|=(ext>open ? A2_EXT : 0);
+      } else {
+        a1[j]=a2[j]=NEG_INF;
+      }
+      if (i>0) {
+        float open=pm[j]+tt.m2i[j]+tq.m2m[i-1];
+        float ext=pb1[j]+tt.i2i[j]+tq.m2m[i-1];
+        b1[j]=std::max(open, ext);
+        f|=(ext>open ? B1_EXT : 0);
+        open=pm[j]+tq.m2d[i-1];
+        ext=pb2[j]+tq.d2d[i-1];
+        b2[j]=std::max(open, ext);
+        f|=(ext>open ? B2_EXT : 0);
+      } else {
+        b1[j]=b2[j]=NEG_INF;
+      }
+      from_row[j]=f;
+    }
+    std::swap(m, pm);
+    std::swap(a1, pa1);
+    std::swap(a2, pa2);
+    std::swap(b1, pb1);
+    std::swap(b2, pb2);
+  }
+  if (best_i<0) {
+    return result;
+  }
+  result.score=best;
+  result.query_end=best_i+1;
+  result.target_end=best_j+1;
+  int i=best_i, j=best_j;
+  int state=FROM_M;
+  String path;
+  while (true) {
+    unsigned char f=from[size_t(i)*n1+j];
+    if (state==FROM_M) {
+      path.push_back('M');
+      state=f & M_MASK;
+      if (state==FROM_START) {
+        break;
+      }
+      --i;
+      --j;
+    } else if (state==FROM_A1 || state==FROM_A2) {
+      path.push_back('I');
+      if (!(f & (state==FROM_A1 ? A1_EXT : A2_EXT))) {
+        state=FROM_M;
+      }
+      --j;
+    } else {
+      path.push_back('D');
+      if (!(f & (state==FROM_B1 ? B1_EXT : B2_EXT))) {
+        state=FROM_M;
+      }
+      --i;
+    }
+  }
+  result.query_begin=i;
+  result.target_begin=j;
+  result.cigar=impl::PathToCigar(path);
+  return result;
+}
+
+class HMMSearchJob {
+public:
+  HMMSearchJob(const HMMAligner& aligner, const ProfileDB& db):
+    aligner_(aligner), db_(db), names_(db.GetNames()), results_(names_.size())
+  { }
+
+  void Run(int num_threads)
+  {
+    ParallelForChunks(names_.size(), 1, num_threads, Worker(*this));
+  }
+
+  HMMAlignResultList& GetResults() { return results_; }
+
+private:
+  class Worker {
+  public:
+    Worker(HMMSearchJob& job): job_(job) { }
+
+    void operator()(size_t begin, size_t end)
+    {
+      for (size_t i=begin; i<end; ++i) {
+        job_.Work(i);
+      }
+    }
+  private:
+    HMMSearchJob& job_;
+  };
+
+  void Work(size_t index)
+  {
+    try {
+      ProfileHandlePtr target=db_.GetProfile(names_[index]);
+      results_[index]=aligner_.Align(*target);
+      results_[index].name=names_[index];
+    } catch (std::exception& e) {
+      throw Error(names_[index]+": "+e.what());
+    }
+  }
+
+  const HMMAligner&   aligner_;
+  const ProfileDB&    db_;
+  std::vector<String> names_;
+  HMMAlignResultList  results_;
+};
+
+bool HigherScore(const HMMAlignResult& lhs, const HMMAlignResult& rhs)
+{
+  return lhs.score>rhs.score;
+}
+
+}
+
+int HMMAlignResult::GetLength() const
+{
+  return impl::CigarLength(cigar);
+}
+
+AlignmentHandle HMMAlignResult::ToAlignment(const ProfileHandle& query,
+                                            const ProfileHandle& target) const
+{
+  if (cigar.empty()) {
+    return AlignmentHandle();
+  }
+  SequenceHandle s1=CreateSequence("query", query.GetSequence());
+  SequenceHandle s2=CreateSequence(name.empty() ? "target" : name,
+                                   target.GetSequence());
+  return impl::CigarToAln(cigar, s1, s2, query_begin, target_begin);
+}
+
+HMMAlignResult HMMAlign(const ProfileHandle& query, const ProfileHandle& target,
+                        Real match_score_offset,
+                        Real del_start_penalty_factor,
+                        Real del_extend_penalty_factor,
+                        Real ins_start_penalty_factor,
+                        Real ins_extend_penalty_factor)
+{
+  HMMAligner aligner(query, match_score_offset, del_start_penalty_factor,
+                     del_extend_penalty_factor, ins_start_penalty_factor,
+                     ins_extend_penalty_factor);
+  return aligner.Align(target);
+}
+
+HMMAlignResultList HMMSearch(const ProfileHandle& query, const ProfileDB& db,
+                             Real match_score_offset,
+                             Real del_start_penalty_factor,
+                             Real del_extend_penalty_factor,
+                             Real ins_start_penalty_factor,
+                             Real ins_extend_penalty_factor,
+                             int num_threads)
+{
+  HMMAligner aligner(query, match_score_offset, del_start_penalty_factor,
+                     del_extend_penalty_factor, ins_start_penalty_factor,
+                     ins_extend_penalty_factor);
+  HMMSearchJob job(aligner, db);
+  job.Run(num_threads);
+  HMMAlignResultList results;
+  results.swap(job.GetResults());
+  std::stable_sort(results.begin(), results.end(), HigherScore);
+  return results;
+}
+
+}}}
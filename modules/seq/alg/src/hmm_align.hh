@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_SEQ_ALG_HMM_ALIGN_HH
+#define OST_SEQ_ALG_HMM_ALIGN_HH
+
+#include <vector>
+#include <ost/seq/profile_handle.hh>
+#include <ost/seq/alignment_handle.hh>
+#include <ost/seq/alg/module_config.hh>
+
+namespace ost { namespace seq { namespace alg {
+
+/// \brief local alignment of two profiles found by HMMAlign() or HMMSearch()
+struct DLLEXPORT_OST_SEQ_ALG HMMAlignResult {
+  HMMAlignResult(): score(0), query_begin(0), query_end(0), target_begin(0),
+    target_end(0) { }
+
+  /// \brief name of the target in the profile database, empty for HMMAlign()
+  String name;
+  /// \brief score of the alignment, equal to HMMScore() of the alignment
+  ///        without the correlation score
+  Real   score;
+  /// \brief first aligned column of the query
+  int    query_begin;
+  /// \brief one past the last aligned column of the query
+  int    query_end;
+  int    target_begin;
+  int    target_end;
+  /// \brief path of the alignment as run lengths of the operations M (query
+  ///        and target column aligned), D (query column against a gap) and
+  ///        I (target column against a gap), e.g. "5M2I10M". Empty if no
+  ///        column pair has a positive score.
+  String cigar;
+
+  /// \brief number of alignment columns
+  int GetLength() const;
+
+  /// \brief alignment of the sequences of the two profiles
+  ///
+  /// The sequences are called "query" and name, or "target" if name is empty.
+  /// An invalid handle is returned if there is no alignment.
+  AlignmentHandle ToAlignment(const ProfileHandle& query,
+                              const ProfileHandle& target) const;
+
+  bool operator==(const HMMAlignResult& rhs) const
+  {
+    return name==rhs.name && score==rhs.score &&
+           query_begin==rhs.query_begin && query_end==rhs.query_end &&
+           target_begin==rhs.target_begin && target_end==rhs.target_end &&
+           cigar==rhs.cigar;
+  }
+
+  bool operator!=(const HMMAlignResult& rhs) const
+  {
+    return !this->operator==(rhs);
+  }
+};
+
+typedef std::vector<HMMAlignResult> HMMAlignResultList;
+
+/// \brief best scoring local alignment of two profile HMMs
+///
+/// The Viterbi algorithm maximizes the score HMMScore() assigns to an
+/// alignment, except for its correlation term, which can't be optimized
+/// column by column. Aligned columns score with the log-odds of their
+/// frequencies plus match_score_offset, gaps with the transition
+/// probabilities of the HMMs. Both profiles must have HMM data.
+HMMAlignResult DLLEXPORT_OST_SEQ_ALG
+HMMAlign(const ProfileHandle& query, const ProfileHandle& target,
+         Real match_score_offset=-0.03,
+         Real del_start_penalty_factor=0.6,
+         Real del_extend_penalty_factor=0.6,
+         Real ins_start_penalty_factor=0.6,
+         Real ins_extend_penalty_factor=0.6);
+
+/// \brief aligns query against all profiles in db on several threads
+///
+/// Same as calling HMMAlign() for every profile in the database. The results
+/// are sorted by decreasing score.
+///
+/// \param num_threads number of worker threads, one per core if 0
+HMMAlignResultList DLLEXPORT_OST_SEQ_ALG
+HMMSearch(const ProfileHandle& query, const ProfileDB& db,
+          Real match_score_offset=-0.03,
+          Real del_start_penalty_factor=0.6,
+          Real del_extend_penalty_factor=0.6,
+          Real ins_start_penalty_factor=0.6,
+          Real ins_extend_penalty_factor=0.6,
+          int num_threads=0);
+
+}}}
+
+#endif
@@ -0,0 +1,206 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include "align_fill.hh"
+
+namespace ost { namespace seq { namespace alg { namespace impl {
+
+void FillAlnColumnsScalar(const SubstProfile& prof, const String& s2,
+                          int gap_open, int gap_ext, AlnMode mode,
+                          int y_begin, int y_end, AlnColumn& col,
+                          AlnMat* block, int* max_score)
+{
+  const int width=col.size();
+  const int height=s2.size()+1;
+  const int n=y_end-y_begin;
+  if (block) {
+    for (int x=0; x<width; ++x) {
+      (*block)(x, 0)=col[x];
+    }
+  }
+  if (n<=0) {
+    return;
+  }
+  std::vector<const short*> weights(n);
+  for (int k=0; k<n; ++k) {
+    weights[k]=prof.GetRow(SubstProfile::GetResidueType(s2[y_begin-1+k]));
+  }
+  // the matrix is filled row by row, up and cur hold the columns y_begin-1 to
+  // y_end-1 of the previous and the current row.
+  AlnColumn up(n+1), cur(n+1);
+  up[0]=col[0];
+  for (int k=1; k<=n; ++k) {
+    up[k]=FirstRowCell(mode, y_begin-1+k, gap_open, gap_ext);
+    if (block) {
+      (*block)(0, k)=up[k];
+    }
+  }
+  for (int x=1; x<width; ++x) {
+    cur[0]=col[x];
+    for (int k=1; k<=n; ++k) {
+      int diag=weights[k-1][x-1]+up[k-1].score;
+      int ins1=cur[k-1].score
+              +(cur[k-1].from==INS1 ? gap_ext : gap_open);
+      int ins2=up[k].score
+              +(up[k].from==INS2 ? gap_ext : gap_open);
+      if (mode==LOCAL_ALN) {
+        ins1=std::max(0, ins1);
+        ins2=std::max(0, ins2);
+      } else if (mode==SEMIGLOBAL_ALN) {
+        // ignore end gaps (if one of the two seqs is done)
+        if (y_begin-1+k==height-1) {
+          ins2=up[k].score;
+        }
+        if (x==width-1) {
+          ins1=cur[k-1].score;
+        }
+      }
+      if (diag>=ins1) {
+        if (diag>=ins2) {
+          cur[k].score=diag;
+          cur[k].from=DIAG;
+        } else {
+          cur[k].score=ins2;
+          cur[k].from=INS2;
+        }
+      } else if (ins1>ins2) {
+        cur[k].score=ins1;
+        cur[k].from=INS1;
+      } else {
+        cur[k].score=ins2;
+        cur[k].from=INS2;
+      }
+    }
+    if (max_score) {
+      for (int k=1; k<=n; ++k) {
+        *max_score=std::max(*max_score, cur[k].score);
+      }
+    }
+    if (block) {
+      for (int k=1; k<=n; ++k) {
+        (*block)(x, k)=cur[k];
+      }
+    }
+    col[x]=cur[n];
+    std::swap(up, cur);
+  }
+  col[0]=FirstRowCell(mode, y_end-1, gap_open, gap_ext);
+}
+
+void FillAlnColumns(const SubstProfile& prof, const String& s2,
+                    int gap_open, int gap_ext, AlnMode mode,
+                    int y_begin, int y_end, AlnColumn& col,
+                    AlnMat* block, int* max_score)
+{
+  if (!FillAlnColumnsSIMD(prof, s2, gap_open, gap_ext, mode, y_begin, y_end,
+                          col, block, max_score)) {
+    FillAlnColumnsScalar(prof, s2, gap_open, gap_ext, mode, y_begin, y_end,
+                         col, block, max_score);
+  }
+}
+
+void FillAlnMat(const SubstProfile& prof, const String& s2,
+                int gap_open, int gap_ext, AlnMode mode, AlnMat& mat)
+{
+  AlnColumn col(mat.GetWidth());
+  for (int x=0; x<mat.GetWidth(); ++x) {
+    col[x]=FirstColumnCell(mode, x, gap_open, gap_ext);
+  }
+  FillAlnColumns(prof, s2, gap_open, gap_ext, mode, 1, mat.GetHeight(), col,
+                 &mat, NULL);
+}
+
+int AlnScore(const SubstProfile& prof, const String& s2,
+             int gap_open, int gap_ext, AlnMode mode)
+{
+  AlnColumn col(prof.GetLength()+1);
+  for (size_t x=0; x<col.size(); ++x) {
+    col[x]=FirstColumnCell(mode, x, gap_open, gap_ext);
+  }
+  int max_score=0;
+  FillAlnColumns(prof, s2, gap_open, gap_ext, mode, 1, s2.size()+1, col,
+                 NULL, &max_score);
+  return mode==LOCAL_ALN ? max_score : col.back().score;
+}
+
+void LowMemoryAlign(const SubstProfile& prof, const ConstSequenceHandle& s1,
+                    const ConstSequenceHandle& s2, int gap_open, int gap_ext,
+                    AlnMode mode, AlignmentList& alignments)
+{
+  assert(mode!=LOCAL_ALN && "local alignments need the complete matrix");
+  const String& str2=s2.GetString();
+  const int width=prof.GetLength()+1;
+  const int height=str2.size()+1;
+  // blocks of a multiple of the SIMD vector width
+  int block_size=std::max(1, static_cast<int>(std::sqrt(double(height)))/16)*16;
+  std::vector<AlnColumn> checkpoints;
+  AlnColumn col(width);
+  for (int x=0; x<width; ++x) {
+    col[x]=FirstColumnCell(mode, x, gap_open, gap_ext);
+  }
+  for (int y=1; y<height; y+=block_size) {
+    checkpoints.push_back(col);
+    FillAlnColumns(prof, str2, gap_open, gap_ext, mode, y,
+                   std::min(y+block_size, height), col, NULL, NULL);
+  }
+  AlnMat block(width, block_size+1);
+  int i=width-1;
+  int j=height-1;
+  String aln_str1;
+  String aln_str2;
+  while (!checkpoints.empty()) {
+    int y_begin=1+(checkpoints.size()-1)*block_size;
+    FillAlnColumns(prof, str2, gap_open, gap_ext, mode, y_begin, j+1,
+                   checkpoints.back(), &block, NULL);
+    checkpoints.pop_back();
+    while (j>=y_begin) {
+      switch (block(i, j-y_begin+1).from) {
+        case DIAG:
+          --i;
+          --j;
+          aln_str1.push_back(s1[i]);
+          aln_str2.push_back(s2[j]);
+          break;
+        case INS1:
+          --j;
+          aln_str1.push_back('-');
+          aln_str2.push_back(s2[j]);
+          break;
+        case INS2:
+          --i;
+          aln_str1.push_back(s1[i]);
+          aln_str2.push_back('-');
+          break;
+        default:
+          assert(0 && "should never get here");
+      }
+    }
+  }
+  // the first column only consists of gaps
+  while (i>0) {
+    --i;
+    aln_str1.push_back(s1[i]);
+    aln_str2.push_back('-');
+  }
+  StoreStrAsAln(aln_str1, aln_str2, s1, s2, i, j, alignments);
+}
+
+}}}}
@@ -0,0 +1,86 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_SEQ_ALG_ALIGN_FILL_HH
+#define OST_SEQ_ALG_ALIGN_FILL_HH
+
+#include <ost/seq/alg/module_config.hh>
+#include "align_impl.hh"
+#include "align_simd.hh"
+
+namespace ost { namespace seq { namespace alg { namespace impl {
+
+/// \brief calculates the columns y_begin to y_end-1 of the alignment matrix
+///        of the profile sequence (along the width) and s2 (along the height)
+///
+/// The cells are set to exactly the scores and paths LocalAlign(),
+/// GlobalAlign() and SemiGlobalAlign() use for mode. The first row is given
+/// by FirstRowCell().
+///
+/// \param col column y_begin-1 on input, column y_end-1 on output
+/// \param block if not NULL, receives the columns y_begin-1 to y_end-1 in
+///     its columns 0 to y_end-y_begin
+/// \param max_score if not NULL, is raised to the highest score of the
+///     calculated cells
+void DLLEXPORT_OST_SEQ_ALG FillAlnColumns(const SubstProfile& prof,
+                                          const String& s2,
+                                          int gap_open, int gap_ext,
+                                          AlnMode mode, int y_begin,
+                                          int y_end, AlnColumn& col,
+                                          AlnMat* block, int* max_score);
+
+/// \brief scalar version of FillAlnColumns(), used if FillAlnColumnsSIMD()
+///        can't be
+void DLLEXPORT_OST_SEQ_ALG FillAlnColumnsScalar(const SubstProfile& prof,
+                                                const String& s2,
+                                                int gap_open, int gap_ext,
+                                                AlnMode mode, int y_begin,
+                                                int y_end, AlnColumn& col,
+                                                AlnMat* block, int* max_score);
+
+/// \brief fills the complete alignment matrix, including the first row and
+///        column
+void DLLEXPORT_OST_SEQ_ALG FillAlnMat(const SubstProfile& prof,
+                                      const String& s2,
+                                      int gap_open, int gap_ext,
+                                      AlnMode mode, AlnMat& mat);
+
+/// \brief score of the best alignment without storing the matrix
+///
+/// That's the score of the last cell for global and semi-global alignments
+/// and the highest score of all cells for local alignments.
+int DLLEXPORT_OST_SEQ_ALG AlnScore(const SubstProfile& prof, const String& s2,
+                                   int gap_open, int gap_ext, AlnMode mode);
+
+/// \brief global or semi-global alignment without storing the matrix
+///
+/// Only every n-th column of the matrix is kept, with n about the square
+/// root of the length of s2. The traceback recalculates one block of n
+/// columns at a time. This needs about twice as long as filling the
+/// complete matrix, but the memory grows with the length of s1 times the
+/// square root of the length of s2 only. The resulting alignment is the same.
+void DLLEXPORT_OST_SEQ_ALG LowMemoryAlign(const SubstProfile& prof,
+                                          const ConstSequenceHandle& s1,
+                                          const ConstSequenceHandle& s2,
+                                          int gap_open, int gap_ext,
+                                          AlnMode mode,
+                                          AlignmentList& alignments);
+
+}}}}
+
+#endif
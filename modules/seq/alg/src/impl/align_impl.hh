@@ -19,6 +19,9 @@
 #ifndef OST_ALIGN_IMPL_HH
 #define OST_ALIGN_IMPL_HH
 
+#include <sstream>
+#include <ost/log.hh>
+#include <ost/message.hh>
 #include <ost/seq/alignment_handle.hh>
 #include <ost/seq/alg/subst_weight_matrix.hh>
 //#include "module_config.hh"
@@ -57,6 +60,42 @@ struct DLLEXPORT AlnMat {
   int               width_;
   int               height_;  
 };
+
+typedef std::vector<impl::AlnPos> AlnColumn;
+
+typedef enum {
+  GLOBAL_ALN,
+  SEMIGLOBAL_ALN,
+  LOCAL_ALN
+} AlnMode;
+
+/// \brief cell (0, y) of the alignment matrix
+inline impl::AlnPos FirstRowCell(impl::AlnMode mode, int y,
+                                 int gap_open, int gap_ext)
+{
+  impl::AlnPos pos;
+  if (y>0 && mode!=impl::LOCAL_ALN) {
+    pos.from=impl::INS1;
+    if (mode==impl::GLOBAL_ALN) {
+      pos.score=gap_open+(y-1)*gap_ext;
+    }
+  }
+  return pos;
+}
+
+/// \brief cell (x, 0) of the alignment matrix
+inline impl::AlnPos FirstColumnCell(impl::AlnMode mode, int x,
+                                    int gap_open, int gap_ext)
+{
+  impl::AlnPos pos;
+  if (x>0 && mode!=impl::LOCAL_ALN) {
+    pos.from=impl::INS2;
+    if (mode==impl::GLOBAL_ALN) {
+      pos.score=gap_open+(x-1)*gap_ext;
+    }
+  }
+  return pos;
+}
         
 inline void DLLEXPORT SetRoute(impl::AlnMat& mat, int& i, int& j,
                      const ConstSequenceHandle& s1, 
@@ -112,6 +151,86 @@ inline void DLLEXPORT StoreStrAsAln(String& aln_str1, String& aln_str2,
   alignments.push_back(aln);
 };
 
+/// \brief run length encoding of a traceback path
+///
+/// The path lists the operations M (aligned pair), D (residue of the first
+/// sequence against a gap) and I (residue of the second sequence against a
+/// gap) from the end of the alignment to its start.
+inline String PathToCigar(const String& path)
+{
+  std::stringstream cigar;
+  for (String::const_reverse_iterator i=path.rbegin(), e=path.rend(); i!=e; ) {
+    String::const_reverse_iterator j=i;
+    while (j!=e && *j==*i) {
+      ++j;
+    }
+    cigar << (j-i) << *i;
+    i=j;
+  }
+  return cigar.str();
+}
+
+/// \brief number of alignment columns of a path created with PathToCigar()
+inline int CigarLength(const String& cigar)
+{
+  int length=0;
+  std::stringstream ss(cigar);
+  int count;
+  char op;
+  while (ss >> count >> op) {
+    length+=count;
+  }
+  return length;
+}
+
+/// \brief alignment of s1 starting at residue i and s2 starting at residue j
+///        following a path created with PathToCigar()
+inline AlignmentHandle CigarToAln(const String& cigar,
+                                  const ConstSequenceHandle& s1,
+                                  const ConstSequenceHandle& s2,
+                                  int i, int j)
+{
+  const String& str1=s1.GetString();
+  const String& str2=s2.GetString();
+  String aln_str1, aln_str2;
+  int x=i, y=j;
+  std::stringstream ss(cigar);
+  int count;
+  char op;
+  while (ss >> count >> op) {
+    for (int k=0; k<count; ++k) {
+      if (op=='M' || op=='D') {
+        if (x<0 || x>=static_cast<int>(str1.size())) {
+          throw Error("alignment doesn't fit the first sequence");
+        }
+        aln_str1.push_back(str1[x++]);
+      } else {
+        aln_str1.push_back('-');
+      }
+      if (op=='M' || op=='I') {
+        if (y<0 || y>=static_cast<int>(str2.size())) {
+          throw Error("alignment doesn't fit the second sequence");
+        }
+        aln_str2.push_back(str2[y++]);
+      } else {
+        aln_str2.push_back('-');
+      }
+    }
+  }
+  AlignmentHandle aln=CreateAlignment();
+  aln.AddSequence(CreateSequence(s1.GetName(), aln_str1));
+  aln.AddSequence(CreateSequence(s2.GetName(), aln_str2));
+  if (s1.GetAttachedView()) {
+    aln.AttachView(0, s1.GetAttachedView());
+  }
+  if (s2.GetAttachedView()) {
+    aln.AttachView(1, s2.GetAttachedView());
+  }
+  aln.SetSequenceOffset(0, i);
+  aln.SetSequenceOffset(1, j);
+  return aln;
+}
+
 #if !defined(NDEBUG)
 inline void DLLEXPORT DbgWriteAlnMatrix(impl::AlnMat& mat,
                                         const ConstSequenceHandle& s1, 
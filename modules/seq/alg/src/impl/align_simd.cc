@@ -0,0 +1,334 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#include <cstdlib>
+#include <algorithm>
+#include "align_simd.hh"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OST_ALIGN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OST_ALIGN_SSE
+#endif
+
+namespace ost { namespace seq { namespace alg { namespace impl {
+
+SubstProfile::SubstProfile(const String& seq, const SubstWeightMatrix& subst):
+  length_(seq.size()), stride_(seq.size()+2*PADDING),
+  weights_((SubstWeightMatrix::ALPHABET_SIZE+1)*stride_, 0),
+  max_abs_weight_(0)
+{
+  // the last row, used for unknown residue types, stays 0
+  for (int t=0; t<SubstWeightMatrix::ALPHABET_SIZE; ++t) {
+    short* row=&weights_[t*stride_+PADDING];
+    for (int i=0; i<length_; ++i) {
+      row[i]=subst.GetWeight(seq[i], 'A'+t);
+      max_abs_weight_=std::max(max_abs_weight_, std::abs(int(row[i])));
+    }
+  }
+}
+
+#if defined(OST_ALIGN_AVX2) || defined(OST_ALIGN_SSE)
+
+namespace {
+
+// The matrix is filled in stripes of LANES columns. Within a stripe, lane k
+// works on column y0+k and lags k rows behind lane 0, i.e. at step t the
+// lanes hold the cells (t, y0), (t-1, y0+1), ... of one anti-diagonal. All
+// cells the recurrence needs are then either in the same lane one step
+// before (x-1, y), in the neighbouring lane one step before (x, y-1) or in
+// the neighbouring lane two steps before (x-1, y-1). Lane 0 takes its
+// neighbours from the last column of the previous stripe.
+//
+// In contrast to Gotoh-style affine gaps, which could be vectorized with
+// striped vectors, the existing implementations decide between gap opening
+// and extension by the path of the neighbouring cell. Walking along the
+// anti-diagonals keeps that decision and therefore the results identical.
+
+#if defined(OST_ALIGN_AVX2)
+struct Vec {
+  typedef __m256i Type;
+  static const int LANES=16;
+
+  static Type Set1(short v) { return _mm256_set1_epi16(v); }
+  static Type Load(const short* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void Store(short* p, Type v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  static Type Adds(Type a, Type b) { return _mm256_adds_epi16(a, b); }
+  static Type Max(Type a, Type b) { return _mm256_max_epi16(a, b); }
+  static Type Min(Type a, Type b) { return _mm256_min_epi16(a, b); }
+  static Type CmpGt(Type a, Type b) { return _mm256_cmpgt_epi16(a, b); }
+  static Type CmpEq(Type a, Type b) { return _mm256_cmpeq_epi16(a, b); }
+  static Type And(Type a, Type b) { return _mm256_and_si256(a, b); }
+  static Type AndNot(Type a, Type b) { return _mm256_andnot_si256(a, b); }
+  static Type Or(Type a, Type b) { return _mm256_or_si256(a, b); }
+  // moves every lane up by one and puts first into lane 0
+  static Type ShiftIn(Type v, short first) {
+    Type low_to_high=_mm256_permute2x128_si256(v, v, 0x08);
+    return _mm256_insert_epi16(_mm256_alignr_epi8(v, low_to_high, 14), first, 0);
+  }
+};
+#else
+struct Vec {
+  typedef __m128i Type;
+  static const int LANES=8;
+
+  static Type Set1(short v) { return _mm_set1_epi16(v); }
+  static Type Load(const short* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static void Store(short* p, Type v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+  static Type Adds(Type a, Type b) { return _mm_adds_epi16(a, b); }
+  static Type Max(Type a, Type b) { return _mm_max_epi16(a, b); }
+  static Type Min(Type a, Type b) { return _mm_min_epi16(a, b); }
+  static Type CmpGt(Type a, Type b) { return _mm_cmpgt_epi16(a, b); }
+  static Type CmpEq(Type a, Type b) { return _mm_cmpeq_epi16(a, b); }
+  static Type And(Type a, Type b) { return _mm_and_si128(a, b); }
+  static Type AndNot(Type a, Type b) { return _mm_andnot_si128(a, b); }
+  static Type Or(Type a, Type b) { return _mm_or_si128(a, b); }
+  // moves every lane up by one and puts first into lane 0
+  static Type ShiftIn(Type v, short first) {
+    return _mm_insert_epi16(_mm_slli_si128(v, 2), first, 0);
+  }
+};
+#endif
+
+typedef Vec::Type VecType;
+
+inline VecType Select(VecType mask, VecType a, VecType b)
+{
+  return Vec::Or(Vec::And(mask, a), Vec::AndNot(mask, b));
+}
+
+// largest absolute score that guarantees that adding any weight or gap
+// penalty doesn't saturate
+const int SCORE_LIMIT=32767;
+
+template <AlnMode MODE>
+bool FillStripes(const SubstProfile& prof, const String& s2,
+                 int gap_open, int gap_ext, int y_begin, int y_end,
+                 AlnColumn& col, AlnMat* block, int* max_score)
+{
+  const int L=Vec::LANES;
+  const int width=col.size();
+  const int height=s2.size()+1;
+  if (prof.GetLength()!=width-1 || y_begin<1 || y_end>height) {
+    return false;
+  }
+  const int max_step=std::max(prof.GetMaxAbsWeight(),
+                              std::max(std::abs(gap_open), std::abs(gap_ext)));
+  const int limit=SCORE_LIMIT-max_step;
+  // row numbers are kept in 16 bit lanes too
+  if (limit<=0 || width+L>=SCORE_LIMIT) {
+    return false;
+  }
+  for (int x=0; x<width; ++x) {
+    if (std::abs(col[x].score)>limit) {
+      return false;
+    }
+  }
+  // the scores of the first row change linearly
+  if (std::abs(FirstRowCell(MODE, y_begin, gap_open, gap_ext).score)>limit ||
+      std::abs(FirstRowCell(MODE, y_end-1, gap_open, gap_ext).score)>limit) {
+    return false;
+  }
+  const int num_steps=width+L-1;
+  // last column of the previous stripe, zero-padded for the lanes past the
+  // last row
+  std::vector<short> col_score(num_steps+1, 0);
+  std::vector<short> col_from(num_steps+1, UNKN);
+  for (int x=0; x<width; ++x) {
+    col_score[x]=col[x].score;
+    col_from[x]=col[x].from;
+  }
+  if (block) {
+    for (int x=0; x<width; ++x) {
+      (*block)(x, 0)=col[x];
+    }
+  }
+  // weights of lane k at step t are at weights[t*L+k], anti-diagonal scores
+  // and paths are stored the same way
+  std::vector<short> weights(num_steps*L);
+  std::vector<short> scores(num_steps*L);
+  std::vector<short> paths(num_steps*L);
+  short tmp[2][Vec::LANES];
+
+  for (int k=0; k<L; ++k) {
+    tmp[0][k]=-k;
+  }
+  const VecType lane_offsets=Vec::Load(tmp[0]);
+  const VecType zero=Vec::Set1(0);
+  const VecType one=Vec::Set1(1);
+  const VecType all_set=Vec::CmpEq(zero, zero);
+  const VecType lowest=Vec::Set1(-SCORE_LIMIT);
+  const VecType last_row=Vec::Set1(width-1);
+  const VecType v_diag=Vec::Set1(DIAG);
+  const VecType v_ins1=Vec::Set1(INS1);
+  const VecType v_ins2=Vec::Set1(INS2);
+  const VecType open1=Vec::Set1(gap_open);
+  const VecType ext1=Vec::Set1(gap_ext);
+  VecType best=lowest;
+
+  for (int y0=y_begin; y0<y_end; y0+=L) {
+    int lanes=std::min(L, y_end-y0);
+    // first row and weights of each lane. Lanes past the last column
+    // calculate garbage which is never used.
+    for (int k=0; k<L; ++k) {
+      bool valid=k<lanes;
+      AlnPos first=FirstRowCell(MODE, valid ? y0+k : 0, gap_open, gap_ext);
+      tmp[0][k]=first.score;
+      tmp[1][k]=first.from;
+      const short* row=prof.GetRow(valid ? SubstProfile::GetResidueType(s2[y0+k-1]) :
+                                   SubstWeightMatrix::ALPHABET_SIZE);
+      // cell (x, y) gets the weight of residue x-1 of the profile
+      for (int t=0; t<num_steps; ++t) {
+        weights[t*L+k]=row[t-k-1];
+      }
+    }
+    const VecType first_score=Vec::Load(tmp[0]);
+    const VecType first_from=Vec::Load(tmp[1]);
+    // semi-global alignments don't penalize gaps in the last column
+    for (int k=0; k<L; ++k) {
+      tmp[0][k]=(MODE==SEMIGLOBAL_ALN && y0+k==height-1) ? 0 : gap_open;
+      tmp[1][k]=(MODE==SEMIGLOBAL_ALN && y0+k==height-1) ? 0 : gap_ext;
+    }
+    const VecType open2=Vec::Load(tmp[0]);
+    const VecType ext2=Vec::Load(tmp[1]);
+    for (int k=0; k<L; ++k) {
+      tmp[0][k]=k<lanes ? width : 0;
+    }
+    // x<end for all cells inside the matrix
+    const VecType end=Vec::Load(tmp[0]);
+
+    VecType score1=zero, score2=zero, from1=Vec::Set1(UNKN);
+    VecType x=lane_offsets;
+    VecType max_score=zero, min_score=zero;
+    for (int t=0; t<num_steps; ++t) {
+      VecType left=Vec::ShiftIn(score1, col_score[t]);
+      VecType left_from=Vec::ShiftIn(from1, col_from[t]);
+      VecType diag=Vec::ShiftIn(score2, t>0 ? col_score[t-1] : 0);
+      diag=Vec::Adds(diag, Vec::Load(&weights[t*L]));
+      VecType ins1=Vec::Adds(left, Select(Vec::CmpEq(left_from, v_ins1),
+                                          ext1, open1));
+      VecType ins2=Vec::Adds(score1, Select(Vec::CmpEq(from1, v_ins2),
+                                            ext2, open2));
+      if (MODE==LOCAL_ALN) {
+        ins1=Vec::Max(ins1, zero);
+        ins2=Vec::Max(ins2, zero);
+      }
+      if (MODE==SEMIGLOBAL_ALN) {
+        ins1=Select(Vec::CmpEq(x, last_row), left, ins1);
+      }
+      VecType ins1_gt=Vec::CmpGt(ins1, diag);
+      VecType take_diag=Vec::AndNot(Vec::Or(ins1_gt, Vec::CmpGt(ins2, diag)),
+                                    all_set);
+      VecType take_ins1=Vec::And(ins1_gt, Vec::CmpGt(ins1, ins2));
+      VecType score=Select(take_diag, diag, Select(take_ins1, ins1, ins2));
+      VecType from=Select(take_diag, v_diag, Select(take_ins1, v_ins1, v_ins2));
+      // lanes that haven't entered the matrix yet hold the first row
+      VecType outside=Vec::CmpGt(one, x);
+      score=Select(outside, first_score, score);
+      from=Select(outside, first_from, from);
+      max_score=Vec::Max(max_score, score);
+      min_score=Vec::Min(min_score, score);
+      best=Vec::Max(best, Select(Vec::AndNot(outside, Vec::CmpGt(end, x)),
+                                 score, lowest));
+      Vec::Store(&scores[t*L], score);
+      Vec::Store(&paths[t*L], from);
+      score2=score1;
+      score1=score;
+      from1=from;
+      x=Vec::Adds(x, one);
+    }
+    Vec::Store(tmp[0], max_score);
+    Vec::Store(tmp[1], min_score);
+    for (int k=0; k<L; ++k) {
+      if (tmp[0][k]>limit || tmp[1][k]<-limit) {
+        return false;
+      }
+    }
+    if (block) {
+      for (int k=0; k<lanes; ++k) {
+        (*block)(0, y0+k-y_begin+1)=FirstRowCell(MODE, y0+k, gap_open,
+                                                 gap_ext);
+      }
+      for (int x=1; x<width; ++x) {
+        for (int k=0; k<lanes; ++k) {
+          AlnPos& pos=(*block)(x, y0+k-y_begin+1);
+          pos.score=scores[(x+k)*L+k];
+          pos.from=static_cast<Path>(paths[(x+k)*L+k]);
+        }
+      }
+    }
+    // the last lane becomes the left neighbour of the next stripe
+    for (int x=1; x<width; ++x) {
+      col_score[x]=scores[(x+lanes-1)*L+lanes-1];
+      col_from[x]=paths[(x+lanes-1)*L+lanes-1];
+    }
+    AlnPos first=FirstRowCell(MODE, y0+lanes-1, gap_open, gap_ext);
+    col_score[0]=first.score;
+    col_from[0]=first.from;
+  }
+  if (y_begin<y_end) {
+    for (int x=0; x<width; ++x) {
+      col[x].score=col_score[x];
+      col[x].from=static_cast<Path>(col_from[x]);
+    }
+  }
+  if (max_score && y_begin<y_end && width>1) {
+    Vec::Store(tmp[0], best);
+    for (int k=0; k<L; ++k) {
+      *max_score=std::max(*max_score, int(tmp[0][k]));
+    }
+  }
+  return true;
+}
+
+}
+
+#endif
+
+bool FillAlnColumnsSIMD(const SubstProfile& prof, const String& s2,
+                        int gap_open, int gap_ext, AlnMode mode,
+                        int y_begin, int y_end, AlnColumn& col,
+                        AlnMat* block, int* max_score)
+{
+#if defined(OST_ALIGN_AVX2) || defined(OST_ALIGN_SSE)
+  switch (mode) {
+    case GLOBAL_ALN:
+      return FillStripes<GLOBAL_ALN>(prof, s2, gap_open, gap_ext, y_begin,
+                                     y_end, col, block, max_score);
+    case SEMIGLOBAL_ALN:
+      return FillStripes<SEMIGLOBAL_ALN>(prof, s2, gap_open, gap_ext, y_begin,
+                                         y_end, col, block, max_score);
+    case LOCAL_ALN:
+      return FillStripes<LOCAL_ALN>(prof, s2, gap_open, gap_ext, y_begin,
+                                    y_end, col, block, max_score);
+  }
+#endif
+  return false;
+}
+
+}}}}
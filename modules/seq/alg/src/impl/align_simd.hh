@@ -0,0 +1,86 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#ifndef OST_SEQ_ALG_ALIGN_SIMD_HH
+#define OST_SEQ_ALG_ALIGN_SIMD_HH
+
+#include <vector>
+#include <ost/seq/alg/module_config.hh>
+#include <ost/seq/alg/subst_weight_matrix.hh>
+#include "align_impl.hh"
+
+namespace ost { namespace seq { namespace alg { namespace impl {
+
+/// \brief substitution weights of one sequence against all residue types
+///
+/// Looking up the weights once per sequence instead of once per matrix cell
+/// is what makes the vectorized fill possible. The profile only depends on
+/// the sequence and the substitution matrix and can be reused to align the
+/// same sequence against many others.
+class DLLEXPORT_OST_SEQ_ALG SubstProfile {
+public:
+  /// \brief number of zero weights before and after every row
+  static const int PADDING=16;
+
+  SubstProfile(const String& seq, const SubstWeightMatrix& subst);
+
+  /// \brief residue type as used by GetRow(), all characters the substitution
+  ///        matrix doesn't know share one type with weight 0
+  static int GetResidueType(char olc)
+  {
+    int t=toupper(olc)-'A';
+    return (t>=0 && t<SubstWeightMatrix::ALPHABET_SIZE) ? t :
+                                                SubstWeightMatrix::ALPHABET_SIZE;
+  }
+
+  /// \brief weights of all residues of the sequence against residue type t
+  ///
+  /// Indices -PADDING to GetLength()+PADDING-1 may be accessed.
+  const short* GetRow(int t) const
+  {
+    return &weights_[t*stride_+PADDING];
+  }
+
+  int GetLength() const { return length_; }
+
+  /// \brief largest absolute weight in the profile
+  int GetMaxAbsWeight() const { return max_abs_weight_; }
+
+private:
+  int                length_;
+  int                stride_;
+  std::vector<short> weights_;
+  int                max_abs_weight_;
+};
+
+/// \brief SIMD version of FillAlnColumns()
+///
+/// The scores are calculated with 16 bit integers. Returns false if the build
+/// lacks the required instructions or if the scores might not fit into 16
+/// bits. col and max_score are left untouched then, the content of block is
+/// undefined.
+bool DLLEXPORT_OST_SEQ_ALG FillAlnColumnsSIMD(const SubstProfile& prof,
+                                              const String& s2,
+                                              int gap_open, int gap_ext,
+                                              AlnMode mode, int y_begin,
+                                              int y_end, AlnColumn& col,
+                                              AlnMat* block, int* max_score);
+
+}}}}
+
+#endif
@@ -18,6 +18,7 @@
 //------------------------------------------------------------------------------
 #include <ost/log.hh>
 #include "impl/align_impl.hh"
+#include "impl/align_fill.hh"
 #include "local_align.hh"
 
 namespace ost { namespace seq { namespace alg {
@@ -66,35 +67,9 @@ AlignmentList LocalAlign(const ConstSequenceHandle& s1,
                          int gap_open, int gap_ext)
 {
   impl::AlnMat mat(s1.GetLength()+1, s2.GetLength()+1);
-  for (int i=0; i<mat.GetWidth()-1; ++i) {
-    for (int j=0; j<mat.GetHeight()-1; ++j) {
-      char c1=s1[i];
-      char c2=s2[j];
-      short weight=subst->GetWeight(c1, c2);
-      int diag=weight+mat(i, j).score;
-      int ins1=mat(i+1, j).score
-              +(mat(i+1, j).from==impl::INS1 ? gap_ext : gap_open);
-      ins1=std::max(0, ins1);
-      int ins2=mat(i, j+1).score
-              +(mat(i, j+1).from==impl::INS2 ? gap_ext : gap_open);
-      ins2=std::max(0, ins2);
-      if (diag>=ins1) {
-        if (diag>=ins2) {
-          mat(i+1, j+1).score=diag;
-          mat(i+1, j+1).from=impl::DIAG;
-        } else {
-          mat(i+1, j+1).score=ins2;
-          mat(i+1, j+1).from=impl::INS2;
-        }
-      } else if (ins1>ins2) {
-        mat(i+1, j+1).score=ins1;
-        mat(i+1, j+1).from=impl::INS1;
-      } else {
-        mat(i+1, j+1).score=ins2;
-        mat(i+1, j+1).from=impl::INS2;
-      }
-    }
-  }
+  impl::SubstProfile prof(s1.GetString(), *subst);
+  impl::FillAlnMat(prof, s2.GetString(), gap_open, gap_ext, impl::LOCAL_ALN,
+                   mat);
 #if !defined(NDEBUG)
   DbgWriteAlnMatrix(mat,s1, s2);
 #endif
@@ -106,4 +81,14 @@ AlignmentList LocalAlign(const ConstSequenceHandle& s1,
   return alignments;
 }
 
+int LocalAlignScore(const ConstSequenceHandle& s1,
+                    const ConstSequenceHandle& s2,
+                    alg::SubstWeightMatrixPtr& subst,
+                    int gap_open, int gap_ext)
+{
+  impl::SubstProfile prof(s1.GetString(), *subst);
+  return impl::AlnScore(prof, s2.GetString(), gap_open, gap_ext,
+                        impl::LOCAL_ALN);
+}
+
 }}}
@@ -30,6 +30,14 @@ AlignmentList DLLEXPORT_OST_SEQ_ALG LocalAlign(const ConstSequenceHandle& s1,
                                                const ConstSequenceHandle& s2,
                                                SubstWeightMatrixPtr& subst,
                                                int gap_open=-5, int gap_ext=-2);
+
+/// \brief score of the alignment LocalAlign() returns first
+///
+/// Only one column of the alignment matrix is kept in memory.
+int DLLEXPORT_OST_SEQ_ALG LocalAlignScore(const ConstSequenceHandle& s1,
+                                          const ConstSequenceHandle& s2,
+                                          SubstWeightMatrixPtr& subst,
+                                          int gap_open=-5, int gap_ext=-2);
 }}}
 
 #endif
@@ -0,0 +1,354 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <ost/log.hh>
+#include <ost/seq/alg/subst_weight_matrix.hh>
+#include <ost/seq/alg/global_align.hh>
+#include <ost/seq/alg/local_align.hh>
+#include <ost/seq/alg/semiglobal_align.hh>
+#include <ost/seq/alg/impl/align_fill.hh>
+
+using namespace ost;
+using namespace ost::seq::alg;
+
+namespace {
+
+// straightforward version of the recurrences in LocalAlign(), GlobalAlign()
+// and SemiGlobalAlign()
+void FillScalar(const String& s1, const String& s2,
+                const SubstWeightMatrix& subst, int gap_open, int gap_ext,
+                impl::AlnMode mode, impl::AlnMat& mat)
+{
+  for (int i=0; i<mat.GetWidth()-1; ++i) {
+    for (int j=0; j<mat.GetHeight()-1; ++j) {
+      int diag=subst.GetWeight(s1[i], s2[j])+mat(i, j).score;
+      int ins1=mat(i+1, j).score
+              +(mat(i+1, j).from==impl::INS1 ? gap_ext : gap_open);
+      int ins2=mat(i, j+1).score
+              +(mat(i, j+1).from==impl::INS2 ? gap_ext : gap_open);
+      if (mode==impl::LOCAL_ALN) {
+        ins1=std::max(0, ins1);
+        ins2=std::max(0, ins2);
+      }
+      if (mode==impl::SEMIGLOBAL_ALN) {
+        if (j+1==mat.GetHeight()-1) {
+          ins2=mat(i, j+1).score;
+        }
+        if (i+1==mat.GetWidth()-1) {
+          ins1=mat(i+1, j).score;
+        }
+      }
+      impl::AlnPos& pos=mat(i+1, j+1);
+      if (diag>=ins1 && diag>=ins2) {
+        pos.score=diag;
+        pos.from=impl::DIAG;
+      } else if (diag>=ins1 || ins2>=ins1) {
+        pos.score=ins2;
+        pos.from=impl::INS2;
+      } else {
+        pos.score=ins1;
+        pos.from=impl::INS1;
+      }
+    }
+  }
+}
+
+void InitBorders(impl::AlnMat& mat, int gap_open, int gap_ext,
+                 impl::AlnMode mode)
+{
+  for (int j=1; j<mat.GetHeight(); ++j) {
+    if (mode==impl::GLOBAL_ALN) {
+      mat(0, j).score=mat(0, j-1).score+(j==1 ? gap_open : gap_ext);
+    }
+    if (mode!=impl::LOCAL_ALN) {
+      mat(0, j).from=impl::INS1;
+    }
+  }
+  for (int i=1; i<mat.GetWidth(); ++i) {
+    if (mode==impl::GLOBAL_ALN) {
+      mat(i, 0).score=mat(i-1, 0).score+(i==1 ? gap_open : gap_ext);
+    }
+    if (mode!=impl::LOCAL_ALN) {
+      mat(i, 0).from=impl::INS2;
+    }
+  }
+}
+
+String RandomSeq(int length)
+{
+  // includes lower case letters, gaps and characters without weights
+  static const char* olcs="ACDEFGHIKLMNPQRSTVWYacdefghiklmnpqrstvwyXBZ-?";
+  String seq(length, 'A');
+  for (int i=0; i<length; ++i) {
+    seq[i]=olcs[rand()%45];
+  }
+  return seq;
+}
+
+bool FillColumnsScalar(const impl::SubstProfile& prof, const String& s2,
+                       int gap_open, int gap_ext, impl::AlnMode mode,
+                       int y_begin, int y_end, impl::AlnColumn& col,
+                       impl::AlnMat* block, int* max_score)
+{
+  impl::FillAlnColumnsScalar(prof, s2, gap_open, gap_ext, mode, y_begin, y_end,
+                             col, block, max_score);
+  return true;
+}
+
+typedef bool (*FillColumnsFunc)(const impl::SubstProfile&, const String&,
+                                int, int, impl::AlnMode, int, int,
+                                impl::AlnColumn&, impl::AlnMat*, int*);
+
+bool SameCell(const impl::AlnPos& a, const impl::AlnPos& b)
+{
+  return a.score==b.score && a.from==b.from;
+}
+
+// calculates the matrix in two blocks of columns and compares the blocks, the
+// last columns and the maximal scores to the reference
+bool CompareColumns(FillColumnsFunc fill, const impl::SubstProfile& prof,
+                    const String& s1, const String& s2, int gap_open,
+                    int gap_ext, impl::AlnMode mode, const impl::AlnMat& ref)
+{
+  int width=ref.GetWidth();
+  int height=ref.GetHeight();
+  int y_mid=(height+1)/2;
+  int ranges[][2]={{1, y_mid}, {y_mid, height}};
+  impl::AlnColumn col(width);
+  for (int x=0; x<width; ++x) {
+    col[x]=ref(x, 0);
+  }
+  for (int r=0; r<2; ++r) {
+    int y_begin=ranges[r][0], y_end=ranges[r][1];
+    impl::AlnMat block(width, y_end-y_begin+1);
+    int max_score=-1000;
+    if (!fill(prof, s2, gap_open, gap_ext, mode, y_begin, y_end, col, &block,
+              &max_score)) {
+      return false;
+    }
+    int ref_max=-1000;
+    for (int x=0; x<width; ++x) {
+      for (int y=y_begin-1; y<y_end; ++y) {
+        if (x>0 && y>=y_begin) {
+          ref_max=std::max(ref_max, ref(x, y).score);
+        }
+        if (!SameCell(block(x, y-y_begin+1), ref(x, y))) {
+          BOOST_ERROR("cell (" << x << ", " << y << ") of block differs for "
+                      << s1 << " vs. " << s2);
+          return true;
+        }
+      }
+      if (!SameCell(col[x], ref(x, std::max(0, y_end-1)))) {
+        BOOST_ERROR("cell " << x << " of column differs for " << s1 << " vs. "
+                    << s2);
+        return true;
+      }
+    }
+    BOOST_CHECK_EQUAL(max_score, ref_max);
+  }
+  return true;
+}
+
+bool CompareFill(const String& s1, const String& s2,
+                 const SubstWeightMatrix& subst, int gap_open, int gap_ext,
+                 impl::AlnMode mode)
+{
+  impl::AlnMat ref(s1.size()+1, s2.size()+1);
+  InitBorders(ref, gap_open, gap_ext, mode);
+  FillScalar(s1, s2, subst, gap_open, gap_ext, mode, ref);
+  impl::SubstProfile prof(s1, subst);
+  impl::AlnMat mat(s1.size()+1, s2.size()+1);
+  impl::FillAlnMat(prof, s2, gap_open, gap_ext, mode, mat);
+  for (int i=0; i<mat.GetWidth(); ++i) {
+    for (int j=0; j<mat.GetHeight(); ++j) {
+      if (!SameCell(mat(i, j), ref(i, j))) {
+        BOOST_ERROR("cell (" << i << ", " << j << ") differs for " << s1
+                    << " vs. " << s2);
+        return true;
+      }
+    }
+  }
+  CompareColumns(&FillColumnsScalar, prof, s1, s2, gap_open, gap_ext, mode,
+                 ref);
+  return CompareColumns(&impl::FillAlnColumnsSIMD, prof, s1, s2, gap_open,
+                        gap_ext, mode, ref);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(ost_seq_alg);
+
+BOOST_AUTO_TEST_CASE(subst_profile)
+{
+  SubstWeightMatrix subst;
+  subst.AssignPreset(SubstWeightMatrix::BLOSUM62);
+  impl::SubstProfile prof("aW-X", subst);
+  BOOST_CHECK_EQUAL(prof.GetLength(), 4);
+  BOOST_CHECK_EQUAL(impl::SubstProfile::GetResidueType('c'), 2);
+  BOOST_CHECK_EQUAL(impl::SubstProfile::GetResidueType('-'),
+                    int(SubstWeightMatrix::ALPHABET_SIZE));
+  const short* w_row=prof.GetRow(impl::SubstProfile::GetResidueType('W'));
+  BOOST_CHECK_EQUAL(w_row[-1], 0);
+  BOOST_CHECK_EQUAL(w_row[0], subst.GetWeight('A', 'W'));
+  BOOST_CHECK_EQUAL(w_row[1], subst.GetWeight('W', 'W'));
+  BOOST_CHECK_EQUAL(w_row[2], 0);
+  BOOST_CHECK_EQUAL(w_row[3], subst.GetWeight('X', 'W'));
+  BOOST_CHECK_EQUAL(w_row[4], 0);
+  BOOST_CHECK_EQUAL(prof.GetRow(SubstWeightMatrix::ALPHABET_SIZE)[1], 0);
+}
+
+BOOST_AUTO_TEST_CASE(fill_aln_mat_simd)
+{
+  SubstWeightMatrix subst;
+  subst.AssignPreset(SubstWeightMatrix::BLOSUM62);
+  impl::AlnMode modes[]={impl::GLOBAL_ALN, impl::SEMIGLOBAL_ALN,
+                         impl::LOCAL_ALN};
+  srand(42);
+  bool used_simd=false;
+  // cover sequences shorter than a vector, lengths just around multiples of
+  // the vector width and longer ones
+  int lengths[]={0, 1, 2, 7, 8, 9, 15, 16, 17, 33, 100, 257};
+  for (int m=0; m<3; ++m) {
+    for (int a=0; a<12; ++a) {
+      for (int b=0; b<12; ++b) {
+        String s1=RandomSeq(lengths[a]);
+        String s2=RandomSeq(lengths[b]);
+        used_simd|=CompareFill(s1, s2, subst, -10, -1, modes[m]);
+        used_simd|=CompareFill(s1, s2, subst, -4, -4, modes[m]);
+        used_simd|=CompareFill(s2, s1, subst, -2, -1, modes[m]);
+      }
+    }
+    // similar sequences produce long stretches of high scores
+    String s1=RandomSeq(300);
+    String s2=s1.substr(20, 100)+RandomSeq(5)+s1.substr(150);
+    used_simd|=CompareFill(s1, s2, subst, -10, -1, modes[m]);
+  }
+#if defined(__SSE2__) || defined(_M_X64)
+  BOOST_CHECK(used_simd);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(fill_aln_mat_simd_overflow)
+{
+  SubstWeightMatrix subst;
+  subst.AssignPreset(SubstWeightMatrix::BLOSUM62);
+  String s1="AAA"+RandomSeq(50);
+  // scores beyond the 16 bit range must be left to the scalar implementation
+  impl::AlnMat mat(s1.size()+1, s1.size()+1);
+  impl::AlnColumn col(s1.size()+1);
+  for (size_t x=0; x<col.size(); ++x) {
+    col[x]=impl::FirstColumnCell(impl::GLOBAL_ALN, x, -1000, -1000);
+  }
+  impl::SubstProfile prof(s1, subst);
+  BOOST_CHECK(!impl::FillAlnColumnsSIMD(prof, s1, -1000, -1000,
+                                        impl::GLOBAL_ALN, 1, s1.size()+1, col,
+                                        &mat, NULL));
+  // FillAlnMat() still has to give the right result
+  BOOST_CHECK(!CompareFill(s1, s1, subst, -1000, -1000, impl::GLOBAL_ALN));
+  impl::AlnColumn local_col(s1.size()+1);
+  BOOST_CHECK(impl::FillAlnColumnsSIMD(prof, s1, -10, -1, impl::LOCAL_ALN, 1,
+                                       s1.size()+1, local_col, &mat, NULL));
+  subst.SetWeight('A', 'A', 10000);
+  impl::SubstProfile prof2(s1, subst);
+  local_col.assign(s1.size()+1, impl::AlnPos());
+  BOOST_CHECK(!impl::FillAlnColumnsSIMD(prof2, s1, -10, -1, impl::LOCAL_ALN,
+                                        1, s1.size()+1, local_col, &mat,
+                                        NULL));
+  BOOST_CHECK(!CompareFill(s1, s1, subst, -10, -1, impl::LOCAL_ALN));
+}
+
+BOOST_AUTO_TEST_CASE(low_memory_align)
+{
+  SubstWeightMatrixPtr subst(new SubstWeightMatrix);
+  subst->AssignPreset(SubstWeightMatrix::BLOSUM62);
+  srand(7);
+  // the second sequence determines the number and size of the blocks
+  int lengths[]={0, 1, 5, 16, 17, 40, 300, 1100};
+  for (int a=0; a<8; ++a) {
+    for (int b=0; b<8; ++b) {
+      String str1=RandomSeq(lengths[a]);
+      String str2=RandomSeq(lengths[b]);
+      if (lengths[b]>lengths[a] && lengths[a]>=40) {
+        // related sequences give alignments with longer gaps
+        str2=str1.substr(0, lengths[a]/3)+RandomSeq(lengths[b]-lengths[a])
+            +str1.substr(lengths[a]/3);
+      }
+      seq::SequenceHandle s1=seq::CreateSequence("s1", str1);
+      seq::SequenceHandle s2=seq::CreateSequence("s2", str2);
+      for (int gap_ext=-1; gap_ext>=-4; gap_ext-=3) {
+        seq::AlignmentList full=GlobalAlign(s1, s2, subst, -10, gap_ext);
+        seq::AlignmentList low=GlobalAlign(s1, s2, subst, -10, gap_ext, true);
+        BOOST_REQUIRE_EQUAL(low.size(), size_t(1));
+        BOOST_CHECK_EQUAL(low[0].ToString(80), full[0].ToString(80));
+        full=SemiGlobalAlign(s1, s2, subst, -10, gap_ext);
+        low=SemiGlobalAlign(s1, s2, subst, -10, gap_ext, true);
+        BOOST_REQUIRE_EQUAL(low.size(), size_t(1));
+        BOOST_CHECK_EQUAL(low[0].ToString(80), full[0].ToString(80));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(align_score)
+{
+  SubstWeightMatrix subst;
+  subst.AssignPreset(SubstWeightMatrix::BLOSUM62);
+  SubstWeightMatrixPtr subst_ptr(new SubstWeightMatrix(subst));
+  impl::AlnMode modes[]={impl::GLOBAL_ALN, impl::SEMIGLOBAL_ALN,
+                         impl::LOCAL_ALN};
+  srand(11);
+  for (int m=0; m<3; ++m) {
+    for (int n=0; n<10; ++n) {
+      String str1=RandomSeq(rand()%200);
+      String str2=RandomSeq(rand()%200);
+      impl::AlnMat ref(str1.size()+1, str2.size()+1);
+      InitBorders(ref, -10, -1, modes[m]);
+      FillScalar(str1, str2, subst, -10, -1, modes[m], ref);
+      int expected=ref(ref.GetWidth()-1, ref.GetHeight()-1).score;
+      if (modes[m]==impl::LOCAL_ALN) {
+        expected=0;
+        for (int i=0; i<ref.GetWidth(); ++i) {
+          for (int j=0; j<ref.GetHeight(); ++j) {
+            expected=std::max(expected, ref(i, j).score);
+          }
+        }
+      }
+      seq::SequenceHandle s1=seq::CreateSequence("s1", str1);
+      seq::SequenceHandle s2=seq::CreateSequence("s2", str2);
+      int score=0;
+      switch (modes[m]) {
+        case impl::GLOBAL_ALN:
+          score=GlobalAlignScore(s1, s2, subst_ptr, -10, -1);
+          break;
+        case impl::SEMIGLOBAL_ALN:
+          score=SemiGlobalAlignScore(s1, s2, subst_ptr, -10, -1);
+          break;
+        case impl::LOCAL_ALN:
+          score=LocalAlignScore(s1, s2, subst_ptr, -10, -1);
+          break;
+      }
+      BOOST_CHECK_EQUAL(score, expected);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
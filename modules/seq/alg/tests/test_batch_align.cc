@@ -0,0 +1,194 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <sstream>
+#include <ost/seq/alg/batch_align.hh>
+#include <ost/seq/alg/global_align.hh>
+#include <ost/seq/alg/local_align.hh>
+#include <ost/seq/alg/semiglobal_align.hh>
+#include <ost/seq/alg/sequence_identity.hh>
+
+using namespace ost;
+using namespace ost::seq;
+using namespace ost::seq::alg;
+
+namespace {
+
+SequenceList RandomSequences(int count)
+{
+  static const char* olcs="ACDEFGHIKLMNPQRSTVWY";
+  String ancestor(150, 'A');
+  for (size_t i=0; i<ancestor.size(); ++i) {
+    ancestor[i]=olcs[rand()%20];
+  }
+  // related sequences of varying length with mutations, insertions and
+  // deletions
+  SequenceList seqs=CreateSequenceList();
+  for (int n=0; n<count; ++n) {
+    String str=ancestor.substr(rand()%30, 60+rand()%90);
+    for (size_t i=0; i<str.size(); ++i) {
+      int r=rand()%20;
+      if (r==0) {
+        str[i]=olcs[rand()%20];
+      } else if (r==1) {
+        str.insert(i, 1+rand()%3, olcs[rand()%20]);
+      } else if (r==2) {
+        str.erase(i, 1+rand()%3);
+      }
+    }
+    std::stringstream name;
+    name << "seq" << n;
+    seqs.AddSequence(CreateSequence(name.str(), str));
+  }
+  return seqs;
+}
+
+AlignmentList PairAlign(const ConstSequenceHandle& s1,
+                        const ConstSequenceHandle& s2,
+                        SubstWeightMatrixPtr& subst, AlignMode::Type mode)
+{
+  switch (mode) {
+    case AlignMode::LOCAL:
+      return LocalAlign(s1, s2, subst, -10, -1);
+    case AlignMode::GLOBAL:
+      return GlobalAlign(s1, s2, subst, -10, -1);
+    default:
+      return SemiGlobalAlign(s1, s2, subst, -10, -1);
+  }
+}
+
+int PairScore(const ConstSequenceHandle& s1, const ConstSequenceHandle& s2,
+              SubstWeightMatrixPtr& subst, AlignMode::Type mode)
+{
+  switch (mode) {
+    case AlignMode::LOCAL:
+      return LocalAlignScore(s1, s2, subst, -10, -1);
+    case AlignMode::GLOBAL:
+      return GlobalAlignScore(s1, s2, subst, -10, -1);
+    default:
+      return SemiGlobalAlignScore(s1, s2, subst, -10, -1);
+  }
+}
+
+void CheckResult(const BatchAlignResult& result, const ConstSequenceHandle& s1,
+                 const ConstSequenceHandle& s2, SubstWeightMatrixPtr& subst,
+                 AlignMode::Type mode)
+{
+  AlignmentList alns=PairAlign(s1, s2, subst, mode);
+  BOOST_CHECK_EQUAL(result.score, PairScore(s1, s2, subst, mode));
+  AlignmentHandle aln=result.ToAlignment(s1, s2);
+  if (alns.empty()) {
+    BOOST_CHECK(!aln.IsValid());
+    return;
+  }
+  BOOST_REQUIRE(aln.IsValid());
+  BOOST_CHECK_EQUAL(aln.ToString(80), alns[0].ToString(80));
+  BOOST_CHECK_EQUAL(aln.GetSequenceOffset(0), alns[0].GetSequenceOffset(0));
+  BOOST_CHECK_EQUAL(aln.GetSequenceOffset(1), alns[0].GetSequenceOffset(1));
+  BOOST_CHECK_EQUAL(result.query_begin, alns[0].GetSequenceOffset(0));
+  BOOST_CHECK_EQUAL(result.query_end-result.query_begin,
+                    int(alns[0].GetSequence(0).GetGaplessString().size()));
+  BOOST_CHECK_EQUAL(result.target_begin, alns[0].GetSequenceOffset(1));
+  BOOST_CHECK_EQUAL(result.target_end-result.target_begin,
+                    int(alns[0].GetSequence(1).GetGaplessString().size()));
+  BOOST_CHECK_EQUAL(result.GetLength(), alns[0].GetLength());
+  BOOST_CHECK_CLOSE(result.identity,
+                    SequenceIdentity(alns[0], RefMode::ALIGNMENT), 1e-4);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(ost_seq_alg);
+
+BOOST_AUTO_TEST_CASE(batch_align)
+{
+  SubstWeightMatrixPtr subst(new SubstWeightMatrix);
+  subst->AssignPreset(SubstWeightMatrix::BLOSUM62);
+  srand(3);
+  SequenceList targets=RandomSequences(40);
+  // unrelated and empty sequences
+  targets.AddSequence(CreateSequence("unrelated", "WWWWPPPPWWWW"));
+  targets.AddSequence(CreateSequence("empty", ""));
+  SequenceHandle query=targets[0].Copy();
+  AlignMode::Type modes[]={AlignMode::LOCAL, AlignMode::GLOBAL,
+                           AlignMode::SEMIGLOBAL};
+  for (int m=0; m<3; ++m) {
+    BatchAlignResultList results=BatchAlign(query, targets, subst, -10, -1,
+                                            modes[m], 4);
+    BOOST_REQUIRE_EQUAL(results.size(), size_t(targets.GetCount()));
+    for (int i=0; i<targets.GetCount(); ++i) {
+      BOOST_CHECK_EQUAL(results[i].query_index, 0);
+      BOOST_CHECK_EQUAL(results[i].target_index, i);
+      CheckResult(results[i], query, targets[i], subst, modes[m]);
+    }
+  }
+  // the query against itself
+  BatchAlignResultList results=BatchAlign(query, targets, subst);
+  std::stringstream cigar;
+  cigar << query.GetLength() << "M";
+  BOOST_CHECK_EQUAL(results[0].cigar, cigar.str());
+  BOOST_CHECK_CLOSE(results[0].identity, Real(100), 1e-4);
+  BOOST_CHECK(BatchAlign(query, CreateSequenceList(), subst).empty());
+}
+
+BOOST_AUTO_TEST_CASE(all_vs_all_align)
+{
+  SubstWeightMatrixPtr subst(new SubstWeightMatrix);
+  subst->AssignPreset(SubstWeightMatrix::BLOSUM62);
+  srand(5);
+  SequenceList seqs=RandomSequences(30);
+  BatchAlignResultList results=AllVsAllAlign(seqs, subst, -10, -1,
+                                             AlignMode::LOCAL, 3);
+  BatchAlignResultList serial=AllVsAllAlign(seqs, subst, -10, -1,
+                                            AlignMode::LOCAL, 1);
+  BOOST_REQUIRE_EQUAL(results.size(), size_t(30*29/2));
+  BOOST_REQUIRE_EQUAL(serial.size(), results.size());
+  size_t k=0;
+  for (int i=0; i<seqs.GetCount(); ++i) {
+    for (int j=i+1; j<seqs.GetCount(); ++j, ++k) {
+      BOOST_CHECK_EQUAL(results[k].query_index, i);
+      BOOST_CHECK_EQUAL(results[k].target_index, j);
+      BOOST_CHECK_EQUAL(results[k].cigar, serial[k].cigar);
+      CheckResult(results[k], seqs[i], seqs[j], subst, AlignMode::LOCAL);
+    }
+  }
+  BOOST_CHECK(AllVsAllAlign(seqs.Slice(0, 1), subst).empty());
+}
+
+BOOST_AUTO_TEST_CASE(batch_align_result_to_alignment)
+{
+  SequenceHandle s1=CreateSequence("A", "acdefghiklmn");
+  SequenceHandle s2=CreateSequence("B", "xxacdhiklmn");
+  BatchAlignResult result;
+  result.query_begin=0;
+  result.target_begin=2;
+  result.cigar="3M3D6M";
+  AlignmentHandle aln=result.ToAlignment(s1, s2);
+  BOOST_CHECK_EQUAL(aln.GetSequence(0).GetString(), "acdefghiklmn");
+  BOOST_CHECK_EQUAL(aln.GetSequence(1).GetString(), "acd---hiklmn");
+  BOOST_CHECK_EQUAL(aln.GetSequenceOffset(1), 2);
+  BOOST_CHECK_EQUAL(result.GetLength(), 12);
+  result.cigar="3M3D7M";
+  BOOST_CHECK_THROW(result.ToAlignment(s1, s2), Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -43,6 +43,23 @@ class TestGlobalAlign(unittest.TestCase):
     self.assertEqual(alns[0].sequences[0].offset, 0)
     self.assertEqual(alns[0].sequences[1].offset, 0)
 
+  def testLowMemory(self):
+    seq_a=seq.CreateSequence('A', 'aacdefghiklmn')
+    seq_b=seq.CreateSequence('B', 'acdhiklmn')
+    alns=seq.alg.GlobalAlign(seq_a, seq_b, seq.alg.BLOSUM62, low_memory=True)
+    self.assertEqual(len(alns), 1)
+    self.assertEqual(str(alns[0].sequences[0]), 'aacdefghiklmn')
+    self.assertEqual(str(alns[0].sequences[1]), '-acd---hiklmn')
+    self.assertEqual(alns[0].sequences[0].offset, 0)
+    self.assertEqual(alns[0].sequences[1].offset, 0)
+
+  def testScore(self):
+    seq_a=seq.CreateSequence('A', 'aacdefghiklmn')
+    seq_b=seq.CreateSequence('B', 'acdhiklmn')
+    score=seq.alg.GlobalAlignScore(seq_a, seq_b, seq.alg.BLOSUM62)
+    # 51 for the matches, 5 for the leading gap and 5+2+2 for the deletion
+    self.assertEqual(score, 37)
+
 if __name__ == "__main__":
   from ost import testutils
   testutils.RunTests()
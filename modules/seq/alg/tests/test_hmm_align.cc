@@ -0,0 +1,205 @@
+//------------------------------------------------------------------------------
+// This file is part of the OpenStructure project <www.openstructure.org>
+//
+// Copyright (C) 2008-2020 by the OpenStructure authors
+//
+// This library is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 3.0 of the License, or (at your option)
+// any later version.
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+// details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//------------------------------------------------------------------------------
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <ost/seq/alg/hmm_align.hh>
+#include <ost/seq/alg/hmm_score.hh>
+
+using namespace ost;
+using namespace ost::seq;
+using namespace ost::seq::alg;
+
+namespace {
+
+Real Random()
+{
+  return (rand()%1000+1)/Real(1000);
+}
+
+ProfileColumn RandomColumn()
+{
+  ProfileColumn col;
+  Real* freqs=col.freqs_begin();
+  Real sum=0;
+  for (int a=0; a<20; ++a) {
+    // a few dominant amino acids per column
+    freqs[a]=std::pow(Random(), 4);
+    sum+=freqs[a];
+  }
+  for (int a=0; a<20; ++a) {
+    freqs[a]/=sum;
+  }
+  HMMDataPtr data(new HMMData);
+  Real m2i=0.02*Random(), m2d=0.02*Random();
+  data->SetProb(HMM_M2M, 1-m2i-m2d);
+  data->SetProb(HMM_M2I, m2i);
+  data->SetProb(HMM_M2D, m2d);
+  Real i2i=0.3+0.5*Random(), d2d=0.3+0.5*Random();
+  data->SetProb(HMM_I2M, 1-i2i);
+  data->SetProb(HMM_I2I, i2i);
+  data->SetProb(HMM_D2M, 1-d2d);
+  data->SetProb(HMM_D2D, d2d);
+  col.SetHMMData(data);
+  return col;
+}
+
+char MostFrequent(const ProfileColumn& col)
+{
+  const char* olcs="ACDEFGHIKLMNPQRSTVWY";
+  return olcs[std::max_element(col.freqs_begin(), col.freqs_end())-
+              col.freqs_begin()];
+}
+
+ProfileHandlePtr RandomProfile(int length)
+{
+  ProfileHandlePtr prof(new ProfileHandle);
+  for (int i=0; i<length; ++i) {
+    ProfileColumn col=RandomColumn();
+    prof->AddColumn(col, MostFrequent(col));
+  }
+  return prof;
+}
+
+// copy of prof with some columns replaced, inserted or deleted
+ProfileHandlePtr RelatedProfile(const ProfileHandle& prof)
+{
+  ProfileHandlePtr related(new ProfileHandle);
+  for (size_t i=rand()%10; i<prof.size(); ++i) {
+    int r=rand()%20;
+    if (r==0) {
+      continue;
+    }
+    ProfileColumn col=(r==1 ? RandomColumn() : prof[i]);
+    related->AddColumn(col, MostFrequent(col));
+    if (r==2) {
+      for (int k=rand()%4; k>=0; --k) {
+        col=RandomColumn();
+        related->AddColumn(col, MostFrequent(col));
+      }
+    }
+  }
+  return related;
+}
+
+Real ScoreOf(const ProfileHandle& query, const ProfileHandle& target,
+             const AlignmentHandle& aln)
+{
+  return HMMScore(query, target, aln, 0, 1, -0.03, 0.0);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(ost_seq_alg);
+
+BOOST_AUTO_TEST_CASE(hmm_align)
+{
+  srand(13);
+  for (int n=0; n<20; ++n) {
+    ProfileHandlePtr query=RandomProfile(30+rand()%150);
+    ProfileHandlePtr target=RelatedProfile(*query);
+    HMMAlignResult result=HMMAlign(*query, *target);
+    BOOST_REQUIRE(!result.cigar.empty());
+    BOOST_CHECK(result.name.empty());
+    AlignmentHandle aln=result.ToAlignment(*query, *target);
+    BOOST_REQUIRE(aln.IsValid());
+    BOOST_CHECK_EQUAL(aln.GetSequence(0).GetName(), "query");
+    BOOST_CHECK_EQUAL(aln.GetSequence(1).GetName(), "target");
+    BOOST_CHECK_EQUAL(aln.GetLength(), result.GetLength());
+    BOOST_CHECK_EQUAL(aln.GetSequenceOffset(0), result.query_begin);
+    BOOST_CHECK_EQUAL(aln.GetSequenceOffset(1), result.target_begin);
+    BOOST_CHECK_EQUAL(int(aln.GetSequence(0).GetGaplessString().size()),
+                      result.query_end-result.query_begin);
+    BOOST_CHECK_EQUAL(int(aln.GetSequence(1).GetGaplessString().size()),
+                      result.target_end-result.target_begin);
+    // the score of the path is the one HMMScore() assigns to the alignment
+    BOOST_CHECK_CLOSE(result.score, ScoreOf(*query, *target, aln), 0.01);
+    // and no ungapped alignment scores higher
+    int n0=query->size(), n1=target->size();
+    for (int shift=-n1+5; shift<n0-5; ++shift) {
+      int begin0=std::max(0, shift), begin1=std::max(0, -shift);
+      int length=std::min(n0-begin0, n1-begin1);
+      AlignmentHandle diag=CreateAlignment();
+      diag.AddSequence(CreateSequence("query",
+                       query->GetSequence().substr(begin0, length)));
+      diag.AddSequence(CreateSequence("target",
+                       target->GetSequence().substr(begin1, length)));
+      diag.SetSequenceOffset(0, begin0);
+      diag.SetSequenceOffset(1, begin1);
+      BOOST_CHECK_LE(ScoreOf(*query, *target, diag), result.score+1e-3);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(hmm_align_self)
+{
+  srand(17);
+  ProfileHandlePtr prof=RandomProfile(80);
+  HMMAlignResult result=HMMAlign(*prof, *prof);
+  BOOST_CHECK_EQUAL(result.cigar, "80M");
+  BOOST_CHECK_EQUAL(result.query_begin, 0);
+  BOOST_CHECK_EQUAL(result.target_end, 80);
+  // empty profiles and profiles without HMM data
+  BOOST_CHECK(HMMAlign(*prof, ProfileHandle()).cigar.empty());
+  ProfileHandle no_hmm;
+  no_hmm.AddColumn(ProfileColumn(), 'A');
+  BOOST_CHECK_THROW(HMMAlign(*prof, no_hmm), Error);
+}
+
+BOOST_AUTO_TEST_CASE(hmm_search)
+{
+  srand(19);
+  ProfileHandlePtr query=RandomProfile(100);
+  ProfileDB db;
+  for (int n=0; n<25; ++n) {
+    std::stringstream name;
+    name << "prof" << n;
+    db.AddProfile(name.str(), n%3==0 ? RelatedProfile(*query) :
+                                       RandomProfile(20+rand()%200));
+  }
+  HMMAlignResultList results=HMMSearch(*query, db, -0.03, 0.6, 0.6, 0.6, 0.6,
+                                       3);
+  HMMAlignResultList serial=HMMSearch(*query, db, -0.03, 0.6, 0.6, 0.6, 0.6,
+                                      1);
+  BOOST_REQUIRE_EQUAL(results.size(), db.size());
+  BOOST_CHECK(results==serial);
+  for (size_t i=0; i<results.size(); ++i) {
+    if (i>0) {
+      BOOST_CHECK_GE(results[i-1].score, results[i].score);
+    }
+    HMMAlignResult single=HMMAlign(*query, *db.GetProfile(results[i].name));
+    BOOST_CHECK_EQUAL(single.score, results[i].score);
+    BOOST_CHECK_EQUAL(single.cigar, results[i].cigar);
+  }
+  // the related profiles come first
+  for (size_t i=0; i<9; ++i) {
+    int n=atoi(results[i].name.substr(4).c_str());
+    BOOST_CHECK_EQUAL(n%3, 0);
+  }
+  ProfileDB broken;
+  ProfileHandlePtr no_hmm(new ProfileHandle);
+  no_hmm->AddColumn(ProfileColumn(), 'A');
+  broken.AddProfile("no_hmm", no_hmm);
+  BOOST_CHECK_THROW(HMMSearch(*query, broken), Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -42,6 +42,26 @@ class TestLocalAlign(unittest.TestCase):
     self.assertEqual(alns[0].sequences[0].offset, 4)
     self.assertEqual(alns[0].sequences[1].offset, 2)
 
+  def testBatchAlign(self):
+    seq_a=seq.CreateSequence('A', 'acdhiklmn')
+    targets=seq.CreateSequenceList()
+    targets.AddSequence(seq.CreateSequence('B', 'ggiklmn'))
+    targets.AddSequence(seq.CreateSequence('C', 'acdefghiklmn'))
+    results=seq.alg.BatchAlign(seq_a, targets, seq.alg.BLOSUM62, num_threads=2)
+    self.assertEqual(len(results), 2)
+    self.assertEqual(results[0].target_index, 0)
+    self.assertEqual(results[0].query_begin, 4)
+    self.assertEqual(results[0].target_begin, 2)
+    self.assertEqual(results[0].cigar, '5M')
+    self.assertAlmostEqual(results[0].identity, 100.0)
+    self.assertEqual(results[1].cigar, '3M3I6M')
+    for result, target in zip(results, targets):
+      aln=result.ToAlignment(seq_a, target)
+      ref=seq.alg.LocalAlign(seq_a, target, seq.alg.BLOSUM62)[0]
+      self.assertEqual(aln.ToString(80), ref.ToString(80))
+      self.assertEqual(result.score,
+                       seq.alg.LocalAlignScore(seq_a, target, seq.alg.BLOSUM62))
+
 if __name__ == "__main__":
   from ost import testutils
   testutils.RunTests()
@@ -23,6 +23,9 @@
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <boost/filesystem/operations.hpp>
 #include <ost/seq/profile_handle.hh>
 
 namespace ost { namespace seq{ 
@@ -188,31 +191,186 @@ Real ProfileHandle::GetAverageScore(const ProfileHandle& other,
 // ProfileDB
 //////////////////////////////////////////////////////////////////////////////
 
+namespace {
 
-void ProfileDB::Save(const String& filename) const{
+// Layout of the mapped format (version 2), all numbers in native byte order:
+//
+//  header:  uint32 magic, uint8 version, uint32 profile count,
+//           uint64 offset of the index
+//  records: one per profile, see EncodeProfile()
+//  index:   per profile uint8 name length, name, uint64 offset of the record,
+//           sorted by name
+//
+// Columns have a fixed size, so column i of a record with n columns starts at
+// RECORD_HEADER_SIZE+n+i*COLUMN_SIZE.
+
+const uint32_t DB_MAGIC = 42;
+const uint8_t DB_VERSION = 2;
+const size_t HEADER_SIZE = 4 + 1 + 4 + 8;
+const size_t INDEX_OFFSET_POS = 4 + 1 + 4;
+// 20 frequencies, HMM flag, 7 transition probabilities, 3 neff values
+const size_t COLUMN_SIZE = 20*2 + 1 + 7*2 + 3*4;
+// null model, number of columns, neff
+const size_t RECORD_HEADER_SIZE = COLUMN_SIZE + 4 + 4;
+
+template <typename T>
+void Put(String& buf, T value) {
+  buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
 
-  std::ofstream out_stream(filename.c_str(), std::ios::binary);
+// bounds checked reading from the mapped file
+class MappedReader {
+public:
+  MappedReader(const char* begin, const char* end): pos_(begin), end_(end) { }
 
-  uint32_t magic_number = 42;
-  out_stream.write(reinterpret_cast<char*>(&magic_number), sizeof(uint32_t));
+  template <typename T>
+  T Read() {
+    T value;
+    memcpy(&value, this->Advance(sizeof(T)), sizeof(T));
+    return value;
+  }
 
-  uint8_t version = 1;
-  out_stream.write(reinterpret_cast<char*>(&version), sizeof(uint8_t));
+  const char* Advance(size_t n) {
+    if (static_cast<size_t>(end_ - pos_) < n) {
+      throw Error("ProfileDB - unexpected end of data, the file is corrupt.");
+    }
+    const char* p = pos_;
+    pos_ += n;
+    return p;
+  }
 
-  //write out total size
-  uint32_t total_size = data_.size();
-  out_stream.write(reinterpret_cast<char*>(&total_size),4);
+private:
+  const char* pos_;
+  const char* end_;
+};
 
-  //write out the data elements
-  char string_size;
-  for (std::map<String, ProfileHandlePtr>::const_iterator i = data_.begin();
-       i != data_.end(); ++i){
-    string_size = static_cast<char>(i->first.size());
-    out_stream.write(reinterpret_cast<char*>(&string_size),1);
-    out_stream.write(i->first.c_str(),string_size);
-    out_stream << *i->second;
+void EncodeColumn(const ProfileColumn& col, String& buf) {
+  const Real* freq = col.freqs_begin();
+  for (uint i = 0; i < 20; ++i) {
+    Put(buf, static_cast<int16_t>(freq[i]*10000));
+  }
+  Put(buf, static_cast<uint8_t>(col.HasHMMData()));
+  HMMData hmm_data;
+  if (col.HasHMMData()) {
+    hmm_data = *col.GetHMMData();
+  }
+  for (uint i = 0; i < 7; ++i) {
+    HMMTransition transition = static_cast<HMMTransition>(i);
+    Put(buf, static_cast<int16_t>(hmm_data.GetProb(transition)*10000));
+  }
+  Put(buf, static_cast<float>(hmm_data.GetNeff()));
+  Put(buf, static_cast<float>(hmm_data.GetNeff_I()));
+  Put(buf, static_cast<float>(hmm_data.GetNeff_D()));
+}
+
+void DecodeColumn(MappedReader& reader, ProfileColumn& col) {
+  Real* freq = col.freqs_begin();
+  for (uint i = 0; i < 20; ++i) {
+    freq[i] = reader.Read<int16_t>() * 0.0001;
+  }
+  if (!reader.Read<uint8_t>()) {
+    reader.Advance(7*2 + 3*4);
+    col.SetHMMData(HMMDataPtr());
+    return;
+  }
+  HMMDataPtr hmm_data(new HMMData);
+  for (uint i = 0; i < 7; ++i) {
+    HMMTransition transition = static_cast<HMMTransition>(i);
+    hmm_data->SetProb(transition, reader.Read<int16_t>() * 0.0001);
+  }
+  hmm_data->SetNeff(reader.Read<float>());
+  hmm_data->SetNeff_I(reader.Read<float>());
+  hmm_data->SetNeff_D(reader.Read<float>());
+  col.SetHMMData(hmm_data);
+}
+
+void EncodeProfile(const ProfileHandle& prof, String& buf) {
+  const String seq = prof.GetSequence();
+  if (seq.length() != prof.size()) {
+    throw Error("ProfileHandle - Inconsistency between number of columns and "
+                " seq. length.");
+  }
+  EncodeColumn(prof.GetNullModel(), buf);
+  Put(buf, static_cast<uint32_t>(prof.size()));
+  Put(buf, static_cast<float>(prof.GetNeff()));
+  buf.append(seq);
+  for (size_t i = 0; i < prof.size(); ++i) {
+    EncodeColumn(prof[i], buf);
+  }
+}
+
+size_t GetRecordSize(const char* record) {
+  uint32_t size;
+  memcpy(&size, record + COLUMN_SIZE, sizeof(uint32_t));
+  return RECORD_HEADER_SIZE + size * (1 + COLUMN_SIZE);
+}
+
+} // anon ns
+
+void ProfileDB::Save(const String& filename) const{
+
+  // compare the files rather than the names, the same file can be reached
+  // through different paths
+  boost::system::error_code ec;
+  if (file_.is_open() && boost::filesystem::equivalent(filename, filename_, 
+                                                       ec)) {
+    throw Error("ProfileDB can't be saved to the file it is mapped from.");
+  }
+
+  std::ofstream out_stream(filename.c_str(), std::ios::binary);
+  if (!out_stream) {
+    std::stringstream ss;
+    ss << "could not open '" << filename << "' for writing.";
+    throw Error(ss.str());
   }
+
+  // the index is sorted by name, the records are stored in the same order
+  std::vector<String> names = this->GetNames();
+  std::sort(names.begin(), names.end());
+
+  String buf;
+  Put(buf, DB_MAGIC);
+  Put(buf, DB_VERSION);
+  Put(buf, static_cast<uint32_t>(names.size()));
+  Put(buf, uint64_t(0));
+  out_stream.write(buf.data(), buf.size());
+
+  uint64_t offset = HEADER_SIZE;
+  std::vector<uint64_t> offsets;
+  offsets.reserve(names.size());
+  for (std::vector<String>::const_iterator i = names.begin();
+       i != names.end(); ++i) {
+    offsets.push_back(offset);
+    std::map<String, ProfileHandlePtr>::const_iterator j = data_.find(*i);
+    if (j != data_.end()) {
+      buf.clear();
+      EncodeProfile(*j->second, buf);
+      out_stream.write(buf.data(), buf.size());
+      offset += buf.size();
+    } else {
+      // mapped profiles are copied without decoding them
+      const char* record = file_.data() + offsets_.find(*i)->second;
+      size_t record_size = GetRecordSize(record);
+      out_stream.write(record, record_size);
+      offset += record_size;
+    }
+  }
+
+  buf.clear();
+  for (size_t i = 0; i < names.size(); ++i) {
+    Put(buf, static_cast<uint8_t>(names[i].size()));
+    buf.append(names[i]);
+    Put(buf, offsets[i]);
+  }
+  out_stream.write(buf.data(), buf.size());
+  out_stream.seekp(INDEX_OFFSET_POS);
+  out_stream.write(reinterpret_cast<char*>(&offset), sizeof(uint64_t));
   out_stream.close();
+  if (!out_stream) {
+    std::stringstream ss;
+    ss << "could not write ProfileDB to '" << filename << "'.";
+    throw Error(ss.str());
+  }
 }
 
 ProfileDBPtr ProfileDB::Load(const String& filename){
@@ -229,7 +387,7 @@ ProfileDBPtr ProfileDB::Load(const String& filename){
   uint32_t magic_number;
   in_stream.read(reinterpret_cast<char*>(&magic_number), sizeof(uint32_t));
 
-  if(magic_number != 42) {
+  if(magic_number != DB_MAGIC) {
     std::stringstream ss;
     ss << "Could not read magic number in " << filename<<". Either the file ";
     ss << "is corrupt, does not contain a ProfileDB or is of an old version ";
@@ -239,10 +397,15 @@ ProfileDBPtr ProfileDB::Load(const String& filename){
 
   uint8_t version;
   in_stream.read(reinterpret_cast<char*>(&version), sizeof(uint8_t));
+  if(version == DB_VERSION) {
+    in_stream.close();
+    LoadMapped(filename, *db);
+    return db;
+  }
   if(version != 1) {
     std::stringstream ss;
-    ss << "ProfileDB in " << filename << " is of version " << version;
-    ss << " but only version 1 can be read.";
+    ss << "ProfileDB in " << filename << " is of version " << int(version);
+    ss << " but only versions 1 and 2 can be read.";
     throw Error(ss.str());
   }
 
@@ -264,6 +427,39 @@ ProfileDBPtr ProfileDB::Load(const String& filename){
   return db;
 }
 
+void ProfileDB::LoadMapped(const String& filename, ProfileDB& db) {
+  try {
+    db.file_.open(filename);
+  } catch (std::exception& e) {
+    std::stringstream ss;
+    ss << "could not map the file '" << filename << "'.";
+    throw Error(ss.str());
+  }
+  const char* data = db.file_.data();
+  const size_t size = db.file_.size();
+  MappedReader header(data, data + size);
+  header.Advance(4 + 1);
+  uint32_t total_size = header.Read<uint32_t>();
+  uint64_t index_offset = header.Read<uint64_t>();
+  // records are stored between the header and the index
+  if (index_offset < HEADER_SIZE || index_offset > size ||
+      (total_size > 0 && index_offset < HEADER_SIZE + RECORD_HEADER_SIZE)) {
+    throw Error("ProfileDB - invalid index offset, the file is corrupt.");
+  }
+  MappedReader index(data + index_offset, data + size);
+  for (uint i = 0; i < total_size; ++i) {
+    uint8_t string_size = index.Read<uint8_t>();
+    String name(index.Advance(string_size), string_size);
+    uint64_t offset = index.Read<uint64_t>();
+    if (offset < HEADER_SIZE || offset > index_offset - RECORD_HEADER_SIZE ||
+        GetRecordSize(data + offset) > index_offset - offset) {
+      throw Error("ProfileDB - invalid record offset, the file is corrupt.");
+    }
+    db.offsets_[name] = offset;
+  }
+  db.filename_ = filename;
+}
+
 void ProfileDB::AddProfile(const String& name, ProfileHandlePtr prof) {
   if (name.size() > 255) {
     throw Error("Name of Profile must be smaller than 256!");
@@ -272,17 +468,37 @@ void ProfileDB::AddProfile(const String& name, ProfileHandlePtr prof) {
     throw Error("Name must not be empty!");
   }
   data_[name] = prof;
+  offsets_.erase(name);
 }
 
 ProfileHandlePtr ProfileDB::GetProfile(const String& name) const{
   std::map<String,ProfileHandlePtr>::const_iterator i = data_.find(name);
-  if (i == data_.end()) {
+  if (i != data_.end()) {
+    return i->second;
+  }
+  std::map<String,uint64_t>::const_iterator j = offsets_.find(name);
+  if (j == offsets_.end()) {
     std::stringstream ss;
     ss << "Profile database does not contain an entry with name ";
     ss << name << "!";
     throw Error(ss.str());
   }
-  return i->second;
+  // offsets and record sizes were checked by LoadMapped()
+  MappedReader reader(file_.data() + j->second, file_.data() + file_.size());
+  ProfileHandlePtr prof(new ProfileHandle);
+  ProfileColumn null_model;
+  DecodeColumn(reader, null_model);
+  prof->SetNullModel(null_model);
+  uint32_t size = reader.Read<uint32_t>();
+  prof->SetNeff(reader.Read<float>());
+  const char* seq = reader.Advance(size);
+  for (uint32_t k = 0; k < size; ++k) {
+    prof->AddColumn(ProfileColumn(), seq[k]);
+  }
+  for (uint32_t k = 0; k < size; ++k) {
+    DecodeColumn(reader, (*prof)[k]);
+  }
+  return prof;
 }
 
 std::vector<String> ProfileDB::GetNames() const{
@@ -292,6 +508,10 @@ std::vector<String> ProfileDB::GetNames() const{
        i != data_.end(); ++i){
     return_vec.push_back(i->first);
   }
+  for (std::map<String, uint64_t>::const_iterator i = offsets_.begin();
+       i != offsets_.end(); ++i){
+    return_vec.push_back(i->first);
+  }
   return return_vec;
 }
 
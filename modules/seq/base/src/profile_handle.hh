@@ -34,6 +34,7 @@
 #include <map>
 #include <fstream>
 #include <boost/shared_ptr.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
 namespace ost { namespace seq { 
 
@@ -198,6 +199,8 @@ public:
     hmm_data_ = p;
   }
 
+  bool HasHMMData() const { return hmm_data_.get() != NULL; }
+
   HMMDataPtr GetHMMData() const{
     if(!hmm_data_) {
       throw Error("ProfileColumn has no HMM data set!");
@@ -270,7 +273,10 @@ public:
     bool has_hmm_data;
     is.read(reinterpret_cast<char*>(&has_hmm_data), 1);
     if(has_hmm_data) {
+      col.hmm_data_ = HMMDataPtr(new HMMData);
       is >> *col.hmm_data_;
+    } else {
+      col.hmm_data_ = HMMDataPtr();
     }
 
     return is;
@@ -425,24 +431,40 @@ private:
 };
 
 /// \brief Contains a DB of profiles (identified by a unique name (String)).
+///
+/// Databases written by Save() are memory mapped by Load(). Only the index of
+/// the file is read, profiles are decoded from the mapped file when they are
+/// requested with GetProfile(), so loading is cheap and the memory of unused
+/// profiles can be reclaimed by the OS. Files of the old format (version 1)
+/// are still read completely into memory.
 class DLLEXPORT_OST_SEQ ProfileDB {
 public:
   /// \brief Saves all profiles in DB with limited accuracy of internal data.
   /// Binary format with fixed-width integers (should be portable).
+  /// \throw Error if filename is the file the DB is mapped from.
   void Save(const String& filename) const;
 
   static ProfileDBPtr Load(const String& filename);
 
   void AddProfile(const String& name, ProfileHandlePtr prof);
 
+  /// \brief Profiles of a mapped DB are decoded on every call. Thread safe as
+  /// long as no profiles are added concurrently.
   ProfileHandlePtr GetProfile(const String& name) const;
 
-  size_t size() const { return data_.size(); }
+  size_t size() const { return data_.size() + offsets_.size(); }
 
   std::vector<String> GetNames() const;
 
 private:
+  static void LoadMapped(const String& filename, ProfileDB& db);
+
   std::map<String, ProfileHandlePtr> data_;
+  // profiles in the mapped file, by offset of their record. Names in data_
+  // are never in offsets_.
+  std::map<String, uint64_t>           offsets_;
+  boost::iostreams::mapped_file_source file_;
+  String                               filename_;
 };
 
 }}
@@ -24,6 +24,11 @@
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
 
 #include <ost/seq/profile_handle.hh>
 #include <ost/io/seq/hhm_io_handler.hh>
@@ -46,6 +51,63 @@ void CheckNullModel(const ProfileColumn& nm) {
   BOOST_CHECK_CLOSE(sum_freq, Real(1), Real(1e-2));
 }
 
+// frequencies and transition probabilities are stored with 4 digits
+void CheckStoredProfile(const ProfileHandle& stored,
+                        const ProfileHandle& prof) {
+  BOOST_CHECK_EQUAL(stored.GetSequence(), prof.GetSequence());
+  BOOST_CHECK_EQUAL(stored.size(), prof.size());
+  for (uint i = 0; i < 20; ++i) {
+    BOOST_CHECK_SMALL(stored.GetNullModel().freqs_begin()[i]
+                      - prof.GetNullModel().freqs_begin()[i], Real(1e-4));
+  }
+  for (uint i = 0; i < stored.size() && i < prof.size(); ++i) {
+    for (uint j = 0; j < 20; ++j) {
+      BOOST_CHECK_SMALL(stored[i].freqs_begin()[j] - prof[i].freqs_begin()[j],
+                        Real(1e-4));
+    }
+    BOOST_CHECK_EQUAL(stored[i].HasHMMData(), prof[i].HasHMMData());
+    if (stored[i].HasHMMData() && prof[i].HasHMMData()) {
+      for (uint j = 0; j < 7; ++j) {
+        HMMTransition t = static_cast<HMMTransition>(j);
+        BOOST_CHECK_SMALL(stored[i].GetTransProb(t) - prof[i].GetTransProb(t),
+                          Real(1e-4));
+      }
+      BOOST_CHECK_CLOSE(stored[i].GetHMMData()->GetNeff_I(),
+                        prof[i].GetHMMData()->GetNeff_I(), Real(1e-4));
+    }
+  }
+}
+
+ProfileHandlePtr RandomProfile(uint length, bool with_hmm_data) {
+  const char * olc = "ACDEFGHIKLMNPQRSTVWY";
+  ProfileHandlePtr prof(new ProfileHandle);
+  for (uint i = 0; i < length; ++i) {
+    ProfileColumn col;
+    Real sum = 0;
+    for (uint j = 0; j < 20; ++j) {
+      col.freqs_begin()[j] = Real(rand() % 1000 + 1);
+      sum += col.freqs_begin()[j];
+    }
+    for (uint j = 0; j < 20; ++j) {
+      col.freqs_begin()[j] /= sum;
+    }
+    if (with_hmm_data) {
+      HMMDataPtr hmm_data(new HMMData);
+      for (uint j = 0; j < 7; ++j) {
+        hmm_data->SetProb(static_cast<HMMTransition>(j),
+                          Real(rand() % 1000) / 1000);
+      }
+      hmm_data->SetNeff(1 + Real(rand() % 100) / 10);
+      hmm_data->SetNeff_I(1 + Real(rand() % 100) / 10);
+      hmm_data->SetNeff_D(1 + Real(rand() % 100) / 10);
+      col.SetHMMData(hmm_data);
+    }
+    prof->AddColumn(col, olc[rand() % 20]);
+  }
+  prof->SetNeff(2.5);
+  return prof;
+}
+
 } // anon ns
 
 BOOST_AUTO_TEST_CASE(profile_column)
@@ -165,5 +227,96 @@ BOOST_AUTO_TEST_CASE(profile_handle)
   BOOST_CHECK_THROW(prof.Extract(3, 6), ost::Error);
 }
 
+BOOST_AUTO_TEST_CASE(profile_db)
+{
+  srand(42);
+  ProfileDB db;
+  std::vector<String> names;
+  std::vector<ProfileHandlePtr> profiles;
+  for (uint i = 0; i < 20; ++i) {
+    std::stringstream name;
+    name << "prof" << i;
+    names.push_back(name.str());
+    profiles.push_back(RandomProfile(rand() % 50, i % 3 != 0));
+    db.AddProfile(names.back(), profiles.back());
+  }
+  db.Save("test_profile_db_out.db");
+
+  // profiles are decoded from the mapped file
+  ProfileDBPtr loaded = ProfileDB::Load("test_profile_db_out.db");
+  BOOST_CHECK_EQUAL(loaded->size(), db.size());
+  std::vector<String> loaded_names = loaded->GetNames();
+  std::sort(loaded_names.begin(), loaded_names.end());
+  std::vector<String> db_names = db.GetNames();
+  BOOST_CHECK_EQUAL_COLLECTIONS(loaded_names.begin(), loaded_names.end(),
+                                db_names.begin(), db_names.end());
+  for (uint i = 0; i < names.size(); ++i) {
+    ProfileHandlePtr prof = loaded->GetProfile(names[i]);
+    CheckStoredProfile(*prof, *profiles[i]);
+    BOOST_CHECK_CLOSE(prof->GetNeff(), Real(2.5), Real(1e-4));
+  }
+  BOOST_CHECK_THROW(loaded->GetProfile("prof20"), ost::Error);
+  BOOST_CHECK_THROW(loaded->Save("test_profile_db_out.db"), ost::Error);
+  BOOST_CHECK_THROW(loaded->Save("./test_profile_db_out.db"), ost::Error);
+
+  // added profiles replace mapped ones, mapped ones are copied by Save()
+  ProfileHandlePtr replacement = RandomProfile(10, true);
+  loaded->AddProfile("prof3", replacement);
+  loaded->AddProfile("extra", RandomProfile(5, false));
+  BOOST_CHECK_EQUAL(loaded->size(), size_t(21));
+  BOOST_CHECK(loaded->GetProfile("prof3") == replacement);
+  loaded->Save("test_profile_db_out2.db");
+  ProfileDBPtr reloaded = ProfileDB::Load("test_profile_db_out2.db");
+  BOOST_CHECK_EQUAL(reloaded->size(), size_t(21));
+  CheckStoredProfile(*reloaded->GetProfile("prof3"), *replacement);
+  CheckStoredProfile(*reloaded->GetProfile("prof4"), *profiles[4]);
+  BOOST_CHECK_EQUAL(reloaded->GetProfile("extra")->size(), size_t(5));
+
+  // files of version 1 are still read
+  {
+    std::ofstream out("test_profile_db_v1.db", std::ios::binary);
+    uint32_t magic_number = 42;
+    uint8_t version = 1;
+    uint32_t total_size = 1;
+    char string_size = 4;
+    out.write(reinterpret_cast<char*>(&magic_number), sizeof(uint32_t));
+    out.write(reinterpret_cast<char*>(&version), sizeof(uint8_t));
+    out.write(reinterpret_cast<char*>(&total_size), sizeof(uint32_t));
+    out.write(&string_size, 1);
+    out.write("prof", 4);
+    out << *profiles[1];
+  }
+  ProfileDBPtr old_db = ProfileDB::Load("test_profile_db_v1.db");
+  BOOST_CHECK_EQUAL(old_db->size(), size_t(1));
+  CheckStoredProfile(*old_db->GetProfile("prof"), *profiles[1]);
+
+  // truncated files are detected when loading
+  {
+    std::ifstream in("test_profile_db_out.db", std::ios::binary);
+    String data((std::istreambuf_iterator<char>(in)),
+                std::istreambuf_iterator<char>());
+    std::ofstream out("test_profile_db_trunc.db", std::ios::binary);
+    out.write(data.data(), data.size() / 2);
+  }
+  BOOST_CHECK_THROW(ProfileDB::Load("test_profile_db_trunc.db"), ost::Error);
+
+  // an index right after the header leaves no room for records
+  {
+    std::ofstream out("test_profile_db_corrupt.db", std::ios::binary);
+    uint32_t magic_number = 42;
+    uint8_t version = 2;
+    uint32_t total_size = 1;
+    uint64_t index_offset = 4 + 1 + 4 + 8;
+    char string_size = 4;
+    out.write(reinterpret_cast<char*>(&magic_number), sizeof(uint32_t));
+    out.write(reinterpret_cast<char*>(&version), sizeof(uint8_t));
+    out.write(reinterpret_cast<char*>(&total_size), sizeof(uint32_t));
+    out.write(reinterpret_cast<char*>(&index_offset), sizeof(uint64_t));
+    out.write(&string_size, 1);
+    out.write("prof", 4);
+    out.write(reinterpret_cast<char*>(&index_offset), sizeof(uint64_t));
+  }
+  BOOST_CHECK_THROW(ProfileDB::Load("test_profile_db_corrupt.db"), ost::Error);
+}
 
 BOOST_AUTO_TEST_SUITE_END();